@@ -1,40 +1,170 @@
+#include <algorithm>
 #include <string>
-#include <iostream>
 #include <sstream>
-#include <cstdio>
+#include <stdexcept>
+#include <cstdlib>
+#include <vector>
 
-/* Create a MINC file using rawtominc.
- * The "args" argument contains arguments passed to "rawtominc".
+#include "itkMINCVolumeGenerator.h"
+
+/* Create a MINC file as rawtominc would, in-process.
+ * The "args" argument contains rawtominc arguments: an axis order
+ * (-xyz, ..., -zyx; -zyx by default), output type (-osigned,
+ * -ounsigned, -obyte, -oshort, -oint, -ofloat, -odouble),
+ * -real_range, -{x,y,z}start, -{x,y,z}step, -{x,y,z}dircos,
+ * -frame_times, -frame_widths and -vector, then the file name and
+ * the sizes, slowest-varying first.  The voxels are the bytes 0, 1,
+ * 2, ... (wrapping at 256) that used to be piped into rawtominc.
+ * MINC_COMPRESS is honoured.  Any other option, or a file that
+ * cannot be created, throws std::invalid_argument.
  * Files with 2, 3, or 4 dimensions may be created.
  */
 
 
 namespace detail {
 
-    std::string createMincFile( const std::string& args, 
+    std::vector<double> parseList( const std::string& list )
+    {
+	std::vector<double> values;
+	std::istringstream in( list );
+	std::string value;
+	while( std::getline( in, value, ',' ) )
+	    values.push_back( std::atof( value.c_str() ) );
+	return values;
+    }
+
+    std::string createMincFile( const std::string& args,
 				unsigned int sampleCount )
     {
-	std::string command( "rawtominc -clobber -2 -unsigned -byte " );
+	std::string command( "createMincFile " );
 	command += args;
-	//std::cout << "Executing [" << command << "]\n";
 
-	FILE* rawtominc = popen( command.c_str(), "w" );
+	std::istringstream in( args );
+	std::vector<std::string> words;
+	std::string word;
+	while( in >> word )
+	    words.push_back( word );
+
+	// Per world axis x, y, z
+	double start[3] = { 0, 0, 0 };
+	double step[3] = { 1, 1, 1 };
+	double cosines[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+	bool hasCosines[3] = { false, false, false };
+
+	std::string order( "zyx" );
+	std::string outputType( "byte" );
+	std::string outputSign;
+	double realMin = 0, realMax = 255;
+	std::vector<double> frameTimes, frameWidths;
+	unsigned long vectorSize = 0;
+	std::string filename;
+	std::vector<unsigned long> sizes;
 
-	unsigned char value = 0;
-	for( unsigned int i = 0; i < sampleCount; ++i )
+	for( size_t i = 0; i < words.size(); ++i )
 	{
-	    fwrite( &value, sizeof(value), 1, rawtominc );
-	    value += 1;
+	    const std::string& w = words[i];
+	    if ( w.size() == 4 && w[0] == '-'
+		 && w.find_first_not_of( "xyz", 1 ) == std::string::npos )
+		order = w.substr( 1 );
+	    else if ( w == "-osigned" || w == "-ounsigned" )
+		outputSign = w.substr( 2 );
+	    else if ( w == "-obyte" || w == "-oshort" || w == "-oint"
+		      || w == "-ofloat" || w == "-odouble" )
+		outputType = w.substr( 2 );
+	    else if ( w == "-real_range" && i + 2 < words.size() )
+	    {
+		realMin = std::atof( words[++i].c_str() );
+		realMax = std::atof( words[++i].c_str() );
+	    }
+	    else if ( w.size() == 7 && w[0] == '-' && w.substr( 2 ) == "start" && i + 1 < words.size() )
+		start[w[1] - 'x'] = std::atof( words[++i].c_str() );
+	    else if ( w.size() == 6 && w[0] == '-' && w.substr( 2 ) == "step" && i + 1 < words.size() )
+		step[w[1] - 'x'] = std::atof( words[++i].c_str() );
+	    else if ( w.size() == 8 && w[0] == '-' && w.substr( 2 ) == "dircos" && i + 3 < words.size() )
+	    {
+		const int axis = w[1] - 'x';
+		for( int c = 0; c < 3; ++c )
+		    cosines[axis][c] = std::atof( words[++i].c_str() );
+		hasCosines[axis] = true;
+	    }
+	    else if ( w == "-frame_times" && i + 1 < words.size() )
+		frameTimes = parseList( words[++i] );
+	    else if ( w == "-frame_widths" && i + 1 < words.size() )
+		frameWidths = parseList( words[++i] );
+	    else if ( w == "-vector" && i + 1 < words.size() )
+		vectorSize = std::atol( words[++i].c_str() );
+	    else if ( w[0] == '-' )
+		throw std::invalid_argument( "createMincFile: unsupported option " + w );
+	    else if ( filename.empty() )
+		filename = w;
+	    else
+		sizes.push_back( std::atol( w.c_str() ) );
+	}
+
+	itk::MINCVolumeGenerator generator;
+
+	// The spatial dimensions are the fastest-varying ones, in the
+	// order given; a fourth dimension is time.
+	const size_t numSpatial = std::min<size_t>( sizes.size(), 3 );
+	for( size_t d = 0; d < sizes.size(); ++d )
+	{
+	    if ( d + numSpatial < sizes.size() )
+	    {
+		generator.AddDimension( "time", sizes[d] );
+		if ( ! frameTimes.empty() )
+		{
+		    frameWidths.resize( frameTimes.size(), 0.0 );
+		    generator.SetDimensionOffsets( d, frameTimes, frameWidths );
+		}
+		continue;
+	    }
+
+	    const int axis = order[3 - sizes.size() + d] - 'x';
+	    generator.AddDimension( std::string( 1, order[3 - sizes.size() + d] ) + "space",
+				    sizes[d], start[axis], step[axis] );
+	    if ( hasCosines[axis] )
+		generator.SetDimensionCosines( d, cosines[axis] );
 	}
-	
-	pclose( rawtominc );
+	if ( vectorSize > 0 )
+	    generator.AddDimension( "vector_dimension", vectorSize );
+
+	// rawtominc's output sign defaults to the input's (unsigned)
+	// for bytes, and to signed for wider integers
+	const bool isSigned = outputSign.empty() ? outputType != "byte" : outputSign == "signed";
+	if ( outputType == "byte" )
+	    generator.SetComponentType( isSigned ? itk::ImageIOBase::CHAR : itk::ImageIOBase::UCHAR );
+	else if ( outputType == "short" )
+	    generator.SetComponentType( isSigned ? itk::ImageIOBase::SHORT : itk::ImageIOBase::USHORT );
+	else if ( outputType == "int" )
+	    generator.SetComponentType( isSigned ? itk::ImageIOBase::INT : itk::ImageIOBase::UINT );
+	else if ( outputType == "float" )
+	    generator.SetComponentType( itk::ImageIOBase::FLOAT );
+	else
+	    generator.SetComponentType( itk::ImageIOBase::DOUBLE );
+
+	generator.SetRealRange( realMin, realMax );
+	generator.SetFillPattern( itk::MINCVolumeGenerator::Ramp );
+
+	const char* compress = std::getenv( "MINC_COMPRESS" );
+	if ( compress )
+	    generator.SetCompressionLevel( std::atoi( compress ) );
+
+	unsigned long numSamples = 1;
+	for( size_t d = 0; d < sizes.size(); ++d )
+	    numSamples *= sizes[d];
+	if ( vectorSize > 0 )
+	    numSamples *= vectorSize;
+
+	if ( filename.empty() || numSamples != sampleCount
+	     || ! generator.Write( filename.c_str() ) )
+	    throw std::invalid_argument( "createMincFile: cannot create [" + command + "]" );
 
 	return command;
     }
 }
 
 
-std::string createMincFile( const std::string& extra_args, 
+std::string createMincFile( const std::string& extra_args,
 			    unsigned int size1,
 			    unsigned int size2 )
 {
@@ -44,7 +174,7 @@ std::string createMincFile( const std::string& extra_args,
 }
 
 
-std::string createMincFile( const std::string& extra_args, 
+std::string createMincFile( const std::string& extra_args,
 			    unsigned int size1,
 			    unsigned int size2,
 			    unsigned int size3 )
@@ -55,3 +185,13 @@ std::string createMincFile( const std::string& extra_args,
 }
 
 
+std::string createMincFile( const std::string& extra_args,
+			    unsigned int size1,
+			    unsigned int size2,
+			    unsigned int size3,
+			    unsigned int size4 )
+{
+    std::stringstream args;
+    args << extra_args << " " << size1 << " " << size2 << " " << size3 << " " << size4;
+    return detail::createMincFile( args.str(), size1 * size2 * size3 * size4 );
+}
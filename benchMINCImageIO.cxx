@@ -0,0 +1,325 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "itkMINCImageIO.h"
+#include "itkMINCVolumeCache.h"
+#include "itkMINCVolumeGenerator.h"
+
+/* Throughput of the read path of MINCImageIO: CanReadFile(),
+ * ReadImageInformation() and Read() of the whole volume, of a
+ * sub-region and of the whole volume as floats.  Volumes are written
+ * with MINCVolumeGenerator, once for all the benchmarks of each.
+ *
+ * By default each parameter (component type, chunk shape, compression
+ * level, axis order and volume size) is varied in turn around a
+ * baseline volume.  With --full, every combination is run; use
+ * --benchmark_filter to pick some out.  --frames=N makes the largest
+ * volume 512^3 x N.  Reads also report their read amplification, the
+ * bytes read from the file per byte returned.
+ */
+
+
+typedef itk::MINCImageIO ImageIO;
+
+
+namespace {
+
+struct ComponentTypeEntry
+{
+  itk::ImageIOBase::IOComponentType type;
+  const char* name;
+};
+
+const ComponentTypeEntry componentTypes[] = {
+  { itk::ImageIOBase::UCHAR, "uchar" },
+  { itk::ImageIOBase::CHAR, "char" },
+  { itk::ImageIOBase::USHORT, "ushort" },
+  { itk::ImageIOBase::SHORT, "short" },
+  { itk::ImageIOBase::UINT, "uint" },
+  { itk::ImageIOBase::INT, "int" },
+  { itk::ImageIOBase::FLOAT, "float" },
+  { itk::ImageIOBase::DOUBLE, "double" } };
+
+// Chunk edge along each spatial dimension of the file; 0 is the whole
+// dimension.
+struct ChunkShapeEntry
+{
+  const char* name;
+  unsigned int edge[3];
+};
+
+const ChunkShapeEntry chunkShapes[] = {
+  { "cube32", { 32, 32, 32 } },
+  { "cube64", { 64, 64, 64 } },
+  { "slice", { 1, 0, 0 } } };
+
+// 0 is uncompressed
+const int compressionLevels[] = { 0, 1, 4, 9 };
+
+// World axis of each file dimension, slowest-varying first
+const char* const axisOrders[] = { "xyz", "xzy", "yxz", "yzx", "zxy", "zyx" };
+
+const unsigned int volumeEdges[] = { 64, 128, 256, 512 };
+
+template<class T, size_t N>
+size_t Count( const T (&)[N] )
+{
+  return N;
+}
+
+struct VolumeSpec
+{
+  size_t componentType;
+  size_t chunkShape;
+  size_t compressionLevel;
+  size_t axisOrder;
+  unsigned int edge;
+  unsigned int frames;
+
+  std::string GetName() const
+  {
+    std::ostringstream name;
+    name << componentTypes[componentType].name
+	 << "/" << chunkShapes[chunkShape].name
+	 << "/z" << compressionLevels[compressionLevel]
+	 << "/" << axisOrders[axisOrder]
+	 << "/" << edge;
+    if ( frames > 1 )
+      name << "x" << frames;
+    return name.str();
+  }
+};
+
+const char* const FileName = "bench.mnc";
+
+// Name of the volume in FileName.  The benchmarks of a volume are
+// registered together, so each volume is written once.
+std::string WrittenVolume;
+
+void WriteVolume( const VolumeSpec& spec )
+{
+  if ( spec.GetName() == WrittenVolume )
+    return;
+
+  const unsigned int numDimensions = spec.frames > 1 ? 4 : 3;
+
+  itk::MINCVolumeGenerator generator;
+  generator.SetComponentType( componentTypes[spec.componentType].type );
+  generator.SetCompressionLevel( compressionLevels[spec.compressionLevel] );
+
+  // Smooth values with some noise, so that compression has some work
+  // to do
+  generator.SetFillPattern( itk::MINCVolumeGenerator::NoisyGradient );
+
+  std::vector<unsigned long> chunkSize( numDimensions, 1 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    // Dimensions are named after the world axis they lie along
+    generator.AddDimension( std::string( 1, axisOrders[spec.axisOrder][d] ) + "space", spec.edge );
+    chunkSize[d] = chunkShapes[spec.chunkShape].edge[d];
+    }
+  if ( numDimensions > 3 )
+    generator.AddDimension( "time", spec.frames );
+  generator.SetChunkSize( chunkSize );
+
+  if ( ! generator.Write( FileName ) )
+    {
+    std::fprintf( stderr, "cannot write %s\n", spec.GetName().c_str() );
+    std::exit( 1 );
+    }
+  WrittenVolume = spec.GetName();
+}
+
+void SetRates( benchmark::State& state, size_t numBytes, size_t numVoxels )
+{
+  state.counters["MB/s"] = benchmark::Counter( numBytes / 1e6,
+					       benchmark::Counter::kIsIterationInvariantRate );
+  state.counters["voxels/s"] = benchmark::Counter( static_cast<double>( numVoxels ),
+						   benchmark::Counter::kIsIterationInvariantRate );
+}
+
+void BM_CanReadFile( benchmark::State& state, VolumeSpec spec )
+{
+  WriteVolume( spec );
+
+  ImageIO::Pointer io = ImageIO::New();
+  while( state.KeepRunning() )
+    {
+    // Answers are cached per file: sniff it afresh each time
+    ImageIO::ClearCanReadFileCache();
+    benchmark::DoNotOptimize( io->CanReadFile( FileName ) );
+    }
+}
+
+void BM_ReadImageInformation( benchmark::State& state, VolumeSpec spec )
+{
+  WriteVolume( spec );
+
+  ImageIO::Pointer io = ImageIO::New();
+  io->SetFileName( FileName );
+  while( state.KeepRunning() )
+    {
+    // Open the file each time, as when scanning many files
+    itk::MINCVolumeCache::Clear();
+    io->ReadImageInformation();
+    }
+}
+
+// Read the whole volume or, with subRegion, the middle half of each
+// spatial dimension, as componentType (by default the type stored).
+void BM_Read( benchmark::State& state, VolumeSpec spec, bool subRegion,
+	      itk::ImageIOBase::IOComponentType componentType )
+{
+  WriteVolume( spec );
+
+  ImageIO::Pointer io = ImageIO::New();
+  io->SetFileName( FileName );
+  io->SetRequestedComponentType( componentType );
+  io->ReadImageInformation();
+
+  const unsigned int numDimensions = io->GetNumberOfDimensions();
+  itk::ImageIORegion region( numDimensions );
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    const unsigned long size = io->GetDimensions( d );
+    if ( subRegion && d < 3 )
+      {
+      region.SetIndex( d, size / 4 );
+      region.SetSize( d, size / 2 );
+      }
+    else
+      {
+      region.SetSize( d, size );
+      }
+    }
+  io->SetIORegion( region );
+
+  // Counted over the timed reads only
+  io->CollectReadStatisticsOn();
+  io->ResetReadStatistics();
+
+  const size_t numVoxels = region.GetNumberOfPixels();
+  const size_t numBytes = numVoxels * io->GetNumberOfComponents() * io->GetComponentSize();
+  std::vector<char> buffer( numBytes );
+
+  while( state.KeepRunning() )
+    {
+    io->Read( &buffer[0] );
+    benchmark::ClobberMemory();
+    }
+
+  SetRates( state, numBytes, numVoxels );
+
+  // Bytes read from the file per byte read into the buffer, and the
+  // work of each read
+  const itk::MINCReadStatistics& statistics = io->GetReadStatistics();
+  state.counters["amplification"] = statistics.GetReadAmplification();
+  state.counters["chunks"] = benchmark::Counter( static_cast<double>( statistics.chunksRead ),
+						 benchmark::Counter::kAvgIterations );
+  state.counters["decompressed"] = benchmark::Counter( static_cast<double>( statistics.chunksDecompressed ),
+						       benchmark::Counter::kAvgIterations );
+  state.counters["cacheHits"] = benchmark::Counter( static_cast<double>( statistics.chunkCacheHits ),
+						    benchmark::Counter::kAvgIterations );
+}
+
+void RegisterVolume( const VolumeSpec& spec )
+{
+  const std::string name = spec.GetName();
+
+  benchmark::RegisterBenchmark( ( "CanReadFile/" + name ).c_str(), BM_CanReadFile, spec );
+  benchmark::RegisterBenchmark( ( "ReadImageInformation/" + name ).c_str(), BM_ReadImageInformation, spec );
+  benchmark::RegisterBenchmark( ( "Read/" + name ).c_str(), BM_Read, spec, false,
+			       itk::ImageIOBase::UNKNOWNCOMPONENTTYPE )
+    ->Unit( benchmark::kMillisecond );
+  benchmark::RegisterBenchmark( ( "ReadRegion/" + name ).c_str(), BM_Read, spec, true,
+			       itk::ImageIOBase::UNKNOWNCOMPONENTTYPE )
+    ->Unit( benchmark::kMillisecond );
+  benchmark::RegisterBenchmark( ( "ReadFloat/" + name ).c_str(), BM_Read, spec, false,
+			       itk::ImageIOBase::FLOAT )
+    ->Unit( benchmark::kMillisecond );
+}
+
+void RegisterBenchmarks( bool full, unsigned int frames )
+{
+  VolumeSpec spec;
+
+  if ( full )
+    {
+    for( spec.componentType = 0; spec.componentType < Count( componentTypes ); ++spec.componentType )
+      for( spec.chunkShape = 0; spec.chunkShape < Count( chunkShapes ); ++spec.chunkShape )
+	for( spec.compressionLevel = 0; spec.compressionLevel < Count( compressionLevels ); ++spec.compressionLevel )
+	  for( spec.axisOrder = 0; spec.axisOrder < Count( axisOrders ); ++spec.axisOrder )
+	    for( size_t e = 0; e < Count( volumeEdges ); ++e )
+	      {
+	      spec.edge = volumeEdges[e];
+	      spec.frames = spec.edge == 512 ? frames : 1;
+	      RegisterVolume( spec );
+	      }
+    return;
+    }
+
+  // A 128^3 volume of shorts in 32^3 chunks, uncompressed, in xyz
+  // order, then each parameter varied in turn
+  const VolumeSpec baseline = { 3, 0, 0, 0, 128, 1 };
+  RegisterVolume( baseline );
+
+  for( spec = baseline; spec.componentType < Count( componentTypes ); ++spec.componentType )
+    if ( spec.componentType != baseline.componentType )
+      RegisterVolume( spec );
+  for( spec = baseline; spec.chunkShape < Count( chunkShapes ); ++spec.chunkShape )
+    if ( spec.chunkShape != baseline.chunkShape )
+      RegisterVolume( spec );
+  for( spec = baseline; spec.compressionLevel < Count( compressionLevels ); ++spec.compressionLevel )
+    if ( spec.compressionLevel != baseline.compressionLevel )
+      RegisterVolume( spec );
+  for( spec = baseline; spec.axisOrder < Count( axisOrders ); ++spec.axisOrder )
+    if ( spec.axisOrder != baseline.axisOrder )
+      RegisterVolume( spec );
+  for( size_t e = 0; e < Count( volumeEdges ); ++e )
+    {
+    spec = baseline;
+    spec.edge = volumeEdges[e];
+    spec.frames = spec.edge == 512 ? frames : 1;
+    if ( spec.edge != baseline.edge )
+      RegisterVolume( spec );
+    }
+}
+
+} // end of unnamed namespace
+
+
+int main( int argc, char** argv )
+{
+  // Our own flags are taken out before the benchmark library sees them
+  bool full = false;
+  unsigned int frames = 1;
+
+  int numArgs = 1;
+  for( int i = 1; i < argc; ++i )
+    {
+    if ( std::strcmp( argv[i], "--full" ) == 0 )
+      full = true;
+    else if ( std::strncmp( argv[i], "--frames=", 9 ) == 0 )
+      frames = std::max( 1, std::atoi( argv[i] + 9 ) );
+    else
+      argv[numArgs++] = argv[i];
+    }
+  argc = numArgs;
+
+  benchmark::Initialize( &argc, argv );
+  if ( benchmark::ReportUnrecognizedArguments( argc, argv ) )
+    return 1;
+
+  RegisterBenchmarks( full, frames );
+  benchmark::RunSpecifiedBenchmarks();
+
+  std::remove( FileName );
+  return 0;
+}
@@ -0,0 +1,410 @@
+#include "itkMINCAxisPermuter.h"
+
+#include "itkMultiThreader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#  define ITK_MINC_PERMUTE_SSE2 1
+#  include <emmintrin.h>
+#else
+#  define ITK_MINC_PERMUTE_SSE2 0
+#endif
+
+
+
+namespace itk {
+
+
+namespace {
+
+// Side, in elements, of the blocks transposed at once.  Rows of the
+// input are often a power of two apart, so few of them fit in the L1
+// cache at once.
+const size_t BlockSize = 16;
+
+// 16-byte elements, such as complex doubles
+struct Element16
+{
+  unsigned long long low;
+  unsigned long long high;
+};
+
+/**
+ * Transpose of a Size x Size tile: out[j * outStride + i] =
+ * in[i * inStride + j].  Strides are in elements.
+ */
+template <class T>
+struct TileTranspose
+{
+  enum { Size = 1 };
+
+  static void Transpose( const T* in, size_t, T* out, size_t )
+  {
+    *out = *in;
+  }
+};
+
+#if ITK_MINC_PERMUTE_SSE2
+
+template <>
+struct TileTranspose<unsigned int>
+{
+  enum { Size = 4 };
+
+  static void Transpose( const unsigned int* in, size_t inStride,
+			 unsigned int* out, size_t outStride )
+  {
+    __m128i r0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in ) );
+    __m128i r1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + inStride ) );
+    __m128i r2 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + 2 * inStride ) );
+    __m128i r3 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + 3 * inStride ) );
+
+    const __m128i t0 = _mm_unpacklo_epi32( r0, r1 );
+    const __m128i t1 = _mm_unpacklo_epi32( r2, r3 );
+    const __m128i t2 = _mm_unpackhi_epi32( r0, r1 );
+    const __m128i t3 = _mm_unpackhi_epi32( r2, r3 );
+
+    r0 = _mm_unpacklo_epi64( t0, t1 );
+    r1 = _mm_unpackhi_epi64( t0, t1 );
+    r2 = _mm_unpacklo_epi64( t2, t3 );
+    r3 = _mm_unpackhi_epi64( t2, t3 );
+
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( out ), r0 );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( out + outStride ), r1 );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( out + 2 * outStride ), r2 );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( out + 3 * outStride ), r3 );
+  }
+};
+
+template <>
+struct TileTranspose<unsigned short>
+{
+  enum { Size = 8 };
+
+  static void Transpose( const unsigned short* in, size_t inStride,
+			 unsigned short* out, size_t outStride )
+  {
+    __m128i r[8];
+    for( int i = 0; i < 8; ++i )
+      r[i] = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + i * inStride ) );
+
+    // Interleave 16-, then 32-, then 64-bit pieces of row pairs
+    __m128i a[8];
+    for( int i = 0; i < 4; ++i )
+      {
+      a[i] = _mm_unpacklo_epi16( r[2*i], r[2*i+1] );
+      a[i+4] = _mm_unpackhi_epi16( r[2*i], r[2*i+1] );
+      }
+
+    __m128i b[8];
+    for( int h = 0; h < 8; h += 4 )
+      {
+      b[h] = _mm_unpacklo_epi32( a[h], a[h+1] );
+      b[h+1] = _mm_unpackhi_epi32( a[h], a[h+1] );
+      b[h+2] = _mm_unpacklo_epi32( a[h+2], a[h+3] );
+      b[h+3] = _mm_unpackhi_epi32( a[h+2], a[h+3] );
+      }
+
+    for( int h = 0; h < 8; h += 4 )
+      {
+      r[h] = _mm_unpacklo_epi64( b[h], b[h+2] );
+      r[h+1] = _mm_unpackhi_epi64( b[h], b[h+2] );
+      r[h+2] = _mm_unpacklo_epi64( b[h+1], b[h+3] );
+      r[h+3] = _mm_unpackhi_epi64( b[h+1], b[h+3] );
+      }
+
+    for( int j = 0; j < 8; ++j )
+      _mm_storeu_si128( reinterpret_cast<__m128i*>( out + j * outStride ), r[j] );
+  }
+};
+
+template <>
+struct TileTranspose<unsigned char>
+{
+  enum { Size = 8 };
+
+  static void Transpose( const unsigned char* in, size_t inStride,
+			 unsigned char* out, size_t outStride )
+  {
+    __m128i r[8];
+    for( int i = 0; i < 8; ++i )
+      r[i] = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( in + i * inStride ) );
+
+    // Rows 2i and 2i+1 interleaved, then four rows, then all eight:
+    // each register ends up holding two columns.
+    __m128i a[4];
+    for( int i = 0; i < 4; ++i )
+      a[i] = _mm_unpacklo_epi8( r[2*i], r[2*i+1] );
+
+    const __m128i b0 = _mm_unpacklo_epi16( a[0], a[1] );
+    const __m128i b1 = _mm_unpackhi_epi16( a[0], a[1] );
+    const __m128i b2 = _mm_unpacklo_epi16( a[2], a[3] );
+    const __m128i b3 = _mm_unpackhi_epi16( a[2], a[3] );
+
+    const __m128i c[4] = { _mm_unpacklo_epi32( b0, b2 ), _mm_unpackhi_epi32( b0, b2 ),
+			   _mm_unpacklo_epi32( b1, b3 ), _mm_unpackhi_epi32( b1, b3 ) };
+
+    for( int j = 0; j < 4; ++j )
+      {
+      _mm_storel_epi64( reinterpret_cast<__m128i*>( out + 2 * j * outStride ), c[j] );
+      _mm_storel_epi64( reinterpret_cast<__m128i*>( out + ( 2 * j + 1 ) * outStride ),
+			_mm_unpackhi_epi64( c[j], c[j] ) );
+      }
+  }
+};
+
+#endif
+
+/**
+ * out[j * outStride + i] = in[i * inStride + j] for i < rows and
+ * j < cols, block by block.
+ */
+template <class T>
+void Transpose( const T* in, size_t inStride, T* out, size_t outStride,
+		size_t rows, size_t cols )
+{
+  const size_t K = TileTranspose<T>::Size;
+
+  for( size_t i0 = 0; i0 < rows; i0 += BlockSize )
+    {
+    const size_t i1 = std::min( i0 + BlockSize, rows );
+    for( size_t j0 = 0; j0 < cols; j0 += BlockSize )
+      {
+      const size_t j1 = std::min( j0 + BlockSize, cols );
+
+      size_t i = i0;
+      for( ; i + K <= i1; i += K )
+	{
+	size_t j = j0;
+	for( ; j + K <= j1; j += K )
+	  TileTranspose<T>::Transpose( in + i * inStride + j, inStride,
+				       out + j * outStride + i, outStride );
+	for( ; j < j1; ++j )
+	  for( size_t r = i; r < i + K; ++r )
+	    out[j * outStride + r] = in[r * inStride + j];
+	}
+      for( ; i < i1; ++i )
+	for( size_t j = j0; j < j1; ++j )
+	  out[j * outStride + i] = in[i * inStride + j];
+      }
+    }
+}
+
+// The same, for elements of any size
+void TransposeBytes( const char* in, size_t inStride, char* out, size_t outStride,
+		     size_t rows, size_t cols, size_t elementSize )
+{
+  for( size_t i0 = 0; i0 < rows; i0 += BlockSize )
+    for( size_t j0 = 0; j0 < cols; j0 += BlockSize )
+      for( size_t i = i0; i < std::min( i0 + BlockSize, rows ); ++i )
+	for( size_t j = j0; j < std::min( j0 + BlockSize, cols ); ++j )
+	  std::memcpy( out + ( j * outStride + i ) * elementSize,
+		       in + ( i * inStride + j ) * elementSize, elementSize );
+}
+
+void Transpose( const char* in, size_t inStride, char* out, size_t outStride,
+		size_t rows, size_t cols, size_t elementSize )
+{
+  switch( elementSize )
+    {
+    case 1:
+      Transpose( reinterpret_cast<const unsigned char*>( in ), inStride,
+		 reinterpret_cast<unsigned char*>( out ), outStride, rows, cols );
+      break;
+    case 2:
+      Transpose( reinterpret_cast<const unsigned short*>( in ), inStride,
+		 reinterpret_cast<unsigned short*>( out ), outStride, rows, cols );
+      break;
+    case 4:
+      Transpose( reinterpret_cast<const unsigned int*>( in ), inStride,
+		 reinterpret_cast<unsigned int*>( out ), outStride, rows, cols );
+      break;
+    case 8:
+      Transpose( reinterpret_cast<const unsigned long long*>( in ), inStride,
+		 reinterpret_cast<unsigned long long*>( out ), outStride, rows, cols );
+      break;
+    case 16:
+      Transpose( reinterpret_cast<const Element16*>( in ), inStride,
+		 reinterpret_cast<Element16*>( out ), outStride, rows, cols );
+      break;
+    default:
+      TransposeBytes( in, inStride, out, outStride, rows, cols, elementSize );
+    }
+}
+
+/**
+ * A permutation, as a stack of planes: rows copied whole when the
+ * fastest-varying dimension stays in place, else 2D transposes.
+ * The dimensions other than the last and inner are indexed by the
+ * plane number; each plane is cut across its rows into pieces, so
+ * that a single plane can be shared out too.
+ */
+struct PermuteJob
+{
+  const char* input;
+  char* output;
+  size_t elementSize;
+
+  // Sizes of the input dimensions, the input dimension of each output
+  // dimension, and the strides of both, in elements
+  std::vector<unsigned long> sizes;
+  std::vector<unsigned int> order;
+  std::vector<size_t> inStrides;
+  std::vector<size_t> outStrides;
+
+  // The output dimension that is the fastest-varying input dimension
+  int inner;
+
+  size_t numPlanes;
+  size_t numPieces;
+};
+
+void PermutePlanes( const PermuteJob& job, size_t first, size_t last )
+{
+  const int n = static_cast<int>( job.sizes.size() );
+  const bool rows = job.inner == n - 1;
+  const size_t numRows = rows ? 1 : job.sizes[job.order[n-1]];
+
+  for( size_t p = first; p < last; ++p )
+    {
+    // Index of the plane, fastest-varying dimension last
+    size_t plane = p / job.numPieces;
+    size_t inOffset = 0;
+    size_t outOffset = 0;
+    for( int k = n - 2; k >= 0; --k )
+      {
+      if ( k == job.inner )
+	continue;
+      const size_t size = job.sizes[job.order[k]];
+      inOffset += ( plane % size ) * job.inStrides[job.order[k]];
+      outOffset += ( plane % size ) * job.outStrides[k];
+      plane /= size;
+      }
+
+    if ( rows )
+      {
+      std::memcpy( job.output + outOffset * job.elementSize,
+		   job.input + inOffset * job.elementSize,
+		   job.sizes[n-1] * job.elementSize );
+      continue;
+      }
+
+    // Rows of the piece, along the fastest-varying output dimension
+    const size_t piece = p % job.numPieces;
+    const size_t firstRow = numRows * piece / job.numPieces;
+    const size_t lastRow = numRows * ( piece + 1 ) / job.numPieces;
+    const size_t inStride = job.inStrides[job.order[n-1]];
+
+    Transpose( job.input + ( inOffset + firstRow * inStride ) * job.elementSize, inStride,
+	       job.output + ( outOffset + firstRow ) * job.elementSize, job.outStrides[job.inner],
+	       lastRow - firstRow, job.sizes[n-1], job.elementSize );
+    }
+}
+
+ITK_THREAD_RETURN_TYPE PermuteThreadCallback( void* arg )
+{
+  MultiThreader::ThreadInfoStruct* info
+    = static_cast<MultiThreader::ThreadInfoStruct*>( arg );
+  const PermuteJob* job = static_cast<const PermuteJob*>( info->UserData );
+
+  const size_t numItems = job->numPlanes * job->numPieces;
+  PermutePlanes( *job,
+		 numItems * info->ThreadID / info->NumberOfThreads,
+		 numItems * ( info->ThreadID + 1 ) / info->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+} // end of unnamed namespace
+
+
+void MINCAxisPermuter::Permute( const void* in,
+				const unsigned long inSizes[],
+				const unsigned int axes[],
+				unsigned int numDimensions,
+				size_t elementSize,
+				void* out,
+				int numberOfThreads )
+{
+  PermuteJob job;
+  job.input = static_cast<const char*>( in );
+  job.output = static_cast<char*>( out );
+  job.elementSize = elementSize;
+
+  // Dimensions of size 1 do not move anything; drop them.
+  std::vector<unsigned int> renumber( numDimensions );
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    if ( inSizes[d] == 0 )
+      return;
+    renumber[d] = job.sizes.size();
+    if ( inSizes[d] > 1 )
+      job.sizes.push_back( inSizes[d] );
+    }
+
+  for( unsigned int k = 0; k < numDimensions; ++k )
+    {
+    if ( inSizes[axes[k]] > 1 )
+      job.order.push_back( renumber[axes[k]] );
+    }
+
+  const int n = static_cast<int>( job.sizes.size() );
+  if ( n == 0 )
+    {
+    std::memcpy( out, in, elementSize );
+    return;
+    }
+
+  size_t numElements = 1;
+  job.inStrides.resize( n );
+  for( int d = n - 1; d >= 0; --d )
+    {
+    job.inStrides[d] = numElements;
+    numElements *= job.sizes[d];
+    }
+  numElements = 1;
+  job.outStrides.resize( n );
+  for( int k = n - 1; k >= 0; --k )
+    {
+    job.outStrides[k] = numElements;
+    numElements *= job.sizes[job.order[k]];
+    }
+
+  job.inner = 0;
+  while( job.order[job.inner] != static_cast<unsigned int>( n - 1 ) )
+    ++job.inner;
+
+  job.numPlanes = 1;
+  for( int k = 0; k < n - 1; ++k )
+    {
+    if ( k != job.inner )
+      job.numPlanes *= job.sizes[job.order[k]];
+    }
+
+  // Cut planes into pieces when there are too few to go round, but
+  // not below a block of rows each.
+  job.numPieces = 1;
+  if ( job.inner != n - 1 && job.numPlanes < static_cast<size_t>( numberOfThreads ) )
+    {
+    job.numPieces = std::min( ( numberOfThreads + job.numPlanes - 1 ) / job.numPlanes,
+			      ( job.sizes[job.order[n-1]] + BlockSize - 1 ) / BlockSize );
+    }
+
+  const size_t numItems = job.numPlanes * job.numPieces;
+  const int numThreads = static_cast<int>( std::min<size_t>( std::max( numberOfThreads, 1 ), numItems ) );
+  if ( numThreads <= 1 )
+    {
+    PermutePlanes( job, 0, numItems );
+    return;
+    }
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( numThreads );
+  threader->SetSingleMethod( PermuteThreadCallback, &job );
+  threader->SingleMethodExecute();
+}
+
+} // namespace itk
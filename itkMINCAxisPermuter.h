@@ -0,0 +1,60 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCAxisPermuter.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCAxisPermuter_h
+#define __itkMINCAxisPermuter_h
+
+#include <cstddef>
+
+
+namespace itk
+{
+
+/** \class MINCAxisPermuter
+ *
+ * \brief Reordering of the dimensions of an array of voxels.
+ *
+ * When the fastest-varying dimension stays in place, rows are copied
+ * whole.  Otherwise the array is a stack of 2D transposes, which are
+ * done in blocks small enough for both sides to stay in the L1
+ * cache; on x86 the blocks of 1-, 2- and 4-byte elements are transposed
+ * with SSE2.  Either way the cost is close to that of a plain copy,
+ * and the planes are shared out among threads.
+ *
+ * \ingroup IOFilters
+ */
+class MINCAxisPermuter
+{
+public:
+  // Copy the array in, of numDimensions dimensions with sizes inSizes
+  // (slowest-varying first) and elements of elementSize bytes, to out
+  // with its dimensions reordered: dimension k of out is dimension
+  // axes[k] of in.  The arrays must not overlap.  The work is shared
+  // out among numberOfThreads threads.
+  static void Permute( const void* in,
+                       const unsigned long inSizes[],
+                       const unsigned int axes[],
+                       unsigned int numDimensions,
+                       size_t elementSize,
+                       void* out,
+                       int numberOfThreads = 1 );
+
+private:
+  MINCAxisPermuter(); //purposely not implemented
+};
+
+} // end namespace itk
+
+#endif // __itkMINCAxisPermuter_h
@@ -0,0 +1,384 @@
+#include "itkMINCCatalog.h"
+#include "itkMINCFileStamp.h"
+#include "itkMINCImageIO.h"
+#include "itkMINCRawFile.h"
+#include "itkMINCSerialization.h"
+#include "itkMetaDataObject.h"
+#include "itkMultiThreader.h"
+#include "itkMutexLockHolder.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <algorithm>
+#include <fstream>
+
+
+
+namespace itk {
+
+
+namespace {
+
+using namespace MINCSerialization;
+
+// Files looked up per thread of the pool in each batch; the next batch
+// is looked up while this one is parsed.
+const size_t FilesPerThread = 16;
+
+// Start of an index file, followed by its version and a byte order
+// mark.
+const char IndexMagic[8] = { 'M', 'I', 'N', 'C', 'C', 'A', 'T', '\0' };
+const unsigned int IndexVersion = 2;
+const unsigned int IndexByteOrderMark = 0x01020304;
+
+struct FileStatus
+{
+  FileStatus()
+    : found( false )
+  {
+  }
+
+  bool found;
+  MINCFileStamp stamp;
+};
+
+// Files [next, last) of fileNames left to look up
+struct PrefetchBatch
+{
+  const std::vector<std::string>* fileNames;
+  std::vector<FileStatus>* status;
+  size_t prefetchSize;
+  int numberOfThreads;
+
+  size_t next;
+  size_t last;
+  SimpleFastMutexLock lock;
+};
+
+void PrefetchFile( const std::string& fileName, size_t prefetchSize,
+		   FileStatus& status, std::vector<char>& buffer )
+{
+  if ( ! status.stamp.Read( fileName.c_str() ) )
+    return;
+  status.found = true;
+
+  const size_t numBytes = static_cast<size_t>( std::min<unsigned long long>( prefetchSize, status.stamp.size ) );
+  if ( numBytes == 0 )
+    return;
+
+  // The bytes are only wanted in the page cache, where HDF5 finds
+  // them
+  MINCRawFile file;
+  if ( file.Open( fileName.c_str() ) )
+    {
+    buffer.resize( numBytes );
+    file.Read( 0, numBytes, &buffer[0] );
+    }
+}
+
+void PrefetchFiles( PrefetchBatch* batch )
+{
+  std::vector<char> buffer;
+  for( ;; )
+    {
+    size_t i;
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder( batch->lock );
+    if ( batch->next >= batch->last )
+      break;
+    i = batch->next++;
+    }
+    PrefetchFile( (*batch->fileNames)[i], batch->prefetchSize, (*batch->status)[i], buffer );
+    }
+}
+
+ITK_THREAD_RETURN_TYPE PrefetchFilesThreadCallback( void* arg )
+{
+  MultiThreader::ThreadInfoStruct* info
+    = static_cast<MultiThreader::ThreadInfoStruct*>( arg );
+  PrefetchFiles( static_cast<PrefetchBatch*>( info->UserData ) );
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+// Runs the pool looking up a batch, off the calling thread
+ITK_THREAD_RETURN_TYPE PrefetchBatchThreadCallback( void* arg )
+{
+  MultiThreader::ThreadInfoStruct* info
+    = static_cast<MultiThreader::ThreadInfoStruct*>( arg );
+  PrefetchBatch* batch = static_cast<PrefetchBatch*>( info->UserData );
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( batch->numberOfThreads );
+  threader->SetSingleMethod( PrefetchFilesThreadCallback, batch );
+  threader->SingleMethodExecute();
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void WriteEntry( std::ostream& out, const MINCCatalogEntry& entry )
+{
+  WriteString( out, entry.fileName );
+  WriteValue( out, entry.fileSize );
+  WriteValue( out, entry.modificationTime );
+  WriteValue( out, entry.modificationNanoseconds );
+  WriteString( out, entry.error );
+
+  WriteValue( out, static_cast<int>( entry.pixelType ) );
+  WriteValue( out, static_cast<int>( entry.componentType ) );
+  WriteValue( out, entry.numberOfComponents );
+  WriteValue( out, static_cast<unsigned char>( entry.labels ) );
+
+  WriteVector<unsigned long long>( out, entry.dimensions );
+  WriteVector<double>( out, entry.spacing );
+  WriteVector<double>( out, entry.origin );
+  WriteValue( out, static_cast<unsigned int>( entry.direction.size() ) );
+  for( size_t d = 0; d < entry.direction.size(); ++d )
+    WriteVector<double>( out, entry.direction[d] );
+
+  WriteVector<unsigned int>( out, entry.chunkSize );
+  WriteValue( out, entry.compressionLevel );
+  WriteVector<double>( out, entry.rescaleSlope );
+  WriteVector<double>( out, entry.rescaleIntercept );
+  WriteValue( out, entry.numberOfResolutionLevels );
+}
+
+bool ReadEntry( std::istream& in, MINCCatalogEntry& entry )
+{
+  int pixelType, componentType;
+  unsigned char labels;
+  unsigned int numDirections;
+
+  if ( ! ReadString( in, entry.fileName )
+       || ! ReadValue( in, entry.fileSize )
+       || ! ReadValue( in, entry.modificationTime )
+       || ! ReadValue( in, entry.modificationNanoseconds )
+       || ! ReadString( in, entry.error )
+       || ! ReadValue( in, pixelType )
+       || ! ReadValue( in, componentType )
+       || ! ReadValue( in, entry.numberOfComponents )
+       || ! ReadValue( in, labels )
+       || ! ReadVector<unsigned long long>( in, entry.dimensions )
+       || ! ReadVector<double>( in, entry.spacing )
+       || ! ReadVector<double>( in, entry.origin )
+       || ! ReadValue( in, numDirections ) )
+    {
+    return false;
+    }
+
+  entry.pixelType = static_cast<ImageIOBase::IOPixelType>( pixelType );
+  entry.componentType = static_cast<ImageIOBase::IOComponentType>( componentType );
+  entry.labels = labels != 0;
+
+  entry.direction.clear();
+  for( unsigned int d = 0; d < numDirections; ++d )
+    {
+    entry.direction.push_back( std::vector<double>() );
+    if ( ! ReadVector<double>( in, entry.direction.back() ) )
+      return false;
+    }
+
+  return ReadVector<unsigned int>( in, entry.chunkSize )
+    && ReadValue( in, entry.compressionLevel )
+    && ReadVector<double>( in, entry.rescaleSlope )
+    && ReadVector<double>( in, entry.rescaleIntercept )
+    && ReadValue( in, entry.numberOfResolutionLevels );
+}
+
+} // end of unnamed namespace
+
+
+MINCCatalog::MINCCatalog()
+  : m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() ),
+    m_PrefetchSize( 64 * 1024 )
+{
+}
+
+size_t MINCCatalog::Scan( const std::vector<std::string>& fileNames )
+{
+  const size_t numFiles = fileNames.size();
+  std::vector<FileStatus> status( numFiles );
+
+  PrefetchBatch batch;
+  batch.fileNames = &fileNames;
+  batch.status = &status;
+  batch.prefetchSize = m_PrefetchSize;
+  batch.numberOfThreads = std::max( m_NumberOfThreads, 1 );
+  batch.next = batch.last = 0;
+
+  const size_t batchSize = FilesPerThread * batch.numberOfThreads;
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  int threadID = -1;
+
+  size_t numRead = 0;
+  for( size_t first = 0; first < numFiles; )
+    {
+    // Finish looking up this batch, then start on the next one
+    if ( threadID >= 0 )
+      {
+      threader->TerminateThread( threadID );
+      threadID = -1;
+      }
+    if ( batch.last == first )
+      {
+      batch.last = std::min( first + batchSize, numFiles );
+      PrefetchFiles( &batch );
+      }
+    const size_t last = batch.last;
+
+    if ( last < numFiles )
+      {
+      batch.last = std::min( last + batchSize, numFiles );
+      threadID = threader->SpawnThread( PrefetchBatchThreadCallback, &batch );
+      }
+
+    for( size_t i = first; i < last; ++i )
+      {
+      MINCCatalogEntry entry;
+      entry.fileName = fileNames[i];
+      if ( status[i].found )
+	{
+	entry.fileSize = status[i].stamp.size;
+	entry.modificationTime = status[i].stamp.seconds;
+	entry.modificationNanoseconds = status[i].stamp.nanoseconds;
+	ReadHeader( entry );
+	}
+      else
+	{
+	entry.error = "cannot find file";
+	}
+
+      if ( entry.IsValid() )
+	++numRead;
+      this->AddEntry( entry );
+      }
+
+    // Without a thread, the next batch is looked up on this one
+    if ( threadID < 0 )
+      batch.last = last;
+    first = last;
+    }
+
+  return numRead;
+}
+
+void MINCCatalog::ReadHeader( MINCCatalogEntry& entry )
+{
+  MINCImageIO::Pointer io = MINCImageIO::New();
+  if ( ! io->CanReadFile( entry.fileName.c_str() ) )
+    {
+    entry.error = "not a MINC file";
+    return;
+    }
+
+  // Nothing but the header is read
+  io->UseMemoryMappingOff();
+  io->SetFileName( entry.fileName.c_str() );
+  try
+    {
+    io->ReadImageInformation();
+    }
+  catch( ExceptionObject& e )
+    {
+    entry.error = e.GetDescription();
+    if ( entry.error.empty() )
+      entry.error = "cannot read header";
+    return;
+    }
+
+  entry.pixelType = io->GetPixelType();
+  entry.componentType = io->GetComponentType();
+  entry.numberOfComponents = io->GetNumberOfComponents();
+  entry.labels = io->IsLabelImage();
+
+  const unsigned int numDimensions = io->GetNumberOfDimensions();
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    entry.dimensions.push_back( io->GetDimensions( d ) );
+    entry.spacing.push_back( io->GetSpacing( d ) );
+    entry.origin.push_back( io->GetOrigin( d ) );
+    entry.direction.push_back( io->GetDirection( d ) );
+    entry.chunkSize.push_back( io->GetChunkSize( d ) );
+    }
+  entry.compressionLevel = io->GetStoredCompressionLevel();
+
+  const MetaDataDictionary& dictionary = io->GetMetaDataDictionary();
+  ExposeMetaData< std::vector<double> >( dictionary, "MINC_RescaleSlope", entry.rescaleSlope );
+  ExposeMetaData< std::vector<double> >( dictionary, "MINC_RescaleIntercept", entry.rescaleIntercept );
+
+  entry.numberOfResolutionLevels = io->GetNumberOfResolutionLevels();
+}
+
+void MINCCatalog::AddEntry( const MINCCatalogEntry& entry )
+{
+  std::map<std::string, size_t>::const_iterator found = m_Index.find( entry.fileName );
+  if ( found != m_Index.end() )
+    {
+    m_Entries[found->second] = entry;
+    return;
+    }
+
+  m_Index[entry.fileName] = m_Entries.size();
+  m_Entries.push_back( entry );
+}
+
+void MINCCatalog::Clear()
+{
+  m_Entries.clear();
+  m_Index.clear();
+}
+
+const MINCCatalogEntry* MINCCatalog::Find( const std::string& fileName ) const
+{
+  std::map<std::string, size_t>::const_iterator found = m_Index.find( fileName );
+  return found == m_Index.end() ? 0 : &m_Entries[found->second];
+}
+
+bool MINCCatalog::Write( const char* fileName ) const
+{
+  std::ofstream out( fileName, std::ios::binary | std::ios::trunc );
+  if ( ! out )
+    return false;
+
+  out.write( IndexMagic, sizeof( IndexMagic ) );
+  WriteValue( out, IndexVersion );
+  WriteValue( out, IndexByteOrderMark );
+  WriteValue( out, static_cast<unsigned long long>( m_Entries.size() ) );
+  for( size_t i = 0; i < m_Entries.size(); ++i )
+    WriteEntry( out, m_Entries[i] );
+
+  out.close();
+  return ! out.fail();
+}
+
+bool MINCCatalog::Read( const char* fileName )
+{
+  std::ifstream in( fileName, std::ios::binary );
+  if ( ! in )
+    return false;
+
+  char magic[sizeof( IndexMagic )];
+  unsigned int version, byteOrderMark;
+  unsigned long long numEntries;
+  if ( ! in.read( magic, sizeof( magic ) )
+       || ! std::equal( magic, magic + sizeof( magic ), IndexMagic )
+       || ! ReadValue( in, version ) || version != IndexVersion
+       || ! ReadValue( in, byteOrderMark ) || byteOrderMark != IndexByteOrderMark
+       || ! ReadValue( in, numEntries ) )
+    {
+    return false;
+    }
+
+  MINCCatalog catalog;
+  for( unsigned long long i = 0; i < numEntries; ++i )
+    {
+    MINCCatalogEntry entry;
+    if ( ! ReadEntry( in, entry ) )
+      return false;
+    catalog.AddEntry( entry );
+    }
+
+  m_Entries.swap( catalog.m_Entries );
+  m_Index.swap( catalog.m_Index );
+  return true;
+}
+
+} // namespace itk
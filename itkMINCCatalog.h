@@ -0,0 +1,206 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCCatalog.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCCatalog_h
+#define __itkMINCCatalog_h
+
+#include "itkImageIOBase.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace itk
+{
+
+/** \struct MINCCatalogEntry
+ *
+ * \brief The header of one MINC file, as MINCImageIO reads it with its
+ * default settings.
+ *
+ * The real value of voxel v in slice s is
+ *   v * rescaleSlope[s] + rescaleIntercept[s]
+ * with a single slope and intercept unless the file is slice-scaled
+ * (see MINCImageIO::SetUseRawVoxels()).
+ *
+ * \ingroup IOFilters
+ */
+struct MINCCatalogEntry
+{
+  MINCCatalogEntry()
+    : fileSize( 0 ),
+      modificationTime( 0 ),
+      modificationNanoseconds( 0 ),
+      pixelType( ImageIOBase::UNKNOWNPIXELTYPE ),
+      componentType( ImageIOBase::UNKNOWNCOMPONENTTYPE ),
+      numberOfComponents( 0 ),
+      labels( false ),
+      compressionLevel( 0 ),
+      numberOfResolutionLevels( 0 )
+  {
+  }
+
+  std::string fileName;
+  unsigned long long fileSize;
+  // Seconds since the epoch, and nanoseconds within that second
+  // where the platform has them: together they tell a file rewritten
+  // within a second
+  long long modificationTime;
+  long long modificationNanoseconds;
+
+  // Empty if the header was read, otherwise why it was not
+  std::string error;
+
+  ImageIOBase::IOPixelType pixelType;
+  ImageIOBase::IOComponentType componentType;
+  unsigned int numberOfComponents;
+  bool labels;
+
+  std::vector<unsigned long> dimensions;
+  std::vector<double> spacing;
+  std::vector<double> origin;
+  // One direction per dimension
+  std::vector< std::vector<double> > direction;
+
+  // 1 along every dimension of a contiguous image
+  std::vector<unsigned int> chunkSize;
+  // 0 if uncompressed
+  int compressionLevel;
+
+  std::vector<double> rescaleSlope;
+  std::vector<double> rescaleIntercept;
+
+  unsigned int numberOfResolutionLevels;
+
+  bool IsValid() const
+  {
+    return error.empty();
+  }
+
+  bool IsSliceScaled() const
+  {
+    return rescaleSlope.size() > 1;
+  }
+};
+
+/** \class MINCCatalog
+ *
+ * \brief The headers of many MINC files, read in one pass and kept
+ * in memory or in a single index file.
+ *
+ * Scan() reads the header of each file through MINCImageIO.  HDF5 and
+ * libminc serialize every call, so the headers themselves are parsed
+ * on the calling thread; meanwhile a pool of NumberOfThreads threads
+ * looks up the size and modification time of the files of the next
+ * batch and reads their first PrefetchSize bytes, where HDF5 keeps
+ * the superblock and the MINC headers, so that parsing seldom waits
+ * for the disk.
+ *
+ * Entries are kept in the order scanned, one per file name; scanning
+ * a file again replaces its entry.  Write() stores them in a binary
+ * index file which Read() loads back, on a machine of the same byte
+ * order.
+ *
+ * \ingroup IOFilters
+ */
+class MINCCatalog
+{
+public:
+  MINCCatalog();
+
+  // Threads looking ahead of the parsing.  Defaults to the global
+  // default number of threads.
+  void SetNumberOfThreads( int numberOfThreads )
+  {
+    m_NumberOfThreads = numberOfThreads;
+  }
+  int GetNumberOfThreads() const
+  {
+    return m_NumberOfThreads;
+  }
+
+  // Bytes read ahead at the start of each file; 0 only looks up the
+  // size and modification time.  64 KiB by default.
+  void SetPrefetchSize( size_t prefetchSize )
+  {
+    m_PrefetchSize = prefetchSize;
+  }
+  size_t GetPrefetchSize() const
+  {
+    return m_PrefetchSize;
+  }
+
+  // Read the header of each file into the catalog.  Files that cannot
+  // be read still get an entry, with an error.  Returns the number of
+  // headers read.
+  size_t Scan( const std::vector<std::string>& fileNames );
+
+  // Add entry, or replace the entry of the same file.
+  void AddEntry( const MINCCatalogEntry& entry );
+
+  void Clear();
+
+  size_t GetNumberOfEntries() const
+  {
+    return m_Entries.size();
+  }
+
+  const MINCCatalogEntry& GetEntry( size_t i ) const
+  {
+    return m_Entries[i];
+  }
+
+  // The entry of fileName, as scanned, or 0 if there is none.
+  const MINCCatalogEntry* Find( const std::string& fileName ) const;
+
+  // Indices of the entries for which predicate( entry ) is true.
+  template< class TPredicate >
+  std::vector<size_t> Select( TPredicate predicate ) const
+  {
+    std::vector<size_t> selected;
+    for( size_t i = 0; i < m_Entries.size(); ++i )
+      {
+      if ( predicate( m_Entries[i] ) )
+	selected.push_back( i );
+      }
+    return selected;
+  }
+
+  // Write the entries to fileName, replacing any file there.  Returns
+  // false on error.
+  bool Write( const char* fileName ) const;
+
+  // Replace the entries with those of the index file fileName.
+  // Returns false, leaving the entries as they were, if the file
+  // cannot be read or is not an index of this version and byte order.
+  bool Read( const char* fileName );
+
+private:
+  // Read the header of fileName into entry, whose file name, size
+  // and modification time are set.
+  static void ReadHeader( MINCCatalogEntry& entry );
+
+  std::vector<MINCCatalogEntry> m_Entries;
+  // Index of the entry of each file name
+  std::map<std::string, size_t> m_Index;
+
+  int m_NumberOfThreads;
+  size_t m_PrefetchSize;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCCatalog_h
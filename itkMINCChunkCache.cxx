@@ -0,0 +1,104 @@
+#include "itkMINCChunkCache.h"
+#include "itkMutexLockHolder.h"
+
+#include <cstring>
+
+
+
+namespace itk {
+
+MINCChunkCache::MINCChunkCache()
+  : m_Size( 0 ),
+    m_MaximumSize( 0 ),
+    m_Policy( 0.75 ),
+    m_Clock( 0 )
+{
+}
+
+void MINCChunkCache::Configure( size_t numBytes, double policy )
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( m_Lock );
+
+  m_MaximumSize = numBytes;
+  m_Policy = policy < 0 ? 0 : policy > 1 ? 1 : policy;
+  this->MakeRoom( 0 );
+}
+
+size_t MINCChunkCache::GetMaximumSize() const
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( m_Lock );
+
+  return m_MaximumSize;
+}
+
+void MINCChunkCache::Clear()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( m_Lock );
+
+  m_Entries.clear();
+  m_Size = 0;
+}
+
+bool MINCChunkCache::Find( unsigned long long key, char* chunk, size_t numBytes, size_t numVoxelsUsed )
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( m_Lock );
+
+  EntryMapType::iterator entry = m_Entries.find( key );
+  if ( entry == m_Entries.end() || entry->second.data.size() != numBytes )
+    return false;
+
+  std::memcpy( chunk, &entry->second.data[0], numBytes );
+  entry->second.lastUse = ++m_Clock;
+  entry->second.numVoxelsUsed += numVoxelsUsed;
+  return true;
+}
+
+void MINCChunkCache::Insert( unsigned long long key, const char* chunk, size_t numBytes,
+			     size_t numVoxels, size_t numVoxelsUsed )
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( m_Lock );
+
+  if ( numBytes == 0 || numBytes > m_MaximumSize || m_Entries.count( key ) )
+    return;
+
+  this->MakeRoom( numBytes );
+
+  Entry& entry = m_Entries[key];
+  entry.data.assign( chunk, chunk + numBytes );
+  entry.lastUse = ++m_Clock;
+  entry.numVoxels = numVoxels;
+  entry.numVoxelsUsed = numVoxelsUsed;
+  m_Size += numBytes;
+}
+
+void MINCChunkCache::MakeRoom( size_t numBytes )
+{
+  while( ! m_Entries.empty() && m_Size + numBytes > m_MaximumSize )
+    {
+    unsigned long oldestUse = m_Clock;
+    for( EntryMapType::const_iterator e = m_Entries.begin(); e != m_Entries.end(); ++e )
+      oldestUse = std::min( oldestUse, e->second.lastUse );
+
+    // Age in [0, 1], 1 for the least recently used, plus w0 for
+    // chunks used up; the highest score goes.
+    const double ageRange = static_cast<double>( m_Clock - oldestUse ) + 1;
+    EntryMapType::iterator victim = m_Entries.begin();
+    double victimScore = -1;
+    for( EntryMapType::iterator e = m_Entries.begin(); e != m_Entries.end(); ++e )
+      {
+      double score = ( m_Clock - e->second.lastUse ) / ageRange;
+      if ( e->second.numVoxelsUsed >= e->second.numVoxels )
+	score += m_Policy;
+      if ( score > victimScore )
+	{
+	victim = e;
+	victimScore = score;
+	}
+      }
+
+    m_Size -= victim->second.data.size();
+    m_Entries.erase( victim );
+    }
+}
+
+} // namespace itk
@@ -0,0 +1,96 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCChunkCache.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCChunkCache_h
+#define __itkMINCChunkCache_h
+
+#include "itkSimpleFastMutexLock.h"
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+
+namespace itk
+{
+
+/** \class MINCChunkCache
+ *
+ * \brief Decoded chunks of a dataset, kept for the reads that follow.
+ *
+ * MINCImageDataset decodes chunks itself, bypassing the chunk cache
+ * of HDF5, so a chunk shared by successive reads (say, the slices of
+ * a chunk several slices thick) would be read and inflated once per
+ * read.  This cache keeps decoded chunks up to a number of bytes.
+ *
+ * Eviction follows the preemption policy of H5Pset_chunk_cache(): a
+ * weight w0 in [0, 1].  With w0 = 0 the least recently used chunk
+ * goes first; the larger w0, the sooner chunks whose voxels have all
+ * been used go, whatever their age.
+ *
+ * All methods are thread-safe.
+ *
+ * \ingroup IOFilters
+ */
+class MINCChunkCache
+{
+public:
+  MINCChunkCache();
+
+  // Keep up to numBytes of chunks, evicting by policy w0.  Zero turns
+  // the cache off.
+  void Configure( size_t numBytes, double policy );
+
+  size_t GetMaximumSize() const;
+
+  void Clear();
+
+  // If chunk key is cached, copy its numBytes into chunk and count
+  // numVoxelsUsed of its voxels as used.  Returns false if it is not.
+  bool Find( unsigned long long key, char* chunk, size_t numBytes, size_t numVoxelsUsed );
+
+  // Add chunk key, of numBytes holding numVoxels voxels, of which
+  // numVoxelsUsed have been used.
+  void Insert( unsigned long long key, const char* chunk, size_t numBytes,
+               size_t numVoxels, size_t numVoxelsUsed );
+
+private:
+  MINCChunkCache(const MINCChunkCache&); //purposely not implemented
+  void operator=(const MINCChunkCache&); //purposely not implemented
+
+  struct Entry
+  {
+    std::vector<char> data;
+    unsigned long lastUse;
+    size_t numVoxels;
+    size_t numVoxelsUsed;
+  };
+
+  typedef std::map<unsigned long long, Entry> EntryMapType;
+
+  // Evict chunks until numBytes more fit.  Caller holds the lock.
+  void MakeRoom( size_t numBytes );
+
+  EntryMapType m_Entries;
+  size_t m_Size;
+  size_t m_MaximumSize;
+  double m_Policy;
+  unsigned long m_Clock;
+  mutable SimpleFastMutexLock m_Lock;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCChunkCache_h
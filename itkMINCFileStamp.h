@@ -0,0 +1,67 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCFileStamp.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCFileStamp_h
+#define __itkMINCFileStamp_h
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+namespace itk
+{
+
+// Size and modification time of a regular file, to the nanosecond
+// where the platform has it: a file may well be rewritten within a
+// second.  Whatever is kept about a file is valid while its stamp
+// stays the same.
+struct MINCFileStamp
+{
+  MINCFileStamp()
+    : size( 0 ), seconds( 0 ), nanoseconds( 0 )
+  {
+  }
+
+  // Returns false if filename is not a regular file.
+  bool Read( const char* filename )
+  {
+    struct stat status;
+    if ( stat( filename, &status ) != 0 || ( status.st_mode & S_IFMT ) != S_IFREG )
+      return false;
+
+    size = status.st_size;
+    seconds = status.st_mtime;
+    nanoseconds = 0;
+#if defined(__linux__)
+    nanoseconds = status.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    nanoseconds = status.st_mtimespec.tv_nsec;
+#endif
+    return true;
+  }
+
+  bool operator==( const MINCFileStamp& other ) const
+  {
+    return size == other.size && seconds == other.seconds && nanoseconds == other.nanoseconds;
+  }
+
+  unsigned long long size;
+  long long seconds;
+  long long nanoseconds;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCFileStamp_h
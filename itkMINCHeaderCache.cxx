@@ -0,0 +1,207 @@
+#include "itkMINCHeaderCache.h"
+#include "itkMINCFileStamp.h"
+#include "itkMINCSerialization.h"
+#include "itkMutexLockHolder.h"
+#include "itkSimpleFastMutexLock.h"
+
+#ifdef _WIN32
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+
+
+namespace itk {
+
+
+namespace {
+
+using namespace MINCSerialization;
+
+// Start of a record file, followed by its version and a byte order
+// mark.
+const char RecordMagic[8] = { 'M', 'I', 'N', 'C', 'H', 'D', 'R', '\0' };
+const unsigned int RecordVersion = 1;
+const unsigned int RecordByteOrderMark = 0x01020304;
+
+const char* const SidecarSuffix = ".mnchdr";
+
+std::string Directory;
+SimpleFastMutexLock DirectoryLock;
+
+// Numbers the temporary files of this process, so that threads storing
+// the same record do not write to the same one
+unsigned long TemporaryCount = 0;
+SimpleFastMutexLock TemporaryCountLock;
+
+std::string GetAbsolutePath( const char* filename )
+{
+  std::string path( filename );
+#ifdef _WIN32
+  char* absolute = _fullpath( 0, filename, 0 );
+#else
+  char* absolute = realpath( filename, 0 );
+#endif
+  if ( absolute )
+    {
+    path = absolute;
+    std::free( absolute );
+    }
+  return path;
+}
+
+// 64-bit FNV-1a
+std::string HashPath( const std::string& path )
+{
+  unsigned long long hash = 14695981039346656037ULL;
+  for( size_t i = 0; i < path.size(); ++i )
+    {
+    hash ^= static_cast<unsigned char>( path[i] );
+    hash *= 1099511628211ULL;
+    }
+
+  std::ostringstream name;
+  name.fill( '0' );
+  name.width( 16 );
+  name << std::hex << hash;
+  return name.str();
+}
+
+} // end of unnamed namespace
+
+
+void MINCHeaderCache::SetDirectory( const std::string& directory )
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( DirectoryLock );
+  Directory = directory;
+}
+
+std::string MINCHeaderCache::GetDirectory()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( DirectoryLock );
+  return Directory;
+}
+
+std::string MINCHeaderCache::GetRecordFileName( const char* filename )
+{
+  const std::string directory = GetDirectory();
+  if ( directory.empty() )
+    return std::string( filename ) + SidecarSuffix;
+
+  return directory + "/" + HashPath( GetAbsolutePath( filename ) ) + SidecarSuffix;
+}
+
+bool MINCHeaderCache::Load( const char* filename,
+			    const std::string& key,
+			    std::string& record )
+{
+  MINCFileStamp current;
+  if ( ! current.Read( filename ) )
+    return false;
+
+  std::ifstream in( GetRecordFileName( filename ).c_str(), std::ios::binary );
+  if ( ! in )
+    return false;
+
+  // Records in a shared directory name the file they are for, in case
+  // two paths hash alike
+  char magic[sizeof( RecordMagic )];
+  unsigned int version, byteOrderMark;
+  std::string path, storedKey;
+  MINCFileStamp stored;
+  if ( ! in.read( magic, sizeof( magic ) )
+       || ! std::equal( magic, magic + sizeof( magic ), RecordMagic )
+       || ! ReadValue( in, version ) || version != RecordVersion
+       || ! ReadValue( in, byteOrderMark ) || byteOrderMark != RecordByteOrderMark
+       || ! ReadString( in, path )
+       || ! ReadValue( in, stored.size )
+       || ! ReadValue( in, stored.seconds )
+       || ! ReadValue( in, stored.nanoseconds )
+       || ! ReadString( in, storedKey ) )
+    {
+    return false;
+    }
+
+  if ( ! ( stored == current ) || storedKey != key
+       || ( ! GetDirectory().empty() && path != GetAbsolutePath( filename ) ) )
+    {
+    return false;
+    }
+
+  return ReadString( in, record );
+}
+
+bool MINCHeaderCache::Store( const char* filename,
+			     const std::string& key,
+			     const std::string& record )
+{
+  MINCFileStamp current;
+  if ( ! current.Read( filename ) )
+    return false;
+
+  const std::string recordFileName = GetRecordFileName( filename );
+
+  // Written aside, then renamed over the old record
+#ifdef _WIN32
+  const int processID = _getpid();
+#else
+  const int processID = getpid();
+#endif
+  unsigned long temporaryNumber;
+  {
+  MutexLockHolder<SimpleFastMutexLock> holder( TemporaryCountLock );
+  temporaryNumber = ++TemporaryCount;
+  }
+  std::ostringstream temporaryName;
+  temporaryName << recordFileName << "." << processID << "." << temporaryNumber << ".tmp";
+  const std::string temporaryFileName = temporaryName.str();
+
+  {
+  std::ofstream out( temporaryFileName.c_str(), std::ios::binary | std::ios::trunc );
+  if ( ! out )
+    return false;
+
+  out.write( RecordMagic, sizeof( RecordMagic ) );
+  WriteValue( out, RecordVersion );
+  WriteValue( out, RecordByteOrderMark );
+  WriteString( out, GetDirectory().empty() ? std::string( filename ) : GetAbsolutePath( filename ) );
+  WriteValue( out, current.size );
+  WriteValue( out, current.seconds );
+  WriteValue( out, current.nanoseconds );
+  WriteString( out, key );
+  WriteString( out, record );
+
+  out.close();
+  if ( out.fail() )
+    {
+    std::remove( temporaryFileName.c_str() );
+    return false;
+    }
+  }
+
+  // Windows does not rename over an existing file
+  if ( std::rename( temporaryFileName.c_str(), recordFileName.c_str() ) != 0 )
+    {
+    std::remove( recordFileName.c_str() );
+    if ( std::rename( temporaryFileName.c_str(), recordFileName.c_str() ) != 0 )
+      {
+      std::remove( temporaryFileName.c_str() );
+      return false;
+      }
+    }
+  return true;
+}
+
+void MINCHeaderCache::Remove( const char* filename )
+{
+  std::remove( GetRecordFileName( filename ).c_str() );
+}
+
+} // namespace itk
@@ -0,0 +1,77 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCHeaderCache.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCHeaderCache_h
+#define __itkMINCHeaderCache_h
+
+#include <string>
+
+
+namespace itk
+{
+
+/** \class MINCHeaderCache
+ *
+ * \brief Records of MINC headers kept on disk, so that a header can
+ * be had again without opening its file.
+ *
+ * Opening a file through HDF5 costs a few round trips to the disk,
+ * which adds up on network filesystems.  A record is the header as a
+ * reader made of it (see MINCImageIO::SetUseHeaderCache()), stored
+ * under a key naming the settings it depends on.  It is handed back
+ * only for the same key, and only while the file keeps the size and
+ * modification time it had when the record was stored.
+ *
+ * Records are kept next to their file, in a sidecar named after it
+ * with ".mnchdr" appended, or in a cache directory shared by many
+ * files, where they are named after a hash of the absolute path of
+ * their file.  Records are replaced atomically, so that processes
+ * sharing a directory never see half a record.
+ *
+ * \ingroup IOFilters
+ */
+class MINCHeaderCache
+{
+public:
+  // Directory holding the records of all files.  Empty (the default)
+  // puts each record in a sidecar.
+  static void SetDirectory( const std::string& directory );
+  static std::string GetDirectory();
+
+  // Get the record stored for filename under key.  Returns false if
+  // there is none, or the file has changed since.
+  static bool Load( const char* filename,
+                    const std::string& key,
+                    std::string& record );
+
+  // Store record for filename as it is now under key, replacing any
+  // other.  Returns false if the record cannot be written.
+  static bool Store( const char* filename,
+                     const std::string& key,
+                     const std::string& record );
+
+  // Remove the record of filename, if any.
+  static void Remove( const char* filename );
+
+  // The file the record of filename is kept in.
+  static std::string GetRecordFileName( const char* filename );
+
+private:
+  MINCHeaderCache(); //purposely not implemented
+};
+
+} // end namespace itk
+
+#endif // __itkMINCHeaderCache_h
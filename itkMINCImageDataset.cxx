@@ -0,0 +1,1484 @@
+#include "itkMINCImageDataset.h"
+#include "itkMINCChunkCache.h"
+#include "itkMINCRawFile.h"
+#include "itkMINCReadStatistics.h"
+
+#include "itkMultiThreader.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+
+
+namespace itk {
+
+
+namespace {
+
+// Chunks are read and written whole through H5Dread_chunk() and
+// H5Dwrite_chunk()
+#if ! H5_VERSION_GE(1,10,2)
+#  error "HDF5 1.10.2 or later is required"
+#endif
+
+// Chunk addresses can be looked up, so chunks can be read around HDF5
+#if H5_VERSION_GE(1,10,5)
+#  define ITK_MINC_DIRECT_CHUNK_READS 1
+#else
+#  define ITK_MINC_DIRECT_CHUNK_READS 0
+#endif
+
+/**
+ * Chunks that are decoded or encoded together.  When reading, the
+ * raw (possibly compressed) bytes of every chunk in the batch are
+ * fetched by the calling thread; the worker threads decode them and
+ * copy the part that intersects the hyperslab into the output
+ * buffer.  When writing, the worker threads gather and encode the
+ * chunks, and the calling thread stores them.
+ */
+struct ChunkBatch
+{
+  unsigned int numDimensions;
+  const unsigned long* dimensions;
+  const unsigned long* chunkSize;
+  const unsigned long* starts;
+  const unsigned long* counts;
+
+  size_t voxelSize;
+  size_t componentSize;
+  size_t chunkBytes;
+  bool swapBytes;
+  bool deflate;
+  unsigned int deflateIndex;
+  int deflateLevel;
+  const std::vector<char>* fillValue;
+
+  char* output;
+  const char* input;
+
+  // Per chunk: origin (in voxels), raw bytes, filter mask.  A chunk
+  // with no raw bytes was never written and holds the fill value,
+  // unless it has a file address: the worker threads then read its
+  // raw bytes from file themselves.
+  std::vector< std::vector<unsigned long> > origins;
+  std::vector< std::vector<unsigned char> > raw;
+  std::vector<unsigned int> filterMasks;
+  std::vector<unsigned long long> addresses;
+  std::vector<size_t> rawSizes;
+  const MINCRawFile* file;
+
+  // Decoded chunks kept between reads, if any.  A chunk already found
+  // there by the calling thread is marked as cached and skipped; one
+  // found there by a worker thread is marked as a cache hit.
+  MINCChunkCache* cache;
+  std::vector<int> cached;
+  std::vector<int> cacheHits;
+
+  // Set by a worker thread that fails to decode a chunk
+  std::vector<int> failed;
+};
+
+void SwapComponents( char* data, size_t numBytes, size_t componentSize )
+{
+  for( size_t i = 0; i + componentSize <= numBytes; i += componentSize )
+    {
+    std::reverse( data + i, data + i + componentSize );
+    }
+}
+
+bool DecodeChunk( const ChunkBatch& batch, unsigned int i,
+                  const std::vector<unsigned char>& raw, char* chunk )
+{
+  if ( raw.empty() )
+    {
+    const std::vector<char>& fill = *batch.fillValue;
+    for( size_t b = 0; b < batch.chunkBytes; b += batch.voxelSize )
+      std::memcpy( chunk + b, &fill[0], batch.voxelSize );
+    return true;
+    }
+
+  bool compressed = batch.deflate
+    && ( batch.filterMasks[i] & (1u << batch.deflateIndex) ) == 0;
+
+  if ( compressed )
+    {
+    uLongf destLength = batch.chunkBytes;
+    if ( uncompress( reinterpret_cast<Bytef*>( chunk ), &destLength,
+                     &raw[0], raw.size() ) != Z_OK
+         || destLength != batch.chunkBytes )
+      {
+      return false;
+      }
+    }
+  else
+    {
+    if ( raw.size() != batch.chunkBytes )
+      return false;
+    std::memcpy( chunk, &raw[0], batch.chunkBytes );
+    }
+
+  if ( batch.swapBytes )
+    SwapComponents( chunk, batch.chunkBytes, batch.componentSize );
+
+  return true;
+}
+
+/**
+ * Copy the part of a chunk that lies inside the hyperslab between
+ * the chunk and the hyperslab buffer, one row (along the fastest
+ * dimension) at a time.  Scattering copies a decoded chunk into the
+ * output buffer; gathering copies the input buffer into a chunk.
+ */
+void CopyChunk( const ChunkBatch& batch, unsigned int i, char* chunk, bool scatter )
+{
+  const unsigned int n = batch.numDimensions;
+  const std::vector<unsigned long>& origin = batch.origins[i];
+
+  std::vector<unsigned long> lo( n ), hi( n );
+  for( unsigned int d = 0; d < n; ++d )
+    {
+    lo[d] = std::max( origin[d], batch.starts[d] );
+    hi[d] = std::min( std::min( origin[d] + batch.chunkSize[d],
+                                batch.starts[d] + batch.counts[d] ),
+                      batch.dimensions[d] );
+    if ( lo[d] >= hi[d] )
+      return;
+    }
+
+  const size_t rowBytes = ( hi[n-1] - lo[n-1] ) * batch.voxelSize;
+  std::vector<unsigned long> index( lo );
+
+  while( true )
+    {
+    size_t src = 0;
+    size_t dst = 0;
+    for( unsigned int d = 0; d < n; ++d )
+      {
+      src = src * batch.chunkSize[d] + ( index[d] - origin[d] );
+      dst = dst * batch.counts[d] + ( index[d] - batch.starts[d] );
+      }
+
+    if ( scatter )
+      std::memcpy( batch.output + dst * batch.voxelSize,
+                   chunk + src * batch.voxelSize,
+                   rowBytes );
+    else
+      std::memcpy( chunk + src * batch.voxelSize,
+                   batch.input + dst * batch.voxelSize,
+                   rowBytes );
+
+    // Advance to the next row
+    int d = static_cast<int>( n ) - 2;
+    for( ; d >= 0; --d )
+      {
+      if ( ++index[d] < hi[d] )
+        break;
+      index[d] = lo[d];
+      }
+    if ( d < 0 )
+      break;
+    }
+}
+
+/**
+ * Key of chunk i in the chunk cache: its index in the chunk grid.
+ */
+unsigned long long ChunkKey( const ChunkBatch& batch, unsigned int i )
+{
+  unsigned long long key = 0;
+  for( unsigned int d = 0; d < batch.numDimensions; ++d )
+    {
+    const unsigned long numChunks
+      = ( batch.dimensions[d] + batch.chunkSize[d] - 1 ) / batch.chunkSize[d];
+    key = key * numChunks + batch.origins[i][d] / batch.chunkSize[d];
+    }
+  return key;
+}
+
+/**
+ * Number of voxels of chunk i that lie inside the hyperslab.
+ */
+size_t ChunkVoxelsUsed( const ChunkBatch& batch, unsigned int i )
+{
+  size_t numVoxels = 1;
+  for( unsigned int d = 0; d < batch.numDimensions; ++d )
+    {
+    const unsigned long lo = std::max( batch.origins[i][d], batch.starts[d] );
+    const unsigned long hi = std::min( batch.origins[i][d] + batch.chunkSize[d],
+                                       batch.starts[d] + batch.counts[d] );
+    numVoxels *= hi > lo ? hi - lo : 0;
+    }
+  return numVoxels;
+}
+
+ITK_THREAD_RETURN_TYPE DecodeChunksThreadCallback( void* arg )
+{
+  MultiThreader::ThreadInfoStruct* info
+    = static_cast<MultiThreader::ThreadInfoStruct*>( arg );
+  ChunkBatch* batch = static_cast<ChunkBatch*>( info->UserData );
+
+  std::vector<char> chunk( batch->chunkBytes );
+  std::vector<unsigned char> fetched;
+
+  for( unsigned int i = info->ThreadID; i < batch->raw.size(); i += info->NumberOfThreads )
+    {
+    if ( batch->cached[i] )
+      continue;
+
+    unsigned long long key = 0;
+    size_t numVoxelsUsed = 0;
+    if ( batch->cache )
+      {
+      key = ChunkKey( *batch, i );
+      numVoxelsUsed = ChunkVoxelsUsed( *batch, i );
+      if ( batch->cache->Find( key, &chunk[0], chunk.size(), numVoxelsUsed ) )
+	{
+	batch->cacheHits[i] = 1;
+	CopyChunk( *batch, i, &chunk[0], true );
+	continue;
+	}
+      }
+
+    const std::vector<unsigned char>* raw = &batch->raw[i];
+    if ( batch->addresses[i] != 0 )
+      {
+      fetched.resize( batch->rawSizes[i] );
+      if ( ! batch->file->Read( batch->addresses[i], fetched.size(), &fetched[0] ) )
+	{
+	batch->failed[i] = 1;
+	continue;
+	}
+      raw = &fetched;
+      }
+
+    if ( ! DecodeChunk( *batch, i, *raw, &chunk[0] ) )
+      {
+      batch->failed[i] = 1;
+      continue;
+      }
+    if ( batch->cache && ! raw->empty() )
+      batch->cache->Insert( key, &chunk[0], chunk.size(),
+			    chunk.size() / batch->voxelSize, numVoxelsUsed );
+    CopyChunk( *batch, i, &chunk[0], true );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+/**
+ * Add the chunks of a decoded batch, and the raw bytes read for them,
+ * to statistics.  Chunks never written hold the fill value and are
+ * not counted as read.
+ */
+void TallyChunks( const ChunkBatch& batch, MINCReadStatistics* statistics )
+{
+  if ( ! statistics )
+    return;
+
+  for( unsigned int i = 0; i < batch.raw.size(); ++i )
+    {
+    if ( batch.cached[i] || batch.cacheHits[i] )
+      {
+      ++statistics->chunkCacheHits;
+      continue;
+      }
+    if ( batch.cache )
+      ++statistics->chunkCacheMisses;
+
+    const size_t rawBytes = batch.addresses[i] != 0 ? batch.rawSizes[i] : batch.raw[i].size();
+    if ( rawBytes == 0 )
+      continue;
+
+    ++statistics->chunksRead;
+    statistics->bytesRead += rawBytes;
+    if ( batch.deflate && ( batch.filterMasks[i] & (1u << batch.deflateIndex) ) == 0 )
+      ++statistics->chunksDecompressed;
+    }
+}
+
+bool EncodeChunk( ChunkBatch& batch, unsigned int i, char* chunk )
+{
+  // Chunks that stick out of the dataset are padded with zeros
+  std::memset( chunk, 0, batch.chunkBytes );
+  CopyChunk( batch, i, chunk, false );
+
+  if ( batch.swapBytes )
+    SwapComponents( chunk, batch.chunkBytes, batch.componentSize );
+
+  std::vector<unsigned char>& raw = batch.raw[i];
+
+  if ( ! batch.deflate )
+    {
+    raw.assign( chunk, chunk + batch.chunkBytes );
+    return true;
+    }
+
+  uLongf rawLength = compressBound( batch.chunkBytes );
+  raw.resize( rawLength );
+  if ( compress2( &raw[0], &rawLength, reinterpret_cast<const Bytef*>( chunk ),
+                  batch.chunkBytes, batch.deflateLevel ) != Z_OK )
+    {
+    return false;
+    }
+  raw.resize( rawLength );
+
+  return true;
+}
+
+ITK_THREAD_RETURN_TYPE EncodeChunksThreadCallback( void* arg )
+{
+  MultiThreader::ThreadInfoStruct* info
+    = static_cast<MultiThreader::ThreadInfoStruct*>( arg );
+  ChunkBatch* batch = static_cast<ChunkBatch*>( info->UserData );
+
+  std::vector<char> chunk( batch->chunkBytes );
+
+  for( unsigned int i = info->ThreadID; i < batch->raw.size(); i += info->NumberOfThreads )
+    {
+    if ( ! EncodeChunk( *batch, i, &chunk[0] ) )
+      batch->failed[i] = 1;
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+/**
+ * Fill in the origin of every chunk of the hyperslab, in file order,
+ * starting from chunkIndex.  At most maxChunks are added; chunkIndex
+ * is left at the next chunk.  Returns true once the last chunk has
+ * been added.
+ */
+bool NextChunks( ChunkBatch& batch,
+                 std::vector<unsigned long>& chunkIndex,
+                 const std::vector<unsigned long>& firstChunk,
+                 const std::vector<unsigned long>& lastChunk,
+                 size_t maxChunks )
+{
+  const unsigned int n = batch.numDimensions;
+
+  batch.origins.clear();
+  while( batch.origins.size() < maxChunks )
+    {
+    std::vector<unsigned long> origin( n );
+    for( unsigned int d = 0; d < n; ++d )
+      origin[d] = chunkIndex[d] * batch.chunkSize[d];
+    batch.origins.push_back( origin );
+
+    int d = static_cast<int>( n ) - 1;
+    for( ; d >= 0; --d )
+      {
+      if ( ++chunkIndex[d] <= lastChunk[d] )
+        break;
+      chunkIndex[d] = firstChunk[d];
+      }
+    if ( d < 0 )
+      return true;
+    }
+
+  return false;
+}
+
+herr_t CopyAttributeCallback( hid_t source, const char* name,
+                             const H5A_info_t*, void* destination )
+{
+  hid_t attribute = H5Aopen( source, name, H5P_DEFAULT );
+  if ( attribute < 0 )
+    return -1;
+
+  hid_t type = H5Aget_type( attribute );
+  hid_t space = H5Aget_space( attribute );
+  hssize_t numValues = H5Sget_simple_extent_npoints( space );
+
+  std::vector<char> values( std::max<size_t>( H5Tget_size( type ) * numValues, 1 ) );
+  herr_t status = H5Aread( attribute, type, &values[0] );
+
+  if ( status >= 0 )
+    {
+    hid_t copy = H5Acreate2( *static_cast<hid_t*>( destination ), name, type, space,
+                             H5P_DEFAULT, H5P_DEFAULT );
+    status = copy >= 0 ? H5Awrite( copy, type, &values[0] ) : -1;
+    if ( copy >= 0 )
+      H5Aclose( copy );
+    }
+
+  // Variable-length strings were allocated by H5Aread
+  if ( H5Tis_variable_str( type ) > 0 )
+    H5Dvlen_reclaim( type, space, H5P_DEFAULT, &values[0] );
+
+  H5Sclose( space );
+  H5Tclose( type );
+  H5Aclose( attribute );
+  return status < 0 ? -1 : 0;
+}
+
+/**
+ * Copy every attribute of the object source to destination.
+ */
+bool CopyAttributes( hid_t source, hid_t destination )
+{
+  hsize_t index = 0;
+  return H5Aiterate2( source, H5_INDEX_NAME, H5_ITER_NATIVE, &index,
+                      CopyAttributeCallback, &destination ) >= 0;
+}
+
+/**
+ * Pieces of a contiguous dataset read straight into the hyperslab
+ * buffer, or copied from the mapped dataset, whose file address
+ * mappedAddress is at mapped, if that is set.  Each thread reads a
+ * consecutive run of segments, so the file is read in a few long
+ * sequential streams.
+ */
+struct ContiguousRead
+{
+  const MINCRawFile* file;
+  const char* mapped;
+  unsigned long long mappedAddress;
+  const MINCImageDataset::ReadPlan* plan;
+  char* output;
+  size_t componentSize;
+  bool swapBytes;
+
+  // Set by a worker thread that fails to read
+  std::vector<int> failed;
+};
+
+// Largest read issued at once, so that the work can be shared out
+// even when the hyperslab is a single run of the file.
+const size_t MaximumSegmentBytes = 4 << 20;
+
+ITK_THREAD_RETURN_TYPE ReadContiguousThreadCallback( void* arg )
+{
+  MultiThreader::ThreadInfoStruct* info
+    = static_cast<MultiThreader::ThreadInfoStruct*>( arg );
+  ContiguousRead* read = static_cast<ContiguousRead*>( info->UserData );
+
+  const MINCImageDataset::ReadPlan& plan = *read->plan;
+
+  const size_t numSegments = plan.segmentAddresses.size();
+  const size_t first = numSegments * info->ThreadID / info->NumberOfThreads;
+  const size_t last = numSegments * ( info->ThreadID + 1 ) / info->NumberOfThreads;
+
+  for( size_t i = first; i < last; ++i )
+    {
+    char* out = read->output + plan.segmentOffsets[i];
+    if ( read->mapped )
+      std::memcpy( out, read->mapped + ( plan.segmentAddresses[i] - read->mappedAddress ),
+		   plan.segmentBytes[i] );
+    else if ( ! read->file->Read( plan.segmentAddresses[i], plan.segmentBytes[i], out ) )
+      {
+      read->failed[info->ThreadID] = 1;
+      break;
+      }
+    if ( read->swapBytes )
+      SwapComponents( out, plan.segmentBytes[i], read->componentSize );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+} // end of unnamed namespace
+
+
+MINCImageDataset::MINCImageDataset()
+  : m_File( -1 ),
+    m_Dataset( -1 ),
+    m_Chunked( false ),
+    m_Deflate( false ),
+    m_DeflateIndex( 0 ),
+    m_DeflateLevel( Z_DEFAULT_COMPRESSION ),
+    m_FiltersSupported( false ),
+    m_VoxelSize( 0 ),
+    m_ComponentSize( 0 ),
+    m_SwapBytes( false ),
+    m_MemoryType( -1 ),
+    m_RawFile( new MINCRawFile ),
+    m_ContiguousAddress( 0 ),
+    m_UseMemoryMapping( true ),
+    m_ChunkCacheBytes( H5D_CHUNK_CACHE_NBYTES_DEFAULT ),
+    m_ChunkCacheSlots( H5D_CHUNK_CACHE_NSLOTS_DEFAULT ),
+    m_ChunkCachePolicy( H5D_CHUNK_CACHE_W0_DEFAULT ),
+    m_ChunkCache( new MINCChunkCache ),
+    m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() )
+{
+}
+
+MINCImageDataset::~MINCImageDataset()
+{
+  this->Close();
+  delete m_RawFile;
+  delete m_ChunkCache;
+}
+
+void MINCImageDataset::SetNumberOfThreads( int numberOfThreads )
+{
+  m_NumberOfThreads = std::max( 1, numberOfThreads );
+}
+
+void MINCImageDataset::SetChunkCache( size_t numBytes, size_t numSlots, double policy )
+{
+  const bool changed = numBytes != m_ChunkCacheBytes
+    || numSlots != m_ChunkCacheSlots
+    || policy != m_ChunkCachePolicy;
+
+  m_ChunkCacheBytes = numBytes;
+  m_ChunkCacheSlots = numSlots;
+  m_ChunkCachePolicy = policy;
+
+  const bool defaults = numBytes == H5D_CHUNK_CACHE_NBYTES_DEFAULT;
+  m_ChunkCache->Configure( defaults ? 0 : numBytes, policy < 0 ? 0.75 : policy );
+
+  // The cache of HDF5 is set when the dataset is opened
+  if ( changed && this->IsOpen() )
+    {
+    hid_t dataset = this->OpenImage();
+    if ( dataset >= 0 )
+      {
+      H5Dclose( m_Dataset );
+      m_Dataset = dataset;
+      }
+    }
+}
+
+hid_t MINCImageDataset::OpenImage() const
+{
+  const std::string imagePath = m_GroupPath + "/image";
+
+  hid_t dapl = H5Pcreate( H5P_DATASET_ACCESS );
+  H5Pset_chunk_cache( dapl, m_ChunkCacheSlots, m_ChunkCacheBytes, m_ChunkCachePolicy );
+
+  hid_t dataset;
+  H5E_BEGIN_TRY
+    {
+    dataset = H5Dopen2( m_File, imagePath.c_str(), dapl );
+    }
+  H5E_END_TRY;
+
+  H5Pclose( dapl );
+  return dataset;
+}
+
+bool MINCImageDataset::Open( const char* filename, unsigned int level, bool writable )
+{
+  this->Close();
+
+  std::ostringstream groupPath;
+  groupPath << "/minc-2.0/image/" << level;
+  m_GroupPath = groupPath.str();
+
+  H5E_BEGIN_TRY
+    {
+    m_File = H5Fopen( filename, writable ? H5F_ACC_RDWR : H5F_ACC_RDONLY, H5P_DEFAULT );
+    }
+  H5E_END_TRY;
+
+  if ( m_File >= 0 )
+    m_Dataset = this->OpenImage();
+
+  if ( m_Dataset < 0 )
+    {
+    this->Close();
+    return false;
+    }
+
+  // Shape
+  hid_t space = H5Dget_space( m_Dataset );
+  int numDimensions = H5Sget_simple_extent_ndims( space );
+  if ( numDimensions <= 0 )
+    {
+    H5Sclose( space );
+    this->Close();
+    return false;
+    }
+
+  std::vector<hsize_t> dims( numDimensions );
+  H5Sget_simple_extent_dims( space, &dims[0], 0 );
+  H5Sclose( space );
+  m_Dimensions.assign( dims.begin(), dims.end() );
+
+  // Chunking and filters
+  hid_t dcpl = H5Dget_create_plist( m_Dataset );
+
+  m_Chunked = H5Pget_layout( dcpl ) == H5D_CHUNKED;
+  m_ChunkSize = m_Dimensions;
+  if ( m_Chunked )
+    {
+    std::vector<hsize_t> chunk( numDimensions );
+    H5Pget_chunk( dcpl, numDimensions, &chunk[0] );
+    m_ChunkSize.assign( chunk.begin(), chunk.end() );
+    }
+
+  m_FiltersSupported = true;
+  int numFilters = H5Pget_nfilters( dcpl );
+  for( int i = 0; i < numFilters; ++i )
+    {
+    unsigned int flags;
+    unsigned int values[1] = { Z_DEFAULT_COMPRESSION };
+    size_t numValues = 1;
+    unsigned int filterConfig;
+    H5Z_filter_t filter = H5Pget_filter2( dcpl, i, &flags, &numValues, values, 0, 0, &filterConfig );
+
+    if ( filter == H5Z_FILTER_DEFLATE )
+      {
+      m_Deflate = true;
+      m_DeflateIndex = i;
+      m_DeflateLevel = numValues > 0 ? static_cast<int>( values[0] ) : Z_DEFAULT_COMPRESSION;
+      }
+    else
+      {
+      m_FiltersSupported = false;
+      }
+    }
+
+  // Data type.  Complex voxels are stored as a compound of two
+  // numbers of the same type.
+  hid_t fileType = H5Dget_type( m_Dataset );
+  hid_t nativeType = H5Tget_native_type( fileType, H5T_DIR_ASCEND );
+  hid_t componentType = fileType;
+  hid_t nativeComponentType = nativeType;
+
+  m_VoxelSize = H5Tget_size( fileType );
+  m_ComponentSize = m_VoxelSize;
+
+  if ( H5Tget_class( fileType ) == H5T_COMPOUND )
+    {
+    componentType = H5Tget_member_type( fileType, 0 );
+    nativeComponentType = H5Tget_member_type( nativeType, 0 );
+    m_ComponentSize = H5Tget_size( componentType );
+    if ( m_ComponentSize * H5Tget_nmembers( fileType ) != m_VoxelSize )
+      m_FiltersSupported = false;
+    }
+
+  m_SwapBytes = m_ComponentSize > 1
+    && H5Tget_order( componentType ) != H5Tget_order( nativeComponentType );
+
+  if ( H5Tget_size( nativeType ) != m_VoxelSize )
+    m_FiltersSupported = false;
+
+  m_FillValue.assign( m_VoxelSize, 0 );
+  H5E_BEGIN_TRY
+    {
+    H5Pget_fill_value( dcpl, nativeType, &m_FillValue[0] );
+    }
+  H5E_END_TRY;
+
+  if ( componentType != fileType )
+    {
+    H5Tclose( componentType );
+    H5Tclose( nativeComponentType );
+    }
+  m_MemoryType = nativeType;
+  H5Tclose( fileType );
+  H5Pclose( dcpl );
+
+  // Data can be read around HDF5 if it is where HDF5 says: the file
+  // is a single plain file without a user block, and nothing is
+  // waiting in HDF5's buffers to be written to it.
+  hid_t fapl = H5Fget_access_plist( m_File );
+  hid_t fcpl = H5Fget_create_plist( m_File );
+  hsize_t userBlock = 0;
+  H5Pget_userblock( fcpl, &userBlock );
+  const bool plainFile = ! writable && userBlock == 0 && H5Pget_driver( fapl ) == H5FD_SEC2;
+  H5Pclose( fcpl );
+  H5Pclose( fapl );
+
+  haddr_t contiguousAddress = HADDR_UNDEF;
+  if ( plainFile && ! m_Chunked && m_FiltersSupported )
+    contiguousAddress = H5Dget_offset( m_Dataset );
+
+  const bool directReads = contiguousAddress != HADDR_UNDEF
+    || ( ITK_MINC_DIRECT_CHUNK_READS && plainFile && this->CanReadChunks() );
+
+  if ( directReads && m_RawFile->Open( filename ) && contiguousAddress != HADDR_UNDEF )
+    m_ContiguousAddress = contiguousAddress;
+
+  // Where mapping fails, as it does past the end of the file, the
+  // data are read instead.
+  if ( m_ContiguousAddress != 0 && m_UseMemoryMapping )
+    {
+    size_t numBytes = m_VoxelSize;
+    for( int d = 0; d < numDimensions; ++d )
+      numBytes *= m_Dimensions[d];
+    m_RawFile->Map( m_ContiguousAddress, numBytes );
+    }
+
+  return true;
+}
+
+void MINCImageDataset::Close()
+{
+  if ( m_MemoryType >= 0 )
+    H5Tclose( m_MemoryType );
+  if ( m_Dataset >= 0 )
+    H5Dclose( m_Dataset );
+  if ( m_File >= 0 )
+    H5Fclose( m_File );
+
+  m_RawFile->Close();
+  m_ContiguousAddress = 0;
+  m_ChunkCache->Clear();
+
+  m_MemoryType = -1;
+  m_Dataset = -1;
+  m_File = -1;
+  m_Dimensions.clear();
+  m_ChunkSize.clear();
+  m_Chunked = false;
+  m_Deflate = false;
+  m_FiltersSupported = false;
+}
+
+bool MINCImageDataset::ReadHyperslab( const unsigned long starts[],
+                                      const unsigned long counts[],
+                                      void* buffer,
+                                      MINCReadStatistics* statistics )
+{
+  if ( ! this->IsOpen() )
+    return false;
+
+  if ( m_RawFile->IsOpen() )
+    {
+    ReadPlan plan;
+    return this->PlanRead( starts, counts, plan )
+      && this->ExecuteRead( plan, m_NumberOfThreads, buffer, statistics );
+    }
+
+  if ( ! this->CanReadChunks() )
+    {
+    if ( statistics )
+      {
+      size_t numBytes = m_VoxelSize;
+      for( unsigned int d = 0; d < this->GetNumberOfDimensions(); ++d )
+        numBytes *= counts[d];
+      statistics->bytesRead += numBytes;
+      }
+    return this->ReadHyperslabThroughHDF5( starts, counts, buffer );
+    }
+
+  const unsigned int n = this->GetNumberOfDimensions();
+
+  // Range of chunk indices covered by the hyperslab
+  std::vector<unsigned long> firstChunk( n ), lastChunk( n );
+  for( unsigned int d = 0; d < n; ++d )
+    {
+    if ( counts[d] == 0 )
+      return true;
+    if ( starts[d] + counts[d] > m_Dimensions[d] )
+      return false;
+    firstChunk[d] = starts[d] / m_ChunkSize[d];
+    lastChunk[d] = ( starts[d] + counts[d] - 1 ) / m_ChunkSize[d];
+    }
+
+  size_t chunkVoxels = 1;
+  for( unsigned int d = 0; d < n; ++d )
+    chunkVoxels *= m_ChunkSize[d];
+
+  ChunkBatch batch;
+  batch.numDimensions = n;
+  batch.dimensions = &m_Dimensions[0];
+  batch.chunkSize = &m_ChunkSize[0];
+  batch.starts = starts;
+  batch.counts = counts;
+  batch.voxelSize = m_VoxelSize;
+  batch.componentSize = m_ComponentSize;
+  batch.chunkBytes = chunkVoxels * m_VoxelSize;
+  batch.swapBytes = m_SwapBytes;
+  batch.deflate = m_Deflate;
+  batch.deflateIndex = m_DeflateIndex;
+  batch.deflateLevel = m_DeflateLevel;
+  batch.fillValue = &m_FillValue;
+  batch.output = static_cast<char*>( buffer );
+  batch.input = 0;
+  batch.file = m_RawFile;
+  batch.cache = m_ChunkCache->GetMaximumSize() > 0 ? m_ChunkCache : 0;
+
+  // Bound the raw bytes held in memory to a few chunks per thread
+  const unsigned int batchSize = 4 * m_NumberOfThreads;
+
+  std::vector<char> chunk( batch.cache ? batch.chunkBytes : 0 );
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+
+  std::vector<unsigned long> chunkIndex( firstChunk );
+  std::vector<hsize_t> offset( n );
+  bool done = false;
+
+  while( ! done )
+    {
+    done = NextChunks( batch, chunkIndex, firstChunk, lastChunk, batchSize );
+
+    // Fetch the raw bytes of the batch
+    batch.raw.assign( batch.origins.size(), std::vector<unsigned char>() );
+    batch.filterMasks.assign( batch.origins.size(), 0 );
+    batch.addresses.assign( batch.origins.size(), 0 );
+    batch.rawSizes.assign( batch.origins.size(), 0 );
+    batch.cached.assign( batch.origins.size(), 0 );
+    batch.cacheHits.assign( batch.origins.size(), 0 );
+
+    for( unsigned int i = 0; i < batch.origins.size(); ++i )
+      {
+      // A cached chunk is copied here rather than fetched, as it may
+      // be evicted by the time a worker thread gets to it.
+      if ( batch.cache
+           && batch.cache->Find( ChunkKey( batch, i ), &chunk[0], chunk.size(),
+                                 ChunkVoxelsUsed( batch, i ) ) )
+        {
+        CopyChunk( batch, i, &chunk[0], true );
+        batch.cached[i] = 1;
+        continue;
+        }
+
+      std::copy( batch.origins[i].begin(), batch.origins[i].end(), offset.begin() );
+
+      hsize_t rawBytes = 0;
+      herr_t status;
+      H5E_BEGIN_TRY
+        {
+        status = H5Dget_chunk_storage_size( m_Dataset, &offset[0], &rawBytes );
+        }
+      H5E_END_TRY;
+
+      if ( status < 0 || rawBytes == 0 )
+        continue;
+
+      std::vector<unsigned char>& raw = batch.raw[i];
+      raw.resize( rawBytes );
+
+      uint32_t filterMask = 0;
+      if ( H5Dread_chunk( m_Dataset, H5P_DEFAULT, &offset[0], &filterMask, &raw[0] ) < 0 )
+        return false;
+      batch.filterMasks[i] = filterMask;
+      }
+
+    // Decode and scatter in parallel
+    batch.failed.assign( batch.raw.size(), 0 );
+
+    int numThreads = std::min( m_NumberOfThreads, static_cast<int>( batch.raw.size() ) );
+    threader->SetNumberOfThreads( numThreads );
+    threader->SetSingleMethod( DecodeChunksThreadCallback, &batch );
+    threader->SingleMethodExecute();
+
+    if ( std::find( batch.failed.begin(), batch.failed.end(), 1 ) != batch.failed.end() )
+      return false;
+
+    TallyChunks( batch, statistics );
+    }
+
+  return true;
+}
+
+bool MINCImageDataset::IsChunkAligned( const unsigned long starts[],
+                                       const unsigned long counts[] ) const
+{
+  for( unsigned int d = 0; d < this->GetNumberOfDimensions(); ++d )
+    {
+    const unsigned long end = starts[d] + counts[d];
+    if ( starts[d] % m_ChunkSize[d] != 0 )
+      return false;
+    if ( end % m_ChunkSize[d] != 0 && end != m_Dimensions[d] )
+      return false;
+    }
+  return true;
+}
+
+bool MINCImageDataset::WriteHyperslab( const unsigned long starts[],
+                                       const unsigned long counts[],
+                                       const void* buffer )
+{
+  if ( ! this->IsOpen() )
+    return false;
+
+  // Decoded chunks may be overwritten
+  m_ChunkCache->Clear();
+
+  const unsigned int n = this->GetNumberOfDimensions();
+
+  for( unsigned int d = 0; d < n; ++d )
+    {
+    if ( counts[d] == 0 )
+      return true;
+    if ( starts[d] + counts[d] > m_Dimensions[d] )
+      return false;
+    }
+
+  if ( ! this->CanReadChunks() || ! this->IsChunkAligned( starts, counts ) )
+    return this->WriteHyperslabThroughHDF5( starts, counts, buffer );
+
+  std::vector<unsigned long> firstChunk( n ), lastChunk( n );
+  size_t chunkVoxels = 1;
+  for( unsigned int d = 0; d < n; ++d )
+    {
+    firstChunk[d] = starts[d] / m_ChunkSize[d];
+    lastChunk[d] = ( starts[d] + counts[d] - 1 ) / m_ChunkSize[d];
+    chunkVoxels *= m_ChunkSize[d];
+    }
+
+  ChunkBatch batch;
+  batch.numDimensions = n;
+  batch.dimensions = &m_Dimensions[0];
+  batch.chunkSize = &m_ChunkSize[0];
+  batch.starts = starts;
+  batch.counts = counts;
+  batch.voxelSize = m_VoxelSize;
+  batch.componentSize = m_ComponentSize;
+  batch.chunkBytes = chunkVoxels * m_VoxelSize;
+  batch.swapBytes = m_SwapBytes;
+  batch.deflate = m_Deflate;
+  batch.deflateIndex = m_DeflateIndex;
+  batch.deflateLevel = m_DeflateLevel;
+  batch.fillValue = &m_FillValue;
+  batch.output = 0;
+  batch.input = static_cast<const char*>( buffer );
+  batch.file = 0;
+  batch.cache = 0;
+
+  const unsigned int batchSize = 4 * m_NumberOfThreads;
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+
+  std::vector<unsigned long> chunkIndex( firstChunk );
+  std::vector<hsize_t> offset( n );
+  bool done = false;
+
+  while( ! done )
+    {
+    done = NextChunks( batch, chunkIndex, firstChunk, lastChunk, batchSize );
+
+    // Gather and encode in parallel
+    batch.raw.assign( batch.origins.size(), std::vector<unsigned char>() );
+    batch.failed.assign( batch.origins.size(), 0 );
+
+    int numThreads = std::min( m_NumberOfThreads, static_cast<int>( batch.raw.size() ) );
+    threader->SetNumberOfThreads( numThreads );
+    threader->SetSingleMethod( EncodeChunksThreadCallback, &batch );
+    threader->SingleMethodExecute();
+
+    if ( std::find( batch.failed.begin(), batch.failed.end(), 1 ) != batch.failed.end() )
+      return false;
+
+    // Store the encoded chunks
+    for( unsigned int i = 0; i < batch.raw.size(); ++i )
+      {
+      std::copy( batch.origins[i].begin(), batch.origins[i].end(), offset.begin() );
+      if ( H5Dwrite_chunk( m_Dataset, H5P_DEFAULT, 0, &offset[0],
+                           batch.raw[i].size(), &batch.raw[i][0] ) < 0 )
+        {
+        return false;
+        }
+      }
+    }
+
+  return true;
+}
+
+bool MINCImageDataset::WriteHyperslabThroughHDF5( const unsigned long starts[],
+                                                  const unsigned long counts[],
+                                                  const void* buffer )
+{
+  const unsigned int n = this->GetNumberOfDimensions();
+
+  std::vector<hsize_t> start( starts, starts + n );
+  std::vector<hsize_t> count( counts, counts + n );
+
+  hid_t fileSpace = H5Dget_space( m_Dataset );
+  hid_t memorySpace = H5Screate_simple( n, &count[0], 0 );
+  H5Sselect_hyperslab( fileSpace, H5S_SELECT_SET, &start[0], 0, &count[0], 0 );
+
+  herr_t status = H5Dwrite( m_Dataset, m_MemoryType, memorySpace, fileSpace,
+                            H5P_DEFAULT, buffer );
+
+  H5Sclose( memorySpace );
+  H5Sclose( fileSpace );
+
+  return status >= 0;
+}
+
+bool MINCImageDataset::PlanRead( const unsigned long starts[],
+                                 const unsigned long counts[],
+                                 ReadPlan& plan ) const
+{
+  if ( ! this->IsOpen() || ! m_RawFile->IsOpen() )
+    return false;
+
+  const int n = static_cast<int>( this->GetNumberOfDimensions() );
+
+  plan = ReadPlan();
+  plan.starts.assign( starts, starts + n );
+  plan.counts.assign( counts, counts + n );
+
+  for( int d = 0; d < n; ++d )
+    {
+    if ( counts[d] == 0 )
+      return true;
+    if ( starts[d] + counts[d] > m_Dimensions[d] )
+      return false;
+    }
+
+  if ( m_ContiguousAddress == 0 )
+    {
+#if ITK_MINC_DIRECT_CHUNK_READS
+    // Look up where each chunk is
+    ChunkBatch batch;
+    batch.numDimensions = n;
+    batch.chunkSize = &m_ChunkSize[0];
+
+    std::vector<unsigned long> firstChunk( n ), lastChunk( n );
+    for( int d = 0; d < n; ++d )
+      {
+      firstChunk[d] = starts[d] / m_ChunkSize[d];
+      lastChunk[d] = ( starts[d] + counts[d] - 1 ) / m_ChunkSize[d];
+      }
+
+    std::vector<unsigned long> chunkIndex( firstChunk );
+    std::vector<hsize_t> offset( n );
+    bool done = false;
+
+    while( ! done )
+      {
+      done = NextChunks( batch, chunkIndex, firstChunk, lastChunk, 1024 );
+
+      for( unsigned int i = 0; i < batch.origins.size(); ++i )
+        {
+        std::copy( batch.origins[i].begin(), batch.origins[i].end(), offset.begin() );
+
+        unsigned int filterMask = 0;
+        haddr_t address = HADDR_UNDEF;
+        hsize_t rawBytes = 0;
+        if ( H5Dget_chunk_info_by_coord( m_Dataset, &offset[0], &filterMask,
+                                         &address, &rawBytes ) < 0 )
+          {
+          return false;
+          }
+
+        const bool written = address != HADDR_UNDEF && rawBytes > 0;
+        plan.chunkOrigins.insert( plan.chunkOrigins.end(),
+                                  batch.origins[i].begin(), batch.origins[i].end() );
+        plan.chunkAddresses.push_back( written ? address : 0 );
+        plan.chunkBytes.push_back( written ? rawBytes : 0 );
+        plan.filterMasks.push_back( filterMask );
+        }
+      }
+
+    return true;
+#else
+    return false;
+#endif
+    }
+
+  // The hyperslab is a series of runs of consecutive voxels in the
+  // file: dimensions k+1 onwards are covered entirely, so a run spans
+  // counts[k] of their blocks.
+  int k = n - 1;
+  size_t blockVoxels = 1;
+  while( k > 0 && starts[k] == 0 && counts[k] == m_Dimensions[k] )
+    {
+    blockVoxels *= m_Dimensions[k];
+    --k;
+    }
+  const size_t runBytes = counts[k] * blockVoxels * m_VoxelSize;
+  const size_t segmentBytes = std::max<size_t>( MaximumSegmentBytes / m_VoxelSize, 1 ) * m_VoxelSize;
+
+  std::vector<unsigned long> index( starts, starts + k );
+  size_t bufferOffset = 0;
+
+  while( true )
+    {
+    size_t voxel = 0;
+    for( int d = 0; d < n; ++d )
+      voxel = voxel * m_Dimensions[d] + ( d < k ? index[d] : d == k ? starts[d] : 0 );
+
+    for( size_t b = 0; b < runBytes; b += segmentBytes )
+      {
+      plan.segmentAddresses.push_back( m_ContiguousAddress + voxel * m_VoxelSize + b );
+      plan.segmentOffsets.push_back( bufferOffset + b );
+      plan.segmentBytes.push_back( std::min( segmentBytes, runBytes - b ) );
+      }
+    bufferOffset += runBytes;
+
+    int d = k - 1;
+    for( ; d >= 0; --d )
+      {
+      if ( ++index[d] < starts[d] + counts[d] )
+        break;
+      index[d] = starts[d];
+      }
+    if ( d < 0 )
+      break;
+    }
+
+  return true;
+}
+
+bool MINCImageDataset::ExecuteRead( const ReadPlan& plan, int numberOfThreads, void* buffer,
+                                    MINCReadStatistics* statistics ) const
+{
+  const unsigned int n = this->GetNumberOfDimensions();
+  if ( ! m_RawFile->IsOpen() || plan.starts.size() != n )
+    return false;
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+
+  if ( ! plan.segmentAddresses.empty() )
+    {
+    ContiguousRead read;
+    read.file = m_RawFile;
+    read.mapped = m_RawFile->GetMappedData();
+    read.mappedAddress = m_ContiguousAddress;
+    read.plan = &plan;
+    read.output = static_cast<char*>( buffer );
+    read.componentSize = m_ComponentSize;
+    read.swapBytes = m_SwapBytes;
+
+    const int numThreads = static_cast<int>( std::min<size_t>( std::max( numberOfThreads, 1 ),
+                                                               plan.segmentAddresses.size() ) );
+    read.failed.assign( numThreads, 0 );
+
+    threader->SetNumberOfThreads( numThreads );
+    threader->SetSingleMethod( ReadContiguousThreadCallback, &read );
+    threader->SingleMethodExecute();
+
+    if ( std::find( read.failed.begin(), read.failed.end(), 1 ) != read.failed.end() )
+      return false;
+
+    if ( statistics )
+      {
+      for( size_t i = 0; i < plan.segmentBytes.size(); ++i )
+        statistics->bytesRead += plan.segmentBytes[i];
+      }
+    return true;
+    }
+
+  const size_t numChunks = plan.chunkAddresses.size();
+  if ( numChunks == 0 )
+    return true;
+
+  size_t chunkVoxels = 1;
+  for( unsigned int d = 0; d < n; ++d )
+    chunkVoxels *= m_ChunkSize[d];
+
+  ChunkBatch batch;
+  batch.numDimensions = n;
+  batch.dimensions = &m_Dimensions[0];
+  batch.chunkSize = &m_ChunkSize[0];
+  batch.starts = &plan.starts[0];
+  batch.counts = &plan.counts[0];
+  batch.voxelSize = m_VoxelSize;
+  batch.componentSize = m_ComponentSize;
+  batch.chunkBytes = chunkVoxels * m_VoxelSize;
+  batch.swapBytes = m_SwapBytes;
+  batch.deflate = m_Deflate;
+  batch.deflateIndex = m_DeflateIndex;
+  batch.deflateLevel = m_DeflateLevel;
+  batch.fillValue = &m_FillValue;
+  batch.output = static_cast<char*>( buffer );
+  batch.input = 0;
+  batch.file = m_RawFile;
+
+  batch.origins.resize( numChunks );
+  for( size_t i = 0; i < numChunks; ++i )
+    batch.origins[i].assign( plan.chunkOrigins.begin() + i * n, plan.chunkOrigins.begin() + ( i + 1 ) * n );
+  batch.raw.assign( numChunks, std::vector<unsigned char>() );
+  batch.filterMasks = plan.filterMasks;
+  batch.addresses = plan.chunkAddresses;
+  batch.rawSizes = plan.chunkBytes;
+  batch.cache = m_ChunkCache->GetMaximumSize() > 0 ? m_ChunkCache : 0;
+  batch.cached.assign( numChunks, 0 );
+  batch.cacheHits.assign( numChunks, 0 );
+  batch.failed.assign( numChunks, 0 );
+
+  const int numThreads = static_cast<int>( std::min<size_t>( std::max( numberOfThreads, 1 ), numChunks ) );
+  threader->SetNumberOfThreads( numThreads );
+  threader->SetSingleMethod( DecodeChunksThreadCallback, &batch );
+  threader->SingleMethodExecute();
+
+  if ( std::find( batch.failed.begin(), batch.failed.end(), 1 ) != batch.failed.end() )
+    return false;
+
+  TallyChunks( batch, statistics );
+  return true;
+}
+
+const void* MINCImageDataset::GetMappedHyperslab( const unsigned long starts[],
+                                                 const unsigned long counts[] ) const
+{
+  const char* mapped = m_RawFile->GetMappedData();
+  if ( ! mapped || m_SwapBytes )
+    return 0;
+
+  // Once a dimension spans more than one index, every faster one must
+  // be covered entirely.
+  const unsigned int n = this->GetNumberOfDimensions();
+  size_t offset = 0;
+  bool spanning = false;
+  for( unsigned int d = 0; d < n; ++d )
+    {
+    if ( counts[d] == 0 || starts[d] + counts[d] > m_Dimensions[d] )
+      return 0;
+    if ( spanning && counts[d] != m_Dimensions[d] )
+      return 0;
+    spanning = spanning || counts[d] > 1;
+    offset = offset * m_Dimensions[d] + starts[d];
+    }
+
+  return mapped + offset * m_VoxelSize;
+}
+
+bool MINCImageDataset::ReadHyperslabThroughHDF5( const unsigned long starts[],
+                                                 const unsigned long counts[],
+                                                 void* buffer )
+{
+  const unsigned int n = this->GetNumberOfDimensions();
+
+  std::vector<hsize_t> start( starts, starts + n );
+  std::vector<hsize_t> count( counts, counts + n );
+
+  hid_t fileSpace = H5Dget_space( m_Dataset );
+  hid_t memorySpace = H5Screate_simple( n, &count[0], 0 );
+  H5Sselect_hyperslab( fileSpace, H5S_SELECT_SET, &start[0], 0, &count[0], 0 );
+
+  herr_t status = H5Dread( m_Dataset, m_MemoryType, memorySpace, fileSpace,
+                           H5P_DEFAULT, buffer );
+
+  H5Sclose( memorySpace );
+  H5Sclose( fileSpace );
+
+  return status >= 0;
+}
+
+bool MINCImageDataset::CreateResolutionLevel( unsigned int level,
+                                              const unsigned long dimensions[],
+                                              bool sliceScaling )
+{
+  if ( ! this->IsOpen() || level == 0 )
+    return false;
+
+  const unsigned int n = this->GetNumberOfDimensions();
+
+  std::ostringstream groupPath;
+  groupPath << "/minc-2.0/image/" << level;
+
+  hid_t group;
+  H5E_BEGIN_TRY
+    {
+    H5Ldelete( m_File, groupPath.str().c_str(), H5P_DEFAULT );
+    group = H5Gcreate2( m_File, groupPath.str().c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    }
+  H5E_END_TRY;
+
+  if ( group < 0 )
+    return false;
+
+  std::vector<hsize_t> dims( dimensions, dimensions + n );
+
+  hid_t fileType = H5Dget_type( m_Dataset );
+  hid_t dcpl = H5Dget_create_plist( m_Dataset );
+  if ( m_Chunked )
+    {
+    std::vector<hsize_t> chunk( n );
+    for( unsigned int d = 0; d < n; ++d )
+      chunk[d] = std::min<hsize_t>( m_ChunkSize[d], std::max<hsize_t>( dims[d], 1 ) );
+    H5Pset_chunk( dcpl, n, &chunk[0] );
+    }
+
+  hid_t space = H5Screate_simple( n, &dims[0], 0 );
+  hid_t image = H5Dcreate2( group, "image", fileType, space, H5P_DEFAULT, dcpl, H5P_DEFAULT );
+
+  bool ok = image >= 0 && CopyAttributes( m_Dataset, image );
+
+  if ( image >= 0 )
+    H5Dclose( image );
+  H5Sclose( space );
+  H5Pclose( dcpl );
+  H5Tclose( fileType );
+
+  ok = ok
+    && this->CreateLevelRangeDataset( group, "image-min", dimensions, sliceScaling )
+    && this->CreateLevelRangeDataset( group, "image-max", dimensions, sliceScaling );
+
+  H5Gclose( group );
+  return ok;
+}
+
+bool MINCImageDataset::CreateLevelRangeDataset( hid_t group, const char* name,
+                                                const unsigned long dimensions[],
+                                                bool sliceScaling )
+{
+  const std::string path = m_GroupPath + "/" + name;
+
+  hid_t source;
+  H5E_BEGIN_TRY
+    {
+    source = H5Dopen2( m_File, path.c_str(), H5P_DEFAULT );
+    }
+  H5E_END_TRY;
+
+  // Label volumes, for one, have no range
+  if ( source < 0 )
+    return true;
+
+  hid_t space;
+  std::vector<double> values;
+
+  if ( sliceScaling )
+    {
+    const unsigned int n = this->GetNumberOfDimensions();
+    if ( n < 3 )
+      {
+      H5Dclose( source );
+      return false;
+      }
+    std::vector<hsize_t> dims( dimensions, dimensions + n - 2 );
+    space = H5Screate_simple( n - 2, &dims[0], 0 );
+    values.assign( H5Sget_simple_extent_npoints( space ), 0.0 );
+    }
+  else
+    {
+    space = H5Dget_space( source );
+    values.resize( H5Sget_simple_extent_npoints( space ) );
+    if ( ! values.empty() )
+      H5Dread( source, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0] );
+    }
+
+  hid_t fileType = H5Dget_type( source );
+  hid_t range = H5Dcreate2( group, name, fileType, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+
+  bool ok = range >= 0
+    && CopyAttributes( source, range )
+    && ( values.empty() 
+         || H5Dwrite( range, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0] ) >= 0 );
+
+  if ( range >= 0 )
+    H5Dclose( range );
+  H5Tclose( fileType );
+  H5Sclose( space );
+  H5Dclose( source );
+
+  return ok;
+}
+
+bool MINCImageDataset::ReadImageRange( std::vector<double>& imageMin,
+                                       std::vector<double>& imageMax )
+{
+  return this->ReadRangeDataset( "image-min", imageMin )
+    && this->ReadRangeDataset( "image-max", imageMax )
+    && imageMin.size() == imageMax.size();
+}
+
+bool MINCImageDataset::HasImage( const char* filename )
+{
+  bool hasImage = false;
+
+  H5E_BEGIN_TRY
+    {
+    hid_t file = H5Fopen( filename, H5F_ACC_RDONLY, H5P_DEFAULT );
+    if ( file >= 0 )
+      {
+      hid_t dataset = H5Dopen2( file, "/minc-2.0/image/0/image", H5P_DEFAULT );
+      hasImage = dataset >= 0;
+      if ( hasImage )
+	H5Dclose( dataset );
+      H5Fclose( file );
+      }
+    }
+  H5E_END_TRY;
+
+  return hasImage;
+}
+
+unsigned int MINCImageDataset::GetNumberOfResolutionLevels() const
+{
+  if ( ! this->IsOpen() )
+    return 0;
+
+  unsigned int level = 0;
+  for( ;; ++level )
+    {
+    std::ostringstream imagePath;
+    imagePath << "/minc-2.0/image/" << level << "/image";
+
+    hid_t dataset;
+    H5E_BEGIN_TRY
+      {
+      dataset = H5Dopen2( m_File, imagePath.str().c_str(), H5P_DEFAULT );
+      }
+    H5E_END_TRY;
+
+    if ( dataset < 0 )
+      break;
+    H5Dclose( dataset );
+    }
+
+  return level;
+}
+
+bool MINCImageDataset::WriteImageRange( const std::vector<double>& imageMin,
+                                        const std::vector<double>& imageMax )
+{
+  return this->WriteRangeDataset( "image-min", imageMin )
+    && this->WriteRangeDataset( "image-max", imageMax );
+}
+
+bool MINCImageDataset::WriteRangeDataset( const char* name, const std::vector<double>& values )
+{
+  if ( ! this->IsOpen() || values.empty() )
+    return false;
+
+  const std::string path = m_GroupPath + "/" + name;
+
+  hid_t dataset;
+  H5E_BEGIN_TRY
+    {
+    dataset = H5Dopen2( m_File, path.c_str(), H5P_DEFAULT );
+    }
+  H5E_END_TRY;
+
+  if ( dataset < 0 )
+    return false;
+
+  hid_t space = H5Dget_space( dataset );
+  hssize_t numValues = H5Sget_simple_extent_npoints( space );
+  H5Sclose( space );
+
+  bool ok = numValues == static_cast<hssize_t>( values.size() )
+    && H5Dwrite( dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0] ) >= 0;
+
+  H5Dclose( dataset );
+  return ok;
+}
+
+bool MINCImageDataset::ReadRangeDataset( const char* name, std::vector<double>& values )
+{
+  if ( ! this->IsOpen() )
+    return false;
+
+  const std::string path = m_GroupPath + "/" + name;
+
+  hid_t dataset;
+  H5E_BEGIN_TRY
+    {
+    dataset = H5Dopen2( m_File, path.c_str(), H5P_DEFAULT );
+    }
+  H5E_END_TRY;
+
+  if ( dataset < 0 )
+    return false;
+
+  hid_t space = H5Dget_space( dataset );
+  hssize_t numValues = H5Sget_simple_extent_npoints( space );
+  H5Sclose( space );
+
+  bool ok = numValues > 0;
+  if ( ok )
+    {
+    values.resize( numValues );
+    ok = H5Dread( dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0] ) >= 0;
+    }
+
+  H5Dclose( dataset );
+  return ok;
+}
+
+
+} // namespace itk
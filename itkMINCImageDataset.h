@@ -0,0 +1,317 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCImageDataset.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCImageDataset_h
+#define __itkMINCImageDataset_h
+
+#include <string>
+#include <vector>
+
+#include <hdf5.h>
+
+
+namespace itk
+{
+
+class MINCChunkCache;
+class MINCRawFile;
+struct MINCReadStatistics;
+
+/** \class MINCImageDataset
+ *
+ * \brief Direct HDF5 access to the image dataset of a MINC2 file.
+ *
+ * libminc reads a hyperslab through HDF5, which inflates the
+ * compressed chunks one after another on the calling thread.  This
+ * class instead fetches the raw chunks that intersect the hyperslab,
+ * inflates them on a pool of threads and scatters the stored voxel
+ * values into the caller's buffer.  Writing works the same way in
+ * reverse: chunks are gathered and deflated on the pool, then handed
+ * to HDF5 as they are.
+ *
+ * HDF5 is not thread-safe, so every HDF5 call is made from the
+ * calling thread; the worker threads only run zlib and memcpy.  When
+ * a file opened for reading uses the default file driver, the calling
+ * thread only looks up where the data lie and the worker threads read
+ * the bytes themselves, bypassing HDF5, so the I/O is parallel too.
+ * The data of an uncompressed contiguous dataset may instead be
+ * mapped into memory and copied from there.
+ *
+ * Dimensions are in file order (slowest-varying first) and voxels are
+ * delivered in native byte order, without any voxel-to-real scaling.
+ *
+ * \ingroup IOFilters
+ */
+class MINCImageDataset
+{
+public:
+  MINCImageDataset();
+  ~MINCImageDataset();
+
+  // Open the image dataset of the given resolution level (0 is full
+  // resolution), for writing if writable is set.  Returns false if
+  // the file is not an HDF5 MINC2 file.
+  bool Open( const char* filename, unsigned int level = 0, bool writable = false );
+  void Close();
+
+  // Whether filename is an HDF5 file with a full-resolution MINC2
+  // image.  Cheaper than Open(): only the file and the image dataset
+  // are opened.
+  static bool HasImage( const char* filename );
+
+  bool IsOpen() const
+  {
+    return m_Dataset >= 0;
+  }
+
+  unsigned int GetNumberOfDimensions() const
+  {
+    return m_Dimensions.size();
+  }
+
+  unsigned long GetDimensionSize( unsigned int d ) const
+  {
+    return m_Dimensions[d];
+  }
+
+  // Chunk size along dimension d; the dimension size if the dataset
+  // is not chunked.
+  unsigned long GetChunkSize( unsigned int d ) const
+  {
+    return m_ChunkSize[d];
+  }
+
+  bool IsChunked() const
+  {
+    return m_Chunked;
+  }
+
+  bool IsCompressed() const
+  {
+    return m_Deflate;
+  }
+
+  // zlib level of the deflate filter, 0 if there is none, -1 if the
+  // filter leaves it to zlib's default.
+  int GetCompressionLevel() const
+  {
+    return m_Deflate ? m_DeflateLevel : 0;
+  }
+
+  // True if ReadHyperslab() decodes the chunks itself, i.e. the
+  // dataset is chunked and only uses the deflate filter.  Other
+  // datasets are read through H5Dread.
+  bool CanReadChunks() const
+  {
+    return m_Chunked && m_FiltersSupported;
+  }
+
+  // True if ReadHyperslab() reads on several threads: the chunks can
+  // be read as above, or the dataset is contiguous and is read
+  // straight from the file.
+  bool CanReadInParallel() const
+  {
+    return this->CanReadChunks() || m_ContiguousAddress != 0;
+  }
+
+  // Size in bytes of one stored voxel, and of one of its components
+  // (these differ for complex data).
+  size_t GetVoxelSize() const
+  {
+    return m_VoxelSize;
+  }
+
+  size_t GetComponentSize() const
+  {
+    return m_ComponentSize;
+  }
+
+  // Number of resolution levels stored in the open file, counting
+  // full resolution: levels 0 to n-1 all have an image dataset.
+  unsigned int GetNumberOfResolutionLevels() const;
+
+  void SetNumberOfThreads( int numberOfThreads );
+
+  int GetNumberOfThreads() const
+  {
+    return m_NumberOfThreads;
+  }
+
+  // Chunk cache: its size in bytes, its number of hash slots and its
+  // preemption policy w0, as for H5Pset_chunk_cache().  They apply to
+  // the reads made through HDF5 and, but for the slots, to the decoded
+  // chunks kept by this class for the reads it decodes itself.  Pass
+  // H5D_CHUNK_CACHE_NBYTES_DEFAULT, H5D_CHUNK_CACHE_NSLOTS_DEFAULT and
+  // H5D_CHUNK_CACHE_W0_DEFAULT for the defaults of HDF5, with no
+  // decoded chunks kept.  Takes effect at once if the dataset is open.
+  void SetChunkCache( size_t numBytes, size_t numSlots, double policy );
+
+  // Map the data of contiguous datasets into memory when they are
+  // opened for reading, rather than reading them with pread.  On by
+  // default; takes effect at the next Open().
+  void SetUseMemoryMapping( bool useMemoryMapping )
+  {
+    m_UseMemoryMapping = useMemoryMapping;
+  }
+
+  bool GetUseMemoryMapping() const
+  {
+    return m_UseMemoryMapping;
+  }
+
+  // The stored voxels of the hyperslab (starts, counts), in place in
+  // the mapped file, if they form one run of the file in native byte
+  // order; else 0.  Valid until the dataset is closed.
+  const void* GetMappedHyperslab( const unsigned long starts[],
+                                  const unsigned long counts[] ) const;
+
+  // Read the stored voxels of the hyperslab (starts, counts) into
+  // buffer, last dimension varying fastest.  The bytes and chunks read
+  // are added to statistics, if given.  Returns false on error.
+  bool ReadHyperslab( const unsigned long starts[],
+                      const unsigned long counts[],
+                      void* buffer,
+                      MINCReadStatistics* statistics = 0 );
+
+  // A read of a hyperslab looked up in advance by PlanRead(), so that
+  // ExecuteRead() makes no HDF5 call and can run on any thread.
+  struct ReadPlan
+  {
+    std::vector<unsigned long> starts;
+    std::vector<unsigned long> counts;
+
+    // Chunked datasets: the origin of each chunk (one value per
+    // dimension), the file address and size of its raw bytes (address
+    // 0 if it was never written) and its filter mask.
+    std::vector<unsigned long> chunkOrigins;
+    std::vector<unsigned long long> chunkAddresses;
+    std::vector<size_t> chunkBytes;
+    std::vector<unsigned int> filterMasks;
+
+    // Contiguous datasets: the file address, offset in the buffer and
+    // size of each segment read.
+    std::vector<unsigned long long> segmentAddresses;
+    std::vector<size_t> segmentOffsets;
+    std::vector<size_t> segmentBytes;
+  };
+
+  // Plan the read of the hyperslab (starts, counts).  Returns false if
+  // the dataset is not read around HDF5 or on error.
+  bool PlanRead( const unsigned long starts[],
+                 const unsigned long counts[],
+                 ReadPlan& plan ) const;
+
+  // Carry out a plan on numberOfThreads threads, adding the bytes and
+  // chunks read to statistics, if given.  The dataset must stay open
+  // until this returns.  Returns false on error.
+  bool ExecuteRead( const ReadPlan& plan, int numberOfThreads, void* buffer,
+                    MINCReadStatistics* statistics = 0 ) const;
+
+  // Write the stored voxels of the hyperslab (starts, counts) from
+  // buffer, last dimension varying fastest.  Chunks lying entirely
+  // inside the hyperslab are compressed in parallel; any other
+  // hyperslab is left to HDF5.  Returns false on error.
+  bool WriteHyperslab( const unsigned long starts[],
+                       const unsigned long counts[],
+                       const void* buffer );
+
+  // Create the image of a lower resolution level, with the given
+  // dimensions, alongside this full-resolution image.  The new image
+  // has the same type, filters and attributes, and chunks clipped to
+  // its size.  Range datasets are created with it when this image has
+  // them: one value per slice if sliceScaling is set, else a copy of
+  // this image's range.  An existing level is replaced.  Returns
+  // false on error.
+  bool CreateResolutionLevel( unsigned int level,
+                              const unsigned long dimensions[],
+                              bool sliceScaling );
+
+  // Read the image-min and image-max datasets that accompany the
+  // image, one value per slice.  Returns false if they are missing.
+  bool ReadImageRange( std::vector<double>& imageMin,
+                       std::vector<double>& imageMax );
+
+  // Write the image-min and image-max datasets, which must already
+  // exist with one value per slice.  Returns false on error.
+  bool WriteImageRange( const std::vector<double>& imageMin,
+                        const std::vector<double>& imageMax );
+
+private:
+  MINCImageDataset(const MINCImageDataset&); //purposely not implemented
+  void operator=(const MINCImageDataset&); //purposely not implemented
+
+  bool ReadRangeDataset( const char* name, std::vector<double>& values );
+  bool WriteRangeDataset( const char* name, const std::vector<double>& values );
+
+  // Create the range dataset name of a new resolution level in group.
+  bool CreateLevelRangeDataset( hid_t group, const char* name,
+                                const unsigned long dimensions[],
+                                bool sliceScaling );
+
+  // Read the hyperslab through H5Dread.
+  bool ReadHyperslabThroughHDF5( const unsigned long starts[],
+                                 const unsigned long counts[],
+                                 void* buffer );
+
+  // True if the hyperslab is made of whole chunks, clipped only by
+  // the edge of the dataset.
+  bool IsChunkAligned( const unsigned long starts[],
+                       const unsigned long counts[] ) const;
+
+  // Open the image dataset of m_GroupPath with the chunk cache set.
+  hid_t OpenImage() const;
+
+  // Write the hyperslab through H5Dwrite.
+  bool WriteHyperslabThroughHDF5( const unsigned long starts[],
+                                  const unsigned long counts[],
+                                  const void* buffer );
+
+  hid_t m_File;
+  hid_t m_Dataset;
+  std::string m_GroupPath;
+
+  std::vector<unsigned long> m_Dimensions;
+  std::vector<unsigned long> m_ChunkSize;
+  bool m_Chunked;
+
+  // Index and level of the deflate filter in the pipeline, if any
+  bool m_Deflate;
+  unsigned int m_DeflateIndex;
+  int m_DeflateLevel;
+  bool m_FiltersSupported;
+
+  size_t m_VoxelSize;
+  size_t m_ComponentSize;
+  bool m_SwapBytes;
+  hid_t m_MemoryType;
+  std::vector<char> m_FillValue;
+
+  // The file, for reading around HDF5, and the address of the data of
+  // a contiguous dataset in it (0 if it cannot be read directly).
+  MINCRawFile* m_RawFile;
+  unsigned long long m_ContiguousAddress;
+  bool m_UseMemoryMapping;
+
+  size_t m_ChunkCacheBytes;
+  size_t m_ChunkCacheSlots;
+  double m_ChunkCachePolicy;
+  MINCChunkCache* m_ChunkCache;
+
+  int m_NumberOfThreads;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCImageDataset_h
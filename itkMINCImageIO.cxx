@@ -1,7 +1,26 @@
 #include "itkMINCImageIO.h"
-
+#include "itkMINCAxisPermuter.h"
+#include "itkMINCFileStamp.h"
+#include "itkMINCHeaderCache.h"
+#include "itkMINCImageDataset.h"
+#include "itkMINCNetCDFFile.h"
+#include "itkMINCPyramidBuilder.h"
+#include "itkMINCReadAhead.h"
+#include "itkMINCSerialization.h"
+#include "itkMINCVolumeCache.h"
+#include "itkMINCVoxelRescaler.h"
+#include "itkMetaDataObject.h"
+#include "itkMutexLockHolder.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
 #include <cassert>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <sstream>
 
 
 
@@ -99,272 +118,3118 @@ void ConvertRegionToMINC( const itk::ImageIORegion& region,
     }
 }
 
-} // end of unnamed namespace
-
-
-MINCImageIO::MINCImageIO()
-  : m_VolumeValid( false ),
-    m_VolumeDimension( 0 )
+/**
+ * Range of an integer MINC type.  Returns false for floating-point types.
+ */
+bool GetMINCTypeRange( const mitype_t& mincType, double& minimum, double& maximum )
 {
-  this->AddSupportedReadExtension( ".mnc" );
-  this->AddSupportedReadExtension( ".mnc2" );
-
-  this->AddSupportedWriteExtension( ".mnc" );
-  this->AddSupportedWriteExtension( ".mnc2" );
+  switch( mincType )
+    {
+    case MI_TYPE_BYTE:
+      minimum = std::numeric_limits<signed char>::min();
+      maximum = std::numeric_limits<signed char>::max();
+      return true;
+    case MI_TYPE_UBYTE:
+      minimum = std::numeric_limits<unsigned char>::min();
+      maximum = std::numeric_limits<unsigned char>::max();
+      return true;
+    case MI_TYPE_SHORT:
+      minimum = std::numeric_limits<short>::min();
+      maximum = std::numeric_limits<short>::max();
+      return true;
+    case MI_TYPE_USHORT:
+      minimum = std::numeric_limits<unsigned short>::min();
+      maximum = std::numeric_limits<unsigned short>::max();
+      return true;
+    case MI_TYPE_INT:
+      minimum = std::numeric_limits<int>::min();
+      maximum = std::numeric_limits<int>::max();
+      return true;
+    case MI_TYPE_UINT:
+      minimum = std::numeric_limits<unsigned int>::min();
+      maximum = std::numeric_limits<unsigned int>::max();
+      return true;
+    default:
+      return false;
+    }
 }
 
-MINCImageIO::~MINCImageIO()
+/**
+ * Size in bytes of one component of a voxel of the given MINC type.
+ */
+size_t ComponentSizeOfMINCType( const mitype_t& mincType )
 {
-  this->CloseVolume();
+  switch( mincType )
+    {
+    case MI_TYPE_BYTE:
+    case MI_TYPE_UBYTE:
+      return 1;
+    case MI_TYPE_SHORT:
+    case MI_TYPE_USHORT:
+    case MI_TYPE_SCOMPLEX:
+      return 2;
+    case MI_TYPE_INT:
+    case MI_TYPE_UINT:
+    case MI_TYPE_ICOMPLEX:
+    case MI_TYPE_FLOAT:
+    case MI_TYPE_FCOMPLEX:
+      return 4;
+    case MI_TYPE_DOUBLE:
+    case MI_TYPE_DCOMPLEX:
+      return 8;
+    default:
+      return 0;
+    }
 }
 
-void MINCImageIO::PrintSelf( std::ostream& os, Indent indent ) const
+/**
+ * Start and step of an irregularly sampled dimension: its first
+ * sample, and the mean step between samples or, failing that, the
+ * width of the first.
+ */
+void ComputeIrregularSampling( const std::vector<double>& offsets,
+			       const std::vector<double>& widths,
+			       double& start, double& step )
 {
-  Superclass::PrintSelf( os, indent );
-  os << indent << "Volume: ";
-
-  if ( m_VolumeValid )
-    os << m_Volume;
-  else
-    os << "(none)";
-  os << "\n";
+  start = offsets.front();
+  step = widths.front();
+  if ( offsets.size() > 1 && offsets.back() != offsets.front() )
+    step = ( offsets.back() - offsets.front() ) / ( offsets.size() - 1 );
+  if ( step == 0 )
+    step = 1.0;
 }
 
-bool MINCImageIO::CanReadFile( const char* filename )
+/**
+ * Position of each sample of a dimension along its axis, in file
+ * order, and the width of each.
+ */
+bool GetDimensionSamples( midimhandle_t dimension, std::vector<double>& offsets,
+			  std::vector<double>& widths )
 {
-  mihandle_t volume;
+  unsigned int size;
+  miboolean_t irregular = 0;
+  if ( miget_dimension_size( dimension, &size ) == MI_ERROR || size == 0
+       || miget_dimension_sampling_flag( dimension, &irregular ) == MI_ERROR )
+    {
+    return false;
+    }
 
-  bool canRead = miopen_volume( filename, MI2_OPEN_READ, &volume ) == MI_NOERROR;
+  offsets.resize( size );
+  widths.resize( size );
 
-  if ( canRead )
-    miclose_volume( volume );
+  double step = 1.0;
+  if ( irregular )
+    {
+    if ( miget_dimension_offsets( dimension, size, 0, &offsets[0] ) == MI_ERROR )
+      return false;
+    if ( size > 1 )
+      step = ( offsets[size - 1] - offsets[0] ) / ( size - 1 );
+    }
+  else
+    {
+    double start;
+    if ( miget_dimension_start( dimension, MI_ORDER_FILE, &start ) == MI_ERROR
+	 || miget_dimension_separation( dimension, MI_ORDER_FILE, &step ) == MI_ERROR )
+      {
+      return false;
+      }
+    for( unsigned int i = 0; i < size; ++i )
+      offsets[i] = start + i * step;
+    }
 
-  return canRead;
+  // Samples without widths of their own are as wide as the step
+  if ( miget_dimension_widths( dimension, MI_ORDER_FILE, size, 0, &widths[0] ) == MI_ERROR )
+    widths.assign( size, std::fabs( step ) );
+
+  return true;
 }
 
-void MINCImageIO::ReadImageInformation()
+/**
+ * Start and step of a dimension in file order.  The step of an
+ * irregularly sampled dimension is the mean step between its samples.
+ */
+bool GetDimensionSampling( midimhandle_t dimension, double& start, double& step )
 {
-  this->CloseVolume();
-
-  const char* filename = this->GetFileName();
-  if ( miopen_volume( filename, MI2_OPEN_READ, &m_Volume ) == MI_ERROR )
+  miboolean_t irregular = 0;
+  if ( miget_dimension_sampling_flag( dimension, &irregular ) == MI_ERROR || ! irregular )
     {
-    itkExceptionMacro(<< "cannot read file " << filename );
+    return miget_dimension_start( dimension, MI_ORDER_FILE, &start ) != MI_ERROR
+      && miget_dimension_separation( dimension, MI_ORDER_FILE, &step ) != MI_ERROR;
     }
 
-  m_VolumeValid = true;
+  std::vector<double> offsets, widths;
+  if ( ! GetDimensionSamples( dimension, offsets, widths ) )
+    return false;
 
-  this->ReadPixelInformation();
-  this->ReadShapeInformation();
-  this->ReadImageToWorldInformation();
-  this->ComputeStrides();
+  ComputeIrregularSampling( offsets, widths, start, step );
+  return true;
 }
 
-void MINCImageIO::Read( void* buffer )
+/**
+ * Class of a dimension of a MINC1 file, which follows from its name.
+ */
+midimclass_t GetDimensionClass( const std::string& name )
 {
-  mitype_t bufferDataType;
-
-  if ( this->GetPixelType() == itk::ImageIOBase::COMPLEX )
-    bufferDataType = ConvertComplexDataTypeToMINC( this->GetComponentType() );
-  else
-    bufferDataType = ConvertScalarDataTypeToMINC( this->GetComponentType() );
+  if ( name == "xspace" || name == "yspace" || name == "zspace" )
+    return MI_DIMCLASS_SPATIAL;
+  if ( name == "time" )
+    return MI_DIMCLASS_TIME;
+  if ( name == "xfrequency" || name == "yfrequency" || name == "zfrequency" )
+    return MI_DIMCLASS_SFREQUENCY;
+  if ( name == "tfrequency" )
+    return MI_DIMCLASS_TFREQUENCY;
+  if ( name == "vector_dimension" )
+    return MI_DIMCLASS_RECORD;
+  return MI_DIMCLASS_USER;
+}
 
-  unsigned long* starts = new unsigned long[this->GetNumberOfDimensions()];
-  unsigned long* sizes = new unsigned long[this->GetNumberOfDimensions()];
-  ConvertRegionToMINC( this->GetIORegion(), starts, sizes );
+/**
+ * MINC type of a variable of a MINC1 file.  Bytes are unsigned and
+ * other integers signed unless its signtype says otherwise.
+ */
+mitype_t GetNetCDFDataType( const MINCNetCDFFile& file, int variable )
+{
+  std::string signType;
+  file.GetAttribute( variable, "signtype", signType );
 
-  if ( miget_real_value_hyperslab( m_Volume, bufferDataType, starts, sizes, buffer ) == MI_ERROR )
+  switch( file.GetVariableType( variable ) )
     {
-    itkExceptionMacro(<< "error reading pixel values");
+    case MINCNetCDFFile::Byte:
+      return signType == "signed__" ? MI_TYPE_BYTE : MI_TYPE_UBYTE;
+    case MINCNetCDFFile::Short:
+      return signType == "unsigned" ? MI_TYPE_USHORT : MI_TYPE_SHORT;
+    case MINCNetCDFFile::Int:
+      return signType == "unsigned" ? MI_TYPE_UINT : MI_TYPE_INT;
+    case MINCNetCDFFile::Float:
+      return MI_TYPE_FLOAT;
+    case MINCNetCDFFile::Double:
+      return MI_TYPE_DOUBLE;
+    default:
+      return MI_TYPE_UNKNOWN;
     }
-  
-  delete[] starts;
-  delete[] sizes;
 }
 
-bool MINCImageIO::CanWriteFile( const char* filenameOrig )
+template <class T>
+void ComputeRange( const T* values, size_t count, double& minimum, double& maximum )
 {
-  std::string filename( filenameOrig );
+  if ( count == 0 )
+    return;
 
-  // transform filename to lower case to make checks case-insensitive
-  std::transform( filename.begin(), filename.end(), filename.begin(), (int(*)(int)) std::tolower );
+  T lo = values[0];
+  T hi = values[0];
+  for( size_t i = 1; i < count; ++i )
+    {
+    if ( values[i] < lo )
+      lo = values[i];
+    else if ( values[i] > hi )
+      hi = values[i];
+    }
 
-  std::string::size_type mncPos = filename.rfind(".mnc");
-  if ( (mncPos != std::string::npos)
-       && (mncPos > 0)
-       && (mncPos == filename.length() - 4) )
+  minimum = lo;
+  maximum = hi;
+}
+
+/**
+ * Compute the minimum and maximum of count components.
+ */
+void ComputeRange( itk::ImageIOBase::IOComponentType type, const void* values,
+		   size_t count, double& minimum, double& maximum )
+{
+  minimum = maximum = 0;
+
+  switch( type )
     {
-    return true;
+    case itk::ImageIOBase::UCHAR:
+      ComputeRange( static_cast<const unsigned char*>( values ), count, minimum, maximum );
+      break;
+    case itk::ImageIOBase::CHAR:
+      ComputeRange( static_cast<const signed char*>( values ), count, minimum, maximum );
+      break;
+    case itk::ImageIOBase::USHORT:
+      ComputeRange( static_cast<const unsigned short*>( values ), count, minimum, maximum );
+      break;
+    case itk::ImageIOBase::SHORT:
+      ComputeRange( static_cast<const short*>( values ), count, minimum, maximum );
+      break;
+    case itk::ImageIOBase::UINT:
+      ComputeRange( static_cast<const unsigned int*>( values ), count, minimum, maximum );
+      break;
+    case itk::ImageIOBase::INT:
+      ComputeRange( static_cast<const int*>( values ), count, minimum, maximum );
+      break;
+    case itk::ImageIOBase::FLOAT:
+      ComputeRange( static_cast<const float*>( values ), count, minimum, maximum );
+      break;
+    case itk::ImageIOBase::DOUBLE:
+      ComputeRange( static_cast<const double*>( values ), count, minimum, maximum );
+      break;
+    default:
+      itkGenericOutputMacro(<< "unhandled ITK data type: " << type);
     }
+}
 
-  mncPos = filename.rfind(".mnc2");
-  if ( (mncPos != std::string::npos)
-       && (mncPos > 0)
-       && (mncPos == filename.length() - 5) )
+/**
+ * Replace each of count labels by its index in the sorted values.
+ * Returns false if a label is not among them.  Labels may be
+ * replaced in place, their index being no wider than they are.
+ */
+template <class TIn, class TOut>
+bool CompactLabels( const TIn* in, TOut* out, size_t count, const std::vector<int>& values )
+{
+  // Narrow labels are looked up in a table of every value they can
+  // take; wider ones are searched for, runs of the same label once.
+  if ( sizeof( TIn ) <= 2 )
     {
+    const long offset = std::numeric_limits<TIn>::min();
+    std::vector<int> index( static_cast<long>( std::numeric_limits<TIn>::max() ) - offset + 1, -1 );
+    for( size_t v = 0; v < values.size(); ++v )
+      {
+      if ( values[v] >= offset && values[v] <= std::numeric_limits<TIn>::max() )
+	index[values[v] - offset] = v;
+      }
+
+    for( size_t i = 0; i < count; ++i )
+      {
+      const int compact = index[static_cast<long>( in[i] ) - offset];
+      if ( compact < 0 )
+	return false;
+      out[i] = static_cast<TOut>( compact );
+      }
     return true;
     }
 
-  return false;
+  TIn last = 0;
+  TOut lastCompact = 0;
+  bool haveLast = false;
+  for( size_t i = 0; i < count; ++i )
+    {
+    const TIn label = in[i];
+    if ( ! haveLast || label != last )
+      {
+      std::vector<int>::const_iterator found =
+	std::lower_bound( values.begin(), values.end(), static_cast<long long>( label ) );
+      if ( found == values.end() || *found != static_cast<long long>( label ) )
+	return false;
+      last = label;
+      lastCompact = static_cast<TOut>( found - values.begin() );
+      haveLast = true;
+      }
+    out[i] = lastCompact;
+    }
+  return true;
 }
 
-void MINCImageIO::WriteImageInformation()
+template <class TIn>
+bool CompactLabels( const TIn* in, itk::ImageIOBase::IOComponentType outType, void* out,
+		    size_t count, const std::vector<int>& values )
 {
+  if ( outType == itk::ImageIOBase::UCHAR )
+    return CompactLabels( in, static_cast<unsigned char*>( out ), count, values );
+  return CompactLabels( in, static_cast<unsigned short*>( out ), count, values );
 }
 
-void MINCImageIO::Write( const void* buffer )
+/**
+ * Compact count labels of an integer MINC type into UCHAR or USHORT
+ * components.
+ */
+bool CompactLabels( const mitype_t& mincType, const void* in,
+		    itk::ImageIOBase::IOComponentType outType, void* out,
+		    size_t count, const std::vector<int>& values )
 {
+  switch( mincType )
+    {
+    case MI_TYPE_BYTE:
+      return CompactLabels( static_cast<const signed char*>( in ), outType, out, count, values );
+    case MI_TYPE_UBYTE:
+      return CompactLabels( static_cast<const unsigned char*>( in ), outType, out, count, values );
+    case MI_TYPE_SHORT:
+      return CompactLabels( static_cast<const short*>( in ), outType, out, count, values );
+    case MI_TYPE_USHORT:
+      return CompactLabels( static_cast<const unsigned short*>( in ), outType, out, count, values );
+    case MI_TYPE_INT:
+      return CompactLabels( static_cast<const int*>( in ), outType, out, count, values );
+    case MI_TYPE_UINT:
+      return CompactLabels( static_cast<const unsigned int*>( in ), outType, out, count, values );
+    default:
+      return false;
+    }
 }
 
-void MINCImageIO::ReadPixelInformation()
+/**
+ * Keep every factors[d]-th voxel along each dimension d of a
+ * row-major array of voxels, sizes[d] along dimension d, in place.
+ * The sizes become those of the voxels kept.
+ */
+void SampleVoxels( char* voxels, std::vector<unsigned long>& sizes,
+		   const std::vector<unsigned int>& factors, size_t voxelBytes )
 {
-  // Pixel & Component information computed from data type and data
-  // class
-
-  miclass_t dataClass;
-
-  if ( miget_data_class( m_Volume, &dataClass ) == MI_ERROR )
-    itkExceptionMacro(<< "cannot get data class");
-
-  switch( dataClass )
+  for( int d = static_cast<int>( sizes.size() ) - 1; d >= 0; --d )
     {
-    case MI_CLASS_REAL:
-    case MI_CLASS_INT:
-    case MI_CLASS_LABEL:
-      this->SetPixelType( itk::ImageIOBase::SCALAR );
-      this->SetNumberOfComponents( 1 );
-      break;
-    case MI_CLASS_COMPLEX:
-      this->SetPixelType( itk::ImageIOBase::COMPLEX );
-      this->SetNumberOfComponents( 2 );
-      break;
-    default:
-      itkExceptionMacro(<< "unhandled data class: " << dataClass);
+    if ( factors[d] <= 1 )
+      continue;
+
+    size_t outer = 1;
+    for( int e = 0; e < d; ++e )
+      outer *= sizes[e];
+    size_t inner = voxelBytes;
+    for( size_t e = d + 1; e < sizes.size(); ++e )
+      inner *= sizes[e];
+
+    const unsigned long sampled = ( sizes[d] + factors[d] - 1 ) / factors[d];
+    char* out = voxels;
+    for( size_t o = 0; o < outer; ++o )
+      {
+      const char* in = voxels + o * sizes[d] * inner;
+      for( unsigned long i = 0; i < sampled; ++i, out += inner )
+	std::memmove( out, in + i * factors[d] * inner, inner );
+      }
+    sizes[d] = sampled;
     }
-
-  mitype_t dataType = MI_TYPE_UNKNOWN;
-
-  if ( miget_data_type( m_Volume, &dataType ) == MI_ERROR )
-    itkExceptionMacro(<< "cannot get data type");
-
-  IOComponentType compType = ConvertDataTypeToITK( dataType );
-  if ( compType == UNKNOWNCOMPONENTTYPE )
-    itkExceptionMacro(<< "unhandled MINC data type: " << dataType );
-
-  this->SetComponentType( compType );
 }
 
-void MINCImageIO::ReadShapeInformation()
+/**
+ * Sum each block of factors[d] values along each dimension d of a
+ * row-major array, sizes[d] along dimension d and numComponents
+ * values per voxel, in place, dropping incomplete blocks.  The sizes
+ * become those of the sums.  Returns the number of values summed
+ * into each.
+ */
+size_t SumBlocks( double* values, std::vector<unsigned long>& sizes,
+		  const std::vector<unsigned int>& factors, size_t numComponents )
 {
-  int numDimensions;
-
-  if ( miget_volume_dimension_count( m_Volume, 
-				     MI_DIMCLASS_ANY, 
-				     MI_DIMATTR_REGULARLY_SAMPLED,
-				     &numDimensions ) == MI_ERROR )
+  size_t blockSize = 1;
+  for( int d = static_cast<int>( sizes.size() ) - 1; d >= 0; --d )
     {
-    itkExceptionMacro(<< "cannot get number of dimensions");
+    const unsigned int factor = factors[d];
+    if ( factor <= 1 )
+      continue;
+
+    size_t outer = 1;
+    for( int e = 0; e < d; ++e )
+      outer *= sizes[e];
+    size_t inner = numComponents;
+    for( size_t e = d + 1; e < sizes.size(); ++e )
+      inner *= sizes[e];
+
+    // Rows of inner values are added whole, a loop the compiler
+    // vectorizes.  Sums are written no later than the rows they are
+    // taken from.
+    const unsigned long sampled = sizes[d] / factor;
+    double* out = values;
+    for( size_t o = 0; o < outer; ++o )
+      {
+      const double* in = values + o * sizes[d] * inner;
+      for( unsigned long i = 0; i < sampled; ++i, out += inner )
+	{
+	const double* block = in + i * factor * inner;
+	for( size_t k = 0; k < inner; ++k )
+	  out[k] = block[k];
+	for( unsigned int j = 1; j < factor; ++j )
+	  {
+	  const double* row = block + j * inner;
+	  for( size_t k = 0; k < inner; ++k )
+	    out[k] += row[k];
+	  }
+	}
+      }
+    sizes[d] = sampled;
+    blockSize *= factor;
     }
+  return blockSize;
+}
 
-  this->SetNumberOfDimensions( numDimensions );
+typedef enum { UnknownFormat = 0, HDF5Format, NetCDFFormat } FileFormatType;
+
+// Format of a file from its signature.  An HDF5 superblock may follow
+// a user block of 512 bytes or a larger power of two; the offsets
+// checked here all fall within a single read.
+FileFormatType SniffFileFormat( const char* filename )
+{
+  FILE* file = fopen( filename, "rb" );
+  if ( ! file )
+    return UnknownFormat;
 
-  delete[] m_VolumeDimension;
-  m_VolumeDimension = new midimhandle_t[numDimensions];
+  char header[2048 + 8];
+  const size_t length = fread( header, 1, sizeof( header ), file );
+  fclose( file );
 
-  if ( miget_volume_dimensions( m_Volume,
-				MI_DIMCLASS_ANY,
-				MI_DIMATTR_REGULARLY_SAMPLED,
-				MI_DIMORDER_FILE,
-				numDimensions,
-				m_VolumeDimension ) == MI_ERROR )
+  if ( length >= 4 && memcmp( header, "CDF", 3 ) == 0 
+       && ( header[3] == 1 || header[3] == 2 ) )
     {
-    itkExceptionMacro(<< "cannot get dimension meta-data");
+    return NetCDFFormat;
     }
 
-  for( int dim = 0; dim < numDimensions; ++dim )
+  static const char hdf5Signature[8] = { '\211', 'H', 'D', 'F', '\r', '\n', '\032', '\n' };
+  for( size_t offset = 0; offset + 8 <= length; offset = offset ? 2 * offset : 512 )
     {
-    unsigned int dimSize;
-    if ( miget_dimension_size( m_VolumeDimension[dim], &dimSize ) == MI_ERROR )
-      {
-      itkExceptionMacro(<< "cannot get size of dimension " << dim);
-      }
-    this->SetDimensions( dim, dimSize );
+    if ( memcmp( header + offset, hdf5Signature, 8 ) == 0 )
+      return HDF5Format;
     }
+
+  return UnknownFormat;
 }
 
-void MINCImageIO::ReadImageToWorldInformation()
+bool HasMINCExtension( const std::string& filename )
 {
-  for( unsigned int dim = 0; dim < this->GetNumberOfDimensions(); ++dim )
-    {
-    double spacing;
-
-    if ( miget_dimension_separation( m_VolumeDimension[dim], MI_ORDER_FILE, &spacing ) == MI_ERROR )
-      {
-      itkExceptionMacro(<< "cannot get spacing of dimension " << dim);
-      }
+  const std::string::size_type dot = filename.rfind( '.' );
+  if ( dot == std::string::npos )
+    return false;
 
-    // MINC allows negative spacing.  We convert to positive spacing
-    // and flip the axis direction.
-    bool flipAxis = spacing < 0;
-    if ( flipAxis ) 
-      spacing *= -1;
-    this->SetSpacing( dim, spacing );
+  const std::string extension = filename.substr( dot );
+  return extension == ".mnc" || extension == ".MNC" 
+    || extension == ".mnc2" || extension == ".MNC2";
+}
 
-    double origin;
-    if ( miget_dimension_start( m_VolumeDimension[dim], MI_ORDER_FILE, &origin ) == MI_ERROR )
-      {
-      itkExceptionMacro(<< "cannot get origin of dimension " << dim);
-      }
+// CanReadFile() answers, keyed by file name.
+struct CanReadFileEntry
+{
+  MINCFileStamp stamp;
+  bool canRead;
+};
 
-    this->SetOrigin( dim, origin );
+typedef std::map<std::string, CanReadFileEntry> CanReadFileCacheType;
 
-    double cosines[3];
-    if ( miget_dimension_cosines( m_VolumeDimension[dim], cosines ) == MI_ERROR )
-      {
-      itkExceptionMacro(<< "cannot get direction cosines of dimension " << dim);
-      }
+// Entries beyond which the cache is emptied rather than grown.
+const size_t MaximumCanReadFileCacheSize = 16384;
 
-    if ( flipAxis )
-      {
-      cosines[0] *= -1;
-      cosines[1] *= -1;
-      cosines[2] *= -1;
-      }
+CanReadFileCacheType CanReadFileCache;
+SimpleFastMutexLock CanReadFileCacheLock;
 
-    // MINC uses RAS convention for world-space, so X- and
-    // Y-coordinates must be flipped to produce the LPS-convention
-    // direction
-    cosines[0] *= -1;
-    cosines[1] *= -1;
-    this->SetDirectionFromCosines( dim, cosines );
-    }
-}
+// Read statistics of all instances together
+MINCReadStatistics GlobalReadStatistics;
+SimpleFastMutexLock GlobalReadStatisticsLock;
 
-void MINCImageIO::SetDirectionFromCosines( unsigned int dim, double cosines[3] )
+// Adds the time from its construction to its destruction to a
+// counter, if given one; otherwise does nothing, not even read the
+// clock.
+class ScopedTimer
+{
+public:
+  ScopedTimer( const RealTimeClock* clock, double* total )
+    : m_Clock( clock ), m_Total( total ), m_Start( total ? clock->GetTimeStamp() : 0.0 )
+  {
+  }
+
+  ~ScopedTimer()
+  {
+    if ( m_Total )
+      *m_Total += m_Clock->GetTimeStamp() - m_Start;
+  }
+
+private:
+  const RealTimeClock* m_Clock;
+  double* m_Total;
+  double m_Start;
+};
+
+// Sets the component type of an ImageIO for as long as it lives.
+class ScopedComponentType
 {
-  std::vector<double> direction;
-  direction.resize( this->GetNumberOfDimensions() );
+public:
+  ScopedComponentType( ImageIOBase* io, ImageIOBase::IOComponentType componentType )
+    : m_IO( io ), m_Saved( io->GetComponentType() )
+  {
+    m_IO->SetComponentType( componentType );
+  }
+
+  ~ScopedComponentType()
+  {
+    m_IO->SetComponentType( m_Saved );
+  }
+
+private:
+  ImageIOBase* m_IO;
+  ImageIOBase::IOComponentType m_Saved;
+};
 
-  for( unsigned int i = 0; i < this->GetNumberOfDimensions(); ++i )
-    {
-    if ( i < 3 )
-      direction[i] = cosines[i];
-    else
-      direction[i] = (dim == i ? 1 : 0);
-    }
+} // end of unnamed namespace
 
-  this->SetDirection( dim, direction );
-}
 
-void MINCImageIO::CloseVolume()
+MINCImageIO::MINCImageIO()
+  : m_VolumeID( 0 ),
+    m_VolumeValid( false ),
+    m_NetCDFFile( new MINCNetCDFFile ),
+    m_VectorComponents( false ),
+    m_TimeFileDimension( -1 ),
+    m_ResolutionLevel( 0 ),
+    m_NumberOfResolutionLevels( 0 ),
+    m_StoredCompressionLevel( 0 ),
+    m_SamplingMode( SamplingNearest ),
+    m_StoredDataType( MI_TYPE_UNKNOWN ),
+    m_StoredDataClass( MI_CLASS_REAL ),
+    m_Dataset( new MINCImageDataset ),
+    m_ReadAhead( new MINCReadAhead ),
+    m_UseParallelDecompression( true ),
+    m_UseParallelReading( true ),
+    m_UseReadAhead( false ),
+    m_UseMemoryMapping( true ),
+    m_UseHeaderCache( false ),
+    m_UseRawVoxels( false ),
+    m_UseCanonicalOrder( false ),
+    m_UseCompactLabels( false ),
+    m_RequestedComponentType( UNKNOWNCOMPONENTTYPE ),
+    m_CollectReadStatistics( false ),
+    m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() ),
+    m_ChunkCacheMode( ChunkCacheDefault ),
+    m_ChunkCacheSize( 1 << 20 ),
+    m_ChunkCacheSlots( 521 ),
+    m_ChunkCachePolicy( 0.75 ),
+    m_Clock( RealTimeClock::New() ),
+    m_CompressionLevel( 4 ),
+    m_FileComponentType( UNKNOWNCOMPONENTTYPE ),
+    m_NumberOfPyramidLevels( 0 ),
+    m_WriteLabels( false ),
+    m_LabelDownsampling( LabelMode ),
+    m_PyramidBuilder( new MINCPyramidBuilder ),
+    m_WriteSlabThickness( 0 ),
+    m_WriteScaling( false ),
+    m_WriteSliceScaling( false ),
+    m_WritingVolume( false ),
+    m_NumberOfPixelsWritten( 0 )
 {
-  if ( ! m_VolumeValid )
-    return;
+  this->AddSupportedReadExtension( ".mnc" );
+  this->AddSupportedReadExtension( ".mnc2" );
 
-  m_VolumeValid = false;
-  miclose_volume( m_Volume );
-  delete[] m_VolumeDimension;
-  m_VolumeDimension = 0;
+  this->AddSupportedWriteExtension( ".mnc" );
+  this->AddSupportedWriteExtension( ".mnc2" );
+}
+
+MINCImageIO::~MINCImageIO()
+{
+  this->CloseVolume();
+  delete m_PyramidBuilder;
+  delete m_ReadAhead;
+  delete m_Dataset;
+  delete m_NetCDFFile;
+}
+
+void MINCImageIO::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+  os << indent << "Volume: ";
+
+  if ( m_VolumeValid )
+    os << m_Volume;
+  else if ( m_NetCDFFile->IsOpen() )
+    os << "(MINC1)";
+  else
+    os << "(none)";
+  os << "\n";
+
+  os << indent << "UseParallelDecompression: " << m_UseParallelDecompression << "\n";
+  os << indent << "UseParallelReading: " << m_UseParallelReading << "\n";
+  os << indent << "UseReadAhead: " << m_UseReadAhead << "\n";
+  os << indent << "UseMemoryMapping: " << m_UseMemoryMapping << "\n";
+  os << indent << "UseHeaderCache: " << m_UseHeaderCache << "\n";
+  os << indent << "UseRawVoxels: " << m_UseRawVoxels << "\n";
+  os << indent << "UseCanonicalOrder: " << m_UseCanonicalOrder << "\n";
+  os << indent << "UseCompactLabels: " << m_UseCompactLabels << "\n";
+  os << indent << "RequestedComponentType: " 
+     << this->GetComponentTypeAsString( m_RequestedComponentType ) << "\n";
+  os << indent << "CollectReadStatistics: " << m_CollectReadStatistics << "\n";
+  if ( m_CollectReadStatistics )
+    m_ReadStatistics.Print( os, indent.GetNextIndent() );
+  os << indent << "ResolutionLevel: " << m_ResolutionLevel << "\n";
+  os << indent << "SamplingFactor:";
+  for( unsigned int i = 0; i < m_SamplingFactor.size(); ++i )
+    os << " " << m_SamplingFactor[i];
+  os << "\n";
+  os << indent << "SamplingMode: " 
+     << ( m_SamplingMode == SamplingAverage ? "SamplingAverage" : "SamplingNearest" ) << "\n";
+  os << indent << "NumberOfThreads: " << m_NumberOfThreads << "\n";
+  os << indent << "ChunkCacheMode: " 
+     << ( m_ChunkCacheMode == ChunkCacheManual ? "ChunkCacheManual" 
+	  : m_ChunkCacheMode == ChunkCacheAuto ? "ChunkCacheAuto" : "ChunkCacheDefault" ) << "\n";
+  os << indent << "ChunkCacheSize: " << m_ChunkCacheSize << "\n";
+  os << indent << "ChunkCacheSlots: " << m_ChunkCacheSlots << "\n";
+  os << indent << "ChunkCachePolicy: " << m_ChunkCachePolicy << "\n";
+  os << indent << "CompressionLevel: " << m_CompressionLevel << "\n";
+  os << indent << "FileComponentType: " 
+     << this->GetComponentTypeAsString( m_FileComponentType ) << "\n";
+  os << indent << "NumberOfPyramidLevels: " << m_NumberOfPyramidLevels << "\n";
+  os << indent << "WriteLabels: " << m_WriteLabels << "\n";
+  os << indent << "LabelDownsampling: " 
+     << ( m_LabelDownsampling == LabelMode ? "LabelMode" : "LabelNearest" ) << "\n";
+}
+
+bool MINCImageIO::CanReadFile( const char* filename )
+{
+  if ( ! filename || ! *filename )
+    return false;
+
+  MINCFileStamp stamp;
+  if ( ! stamp.Read( filename ) )
+    return false;
+
+  const std::string name( filename );
+  {
+  MutexLockHolder<SimpleFastMutexLock> holder( CanReadFileCacheLock );
+  CanReadFileCacheType::const_iterator cached = CanReadFileCache.find( name );
+  if ( cached != CanReadFileCache.end() && cached->second.stamp == stamp )
+    return cached->second.canRead;
+  }
+
+  bool canRead = false;
+  switch( SniffFileFormat( filename ) )
+    {
+    case HDF5Format:
+      canRead = HasMINCExtension( name ) || MINCImageDataset::HasImage( filename );
+      break;
+    case NetCDFFormat:
+      {
+      // MINC1 files are read without libminc, which would convert
+      // them first
+      MINCNetCDFFile file;
+      canRead = file.Open( filename ) && file.FindVariable( "image" ) >= 0;
+      }
+      break;
+    default:
+      break;
+    }
+
+  CanReadFileEntry entry;
+  entry.stamp = stamp;
+  entry.canRead = canRead;
+
+  MutexLockHolder<SimpleFastMutexLock> holder( CanReadFileCacheLock );
+  if ( CanReadFileCache.size() >= MaximumCanReadFileCacheSize )
+    CanReadFileCache.clear();
+  CanReadFileCache[name] = entry;
+
+  return canRead;
+}
+
+void MINCImageIO::ClearCanReadFileCache()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( CanReadFileCacheLock );
+  CanReadFileCache.clear();
+}
+
+MINCReadStatistics MINCImageIO::GetGlobalReadStatistics()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( GlobalReadStatisticsLock );
+  return GlobalReadStatistics;
+}
+
+void MINCImageIO::ResetGlobalReadStatistics()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( GlobalReadStatisticsLock );
+  GlobalReadStatistics.Reset();
+}
+
+void MINCImageIO::CommitStatistics()
+{
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+  if ( ! statistics )
+    return;
+
+  m_ReadStatistics.Add( *statistics );
+  {
+  MutexLockHolder<SimpleFastMutexLock> holder( GlobalReadStatisticsLock );
+  GlobalReadStatistics.Add( *statistics );
+  }
+
+  this->InvokeEvent( MINCReadStatisticsEvent() );
+}
+
+void MINCImageIO::CountBytesRead( const unsigned long sizes[] )
+{
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+  if ( ! statistics )
+    return;
+
+  // Vector components are a dimension of the hyperslab; those of
+  // complex voxels are not.
+  size_t numBytes = ComponentSizeOfMINCType( m_StoredDataType );
+  if ( ! m_VectorComponents )
+    numBytes *= this->GetNumberOfComponents();
+  for( unsigned int d = 0; d < this->GetNumberOfFileDimensions(); ++d )
+    numBytes *= sizes[d];
+  statistics->bytesRead += numBytes;
+}
+
+void MINCImageIO::ReadImageInformation()
+{
+  this->CloseVolume();
+
+  m_CurrentStatistics.Reset();
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+
+  const char* filename = this->GetFileName();
+
+  // A cached header spares opening the file until Read()
+  std::string cacheKey;
+  if ( m_UseHeaderCache )
+    {
+    cacheKey = this->GetHeaderCacheKey();
+
+    bool restored;
+    {
+    ScopedTimer timer( m_Clock, statistics ? &statistics->metadataTime : 0 );
+    std::string record;
+    restored = MINCHeaderCache::Load( filename, cacheKey, record ) && this->RestoreHeader( record );
+    }
+
+    if ( restored )
+      {
+      this->CommitStatistics();
+      return;
+      }
+    }
+
+  this->OpenVolume();
+  m_NumberOfResolutionLevels = m_Dataset->IsOpen() ? m_Dataset->GetNumberOfResolutionLevels() : 1;
+
+  {
+  ScopedTimer timer( m_Clock, statistics ? &statistics->metadataTime : 0 );
+
+  MINCVolumeCache::LockHolder volumeLock( m_VolumeID );
+  if ( m_VolumeValid && ! volumeLock.IsLocked() )
+    {
+    itkExceptionMacro(<< filename << " was rewritten while being read");
+    }
+
+  this->ReadPixelInformation();
+  this->ReadLabelInformation();
+  this->ReadShapeInformation();
+  this->ReadImageToWorldInformation();
+  this->ApplyResolutionLevel();
+  this->ReadTimeInformation();
+  this->ReadChunkInformation();
+  this->ReadScalingInformation();
+  this->EncapsulateScalingInformation();
+  this->ApplyCanonicalOrder();
+  this->ApplySampling();
+  this->ComputeStrides();
+  }
+
+  // A cache that cannot be written is no reason to fail
+  if ( m_UseHeaderCache )
+    MINCHeaderCache::Store( filename, cacheKey, this->SaveHeader() );
+
+  this->CommitStatistics();
+}
+
+void MINCImageIO::OpenVolume()
+{
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+  const char* filename = this->GetFileName();
+
+  {
+  ScopedTimer timer( m_Clock, statistics ? &statistics->openTime : 0 );
+
+  // MINC1 files are read as they are: libminc would first convert
+  // them to a temporary MINC2 file
+  if ( SniffFileFormat( filename ) == NetCDFFormat )
+    {
+    if ( ! m_NetCDFFile->Open( filename ) || ! this->ReadNetCDFDimensions() )
+      {
+      m_NetCDFFile->Close();
+      itkExceptionMacro(<< "cannot read file " << filename );
+      }
+    }
+  else
+    {
+    std::vector<midimhandle_t> dimensions;
+    if ( ! MINCVolumeCache::Acquire( filename, &m_VolumeID, &m_Volume, &dimensions ) )
+      {
+      itkExceptionMacro(<< "cannot read file " << filename );
+      }
+
+    m_VolumeValid = true;
+
+    MINCVolumeCache::LockHolder volumeLock( m_VolumeID );
+    if ( ! volumeLock.IsLocked() )
+      {
+      itkExceptionMacro(<< filename << " was rewritten while being read");
+      }
+    this->ReadVolumeDimensions( dimensions );
+
+    // Not every MINC file is an HDF5 file; if this fails, all reads go
+    // through libminc.
+    m_Dataset->SetUseMemoryMapping( m_UseMemoryMapping );
+    m_Dataset->Open( filename, m_ResolutionLevel );
+    }
+  }
+
+  if ( statistics )
+    ++statistics->numberOfOpens;
+
+  // Lower resolution levels are read through the dataset only: libminc
+  // does not know about levels it did not create itself.
+  if ( m_ResolutionLevel > 0 && ! m_Dataset->IsOpen() )
+    {
+    itkExceptionMacro(<< "resolution level " << m_ResolutionLevel 
+		      << " is not available in " << filename );
+    }
+}
+
+void MINCImageIO::ReadVolumeDimensions( const std::vector<midimhandle_t>& dimensions )
+{
+  m_FileDimensions.resize( dimensions.size() );
+  for( unsigned int dim = 0; dim < dimensions.size(); ++dim )
+    {
+    FileDimension& dimension = m_FileDimensions[dim];
+
+    char* name = 0;
+    if ( miget_dimension_name( dimensions[dim], &name ) != MI_ERROR && name )
+      {
+      dimension.name = name;
+      mifree_name( name );
+      }
+
+    unsigned int size;
+    if ( miget_dimension_size( dimensions[dim], &size ) == MI_ERROR )
+      {
+      itkExceptionMacro(<< "cannot get size of dimension " << dim);
+      }
+    dimension.size = size;
+
+    // Dimensions of unknown class are taken for spatial ones
+    if ( miget_dimension_class( dimensions[dim], &dimension.dimClass ) == MI_ERROR )
+      dimension.dimClass = MI_DIMCLASS_SPATIAL;
+
+    dimension.hasSampling = GetDimensionSampling( dimensions[dim], dimension.start, dimension.step );
+    dimension.hasCosines = miget_dimension_cosines( dimensions[dim], dimension.cosines ) != MI_ERROR;
+
+    dimension.hasSamples = ( dimension.dimClass == MI_DIMCLASS_TIME
+			     || dimension.dimClass == MI_DIMCLASS_TFREQUENCY )
+      && GetDimensionSamples( dimensions[dim], dimension.offsets, dimension.widths );
+    }
+}
+
+bool MINCImageIO::ReadNetCDFDimensions()
+{
+  const int image = m_NetCDFFile->FindVariable( "image" );
+  if ( image < 0 )
+    return false;
+
+  const std::vector<unsigned int>& dimensions = m_NetCDFFile->GetVariableDimensions( image );
+  m_FileDimensions.resize( dimensions.size() );
+
+  for( unsigned int dim = 0; dim < dimensions.size(); ++dim )
+    {
+    FileDimension& dimension = m_FileDimensions[dim];
+    dimension.name = m_NetCDFFile->GetDimensionName( dimensions[dim] );
+    dimension.size = m_NetCDFFile->GetDimensionSize( dimensions[dim] );
+    dimension.dimClass = GetDimensionClass( dimension.name );
+    if ( dimension.size == 0 )
+      return false;
+
+    // The variable named after a dimension describes it, as libminc
+    // reads it: samples a unit apart from 0 along their own axis by
+    // default, or at the values of the variable if it says they are
+    // irregular, each as wide as the values of its "-width" variable.
+    const int variable = m_NetCDFFile->FindVariable( dimension.name );
+
+    std::vector<double> values;
+    double start = 0.0, step = 1.0;
+    if ( m_NetCDFFile->GetAttribute( variable, "start", values ) && ! values.empty() )
+      start = values[0];
+    if ( m_NetCDFFile->GetAttribute( variable, "step", values ) && ! values.empty() )
+      step = values[0];
+
+    dimension.cosines[0] = dimension.cosines[1] = dimension.cosines[2] = 0.0;
+    if ( m_NetCDFFile->GetAttribute( variable, "direction_cosines", values ) && values.size() == 3 )
+      std::copy( values.begin(), values.end(), dimension.cosines );
+    else if ( dimension.name == "yspace" || dimension.name == "yfrequency" )
+      dimension.cosines[1] = 1.0;
+    else if ( dimension.name == "zspace" || dimension.name == "zfrequency" )
+      dimension.cosines[2] = 1.0;
+    else
+      dimension.cosines[0] = 1.0;
+    dimension.hasCosines = true;
+
+    std::string spacing;
+    std::vector<double>& offsets = dimension.offsets;
+    std::vector<double>& widths = dimension.widths;
+    const bool irregular = m_NetCDFFile->GetAttribute( variable, "spacing", spacing )
+      && spacing == "irregular"
+      && m_NetCDFFile->ReadValues( variable, offsets )
+      && offsets.size() == dimension.size;
+
+    if ( irregular )
+      {
+      step = 1.0;
+      if ( offsets.size() > 1 )
+	step = ( offsets.back() - offsets.front() ) / ( offsets.size() - 1 );
+      }
+    else
+      {
+      offsets.resize( dimension.size );
+      for( unsigned long i = 0; i < dimension.size; ++i )
+	offsets[i] = start + i * step;
+      }
+
+    if ( ! m_NetCDFFile->ReadValues( m_NetCDFFile->FindVariable( dimension.name + "-width" ), widths )
+	 || widths.size() != dimension.size )
+      {
+      widths.assign( dimension.size, std::fabs( step ) );
+      }
+
+    dimension.hasSampling = true;
+    dimension.start = start;
+    dimension.step = step;
+    if ( irregular )
+      ComputeIrregularSampling( offsets, widths, dimension.start, dimension.step );
+
+    // Only the samples of time are needed
+    dimension.hasSamples = dimension.dimClass == MI_DIMCLASS_TIME
+      || dimension.dimClass == MI_DIMCLASS_TFREQUENCY;
+    if ( ! dimension.hasSamples )
+      {
+      offsets.clear();
+      widths.clear();
+      }
+    }
+
+  return true;
+}
+
+bool MINCImageIO::ReadNetCDFScaling( double& validMin, double& validMax,
+				     std::vector<double>& imageMin,
+				     std::vector<double>& imageMax ) const
+{
+  const int image = m_NetCDFFile->FindVariable( "image" );
+
+  // The valid range defaults to the range of the type
+  std::vector<double> values;
+  if ( ! GetMINCTypeRange( m_StoredDataType, validMin, validMax ) )
+    return false;
+  if ( m_NetCDFFile->GetAttribute( image, "valid_range", values ) && values.size() == 2 )
+    {
+    validMin = std::min( values[0], values[1] );
+    validMax = std::max( values[0], values[1] );
+    }
+  else
+    {
+    if ( m_NetCDFFile->GetAttribute( image, "valid_min", values ) && ! values.empty() )
+      validMin = values[0];
+    if ( m_NetCDFFile->GetAttribute( image, "valid_max", values ) && ! values.empty() )
+      validMax = values[0];
+    }
+
+  // Without image-min and image-max, the image spans [0, 1], as
+  // libminc has it
+  const int minVariable = m_NetCDFFile->FindVariable( "image-min" );
+  const int maxVariable = m_NetCDFFile->FindVariable( "image-max" );
+  if ( minVariable < 0 || maxVariable < 0 )
+    {
+    imageMin.assign( 1, 0.0 );
+    imageMax.assign( 1, 1.0 );
+    return true;
+    }
+
+  std::vector<double> minValues, maxValues;
+  const std::vector<unsigned int>& rangeDimensions = m_NetCDFFile->GetVariableDimensions( maxVariable );
+  if ( m_NetCDFFile->GetVariableDimensions( minVariable ) != rangeDimensions
+       || ! m_NetCDFFile->ReadValues( minVariable, minValues )
+       || ! m_NetCDFFile->ReadValues( maxVariable, maxValues )
+       || minValues.empty() || minValues.size() != maxValues.size() )
+    {
+    return false;
+    }
+
+  if ( rangeDimensions.empty() )
+    {
+    imageMin.assign( 1, minValues[0] );
+    imageMax.assign( 1, maxValues[0] );
+    return true;
+    }
+
+  // The ranges vary along some of the slice dimensions, those of the
+  // image but the two fastest-varying, and are the same along the
+  // others
+  const std::vector<unsigned int>& imageDimensions = m_NetCDFFile->GetVariableDimensions( image );
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  const unsigned int sliceDimensions = numDimensions > 2 ? numDimensions - 2 : 0;
+
+  std::vector<unsigned int> sliceDimension( rangeDimensions.size() );
+  for( size_t r = 0; r < rangeDimensions.size(); ++r )
+    {
+    const std::vector<unsigned int>::const_iterator found =
+      std::find( imageDimensions.begin(), imageDimensions.begin() + sliceDimensions, rangeDimensions[r] );
+    if ( found == imageDimensions.begin() + sliceDimensions )
+      return false;
+    sliceDimension[r] = found - imageDimensions.begin();
+    }
+
+  size_t numSlices = 1;
+  for( unsigned int d = 0; d < sliceDimensions; ++d )
+    numSlices *= this->GetDimensions( d );
+
+  imageMin.resize( numSlices );
+  imageMax.resize( numSlices );
+
+  std::vector<unsigned long> position( sliceDimensions, 0 );
+  for( size_t s = 0; s < numSlices; ++s )
+    {
+    size_t slice = s;
+    for( int d = static_cast<int>( sliceDimensions ) - 1; d >= 0; --d )
+      {
+      position[d] = slice % this->GetDimensions( d );
+      slice /= this->GetDimensions( d );
+      }
+
+    size_t range = 0;
+    for( size_t r = 0; r < rangeDimensions.size(); ++r )
+      range = range * this->GetDimensions( sliceDimension[r] ) + position[sliceDimension[r]];
+    if ( range >= minValues.size() )
+      return false;
+
+    imageMin[s] = minValues[range];
+    imageMax[s] = maxValues[range];
+    }
+
+  return true;
+}
+
+ImageIORegion 
+MINCImageIO::GenerateStreamableReadRegionFromRequestedRegion( const ImageIORegion& requested ) const
+{
+  ImageIORegion streamable( requested.GetImageDimension() );
+
+  for( unsigned int d = 0; d < requested.GetImageDimension(); ++d )
+    {
+    if ( d >= this->GetNumberOfDimensions() )
+      {
+      streamable.SetIndex( d, requested.GetIndex(d) );
+      streamable.SetSize( d, requested.GetSize(d) );
+      continue;
+      }
+
+    const unsigned long dimSize = this->GetDimensions( d );
+
+    if ( ! this->GetUseStreamedReading() )
+      {
+      streamable.SetIndex( d, 0 );
+      streamable.SetSize( d, dimSize );
+      continue;
+      }
+
+    // The chunk cache keeps what frames share
+    if ( m_ChunkCacheMode == ChunkCacheAuto 
+	 && static_cast<int>( d ) == this->GetTimeDimension() )
+      {
+      streamable.SetIndex( d, requested.GetIndex(d) );
+      streamable.SetSize( d, requested.GetSize(d) );
+      continue;
+      }
+
+    // Round the start down and the end up to a chunk boundary, but
+    // never past the end of the image.
+    const unsigned long chunk = this->GetChunkSize( d );
+    unsigned long start = requested.GetIndex(d);
+    unsigned long end = start + requested.GetSize(d);
+
+    start = (start / chunk) * chunk;
+    end = ((end + chunk - 1) / chunk) * chunk;
+    if ( end > dimSize )
+      end = dimSize;
+
+    streamable.SetIndex( d, start );
+    streamable.SetSize( d, end - start );
+    }
+
+  return streamable;
+}
+
+unsigned int MINCImageIO::GetChunkSize( unsigned int i ) const
+{
+  if ( i >= m_ChunkSize.size() )
+    return 1;
+  return m_ChunkSize[i];
+}
+
+void MINCImageIO::SetSamplingFactor( unsigned int i, unsigned int factor )
+{
+  if ( i >= m_SamplingFactor.size() )
+    m_SamplingFactor.resize( i + 1, 1 );
+  m_SamplingFactor[i] = std::max( factor, 1u );
+  this->Modified();
+}
+
+unsigned int MINCImageIO::GetSamplingFactor( unsigned int i ) const
+{
+  if ( i >= m_SamplingFactor.size() )
+    return 1;
+  return m_SamplingFactor[i];
+}
+
+bool MINCImageIO::IsSampled() const
+{
+  for( unsigned int d = 0; d < m_FileSamplingFactor.size(); ++d )
+    {
+    if ( m_FileSamplingFactor[d] > 1 )
+      return true;
+    }
+  return false;
+}
+
+unsigned int MINCImageIO::GetFileDimension( unsigned int i ) const
+{
+  if ( i >= m_FileAxis.size() )
+    return i;
+  return m_FileAxis[i];
+}
+
+int MINCImageIO::GetTimeDimension() const
+{
+  for( unsigned int i = 0; i < m_FileAxis.size(); ++i )
+    {
+    if ( static_cast<int>( m_FileAxis[i] ) == m_TimeFileDimension )
+      return i;
+    }
+  return -1;
+}
+
+unsigned long MINCImageIO::GetNumberOfFrames() const
+{
+  const int timeDimension = this->GetTimeDimension();
+  return timeDimension < 0 ? 1 : this->GetDimensions( timeDimension );
+}
+
+void MINCImageIO::ReadFrame( unsigned long frame, void* buffer )
+{
+  if ( frame >= this->GetNumberOfFrames() )
+    {
+    itkExceptionMacro(<< "frame " << frame << " is beyond the " << this->GetNumberOfFrames()
+		      << " frames of " << this->GetFileName() );
+    }
+
+  ImageIORegion region( this->GetNumberOfDimensions() );
+  for( unsigned int d = 0; d < this->GetNumberOfDimensions(); ++d )
+    region.SetSize( d, this->GetDimensions( d ) );
+
+  const int timeDimension = this->GetTimeDimension();
+  if ( timeDimension >= 0 )
+    {
+    region.SetIndex( timeDimension, frame );
+    region.SetSize( timeDimension, 1 );
+    }
+
+  this->SetIORegion( region );
+  this->Read( buffer );
+}
+
+void MINCImageIO::Read( void* buffer )
+{
+  m_CurrentStatistics.Reset();
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+  if ( statistics )
+    this->UpdateProgress( 0.0f );
+
+  // The header came from the header cache
+  if ( ! m_VolumeValid && ! m_NetCDFFile->IsOpen() )
+    {
+    this->OpenVolume();
+    if ( m_FileDimensions.size() != m_StoredSize.size() + ( m_VectorComponents ? 1 : 0 ) )
+      {
+      this->CloseVolume();
+      itkExceptionMacro(<< this->GetFileName() << " has changed since ReadImageInformation()");
+      }
+    }
+
+  this->ReadRegion( buffer );
+
+  if ( ! statistics )
+    return;
+
+  statistics->numberOfReads = 1;
+  statistics->bytesRequested = this->GetIORegion().GetNumberOfPixels()
+    * this->GetNumberOfComponents() * this->GetComponentSize();
+  this->CommitStatistics();
+  this->UpdateProgress( 1.0f );
+}
+
+void MINCImageIO::ReadRegion( void* buffer )
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+
+  std::vector<unsigned long> starts( numDimensions );
+  std::vector<unsigned long> sizes( numDimensions );
+  ConvertRegionToMINC( this->GetIORegion(), &starts[0], &sizes[0] );
+
+  bool fileOrder = true;
+  for( unsigned int d = 0; d < m_FileAxis.size(); ++d )
+    fileOrder = fileOrder && m_FileAxis[d] == d;
+
+  if ( fileOrder )
+    {
+    this->ReadSampledHyperslab( &starts[0], &sizes[0], buffer );
+    return;
+    }
+
+  // Read the hyperslab as stored, then reorder it into the buffer
+  std::vector<unsigned long> fileStarts( numDimensions );
+  std::vector<unsigned long> fileSizes( numDimensions );
+  size_t numBytes = this->GetNumberOfComponents() * this->GetComponentSize();
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    fileStarts[m_FileAxis[d]] = starts[d];
+    fileSizes[m_FileAxis[d]] = sizes[d];
+    numBytes *= sizes[d];
+    }
+
+  if ( numBytes == 0 )
+    return;
+  std::vector<char> stored( numBytes );
+  this->ReadSampledHyperslab( &fileStarts[0], &fileSizes[0], &stored[0] );
+
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+  ScopedTimer timer( m_Clock, statistics ? &statistics->conversionTime : 0 );
+  MINCAxisPermuter::Permute( &stored[0], &fileSizes[0], &m_FileAxis[0], numDimensions,
+			     this->GetNumberOfComponents() * this->GetComponentSize(),
+			     buffer, m_NumberOfThreads );
+}
+
+void MINCImageIO::ReadSampledHyperslab( const unsigned long starts[],
+					const unsigned long sizes[],
+					void* buffer )
+{
+  if ( ! this->IsSampled() )
+    {
+    this->ReadHyperslab( starts, sizes, buffer );
+    return;
+    }
+
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  const bool average = m_SamplingMode == SamplingAverage && ! this->IsLabelImage();
+
+  // The stored hyperslab of each plane along dimension 0, and its
+  // size once sampled
+  std::vector<unsigned long> planeStarts( numDimensions );
+  std::vector<unsigned long> planeSizes( numDimensions );
+  size_t planeComponents = this->GetNumberOfComponents();
+  size_t sampledComponents = this->GetNumberOfComponents();
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    if ( sizes[d] == 0 )
+      return;
+
+    const unsigned int factor = m_FileSamplingFactor[d];
+    planeStarts[d] = starts[d] * factor;
+    planeSizes[d] = average ? sizes[d] * factor : ( sizes[d] - 1 ) * factor + 1;
+    if ( d == 0 )
+      planeSizes[d] = average ? factor : 1;
+
+    planeComponents *= planeSizes[d];
+    if ( d > 0 )
+      sampledComponents *= sizes[d];
+    }
+
+  const size_t sampledBytes = sampledComponents * this->GetComponentSize();
+  char* out = static_cast<char*>( buffer );
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+
+  if ( average )
+    {
+    // Real values are summed in double precision, and the sums
+    // converted to the component type
+    std::vector<double> values( planeComponents );
+    for( unsigned long p = 0; p < sizes[0]; ++p, out += sampledBytes )
+      {
+      planeStarts[0] = ( starts[0] + p ) * m_FileSamplingFactor[0];
+      {
+      ScopedComponentType asDouble( this, DOUBLE );
+      this->ReadHyperslab( &planeStarts[0], &planeSizes[0], &values[0] );
+      }
+
+      ScopedTimer timer( m_Clock, statistics ? &statistics->conversionTime : 0 );
+      std::vector<unsigned long> sumSizes( planeSizes );
+      const size_t blockSize = SumBlocks( &values[0], sumSizes, m_FileSamplingFactor,
+					  this->GetNumberOfComponents() );
+      MINCVoxelRescaler::Rescale( DOUBLE, &values[0], this->GetComponentType(), out,
+				  sampledComponents, 1.0 / blockSize, 0.0 );
+      }
+    return;
+    }
+
+  const size_t voxelBytes = this->GetNumberOfComponents() * this->GetComponentSize();
+  std::vector<char> plane( planeComponents * this->GetComponentSize() );
+  for( unsigned long p = 0; p < sizes[0]; ++p, out += sampledBytes )
+    {
+    planeStarts[0] = ( starts[0] + p ) * m_FileSamplingFactor[0];
+    this->ReadHyperslab( &planeStarts[0], &planeSizes[0], &plane[0] );
+
+    ScopedTimer timer( m_Clock, statistics ? &statistics->conversionTime : 0 );
+    std::vector<unsigned long> sampledSizes( planeSizes );
+    SampleVoxels( &plane[0], sampledSizes, m_FileSamplingFactor, voxelBytes );
+    std::memcpy( out, &plane[0], sampledBytes );
+    }
+}
+
+void MINCImageIO::ReadHyperslab( const unsigned long imageStarts[],
+				 const unsigned long imageSizes[],
+				 void* buffer )
+{
+  // The components of vector pixels are read whole, along the vector
+  // dimension
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  std::vector<unsigned long> fileStarts( imageStarts, imageStarts + numDimensions );
+  std::vector<unsigned long> fileSizes( imageSizes, imageSizes + numDimensions );
+  if ( m_VectorComponents )
+    {
+    fileStarts.push_back( 0 );
+    fileSizes.push_back( this->GetNumberOfComponents() );
+    }
+  const unsigned long* starts = &fileStarts[0];
+  const unsigned long* sizes = &fileSizes[0];
+
+  mitype_t bufferDataType;
+
+  if ( this->GetPixelType() == itk::ImageIOBase::COMPLEX )
+    bufferDataType = ConvertComplexDataTypeToMINC( this->GetComponentType() );
+  else
+    bufferDataType = ConvertScalarDataTypeToMINC( this->GetComponentType() );
+
+  // Labels are integers that are never scaled: unless compacted,
+  // they are read as stored, like raw voxels.
+  const bool labels = this->IsLabelImage() && m_CompactLabelValues.empty();
+  if ( ( m_UseRawVoxels && m_CompactLabelValues.empty() ) || labels )
+    {
+    if ( this->ReadRawVoxelsFromDataset( starts, sizes, buffer ) )
+      return;
+
+    // Only a type conversion remains, which RescaleVoxels() does
+    // with the identity rather than the file's scaling
+    if ( m_ResolutionLevel > 0
+	 || ( labels && ConvertDataTypeToITK( m_StoredDataType ) != this->GetComponentType() ) )
+      {
+      if ( ! this->ReadAndRescaleVoxels( starts, sizes, buffer, true ) )
+	{
+	itkExceptionMacro(<< "error reading voxel values");
+	}
+      return;
+      }
+
+    if ( m_NetCDFFile->IsOpen() )
+      {
+      this->ReadRawVoxelsFromNetCDF( starts, sizes, buffer );
+      return;
+      }
+
+    MINCReadStatistics* statistics = this->GetCurrentStatistics();
+    ScopedTimer timer( m_Clock, statistics ? &statistics->readTime : 0 );
+    MINCVolumeCache::LockHolder volumeLock( m_VolumeID );
+    if ( ! volumeLock.IsLocked()
+	 || miget_voxel_value_hyperslab( m_Volume, bufferDataType, starts, sizes, buffer ) == MI_ERROR )
+      {
+      itkExceptionMacro(<< "error reading voxel values");
+      }
+    this->CountBytesRead( sizes );
+    return;
+    }
+
+  if ( this->ReadAndRescaleVoxels( starts, sizes, buffer ) )
+    return;
+
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+  ScopedTimer timer( m_Clock, statistics ? &statistics->readTime : 0 );
+  MINCVolumeCache::LockHolder volumeLock( m_VolumeID );
+  if ( ! volumeLock.IsLocked()
+       || miget_real_value_hyperslab( m_Volume, bufferDataType, starts, sizes, buffer ) == MI_ERROR )
+    {
+    itkExceptionMacro(<< "error reading pixel values");
+    }
+  this->CountBytesRead( sizes );
+}
+
+bool MINCImageIO::CanReadThroughDataset() const
+{
+  if ( ! m_Dataset->IsOpen() )
+    return false;
+
+  // Lower resolution levels are always read this way
+  if ( m_ResolutionLevel > 0 )
+    return true;
+
+  if ( m_Dataset->IsCompressed() )
+    return m_UseParallelDecompression && m_Dataset->CanReadChunks();
+
+  return m_UseParallelReading && m_Dataset->CanReadInParallel();
+}
+
+bool MINCImageIO::ReadRawVoxelsFromDataset( const unsigned long starts[],
+					    const unsigned long sizes[],
+					    void* buffer )
+{
+  // Only worth it when no type conversion is needed; libminc handles
+  // the rest.
+  if ( ! m_Dataset->IsOpen()
+       || m_Dataset->GetNumberOfDimensions() != this->GetNumberOfFileDimensions()
+       || ConvertDataTypeToITK( m_StoredDataType ) != this->GetComponentType()
+       || m_Dataset->GetComponentSize() != this->GetComponentSize() )
+    {
+    return false;
+    }
+
+  const void* mapped = this->GetMappedStoredVoxels( starts, sizes );
+  if ( mapped )
+    {
+    MINCReadStatistics* statistics = this->GetCurrentStatistics();
+    ScopedTimer timer( m_Clock, statistics ? &statistics->readTime : 0 );
+    size_t numBytes = m_Dataset->GetVoxelSize();
+    for( unsigned int d = 0; d < this->GetNumberOfFileDimensions(); ++d )
+      numBytes *= sizes[d];
+    std::memcpy( buffer, mapped, numBytes );
+    this->CountBytesRead( sizes );
+    return true;
+    }
+
+  return this->CanReadThroughDataset() && this->ReadFromDataset( starts, sizes, buffer );
+}
+
+bool MINCImageIO::ReadAndRescaleVoxels( const unsigned long starts[],
+					const unsigned long sizes[],
+					void* buffer,
+					bool unscaled )
+{
+  const size_t storedComponentSize = ComponentSizeOfMINCType( m_StoredDataType );
+  if ( storedComponentSize == 0
+       || ConvertDataTypeToITK( m_StoredDataType ) == UNKNOWNCOMPONENTTYPE )
+    {
+    return false;
+    }
+
+  size_t numComponents = this->GetNumberOfComponents();
+  for( unsigned int d = 0; d < this->GetNumberOfDimensions(); ++d )
+    numComponents *= sizes[d];
+
+  const size_t storedBytes = numComponents * storedComponentSize;
+  const size_t bufferBytes = numComponents * this->GetComponentSize();
+
+  // Voxels mapped or read ahead are rescaled straight from where
+  // they are
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+
+  const void* mapped = this->GetMappedStoredVoxels( starts, sizes );
+  if ( mapped )
+    {
+    ScopedTimer timer( m_Clock, statistics ? &statistics->conversionTime : 0 );
+    this->RescaleVoxels( starts, sizes, mapped, buffer, unscaled );
+    this->CountBytesRead( sizes );
+    return true;
+    }
+
+  bool readAhead;
+  {
+  ScopedTimer timer( m_Clock, statistics ? &statistics->readTime : 0 );
+  readAhead = m_ReadAhead->Take( starts, sizes, m_ReadAheadBuffer, statistics );
+  }
+  if ( readAhead )
+    {
+    {
+    ScopedTimer timer( m_Clock, statistics ? &statistics->conversionTime : 0 );
+    this->RescaleVoxels( starts, sizes, &m_ReadAheadBuffer[0], buffer, unscaled );
+    }
+    m_ReadAhead->Recycle( m_ReadAheadBuffer );
+    this->StartReadAhead( starts, sizes );
+    return true;
+    }
+
+  // Stored voxels are read into the end of the caller's buffer and
+  // rescaled front to back, so a separate buffer is only needed when
+  // the stored type is wider than the component type.
+  std::vector<char> staging;
+  char* stored = static_cast<char*>( buffer ) + bufferBytes - storedBytes;
+  if ( storedBytes > bufferBytes )
+    {
+    staging.resize( storedBytes );
+    stored = &staging[0];
+    }
+
+  if ( m_NetCDFFile->IsOpen() )
+    {
+    ScopedTimer timer( m_Clock, statistics ? &statistics->readTime : 0 );
+    if ( ! m_NetCDFFile->ReadHyperslab( m_NetCDFFile->FindVariable( "image" ), starts, sizes,
+					stored, m_NumberOfThreads ) )
+      {
+      itkExceptionMacro(<< "error reading voxel values");
+      }
+    this->CountBytesRead( sizes );
+    }
+  else if ( ! this->ReadChunksInParallel( starts, sizes, stored ) )
+    {
+    ScopedTimer timer( m_Clock, statistics ? &statistics->readTime : 0 );
+    MINCVolumeCache::LockHolder volumeLock( m_VolumeID );
+    if ( m_ResolutionLevel > 0 || ! volumeLock.IsLocked()
+	 || miget_voxel_value_hyperslab( m_Volume, m_StoredDataType, starts, sizes, stored ) == MI_ERROR )
+      {
+      itkExceptionMacro(<< "error reading voxel values");
+      }
+    this->CountBytesRead( sizes );
+    }
+
+  ScopedTimer timer( m_Clock, statistics ? &statistics->conversionTime : 0 );
+  this->RescaleVoxels( starts, sizes, stored, buffer, unscaled );
+  return true;
+}
+
+void MINCImageIO::ReadRawVoxelsFromNetCDF( const unsigned long starts[],
+					   const unsigned long sizes[],
+					   void* buffer )
+{
+  const IOComponentType storedComponentType = ConvertDataTypeToITK( m_StoredDataType );
+
+  size_t numComponents = this->GetNumberOfComponents();
+  for( unsigned int d = 0; d < this->GetNumberOfDimensions(); ++d )
+    numComponents *= sizes[d];
+
+  // Voxels of another type are staged, then converted
+  std::vector<char> staging;
+  void* stored = buffer;
+  if ( storedComponentType != this->GetComponentType() )
+    {
+    staging.resize( numComponents * ComponentSizeOfMINCType( m_StoredDataType ) );
+    stored = &staging[0];
+    }
+
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+  {
+  ScopedTimer timer( m_Clock, statistics ? &statistics->readTime : 0 );
+  if ( ! m_NetCDFFile->ReadHyperslab( m_NetCDFFile->FindVariable( "image" ), starts, sizes,
+				      stored, m_NumberOfThreads ) )
+    {
+    itkExceptionMacro(<< "error reading voxel values");
+    }
+  this->CountBytesRead( sizes );
+  }
+
+  if ( staging.empty() )
+    return;
+
+  ScopedTimer timer( m_Clock, statistics ? &statistics->conversionTime : 0 );
+  MINCVoxelRescaler::Rescale( storedComponentType, stored, this->GetComponentType(), buffer,
+			      numComponents, 1.0, 0.0 );
+}
+
+bool MINCImageIO::ReadChunksInParallel( const unsigned long starts[],
+					const unsigned long sizes[],
+					void* stored )
+{
+  if ( ! this->CanReadThroughDataset()
+       || m_Dataset->GetNumberOfDimensions() != this->GetNumberOfFileDimensions()
+       || m_Dataset->GetComponentSize() != ComponentSizeOfMINCType( m_StoredDataType ) )
+    {
+    return false;
+    }
+
+  return this->ReadFromDataset( starts, sizes, stored );
+}
+
+const void* MINCImageIO::GetMappedStoredVoxels( const unsigned long starts[],
+						const unsigned long sizes[] ) const
+{
+  if ( ! m_Dataset->IsOpen()
+       || m_Dataset->GetNumberOfDimensions() != this->GetNumberOfFileDimensions()
+       || m_Dataset->GetComponentSize() != ComponentSizeOfMINCType( m_StoredDataType ) )
+    {
+    return 0;
+    }
+
+  return m_Dataset->GetMappedHyperslab( starts, sizes );
+}
+
+const void* MINCImageIO::GetMappedBuffer() const
+{
+  if ( ! m_Dataset->IsOpen() )
+    return 0;
+
+  std::vector<unsigned long> starts( m_Dataset->GetNumberOfDimensions(), 0 );
+  std::vector<unsigned long> sizes( m_Dataset->GetNumberOfDimensions() );
+  for( unsigned int d = 0; d < sizes.size(); ++d )
+    sizes[d] = m_Dataset->GetDimensionSize( d );
+
+  return sizes.empty() ? 0 : m_Dataset->GetMappedHyperslab( &starts[0], &sizes[0] );
+}
+
+bool MINCImageIO::ReadFromDataset( const unsigned long starts[],
+				   const unsigned long sizes[],
+				   void* stored )
+{
+  this->ConfigureChunkCache( starts, sizes );
+
+  MINCReadStatistics* statistics = this->GetCurrentStatistics();
+  {
+  ScopedTimer timer( m_Clock, statistics ? &statistics->readTime : 0 );
+
+  if ( m_ReadAhead->Take( starts, sizes, m_ReadAheadBuffer, statistics ) )
+    {
+    if ( ! m_ReadAheadBuffer.empty() )
+      std::memcpy( stored, &m_ReadAheadBuffer[0], m_ReadAheadBuffer.size() );
+    m_ReadAhead->Recycle( m_ReadAheadBuffer );
+    }
+  else
+    {
+    m_Dataset->SetNumberOfThreads( m_NumberOfThreads );
+    if ( ! m_Dataset->ReadHyperslab( starts, sizes, stored, statistics ) )
+      return false;
+    }
+  }
+
+  this->StartReadAhead( starts, sizes );
+  return true;
+}
+
+void MINCImageIO::ConfigureChunkCache( const unsigned long starts[],
+				       const unsigned long sizes[] )
+{
+  if ( m_ChunkCacheMode == ChunkCacheManual )
+    {
+    m_Dataset->SetChunkCache( m_ChunkCacheSize, m_ChunkCacheSlots, m_ChunkCachePolicy );
+    return;
+    }
+
+  // Sampled images are read plane by plane, and the planes share
+  // chunks: they are cached as with ChunkCacheAuto
+  if ( ( m_ChunkCacheMode == ChunkCacheDefault && ! this->IsSampled() ) || ! m_Dataset->IsChunked() )
+    {
+    m_Dataset->SetChunkCache( H5D_CHUNK_CACHE_NBYTES_DEFAULT, H5D_CHUNK_CACHE_NSLOTS_DEFAULT,
+			      H5D_CHUNK_CACHE_W0_DEFAULT );
+    return;
+    }
+
+  // The next reads are expected to step along the slowest-varying
+  // dimension that the hyperslab does not span: slab after slab along
+  // dimension 0, say, or frame after frame along time.
+  const unsigned int numDimensions = m_Dataset->GetNumberOfDimensions();
+  unsigned int stepDimension = 0;
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    if ( sizes[d] < m_Dataset->GetDimensionSize( d ) )
+      {
+      stepDimension = d;
+      break;
+      }
+    }
+
+  // One layer of the chunks that the hyperslab cuts across it
+  size_t numChunks = 1;
+  size_t chunkBytes = m_Dataset->GetVoxelSize();
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    const unsigned long chunkSize = m_Dataset->GetChunkSize( d );
+    chunkBytes *= chunkSize;
+    if ( d != stepDimension && sizes[d] > 0 )
+      numChunks *= ( starts[d] + sizes[d] - 1 ) / chunkSize - starts[d] / chunkSize + 1;
+    }
+
+  // HDF5 advises about a hundred times as many hash slots as chunks,
+  // a prime number of them.
+  size_t numSlots = 100 * numChunks + 1;
+  for( size_t divisor = 3; divisor * divisor <= numSlots; divisor += 2 )
+    {
+    if ( numSlots % divisor == 0 )
+      {
+      numSlots += 2;
+      divisor = 1;
+      }
+    }
+
+  m_Dataset->SetChunkCache( numChunks * chunkBytes, numSlots, m_ChunkCachePolicy );
+}
+
+void MINCImageIO::StartReadAhead( const unsigned long starts[],
+				  const unsigned long sizes[] )
+{
+  const unsigned int numDimensions = this->GetNumberOfFileDimensions();
+  if ( ! m_UseReadAhead || numDimensions == 0 )
+    return;
+
+  // Mapped files are read from the page cache as they are
+  if ( this->GetMappedStoredVoxels( starts, sizes ) )
+    return;
+
+  // The next slab along dimension 0, the slowest-varying
+  std::vector<unsigned long> nextStarts( starts, starts + numDimensions );
+  std::vector<unsigned long> nextSizes( sizes, sizes + numDimensions );
+
+  nextStarts[0] = starts[0] + sizes[0];
+  if ( nextStarts[0] >= m_StoredSize[0] )
+    return;
+  nextSizes[0] = std::min<unsigned long>( sizes[0], m_StoredSize[0] - nextStarts[0] );
+
+  size_t numBytes = m_Dataset->GetVoxelSize();
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    numBytes *= nextSizes[d];
+
+  m_ReadAhead->Start( m_Dataset, &nextStarts[0], &nextSizes[0], numBytes, m_NumberOfThreads );
+}
+
+void MINCImageIO::RescaleVoxels( const unsigned long starts[],
+				 const unsigned long sizes[],
+				 const void* stored,
+				 void* buffer,
+				 bool unscaled ) const
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+
+  size_t numComponents = this->GetNumberOfComponents();
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    numComponents *= sizes[d];
+
+  if ( unscaled )
+    {
+    MINCVoxelRescaler::Rescale( ConvertDataTypeToITK( m_StoredDataType ), stored,
+				this->GetComponentType(), buffer, numComponents, 1.0, 0.0 );
+    return;
+    }
+
+  if ( ! m_CompactLabelValues.empty() )
+    {
+    if ( ! CompactLabels( m_StoredDataType, stored, this->GetComponentType(), buffer,
+			  numComponents, m_CompactLabelValues ) )
+      {
+      itkExceptionMacro(<< "voxel value not in the label table of " << this->GetFileName());
+      }
+    return;
+    }
+
+  const unsigned int sliceDimensions = numDimensions > 2 ? numDimensions - 2 : 0;
+
+  size_t sliceComponents = this->GetNumberOfComponents();
+  for( unsigned int d = sliceDimensions; d < numDimensions; ++d )
+    sliceComponents *= sizes[d];
+
+  size_t numSlices = 1;
+  for( unsigned int d = 0; d < sliceDimensions; ++d )
+    numSlices *= sizes[d];
+
+  const size_t storedSliceBytes = sliceComponents * ComponentSizeOfMINCType( m_StoredDataType );
+  const size_t bufferSliceBytes = sliceComponents * this->GetComponentSize();
+
+  const char* in = static_cast<const char*>( stored );
+  char* out = static_cast<char*>( buffer );
+
+  std::vector<unsigned long> index( sliceDimensions, 0 );
+
+  for( size_t s = 0; s < numSlices; ++s )
+    {
+    // Index of this slice in the file
+    size_t fileSlice = 0;
+    for( unsigned int d = 0; d < sliceDimensions; ++d )
+      fileSlice = fileSlice * m_StoredSize[d] + starts[d] + index[d];
+
+    if ( m_RescaleSlope.size() == 1 )
+      fileSlice = 0;
+
+    MINCVoxelRescaler::Rescale( ConvertDataTypeToITK( m_StoredDataType ), in + s * storedSliceBytes,
+				this->GetComponentType(), out + s * bufferSliceBytes,
+				sliceComponents,
+				m_RescaleSlope[fileSlice], m_RescaleIntercept[fileSlice] );
+
+    for( int d = static_cast<int>( sliceDimensions ) - 1; d >= 0; --d )
+      {
+      if ( ++index[d] < sizes[d] )
+	break;
+      index[d] = 0;
+      }
+    }
+}
+
+bool MINCImageIO::CanWriteFile( const char* filenameOrig )
+{
+  std::string filename( filenameOrig );
+
+  // transform filename to lower case to make checks case-insensitive
+  std::transform( filename.begin(), filename.end(), filename.begin(), (int(*)(int)) std::tolower );
+
+  std::string::size_type mncPos = filename.rfind(".mnc");
+  if ( (mncPos != std::string::npos)
+       && (mncPos > 0)
+       && (mncPos == filename.length() - 4) )
+    {
+    return true;
+    }
+
+  mncPos = filename.rfind(".mnc2");
+  if ( (mncPos != std::string::npos)
+       && (mncPos > 0)
+       && (mncPos == filename.length() - 5) )
+    {
+    return true;
+    }
+
+  return false;
+}
+
+void MINCImageIO::SetWriteChunkSize( unsigned int i, unsigned int size )
+{
+  if ( i >= m_WriteChunkSize.size() )
+    m_WriteChunkSize.resize( i + 1, 0 );
+  m_WriteChunkSize[i] = size;
+  this->Modified();
+}
+
+unsigned int MINCImageIO::GetWriteChunkSize( unsigned int i ) const
+{
+  if ( i >= m_WriteChunkSize.size() )
+    return 0;
+  return m_WriteChunkSize[i];
+}
+
+void MINCImageIO::WriteImageInformation()
+{
+  this->CloseVolume();
+
+  const char* filename = this->GetFileName();
+
+  // Readers must not be handed the file being replaced
+  MINCVolumeCache::Invalidate( filename );
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+
+  mitype_t dataType;
+  miclass_t dataClass;
+
+  IOComponentType fileComponentType = m_FileComponentType;
+  if ( fileComponentType == UNKNOWNCOMPONENTTYPE )
+    fileComponentType = this->GetComponentType();
+
+  // The components of vector pixels go along a vector_dimension
+  // varying fastest, as ReadShapeInformation() expects them
+  m_VectorComponents = this->GetPixelType() == itk::ImageIOBase::VECTOR;
+
+  switch( this->GetPixelType() )
+    {
+    case itk::ImageIOBase::SCALAR:
+    case itk::ImageIOBase::VECTOR:
+      dataType = ConvertScalarDataTypeToMINC( fileComponentType );
+      dataClass = m_WriteLabels ? MI_CLASS_LABEL : MI_CLASS_REAL;
+      break;
+    case itk::ImageIOBase::COMPLEX:
+      dataType = ConvertComplexDataTypeToMINC( fileComponentType );
+      dataClass = MI_CLASS_COMPLEX;
+      break;
+    default:
+      itkExceptionMacro(<< "unhandled pixel type: " << this->GetPixelType());
+    }
+
+  if ( dataType == MI_TYPE_UNKNOWN )
+    itkExceptionMacro(<< "unhandled component type: " << this->GetComponentType());
+
+  double typeMin, typeMax;
+  const bool integerType = GetMINCTypeRange( dataType, typeMin, typeMax );
+
+  if ( dataClass == MI_CLASS_LABEL
+       && ( ! integerType || fileComponentType != this->GetComponentType() ) )
+    {
+    itkExceptionMacro(<< "labels must be written as their own integer type");
+    }
+
+  const unsigned int numFileDimensions = numDimensions + ( m_VectorComponents ? 1 : 0 );
+  std::vector<midimhandle_t> dimensions( numFileDimensions );
+  this->CreateDimensions( &dimensions[0] );
+
+  // Chunking and compression; chunks hold whole pixels
+  std::vector<int> chunkSize( numFileDimensions );
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    chunkSize[dim] = this->ComputeWriteChunkSize( dim );
+  if ( m_VectorComponents )
+    chunkSize[numDimensions] = this->GetNumberOfComponents();
+
+  mivolumeprops_t props;
+  if ( minew_volume_props( &props ) == MI_ERROR )
+    itkExceptionMacro(<< "cannot create volume properties");
+
+  if ( this->GetUseCompression() )
+    {
+    miset_props_compression_type( props, MI_COMPRESS_ZLIB );
+    miset_props_zlib_compression( props, m_CompressionLevel );
+    }
+  else
+    {
+    miset_props_compression_type( props, MI_COMPRESS_NONE );
+    }
+  miset_props_blocking( props, numFileDimensions, &chunkSize[0] );
+
+  // libminc creates the file and its metadata; the voxels are then
+  // written directly through HDF5 so that chunks can be compressed in
+  // parallel.
+  mihandle_t volume;
+  if ( micreate_volume( filename, numFileDimensions, &dimensions[0], 
+			dataType, dataClass, props, &volume ) == MI_ERROR )
+    {
+    mifree_volume_props( props );
+    itkExceptionMacro(<< "cannot create file " << filename);
+    }
+  mifree_volume_props( props );
+
+  // Integer voxels of the image's own type are written unscaled: the
+  // real range equals the valid range.  Any other conversion to an
+  // integer type is scaled slice by slice, except for images without
+  // slices, i.e. of fewer than 3 dimensions, and vector images:
+  // libminc would not leave their vector_dimension out of the slices.
+  // Those get one range for the whole image.
+  m_WriteScaling = integerType && fileComponentType != this->GetComponentType();
+  m_WriteSliceScaling = m_WriteScaling && numDimensions >= 3 && ! m_VectorComponents;
+
+  miset_slice_scaling_flag( volume, m_WriteSliceScaling );
+
+  // The labels are members of the image's data type, so they are
+  // defined before the image is created
+  std::vector<int> labelValues;
+  std::vector<std::string> labelNames;
+  if ( dataClass == MI_CLASS_LABEL
+       && ExposeMetaData< std::vector<int> >( this->GetMetaDataDictionary(), "MINC_LabelValues", labelValues )
+       && ExposeMetaData< std::vector<std::string> >( this->GetMetaDataDictionary(), "MINC_LabelNames", labelNames ) )
+    {
+    for( size_t i = 0; i < labelValues.size() && i < labelNames.size(); ++i )
+      {
+      if ( midefine_label( volume, labelValues[i], labelNames[i].c_str() ) == MI_ERROR )
+	{
+	miclose_volume( volume );
+	itkExceptionMacro(<< "cannot define label " << labelValues[i] << " in file " << filename);
+	}
+      }
+    }
+
+  if ( micreate_volume_image( volume ) == MI_ERROR )
+    {
+    miclose_volume( volume );
+    itkExceptionMacro(<< "cannot create image in file " << filename);
+    }
+
+  if ( integerType )
+    {
+    miset_volume_valid_range( volume, typeMax, typeMin );
+    if ( ! m_WriteScaling && dataClass != MI_CLASS_LABEL )
+      miset_volume_range( volume, typeMax, typeMin );
+    }
+
+  miclose_volume( volume );
+
+  if ( ! m_Dataset->Open( filename, 0, true ) )
+    itkExceptionMacro(<< "cannot open image in file " << filename << " for writing");
+
+  size_t numSlices = 1;
+  for( unsigned int dim = 0; m_WriteSliceScaling && dim + 2 < numDimensions; ++dim )
+    numSlices *= this->GetDimensions( dim );
+
+  m_WriteImageMin.assign( m_WriteScaling ? numSlices : 0, 0.0 );
+  m_WriteImageMax.assign( m_WriteScaling ? numSlices : 0, 0.0 );
+
+  m_StoredDataType = dataType;
+  m_Dataset->SetNumberOfThreads( m_NumberOfThreads );
+
+  // The levels would halve the vector_dimension along with the others
+  if ( m_NumberOfPyramidLevels > 0 && m_VectorComponents )
+    {
+    this->CloseVolume();
+    itkExceptionMacro(<< "resolution levels cannot be written for vector images");
+    }
+
+  if ( m_NumberOfPyramidLevels > 0 )
+    {
+    MINCPyramidBuilder::DownsamplingType method = MINCPyramidBuilder::Average;
+    if ( dataClass == MI_CLASS_LABEL )
+      method = m_LabelDownsampling == LabelMode ? MINCPyramidBuilder::Mode : MINCPyramidBuilder::Nearest;
+
+    m_PyramidBuilder->SetNumberOfThreads( m_NumberOfThreads );
+    if ( ! m_PyramidBuilder->Create( m_Dataset, filename, m_NumberOfPyramidLevels,
+				     this->GetNumberOfComponents(), ConvertDataTypeToITK( dataType ),
+				     m_WriteSliceScaling, typeMin, typeMax, method ) )
+      {
+      this->CloseVolume();
+      itkExceptionMacro(<< "cannot create resolution levels in file " << filename);
+      }
+    }
+
+  m_WritingVolume = true;
+  m_NumberOfPixelsWritten = 0;
+}
+
+void MINCImageIO::Write( const void* buffer )
+{
+  if ( ! m_WritingVolume )
+    this->WriteImageInformation();
+
+  const ImageIORegion& region = this->GetIORegion();
+
+  std::vector<unsigned long> starts( this->GetNumberOfDimensions() );
+  std::vector<unsigned long> sizes( this->GetNumberOfDimensions() );
+  ConvertRegionToMINC( region, &starts[0], &sizes[0] );
+  if ( m_VectorComponents )
+    {
+    starts.push_back( 0 );
+    sizes.push_back( this->GetNumberOfComponents() );
+    }
+
+  // Only the piece being written is converted, so memory use scales
+  // with the piece rather than the image.
+  const void* stored = buffer;
+  std::vector<char> staging;
+
+  if ( ConvertDataTypeToITK( m_StoredDataType ) != this->GetComponentType() )
+    {
+    staging.resize( region.GetNumberOfPixels() * this->GetNumberOfComponents()
+		    * ComponentSizeOfMINCType( m_StoredDataType ) );
+    this->ScaleSlicesForWriting( &starts[0], &sizes[0], buffer, &staging[0] );
+    stored = &staging[0];
+    }
+
+  if ( ! m_Dataset->WriteHyperslab( &starts[0], &sizes[0], stored ) )
+    {
+    this->CloseVolume();
+    itkExceptionMacro(<< "error writing pixel values to " << this->GetFileName());
+    }
+
+  if ( m_PyramidBuilder->IsOpen() )
+    {
+    // A whole image scaled as such is also one piece, its range known
+    if ( m_WriteScaling && ! m_WriteSliceScaling )
+      m_PyramidBuilder->SetImageRange( m_WriteImageMin[0], m_WriteImageMax[0] );
+    this->AddPieceToPyramid( &starts[0], &sizes[0], buffer );
+    }
+
+  m_NumberOfPixelsWritten += region.GetNumberOfPixels();
+  if ( m_NumberOfPixelsWritten >= this->GetImageSizeInPixels() )
+    this->FinishWriting();
+}
+
+unsigned int 
+MINCImageIO::GetActualNumberOfSplitsForWriting( unsigned int numberOfRequestedSplits,
+						const ImageIORegion& pasteRegion,
+						const ImageIORegion& largestPossibleRegion )
+{
+  // Slabs along dimension 0 hold whole slices only in 3D and above,
+  // and vector images may be scaled as a whole
+  if ( ! this->GetUseStreamedWriting()
+       || numberOfRequestedSplits <= 1
+       || this->GetNumberOfDimensions() < 3
+       || this->GetPixelType() == itk::ImageIOBase::VECTOR
+       || pasteRegion.GetSize( 0 ) == 0 )
+    {
+    m_WriteSlabThickness = 0;
+    return 1;
+    }
+
+  const unsigned long chunk = this->ComputeWriteChunkSize( 0 );
+  const unsigned long start = pasteRegion.GetIndex( 0 );
+  const unsigned long end = start + pasteRegion.GetSize( 0 );
+
+  unsigned long thickness = ( pasteRegion.GetSize( 0 ) + numberOfRequestedSplits - 1 ) 
+    / numberOfRequestedSplits;
+  thickness = ( ( thickness + chunk - 1 ) / chunk ) * chunk;
+
+  m_WriteSlabThickness = thickness;
+  return ( end - 1 ) / thickness - start / thickness + 1;
+}
+
+ImageIORegion 
+MINCImageIO::GetSplitRegionForWriting( unsigned int ithPiece,
+				       unsigned int numberOfActualSplits,
+				       const ImageIORegion& pasteRegion,
+				       const ImageIORegion& largestPossibleRegion )
+{
+  if ( numberOfActualSplits <= 1 || m_WriteSlabThickness == 0 )
+    return pasteRegion;
+
+  // Slabs are aligned to multiples of the thickness, which is a
+  // multiple of the chunk size.
+  const unsigned long thickness = m_WriteSlabThickness;
+  const unsigned long start = pasteRegion.GetIndex( 0 );
+  const unsigned long end = start + pasteRegion.GetSize( 0 );
+  const unsigned long slab = start / thickness + ithPiece;
+
+  const unsigned long pieceStart = std::max( start, slab * thickness );
+  const unsigned long pieceEnd = std::min( end, ( slab + 1 ) * thickness );
+
+  ImageIORegion piece( pasteRegion );
+  piece.SetIndex( 0, pieceStart );
+  piece.SetSize( 0, pieceEnd > pieceStart ? pieceEnd - pieceStart : 0 );
+  return piece;
+}
+
+unsigned int MINCImageIO::ComputeWriteChunkSize( unsigned int i ) const
+{
+  unsigned int size = this->GetWriteChunkSize( i );
+  if ( size == 0 )
+    size = 32;
+  return std::min( size, this->GetDimensions( i ) );
+}
+
+void MINCImageIO::ScaleSlicesForWriting( const unsigned long starts[],
+					 const unsigned long sizes[],
+					 const void* buffer,
+					 void* stored )
+{
+  // Without slice scaling the whole image is one slice
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  const unsigned int sliceDimensions = m_WriteSliceScaling && numDimensions > 2 ? numDimensions - 2 : 0;
+  const IOComponentType storedComponentType = ConvertDataTypeToITK( m_StoredDataType );
+
+  size_t sliceComponents = this->GetNumberOfComponents();
+  for( unsigned int d = sliceDimensions; d < numDimensions; ++d )
+    sliceComponents *= sizes[d];
+
+  size_t numSlices = 1;
+  for( unsigned int d = 0; d < sliceDimensions; ++d )
+    numSlices *= sizes[d];
+
+  if ( ! m_WriteScaling )
+    {
+    MINCVoxelRescaler::Rescale( this->GetComponentType(), buffer, storedComponentType, stored,
+				numSlices * sliceComponents, 1.0, 0.0 );
+    return;
+    }
+
+  for( unsigned int d = sliceDimensions; d < numDimensions; ++d )
+    {
+    if ( starts[d] != 0 || sizes[d] != this->GetDimensions( d ) )
+      itkExceptionMacro(<< "pieces written with slice scaling must hold whole slices");
+    }
+
+  double validMin, validMax;
+  GetMINCTypeRange( m_StoredDataType, validMin, validMax );
+
+  const size_t bufferSliceBytes = sliceComponents * this->GetComponentSize();
+  const size_t storedSliceBytes = sliceComponents * ComponentSizeOfMINCType( m_StoredDataType );
+
+  const char* in = static_cast<const char*>( buffer );
+  char* out = static_cast<char*>( stored );
+
+  std::vector<unsigned long> index( sliceDimensions, 0 );
+
+  for( size_t s = 0; s < numSlices; ++s )
+    {
+    size_t fileSlice = 0;
+    for( unsigned int d = 0; d < sliceDimensions; ++d )
+      fileSlice = fileSlice * this->GetDimensions( d ) + starts[d] + index[d];
+
+    // Map the slice's real range onto the valid range of the type
+    double imageMin, imageMax;
+    ComputeRange( this->GetComponentType(), in + s * bufferSliceBytes, sliceComponents,
+		  imageMin, imageMax );
+    m_WriteImageMin[fileSlice] = imageMin;
+    m_WriteImageMax[fileSlice] = imageMax;
+
+    double slope = 0.0;
+    if ( imageMax > imageMin )
+      slope = ( validMax - validMin ) / ( imageMax - imageMin );
+
+    MINCVoxelRescaler::Rescale( this->GetComponentType(), in + s * bufferSliceBytes,
+				storedComponentType, out + s * storedSliceBytes,
+				sliceComponents, slope, validMin - imageMin * slope );
+
+    for( int d = static_cast<int>( sliceDimensions ) - 1; d >= 0; --d )
+      {
+      if ( ++index[d] < sizes[d] )
+	break;
+      index[d] = 0;
+      }
+    }
+}
+
+void MINCImageIO::AddPieceToPyramid( const unsigned long starts[],
+				     const unsigned long sizes[],
+				     const void* buffer )
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  for( unsigned int d = 1; d < numDimensions; ++d )
+    {
+    if ( starts[d] != 0 || sizes[d] != this->GetDimensions( d ) )
+      {
+      this->CloseVolume();
+      itkExceptionMacro(<< "pieces written with resolution levels must span all but the first dimension");
+      }
+    }
+
+  // One row at a time, as real values
+  const size_t rowSize = m_PyramidBuilder->GetRowSize();
+  const size_t rowBytes = rowSize * this->GetComponentSize();
+  std::vector<double> row( rowSize );
+
+  for( unsigned long r = 0; r < sizes[0]; ++r )
+    {
+    MINCVoxelRescaler::Rescale( this->GetComponentType(), static_cast<const char*>( buffer ) + r * rowBytes,
+				DOUBLE, &row[0], rowSize, 1.0, 0.0 );
+    if ( ! m_PyramidBuilder->AddRow( starts[0] + r, &row[0] ) )
+      {
+      this->CloseVolume();
+      itkExceptionMacro(<< "error writing resolution levels to " << this->GetFileName());
+      }
+    }
+}
+
+void MINCImageIO::FinishWriting()
+{
+  const bool levelsWritten = ! m_PyramidBuilder->IsOpen() || m_PyramidBuilder->Finish();
+
+  const bool rangeWritten = ! m_WriteScaling
+    || m_Dataset->WriteImageRange( m_WriteImageMin, m_WriteImageMax );
+
+  this->CloseVolume();
+
+  if ( ! levelsWritten )
+    itkExceptionMacro(<< "error writing resolution levels to " << this->GetFileName());
+
+  if ( rangeWritten )
+    return;
+
+  // Fall back on libminc to store the slice ranges
+  mihandle_t volume;
+  if ( miopen_volume( this->GetFileName(), MI2_OPEN_RDWR, &volume ) == MI_ERROR )
+    itkExceptionMacro(<< "cannot reopen " << this->GetFileName() << " to store slice ranges");
+
+  if ( ! m_WriteSliceScaling )
+    {
+    miset_volume_range( volume, m_WriteImageMax[0], m_WriteImageMin[0] );
+    miclose_volume( volume );
+    return;
+    }
+
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  std::vector<unsigned long> position( numDimensions, 0 );
+
+  for( size_t s = 0; s < m_WriteImageMin.size(); ++s )
+    {
+    size_t slice = s;
+    for( int d = static_cast<int>( numDimensions ) - 3; d >= 0; --d )
+      {
+      position[d] = slice % this->GetDimensions( d );
+      slice /= this->GetDimensions( d );
+      }
+    miset_slice_range( volume, &position[0], numDimensions,
+		       m_WriteImageMax[s], m_WriteImageMin[s] );
+    }
+
+  miclose_volume( volume );
+}
+
+void MINCImageIO::ReadPixelInformation()
+{
+  // Pixel & Component information computed from data type and data
+  // class
+
+  // MINC1 images hold real values
+  miclass_t dataClass = MI_CLASS_REAL;
+
+  if ( m_VolumeValid && miget_data_class( m_Volume, &dataClass ) == MI_ERROR )
+    itkExceptionMacro(<< "cannot get data class");
+
+  switch( dataClass )
+    {
+    case MI_CLASS_REAL:
+    case MI_CLASS_INT:
+    case MI_CLASS_LABEL:
+      this->SetPixelType( itk::ImageIOBase::SCALAR );
+      this->SetNumberOfComponents( 1 );
+      break;
+    case MI_CLASS_COMPLEX:
+      this->SetPixelType( itk::ImageIOBase::COMPLEX );
+      this->SetNumberOfComponents( 2 );
+      break;
+    default:
+      itkExceptionMacro(<< "unhandled data class: " << dataClass);
+    }
+
+  mitype_t dataType = MI_TYPE_UNKNOWN;
+
+  if ( m_NetCDFFile->IsOpen() )
+    dataType = GetNetCDFDataType( *m_NetCDFFile, m_NetCDFFile->FindVariable( "image" ) );
+  else if ( miget_data_type( m_Volume, &dataType ) == MI_ERROR )
+    itkExceptionMacro(<< "cannot get data type");
+
+  IOComponentType compType = ConvertDataTypeToITK( dataType );
+  if ( compType == UNKNOWNCOMPONENTTYPE )
+    itkExceptionMacro(<< "unhandled MINC data type: " << dataType );
+
+  // Read() converts the voxels to the requested type as it goes
+  if ( m_RequestedComponentType != UNKNOWNCOMPONENTTYPE )
+    {
+    const mitype_t requestedType = dataClass == MI_CLASS_COMPLEX
+      ? ConvertComplexDataTypeToMINC( m_RequestedComponentType )
+      : ConvertScalarDataTypeToMINC( m_RequestedComponentType );
+    if ( requestedType == MI_TYPE_UNKNOWN )
+      {
+      itkExceptionMacro(<< "cannot read " << this->GetFileName() << " as " 
+			<< this->GetComponentTypeAsString( m_RequestedComponentType ) );
+      }
+    compType = m_RequestedComponentType;
+    }
+
+  this->SetComponentType( compType );
+  m_StoredDataType = dataType;
+  m_StoredDataClass = dataClass;
+}
+
+void MINCImageIO::ReadLabelInformation()
+{
+  m_LabelValues.clear();
+  m_LabelNames.clear();
+  m_CompactLabelValues.clear();
+
+  int numLabels = 0;
+  if ( m_StoredDataClass != MI_CLASS_LABEL
+       || miget_number_of_defined_labels( m_Volume, &numLabels ) == MI_ERROR )
+    {
+    numLabels = 0;
+    }
+
+  std::map<int, std::string> labels;
+  for( int i = 0; i < numLabels; ++i )
+    {
+    int value;
+    char* name = 0;
+    if ( miget_label_value_by_index( m_Volume, i, &value ) == MI_ERROR
+	 || miget_label_name( m_Volume, value, &name ) == MI_ERROR || ! name )
+      {
+      itkExceptionMacro(<< "cannot get label " << i << " of " << this->GetFileName());
+      }
+    labels[value] = name;
+    mifree_name( name );
+    }
+
+  for( std::map<int, std::string>::const_iterator label = labels.begin(); label != labels.end(); ++label )
+    {
+    m_LabelValues.push_back( label->first );
+    m_LabelNames.push_back( label->second );
+    }
+
+  // Background voxels are 0 whether or not the table names them
+  double typeMin, typeMax;
+  if ( m_UseCompactLabels && ! m_LabelValues.empty()
+       && this->GetPixelType() == itk::ImageIOBase::SCALAR
+       && GetMINCTypeRange( m_StoredDataType, typeMin, typeMax ) )
+    {
+    labels.insert( std::make_pair( 0, std::string() ) );
+    if ( labels.size() <= 256 )
+      this->SetComponentType( UCHAR );
+    else if ( labels.size() <= 65536 )
+      this->SetComponentType( USHORT );
+    else
+      labels.clear();
+
+    for( std::map<int, std::string>::const_iterator label = labels.begin(); label != labels.end(); ++label )
+      m_CompactLabelValues.push_back( label->first );
+    }
+
+  MetaDataDictionary& dictionary = this->GetMetaDataDictionary();
+  EncapsulateMetaData< std::vector<int> >( dictionary, "MINC_LabelValues", m_LabelValues );
+  EncapsulateMetaData< std::vector<std::string> >( dictionary, "MINC_LabelNames", m_LabelNames );
+  EncapsulateMetaData< std::vector<int> >( dictionary, "MINC_CompactLabelValues", m_CompactLabelValues );
+}
+
+void MINCImageIO::ReadShapeInformation()
+{
+  // The dimensions come with the file
+  unsigned int numDimensions = m_FileDimensions.size();
+
+  // A vector_dimension varying fastest holds the components of each
+  // pixel
+  m_VectorComponents = numDimensions > 1
+    && this->GetPixelType() == itk::ImageIOBase::SCALAR
+    && m_FileDimensions[numDimensions - 1].name == "vector_dimension";
+
+  if ( m_VectorComponents )
+    {
+    this->SetPixelType( itk::ImageIOBase::VECTOR );
+    this->SetNumberOfComponents( m_FileDimensions[numDimensions - 1].size );
+    --numDimensions;
+    }
+
+  this->SetNumberOfDimensions( numDimensions );
+
+  m_TimeFileDimension = -1;
+  for( unsigned int dim = 0; dim < numDimensions && m_TimeFileDimension < 0; ++dim )
+    {
+    const midimclass_t dimClass = m_FileDimensions[dim].dimClass;
+    if ( dimClass == MI_DIMCLASS_TIME || dimClass == MI_DIMCLASS_TFREQUENCY )
+      m_TimeFileDimension = dim;
+    }
+
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    this->SetDimensions( dim, m_FileDimensions[dim].size );
+}
+
+void MINCImageIO::ReadImageToWorldInformation()
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+
+  // Spatial dimensions span the first world axes, along their
+  // direction cosines; time and any other dimension each have an
+  // axis of their own after those.
+  std::vector<bool> spatial( numDimensions, true );
+  unsigned int numSpatial = 0;
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    const midimclass_t dimClass = m_FileDimensions[dim].dimClass;
+    spatial[dim] = dimClass == MI_DIMCLASS_SPATIAL || dimClass == MI_DIMCLASS_SFREQUENCY;
+    if ( spatial[dim] )
+      ++numSpatial;
+    }
+
+  const unsigned int numSpatialAxes = std::min( numSpatial, 3u );
+  unsigned int nextAxis = numSpatialAxes;
+
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    const FileDimension& dimension = m_FileDimensions[dim];
+    if ( ! dimension.hasSampling )
+      {
+      itkExceptionMacro(<< "cannot get spacing and origin of dimension " << dim);
+      }
+    const double origin = dimension.start;
+    double spacing = dimension.step;
+
+    // MINC allows negative spacing.  We convert to positive spacing
+    // and flip the axis direction.
+    bool flipAxis = spacing < 0;
+    if ( flipAxis ) 
+      spacing *= -1;
+    this->SetSpacing( dim, spacing );
+    this->SetOrigin( dim, origin );
+
+    std::vector<double> direction( numDimensions, 0.0 );
+
+    if ( spatial[dim] )
+      {
+      if ( ! dimension.hasCosines )
+	{
+	itkExceptionMacro(<< "cannot get direction cosines of dimension " << dim);
+	}
+      double cosines[3] = { dimension.cosines[0], dimension.cosines[1], dimension.cosines[2] };
+
+      // MINC uses RAS convention for world-space, so X- and
+      // Y-coordinates must be flipped to produce the LPS-convention
+      // direction
+      cosines[0] *= -1;
+      cosines[1] *= -1;
+
+      for( unsigned int i = 0; i < numSpatialAxes; ++i )
+	direction[i] = cosines[i];
+      }
+    else
+      {
+      direction[nextAxis++] = 1;
+      }
+
+    if ( flipAxis )
+      {
+      for( unsigned int i = 0; i < numDimensions; ++i )
+	direction[i] *= -1;
+      }
+
+    this->SetDirection( dim, direction );
+    }
+}
+
+void MINCImageIO::ReadTimeInformation()
+{
+  m_FrameTimes.clear();
+  m_FrameWidths.clear();
+
+  if ( m_TimeFileDimension >= 0 )
+    {
+    const FileDimension& time = m_FileDimensions[m_TimeFileDimension];
+    if ( ! time.hasSamples )
+      {
+      itkExceptionMacro(<< "cannot get frame times of dimension " << m_TimeFileDimension);
+      }
+    m_FrameTimes = time.offsets;
+    m_FrameWidths = time.widths;
+    }
+
+  // Each frame of a lower resolution level stands for a run of full
+  // resolution frames: their mean time, and their total width.
+  const unsigned long numFrames = m_TimeFileDimension < 0 ? 0 : this->GetDimensions( m_TimeFileDimension );
+  if ( numFrames > 0 && numFrames < m_FrameTimes.size() )
+    {
+    const size_t numFullFrames = m_FrameTimes.size();
+    std::vector<double> times( numFrames, 0.0 );
+    std::vector<double> widths( numFrames, 0.0 );
+    for( unsigned long f = 0; f < numFrames; ++f )
+      {
+      const size_t first = f * numFullFrames / numFrames;
+      const size_t last = ( f + 1 ) * numFullFrames / numFrames;
+      for( size_t i = first; i < last; ++i )
+	{
+	times[f] += m_FrameTimes[i];
+	widths[f] += m_FrameWidths[i];
+	}
+      times[f] /= last - first;
+      }
+    m_FrameTimes.swap( times );
+    m_FrameWidths.swap( widths );
+    }
+
+  MetaDataDictionary& dictionary = this->GetMetaDataDictionary();
+  EncapsulateMetaData< std::vector<double> >( dictionary, "MINC_FrameTimes", m_FrameTimes );
+  EncapsulateMetaData< std::vector<double> >( dictionary, "MINC_FrameWidths", m_FrameWidths );
+}
+
+void MINCImageIO::ApplyResolutionLevel()
+{
+  if ( m_ResolutionLevel == 0 )
+    return;
+
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  if ( m_Dataset->GetNumberOfDimensions() != this->GetNumberOfFileDimensions() )
+    itkExceptionMacro(<< "resolution level " << m_ResolutionLevel << " has the wrong number of dimensions");
+
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    const unsigned long levelSize = m_Dataset->GetDimensionSize( dim );
+    if ( levelSize == 0 )
+      itkExceptionMacro(<< "resolution level " << m_ResolutionLevel << " is empty");
+
+    // Each level halves the dimensions of the one above that have two
+    // voxels or more, dropping an odd last voxel, as
+    // MINCPyramidBuilder does.  Each voxel of the level covers factor
+    // voxels of the full image, and sits at their centre.
+    unsigned long factor = 1;
+    unsigned long size = this->GetDimensions( dim );
+    for( unsigned int level = 0; level < m_ResolutionLevel; ++level )
+      {
+      if ( size >= 2 )
+	{
+	factor *= 2;
+	size /= 2;
+	}
+      }
+    if ( size != levelSize )
+      {
+      itkExceptionMacro(<< "resolution level " << m_ResolutionLevel << " has " << levelSize
+			<< " voxels along dimension " << dim << " instead of " << size);
+      }
+
+    if ( ! m_FileDimensions[dim].hasSampling )
+      itkExceptionMacro(<< "cannot get spacing of dimension " << dim);
+
+    const double step = m_FileDimensions[dim].step;
+    this->SetOrigin( dim, this->GetOrigin( dim ) + 0.5 * ( factor - 1.0 ) * step );
+    this->SetSpacing( dim, this->GetSpacing( dim ) * factor );
+    this->SetDimensions( dim, levelSize );
+    }
+}
+
+void MINCImageIO::ReadChunkInformation()
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+
+  // A contiguous (unchunked) image has no alignment requirement.
+  m_ChunkSize.assign( numDimensions, 1 );
+
+  // HDF5 knows the deflate level; libminc only whether it is
+  // compressed.
+  m_StoredCompressionLevel = m_Dataset->IsOpen() ? m_Dataset->GetCompressionLevel() : 0;
+
+  // Lower resolution levels have chunks of their own
+  if ( m_ResolutionLevel > 0 )
+    {
+    if ( m_Dataset->IsChunked() )
+      {
+      for( unsigned int dim = 0; dim < numDimensions; ++dim )
+	m_ChunkSize[dim] = m_Dataset->GetChunkSize( dim );
+      }
+    return;
+    }
+
+  // MINC1 images are neither chunked nor compressed
+  mivolumeprops_t props;
+  if ( ! m_VolumeValid || miget_volume_props( m_Volume, &props ) == MI_ERROR )
+    return;
+
+  // The vector dimension, if any, is read whole
+  const unsigned int numFileDimensions = this->GetNumberOfFileDimensions();
+  std::vector<int> edgeLengths( numFileDimensions );
+  int edgeCount = 0;
+
+  if ( numFileDimensions > 0 
+       && miget_props_blocking( props, &edgeCount, &edgeLengths[0], numFileDimensions ) != MI_ERROR
+       && edgeCount == static_cast<int>( numFileDimensions ) )
+    {
+    for( unsigned int dim = 0; dim < numDimensions; ++dim )
+      {
+      if ( edgeLengths[dim] > 0 )
+	m_ChunkSize[dim] = edgeLengths[dim];
+      }
+    }
+
+  micompression_t compression = MI_COMPRESS_NONE;
+  int level = 0;
+  if ( ! m_Dataset->IsOpen()
+       && miget_props_compression_type( props, &compression ) != MI_ERROR
+       && compression == MI_COMPRESS_ZLIB 
+       && miget_props_zlib_compression( props, &level ) != MI_ERROR )
+    {
+    m_StoredCompressionLevel = level;
+    }
+
+  mifree_volume_props( props );
+}
+
+void MINCImageIO::ApplyCanonicalOrder()
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+
+  m_FileAxis.resize( numDimensions );
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    m_FileAxis[dim] = dim;
+
+  if ( ! m_UseCanonicalOrder )
+    return;
+
+  // Rank of each file dimension in canonical order; the sort is
+  // stable, so dimensions of equal rank stay in file order.
+  static const char* const canonicalNames[][2] = {
+    { "xspace", "xfrequency" },
+    { "yspace", "yfrequency" },
+    { "zspace", "zfrequency" },
+    { "time", "tfrequency" },
+    { "vector_dimension", "vector_dimension" } };
+  const unsigned int numNames = sizeof(canonicalNames) / sizeof(canonicalNames[0]);
+
+  std::vector< std::pair<unsigned int, unsigned int> > ranks( numDimensions );
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    ranks[dim] = std::make_pair( numNames, dim );
+
+    const std::string& name = m_FileDimensions[dim].name;
+    for( unsigned int r = 0; r < numNames; ++r )
+      {
+      if ( name == canonicalNames[r][0] || name == canonicalNames[r][1] )
+	ranks[dim].first = r;
+      }
+    }
+  std::stable_sort( ranks.begin(), ranks.end() );
+
+  std::vector<unsigned long> dimensions( numDimensions );
+  std::vector<double> spacing( numDimensions ), origin( numDimensions );
+  std::vector< std::vector<double> > direction( numDimensions );
+  std::vector<unsigned int> chunkSize( m_ChunkSize );
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    dimensions[dim] = this->GetDimensions( dim );
+    spacing[dim] = this->GetSpacing( dim );
+    origin[dim] = this->GetOrigin( dim );
+    direction[dim] = this->GetDirection( dim );
+    }
+
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    const unsigned int fileDim = ranks[dim].second;
+    m_FileAxis[dim] = fileDim;
+    this->SetDimensions( dim, dimensions[fileDim] );
+    this->SetSpacing( dim, spacing[fileDim] );
+    this->SetOrigin( dim, origin[fileDim] );
+    this->SetDirection( dim, direction[fileDim] );
+    m_ChunkSize[dim] = chunkSize[fileDim];
+    }
+}
+
+void MINCImageIO::ApplySampling()
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+
+  m_StoredSize.resize( numDimensions );
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    m_StoredSize[m_FileAxis[dim]] = this->GetDimensions( dim );
+  m_FileSamplingFactor.assign( numDimensions, 1 );
+
+  const bool average = m_SamplingMode == SamplingAverage && ! this->IsLabelImage();
+  bool framesSampled = false;
+
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    const unsigned long size = this->GetDimensions( dim );
+    const unsigned int factor = std::min<unsigned long>( this->GetSamplingFactor( dim ), size );
+    if ( factor <= 1 )
+      continue;
+
+    const unsigned int fileDim = m_FileAxis[dim];
+    m_FileSamplingFactor[fileDim] = factor;
+    this->SetDimensions( dim, size / factor );
+
+    // A mean stands at the centre of its block, along the axis as
+    // stored
+    if ( average )
+      {
+      if ( ! m_FileDimensions[fileDim].hasSampling )
+	itkExceptionMacro(<< "cannot get spacing of dimension " << fileDim);
+
+      const double spacing = m_FileDimensions[fileDim].step < 0 ? -this->GetSpacing( dim ) : this->GetSpacing( dim );
+      this->SetOrigin( dim, this->GetOrigin( dim ) + 0.5 * ( factor - 1.0 ) * spacing );
+      }
+    this->SetSpacing( dim, this->GetSpacing( dim ) * factor );
+    m_ChunkSize[dim] = std::max( m_ChunkSize[dim] / factor, 1u );
+
+    // Frames are sampled like voxels: the first of each block, or
+    // their mean time and total width
+    if ( static_cast<int>( fileDim ) == m_TimeFileDimension )
+      {
+      const unsigned long numFrames = size / factor;
+      std::vector<double> times( numFrames, 0.0 );
+      std::vector<double> widths( numFrames, 0.0 );
+      for( unsigned long f = 0; f < numFrames; ++f )
+	{
+	if ( ! average )
+	  {
+	  times[f] = m_FrameTimes[f * factor];
+	  widths[f] = m_FrameWidths[f * factor];
+	  continue;
+	  }
+	for( unsigned int i = 0; i < factor; ++i )
+	  {
+	  times[f] += m_FrameTimes[f * factor + i];
+	  widths[f] += m_FrameWidths[f * factor + i];
+	  }
+	times[f] /= factor;
+	}
+      m_FrameTimes.swap( times );
+      m_FrameWidths.swap( widths );
+      framesSampled = true;
+      }
+    }
+
+  if ( framesSampled )
+    {
+    MetaDataDictionary& dictionary = this->GetMetaDataDictionary();
+    EncapsulateMetaData< std::vector<double> >( dictionary, "MINC_FrameTimes", m_FrameTimes );
+    EncapsulateMetaData< std::vector<double> >( dictionary, "MINC_FrameWidths", m_FrameWidths );
+    }
+}
+
+void MINCImageIO::ReadScalingInformation()
+{
+  m_RescaleSlope.assign( 1, 1.0 );
+  m_RescaleIntercept.assign( 1, 0.0 );
+
+  // Labels are names rather than quantities: whatever range the file
+  // gives them, they are read and reported as stored
+  if ( m_StoredDataClass == MI_CLASS_LABEL )
+    return;
+
+  // Floating-point and complex voxels are real values already
+  switch( m_StoredDataType )
+    {
+    case MI_TYPE_FLOAT:
+    case MI_TYPE_DOUBLE:
+    case MI_TYPE_SCOMPLEX:
+    case MI_TYPE_ICOMPLEX:
+    case MI_TYPE_FCOMPLEX:
+    case MI_TYPE_DCOMPLEX:
+      return;
+    default:
+      break;
+    }
+
+  // The ranges of MINC1 files are all in their header
+  double validMin, validMax;
+  std::vector<double> imageMin, imageMax;
+  if ( m_NetCDFFile->IsOpen() )
+    {
+    if ( ! this->ReadNetCDFScaling( validMin, validMax, imageMin, imageMax ) )
+      itkExceptionMacro(<< "cannot get image range");
+    }
+  else if ( miget_volume_valid_range( m_Volume, &validMax, &validMin ) == MI_ERROR )
+    itkExceptionMacro(<< "cannot get valid range");
+
+  miboolean_t sliceScaling = 0;
+  if ( ! m_VolumeValid || miget_slice_scaling_flag( m_Volume, &sliceScaling ) == MI_ERROR )
+    sliceScaling = 0;
+
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  const unsigned int sliceDimensions = numDimensions > 2 ? numDimensions - 2 : 0;
+
+  size_t numSlices = 1;
+  if ( sliceScaling )
+    {
+    for( unsigned int d = 0; d < sliceDimensions; ++d )
+      numSlices *= this->GetDimensions( d );
+    }
+
+  // The image-min and image-max datasets are read whole when
+  // possible, rather than one slice at a time through libminc.
+  if ( imageMin.empty()
+       && ( ! m_Dataset->ReadImageRange( imageMin, imageMax ) || imageMin.size() != numSlices ) )
+    {
+    // libminc has slice ranges for full resolution only; other
+    // levels fall back on the range of the whole volume.
+    if ( m_ResolutionLevel > 0 )
+      {
+      sliceScaling = 0;
+      numSlices = 1;
+      }
+
+    imageMin.resize( numSlices );
+    imageMax.resize( numSlices );
+
+    if ( ! sliceScaling )
+      {
+      if ( miget_volume_range( m_Volume, &imageMax[0], &imageMin[0] ) == MI_ERROR )
+	itkExceptionMacro(<< "cannot get image range");
+      }
+    else
+      {
+      const unsigned int numFileDimensions = this->GetNumberOfFileDimensions();
+      std::vector<unsigned long> position( numFileDimensions, 0 );
+      for( size_t s = 0; s < numSlices; ++s )
+	{
+	size_t slice = s;
+	for( int d = static_cast<int>( sliceDimensions ) - 1; d >= 0; --d )
+	  {
+	  position[d] = slice % this->GetDimensions( d );
+	  slice /= this->GetDimensions( d );
+	  }
+
+	if ( miget_slice_range( m_Volume, &position[0], numFileDimensions,
+				&imageMax[s], &imageMin[s] ) == MI_ERROR )
+	  {
+	  itkExceptionMacro(<< "cannot get image range of slice " << s);
+	  }
+	}
+      }
+    }
+
+  numSlices = imageMin.size();
+  m_RescaleSlope.resize( numSlices );
+  m_RescaleIntercept.resize( numSlices );
+
+  for( size_t s = 0; s < numSlices; ++s )
+    {
+    double slope = 1.0;
+    if ( validMax != validMin )
+      slope = ( imageMax[s] - imageMin[s] ) / ( validMax - validMin );
+
+    m_RescaleSlope[s] = slope;
+    m_RescaleIntercept[s] = imageMin[s] - validMin * slope;
+    }
+}
+
+void MINCImageIO::EncapsulateScalingInformation()
+{
+  MetaDataDictionary& dictionary = this->GetMetaDataDictionary();
+  EncapsulateMetaData< std::vector<double> >( dictionary, "MINC_RescaleSlope", m_RescaleSlope );
+  EncapsulateMetaData< std::vector<double> >( dictionary, "MINC_RescaleIntercept", m_RescaleIntercept );
+}
+
+void MINCImageIO::CreateDimensions( midimhandle_t dimensions[] )
+{
+  const char* spatialNames[3] = { "xspace", "yspace", "zspace" };
+  bool spatialNameUsed[3] = { false, false, false };
+
+  for( unsigned int dim = 0; dim < this->GetNumberOfDimensions(); ++dim )
+    {
+    std::string name;
+    midimclass_t dimClass = MI_DIMCLASS_SPATIAL;
+    double cosines[3] = { 0, 0, 0 };
+
+    if ( dim < 3 )
+      {
+      // Undo the LPS-to-RAS flip of ReadImageToWorldInformation(),
+      // then name the axis after the world axis it is closest to.
+      std::vector<double> direction = this->GetDirection( dim );
+      for( unsigned int i = 0; i < 3 && i < direction.size(); ++i )
+	cosines[i] = direction[i];
+      cosines[0] *= -1;
+      cosines[1] *= -1;
+
+      int axis = -1;
+      for( int i = 0; i < 3; ++i )
+	{
+	if ( ! spatialNameUsed[i]
+	     && ( axis < 0 || std::fabs( cosines[i] ) > std::fabs( cosines[axis] ) ) )
+	  {
+	  axis = i;
+	  }
+	}
+      spatialNameUsed[axis] = true;
+      name = spatialNames[axis];
+      }
+    else if ( dim == 3 )
+      {
+      name = "time";
+      dimClass = MI_DIMCLASS_TIME;
+      }
+    else
+      {
+      std::ostringstream userName;
+      userName << "user" << dim;
+      name = userName.str();
+      dimClass = MI_DIMCLASS_USER;
+      }
+
+    if ( micreate_dimension( name.c_str(), dimClass, MI_DIMATTR_REGULARLY_SAMPLED,
+			     this->GetDimensions( dim ), &dimensions[dim] ) == MI_ERROR )
+      {
+      itkExceptionMacro(<< "cannot create dimension " << dim);
+      }
+
+    miset_dimension_separation( dimensions[dim], this->GetSpacing( dim ) );
+    miset_dimension_start( dimensions[dim], this->GetOrigin( dim ) );
+    if ( dimClass == MI_DIMCLASS_SPATIAL )
+      miset_dimension_cosines( dimensions[dim], cosines );
+    }
+
+  if ( m_VectorComponents
+       && micreate_dimension( "vector_dimension", MI_DIMCLASS_RECORD, MI_DIMATTR_REGULARLY_SAMPLED,
+			      this->GetNumberOfComponents(),
+			      &dimensions[this->GetNumberOfDimensions()] ) == MI_ERROR )
+    {
+    itkExceptionMacro(<< "cannot create vector dimension");
+    }
+}
+
+void MINCImageIO::CloseVolume()
+{
+  m_ReadAhead->Cancel();
+  m_PyramidBuilder->Close();
+  m_Dataset->Close();
+  m_NetCDFFile->Close();
+  m_FileDimensions.clear();
+  m_WritingVolume = false;
+
+  if ( ! m_VolumeValid )
+    return;
+
+  m_VolumeValid = false;
+  MINCVolumeCache::Release( m_VolumeID );
+  m_VolumeID = 0;
+}
+
+std::string MINCImageIO::GetHeaderCacheKey() const
+{
+  std::ostringstream key;
+  key << "level " << m_ResolutionLevel
+      << " type " << m_RequestedComponentType
+      << " compact " << m_UseCompactLabels
+      << " canonical " << m_UseCanonicalOrder
+      << " sampling " << m_SamplingMode;
+  for( unsigned int i = 0; i < m_SamplingFactor.size(); ++i )
+    {
+    if ( m_SamplingFactor[i] > 1 )
+      key << " " << i << ":" << m_SamplingFactor[i];
+    }
+  return key.str();
+}
+
+std::string MINCImageIO::SaveHeader() const
+{
+  using namespace MINCSerialization;
+
+  std::ostringstream out;
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  WriteValue( out, numDimensions );
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    WriteValue( out, static_cast<unsigned long long>( this->GetDimensions( dim ) ) );
+    WriteValue( out, this->GetSpacing( dim ) );
+    WriteValue( out, this->GetOrigin( dim ) );
+    WriteVector<double>( out, this->GetDirection( dim ) );
+    }
+  WriteValue( out, static_cast<int>( this->GetPixelType() ) );
+  WriteValue( out, static_cast<int>( this->GetComponentType() ) );
+  WriteValue( out, this->GetNumberOfComponents() );
+
+  WriteValue( out, static_cast<unsigned char>( m_VectorComponents ) );
+  WriteValue( out, m_TimeFileDimension );
+  WriteVector<double>( out, m_FrameTimes );
+  WriteVector<double>( out, m_FrameWidths );
+  WriteValue( out, m_NumberOfResolutionLevels );
+  WriteVector<unsigned int>( out, m_ChunkSize );
+  WriteValue( out, m_StoredCompressionLevel );
+  WriteVector<unsigned int>( out, m_FileAxis );
+  WriteVector<unsigned int>( out, m_FileSamplingFactor );
+  WriteVector<unsigned long long>( out, m_StoredSize );
+  WriteValue( out, static_cast<int>( m_StoredDataType ) );
+  WriteValue( out, static_cast<int>( m_StoredDataClass ) );
+  WriteVector<int>( out, m_LabelValues );
+  WriteStrings( out, m_LabelNames );
+  WriteVector<int>( out, m_CompactLabelValues );
+  WriteVector<double>( out, m_RescaleSlope );
+  WriteVector<double>( out, m_RescaleIntercept );
+
+  return out.str();
+}
+
+bool MINCImageIO::RestoreHeader( const std::string& record )
+{
+  using namespace MINCSerialization;
+
+  std::istringstream in( record );
+
+  unsigned int numDimensions;
+  if ( ! ReadValue( in, numDimensions ) || numDimensions == 0 )
+    return false;
+
+  std::vector<unsigned long long> dimensions( numDimensions );
+  std::vector<double> spacing( numDimensions ), origin( numDimensions );
+  std::vector< std::vector<double> > direction( numDimensions );
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    if ( ! ReadValue( in, dimensions[dim] )
+	 || ! ReadValue( in, spacing[dim] )
+	 || ! ReadValue( in, origin[dim] )
+	 || ! ReadVector<double>( in, direction[dim] ) )
+      {
+      return false;
+      }
+    }
+
+  int pixelType, componentType, storedDataType, storedDataClass;
+  unsigned int numComponents;
+  unsigned char vectorComponents;
+  if ( ! ReadValue( in, pixelType )
+       || ! ReadValue( in, componentType )
+       || ! ReadValue( in, numComponents )
+       || ! ReadValue( in, vectorComponents )
+       || ! ReadValue( in, m_TimeFileDimension )
+       || ! ReadVector<double>( in, m_FrameTimes )
+       || ! ReadVector<double>( in, m_FrameWidths )
+       || ! ReadValue( in, m_NumberOfResolutionLevels )
+       || ! ReadVector<unsigned int>( in, m_ChunkSize )
+       || ! ReadValue( in, m_StoredCompressionLevel )
+       || ! ReadVector<unsigned int>( in, m_FileAxis )
+       || ! ReadVector<unsigned int>( in, m_FileSamplingFactor )
+       || ! ReadVector<unsigned long long>( in, m_StoredSize )
+       || ! ReadValue( in, storedDataType )
+       || ! ReadValue( in, storedDataClass )
+       || ! ReadVector<int>( in, m_LabelValues )
+       || ! ReadStrings( in, m_LabelNames )
+       || ! ReadVector<int>( in, m_CompactLabelValues )
+       || ! ReadVector<double>( in, m_RescaleSlope )
+       || ! ReadVector<double>( in, m_RescaleIntercept ) )
+    {
+    return false;
+    }
+
+  if ( m_ChunkSize.size() != numDimensions
+       || m_FileAxis.size() != numDimensions
+       || m_FileSamplingFactor.size() != numDimensions
+       || m_StoredSize.size() != numDimensions
+       || m_RescaleSlope.empty()
+       || m_RescaleSlope.size() != m_RescaleIntercept.size() )
+    {
+    return false;
+    }
+
+  this->SetNumberOfDimensions( numDimensions );
+  for( unsigned int dim = 0; dim < numDimensions; ++dim )
+    {
+    this->SetDimensions( dim, dimensions[dim] );
+    this->SetSpacing( dim, spacing[dim] );
+    this->SetOrigin( dim, origin[dim] );
+    this->SetDirection( dim, direction[dim] );
+    }
+  this->SetPixelType( static_cast<IOPixelType>( pixelType ) );
+  this->SetComponentType( static_cast<IOComponentType>( componentType ) );
+  this->SetNumberOfComponents( numComponents );
+  m_VectorComponents = vectorComponents != 0;
+  m_StoredDataType = static_cast<mitype_t>( storedDataType );
+  m_StoredDataClass = static_cast<miclass_t>( storedDataClass );
+
+  MetaDataDictionary& dictionary = this->GetMetaDataDictionary();
+  EncapsulateMetaData< std::vector<int> >( dictionary, "MINC_LabelValues", m_LabelValues );
+  EncapsulateMetaData< std::vector<std::string> >( dictionary, "MINC_LabelNames", m_LabelNames );
+  EncapsulateMetaData< std::vector<int> >( dictionary, "MINC_CompactLabelValues", m_CompactLabelValues );
+  EncapsulateMetaData< std::vector<double> >( dictionary, "MINC_FrameTimes", m_FrameTimes );
+  EncapsulateMetaData< std::vector<double> >( dictionary, "MINC_FrameWidths", m_FrameWidths );
+  this->EncapsulateScalingInformation();
+
+  this->ComputeStrides();
+  return true;
 }
 
 
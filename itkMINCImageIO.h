@@ -30,6 +30,9 @@
 #endif
 
 #include "itkImageIOBase.h"
+#include "itkMINCReadStatistics.h"
+#include "itkMultiThreader.h"
+#include "itkRealTimeClock.h"
 
 extern "C" {
 #include <minc2.h>
@@ -39,17 +42,30 @@ extern "C" {
 namespace itk
 {
 
+class MINCImageDataset;
+class MINCNetCDFFile;
+class MINCPyramidBuilder;
+class MINCReadAhead;
+
+// Invoked by MINCImageIO once the read statistics have been updated.
+itkEventMacro( MINCReadStatisticsEvent, UserEvent );
+
 /** \class MINCImageIO
  *
  * \author Leila Baghdadi
  * \brief Class that defines how to read MINC2 file format. Note,like
  * ITK, MINC2 is N dimensional and dimensions can be submitted in any 
- * arbitrary order. Here we make sure the dimensions are ordered as
- * xspace, yspace, zspace, time and vector_dimension and so on or
- * xfrequencey, yfrequency, zfrequency, tfrequency and
- * vector_dimension and so on
- * NOTE** This class only reads the regularly sampled dimensions as I
- * am not sure how to deal with "iregularly sampled" dimensions yet!
+ * arbitrary order. With UseCanonicalOrder on, we make sure the
+ * dimensions are ordered as xspace, yspace, zspace, time and
+ * vector_dimension and so on or xfrequencey, yfrequency, zfrequency,
+ * tfrequency and vector_dimension and so on; otherwise they are in
+ * file order.  Time may be sampled irregularly: the image then has
+ * the mean spacing of the frames, whose own times and widths are in
+ * the MetaDataDictionary.  A vector_dimension varying fastest holds
+ * the components of the pixels rather than being a dimension, and
+ * vector images are written that way.
+ * MINC1 (netCDF) files are read as they are stored, without libminc,
+ * with the same geometry and values as MINC2 files.
  * \ingroup IOFilters
  *
  */
@@ -69,16 +85,332 @@ public:
 
   /*-------- This part of the interface deals with reading data. ------ */
 
+  // Decided from the first bytes of the file; the MINC2 structure is
+  // checked only for HDF5 files without a MINC extension, and the
+  // netCDF header of MINC1 files for an image.  Answers are cached per
+  // file until its size or modification time changes.
   virtual bool CanReadFile(const char*);
+  static void ClearCanReadFileCache();
+
   virtual void ReadImageInformation();
   virtual void Read(void* buffer);
 
+  // Any hyperslab of a MINC2 file can be read, so streaming is
+  // supported.  The requested region is enlarged to the HDF5 chunk
+  // boundaries of the file, so that each chunk is decompressed only
+  // once per streamed piece.  With ChunkCacheAuto, it is not enlarged
+  // along the time dimension: frames are then read one at a time, the
+  // chunks they share being cached.
+  virtual bool CanStreamRead()
+  {
+    return true;
+  }
+
+  virtual ImageIORegion 
+  GenerateStreamableReadRegionFromRequestedRegion( const ImageIORegion& requested ) const;
+
+  // Resolution level to read.  Level 0 is the full-resolution image;
+  // MINC2 files may also hold successively lower-resolution copies.
+  // ReadImageInformation() reports the size, spacing and origin of the
+  // selected level, and Read() reads from it.  0 by default.
+  itkSetMacro( ResolutionLevel, unsigned int );
+  itkGetConstMacro( ResolutionLevel, unsigned int );
+
+  // Number of resolution levels in the file, including full
+  // resolution.  Valid after ReadImageInformation().
+  unsigned int GetNumberOfResolutionLevels() const
+  {
+    return m_NumberOfResolutionLevels;
+  }
+
+  // Read every SamplingFactor(i)-th voxel along dimension i of the
+  // image, or the mean of each block of that many voxels, so that a
+  // preview costs a fraction of the full image.  ReadImageInformation()
+  // reports the size (rounded down), spacing and origin of the
+  // sampled image, and Read() reads regions of it.  The stored image
+  // is read plane by plane along its slowest-varying dimension, each
+  // plane reduced as soon as it is read; the chunk cache keeps the
+  // chunks that planes share, so that each is decoded once.  Factors
+  // apply to the selected resolution level, along the dimensions in
+  // image order.  1 by default.
+  void SetSamplingFactor( unsigned int i, unsigned int factor );
+  unsigned int GetSamplingFactor( unsigned int i ) const;
+
+  //   SamplingNearest: the first voxel of each block, which stays
+  //                    where it is.
+  //   SamplingAverage: the mean real value of each block, placed at
+  //                    its centre.
+  // Label volumes are always sampled with SamplingNearest.
+  // SamplingNearest by default.
+  typedef enum { SamplingNearest = 0, SamplingAverage } SamplingModeType;
+  itkSetEnumMacro( SamplingMode, SamplingModeType );
+  itkGetEnumMacro( SamplingMode, SamplingModeType );
+
+  // Chunk size of dimension i as stored in the file; 1 if the image
+  // is not chunked.  Valid after ReadImageInformation().
+  unsigned int GetChunkSize( unsigned int i ) const;
+
+  // zlib level of the image as stored in the file, 0 if it is not
+  // compressed.  Valid after ReadImageInformation().
+  int GetStoredCompressionLevel() const
+  {
+    return m_StoredCompressionLevel;
+  }
+
+  // Read compressed files by inflating their chunks on several
+  // threads rather than through libminc.  The values read are
+  // identical either way.  On by default.
+  itkSetMacro( UseParallelDecompression, bool );
+  itkGetConstMacro( UseParallelDecompression, bool );
+  itkBooleanMacro( UseParallelDecompression );
+
+  // Read uncompressed files on several threads, each reading its own
+  // part of the file directly rather than through libminc.  Only files
+  // that HDF5 stores as plain bytes at known offsets qualify.  The
+  // values read are identical either way.  On by default.
+  itkSetMacro( UseParallelReading, bool );
+  itkGetConstMacro( UseParallelReading, bool );
+  itkBooleanMacro( UseParallelReading );
+
+  // After each Read(), read the next slab along the slowest-varying
+  // dimension in the background, as a streamed read will ask for it
+  // next.  The following Read() then only waits for what is left of
+  // it.  Only files read around HDF5 can be read ahead (see
+  // UseParallelReading).  Off by default.
+  itkSetMacro( UseReadAhead, bool );
+  itkGetConstMacro( UseReadAhead, bool );
+  itkBooleanMacro( UseReadAhead );
+
+  // Map uncompressed, contiguously stored images into memory and read
+  // them from there, so that processes reading the same file share its
+  // pages.  Takes effect at the next ReadImageInformation().  On by
+  // default.
+  itkSetMacro( UseMemoryMapping, bool );
+  itkGetConstMacro( UseMemoryMapping, bool );
+  itkBooleanMacro( UseMemoryMapping );
+
+  // Keep the header read by ReadImageInformation() in the
+  // MINCHeaderCache, and take it from there when the file has not
+  // changed, so that the file is only opened once Read() is called.
+  // Records depend on ResolutionLevel, RequestedComponentType,
+  // UseCompactLabels, UseCanonicalOrder and the sampling, and are
+  // stored again when these change.  Off by default.
+  itkSetMacro( UseHeaderCache, bool );
+  itkGetConstMacro( UseHeaderCache, bool );
+  itkBooleanMacro( UseHeaderCache );
+
+  // The stored voxels of the whole image (or selected resolution
+  // level), in place in the mapped file, in file order; 0 unless the
+  // file is mapped (see UseMemoryMapping) and in native byte order.
+  // With UseRawVoxels, or when the stored type is the component type
+  // and the scaling is the identity, this is the image itself, read
+  // without any copy.  Valid until the next ReadImageInformation().
+  // A header taken from the header cache leaves the file closed: the
+  // mapping is then there only after the first Read().
+  const void* GetMappedBuffer() const;
+
+  // Chunk cache used when reading chunked files.  Chunks are decoded
+  // whole, so a read that covers part of a chunk (a slice of a chunk
+  // several slices thick, say) only avoids decoding it again on the
+  // next read if it is cached.
+  //   ChunkCacheDefault: the defaults of HDF5, and no decoded chunks
+  //                      kept between the reads made around HDF5.
+  //   ChunkCacheManual:  ChunkCacheSize bytes and ChunkCacheSlots
+  //                      hash slots.
+  //   ChunkCacheAuto:    sized before each Read() to hold the layer of
+  //                      chunks that the IORegion cuts across the
+  //                      slowest-varying dimension it does not span,
+  //                      so that streaming slab by slab, or reading
+  //                      frame by frame, decodes each chunk once.
+  // ChunkCachePolicy is the preemption policy w0 of HDF5 in [0, 1]:
+  // the larger, the sooner chunks whose voxels have all been read are
+  // evicted.  ChunkCacheDefault by default.
+  typedef enum { ChunkCacheDefault = 0, ChunkCacheManual, ChunkCacheAuto } ChunkCacheModeType;
+  itkSetEnumMacro( ChunkCacheMode, ChunkCacheModeType );
+  itkGetEnumMacro( ChunkCacheMode, ChunkCacheModeType );
+  itkSetMacro( ChunkCacheSize, size_t );
+  itkGetConstMacro( ChunkCacheSize, size_t );
+  itkSetMacro( ChunkCacheSlots, size_t );
+  itkGetConstMacro( ChunkCacheSlots, size_t );
+  itkSetClampMacro( ChunkCachePolicy, double, 0.0, 1.0 );
+  itkGetConstMacro( ChunkCachePolicy, double );
+
+  // Component type reported by ReadImageInformation() and read into
+  // by Read(), whatever the type stored.  Voxels are converted to it
+  // as they are read, in a single pass: ImageFileReader then reads
+  // straight into its image, with no buffer of the stored type nor
+  // ConvertPixelBuffer() pass.  Integer types are clamped to their
+  // range and rounded.  The default, UNKNOWNCOMPONENTTYPE, is the type
+  // stored.  Compact labels keep their own type.  Takes effect at the
+  // next ReadImageInformation().
+  itkSetEnumMacro( RequestedComponentType, IOComponentType );
+  itkGetEnumMacro( RequestedComponentType, IOComponentType );
+
+  // Read the stored voxel values without converting them to real
+  // values.  The real value of voxel v in slice s is
+  //   v * slope[s] + intercept[s]
+  // where slope and intercept are the std::vector<double> entries
+  // "MINC_RescaleSlope" and "MINC_RescaleIntercept" of the
+  // MetaDataDictionary.  They hold a single value when the whole
+  // volume shares one scaling.  Off by default.
+  itkSetMacro( UseRawVoxels, bool );
+  itkGetConstMacro( UseRawVoxels, bool );
+  itkBooleanMacro( UseRawVoxels );
+
+  // Label volumes (MI_CLASS_LABEL) are read as the integers stored,
+  // never scaled nor converted, so that reading a mapped file is a
+  // copy.  Their label table is in the MetaDataDictionary, sorted by
+  // value: "MINC_LabelValues" (std::vector<int>) and "MINC_LabelNames"
+  // (std::vector<std::string>).  Write() with WriteLabels on stores
+  // the table it finds there.  Valid after ReadImageInformation().
+  bool IsLabelImage() const
+  {
+    return m_StoredDataClass == MI_CLASS_LABEL;
+  }
+
+  // Read label volumes as compact labels: voxel value i stands for
+  // the stored value GetCompactLabelValues()[i], these being the
+  // values of the label table and 0, sorted.  The component type is
+  // then UCHAR or USHORT, whichever holds them all.  Label volumes
+  // with more labels or without a label table are read as stored.
+  // Read() throws if a voxel is not in the table.  UseRawVoxels does
+  // not apply to compact labels.  Takes effect at the next
+  // ReadImageInformation().  Off by default.
+  itkSetMacro( UseCompactLabels, bool );
+  itkGetConstMacro( UseCompactLabels, bool );
+  itkBooleanMacro( UseCompactLabels );
+
+  // Stored value of each compact label, also the std::vector<int>
+  // entry "MINC_CompactLabelValues" of the MetaDataDictionary; empty
+  // unless labels are compacted.  Valid after ReadImageInformation().
+  const std::vector<int>& GetCompactLabelValues() const
+  {
+    return m_CompactLabelValues;
+  }
+
+  // Order the dimensions as the class description says, rather than
+  // as they are stored: xspace (or xfrequency), yspace, zspace, time,
+  // vector_dimension, then any others in file order.  Read() then
+  // reorders the voxels of each region as it reads them.  Takes effect
+  // at the next ReadImageInformation().  Off by default.
+  itkSetMacro( UseCanonicalOrder, bool );
+  itkGetConstMacro( UseCanonicalOrder, bool );
+  itkBooleanMacro( UseCanonicalOrder );
+
+  // File dimension that is dimension i of the image.  Slice indices in
+  // the MetaDataDictionary count slices in file order.  Valid after
+  // ReadImageInformation().
+  unsigned int GetFileDimension( unsigned int i ) const;
+
+  // Image dimension along time ("time" or "tfrequency"), or -1 if
+  // there is none.  The time and width of each frame are the
+  // std::vector<double> entries "MINC_FrameTimes" and
+  // "MINC_FrameWidths" of the MetaDataDictionary, empty without a time
+  // dimension.  Valid after ReadImageInformation().
+  int GetTimeDimension() const;
+
+  // Number of frames along the time dimension; 1 if there is none.
+  unsigned long GetNumberOfFrames() const;
+
+  // Read a single frame into buffer: the whole image, but only frame
+  // along the time dimension.  Only the chunks holding the frame are
+  // decoded; with ChunkCacheAuto, those it shares with the next frames
+  // are kept for them.  Sets the IORegion.
+  void ReadFrame( unsigned long frame, void* buffer );
+
+  // Count the work done by ReadImageInformation() and Read(): bytes
+  // requested and read, chunks read, decompressed or found in the
+  // chunk cache, and the time spent opening, reading metadata, reading
+  // and converting (see MINCReadStatistics).  The counts are kept per
+  // instance and for all instances together.  While this is on, each
+  // Read() also invokes a ProgressEvent as it starts and ends, and
+  // both calls a MINCReadStatisticsEvent once the counts are updated.
+  // Off by default, so that reading pays nothing for it.
+  itkSetMacro( CollectReadStatistics, bool );
+  itkGetConstMacro( CollectReadStatistics, bool );
+  itkBooleanMacro( CollectReadStatistics );
+
+  const MINCReadStatistics& GetReadStatistics() const
+  {
+    return m_ReadStatistics;
+  }
+
+  void ResetReadStatistics()
+  {
+    m_ReadStatistics.Reset();
+  }
+
+  static MINCReadStatistics GetGlobalReadStatistics();
+  static void ResetGlobalReadStatistics();
+
+  // Number of threads used to read, compress or decompress chunks.
+  itkSetClampMacro( NumberOfThreads, int, 1, ITK_MAX_THREADS );
+  itkGetConstMacro( NumberOfThreads, int );
+
   /*-------- This part of the interfaces deals with writing data. ----- */
 
   virtual bool CanWriteFile(const char*);
   virtual void WriteImageInformation();
   virtual void Write(const void* buffer);
 
+  // Streamed writing is supported.  When UseStreamedWriting is on,
+  // the pieces are slabs of whole slices along the slowest-varying
+  // dimension, aligned to chunk boundaries.
+  virtual bool CanStreamWrite()
+  {
+    return true;
+  }
+
+  virtual unsigned int 
+  GetActualNumberOfSplitsForWriting( unsigned int numberOfRequestedSplits,
+				     const ImageIORegion& pasteRegion,
+				     const ImageIORegion& largestPossibleRegion );
+
+  virtual ImageIORegion 
+  GetSplitRegionForWriting( unsigned int ithPiece,
+			    unsigned int numberOfActualSplits,
+			    const ImageIORegion& pasteRegion,
+			    const ImageIORegion& largestPossibleRegion );
+
+  // Number of lower resolution levels written along with the image,
+  // each half the size of the one before (see ResolutionLevel).  They
+  // are computed from the pieces as they are written, which must then
+  // span every dimension but the slowest-varying one.  0 by default.
+  itkSetMacro( NumberOfPyramidLevels, unsigned int );
+  itkGetConstMacro( NumberOfPyramidLevels, unsigned int );
+
+  // Write a label volume (MI_CLASS_LABEL) rather than real values.
+  // The component type must be an integer type, stored as is.  Off by
+  // default.
+  itkSetMacro( WriteLabels, bool );
+  itkGetConstMacro( WriteLabels, bool );
+  itkBooleanMacro( WriteLabels );
+
+  // Downsampling of label volumes for the pyramid levels: the most
+  // frequent label of each block, or its first voxel.  Real-valued
+  // volumes are averaged.
+  typedef enum { LabelMode = 0, LabelNearest } LabelDownsamplingType;
+  itkSetEnumMacro( LabelDownsampling, LabelDownsamplingType );
+  itkGetEnumMacro( LabelDownsampling, LabelDownsamplingType );
+
+  // Component type stored in the files written.  The default,
+  // UNKNOWNCOMPONENTTYPE, stores the image's own component type.  An
+  // integer type other than the image's is written with per-slice
+  // scaling, computed from each piece as it is written.
+  itkSetEnumMacro( FileComponentType, IOComponentType );
+  itkGetEnumMacro( FileComponentType, IOComponentType );
+
+  // Chunk size of dimension i in the files written.  A size of 0 (the
+  // default) uses libminc's default of 32, or less if the dimension
+  // is shorter.
+  void SetWriteChunkSize( unsigned int i, unsigned int size );
+  unsigned int GetWriteChunkSize( unsigned int i ) const;
+
+  // zlib compression level used when UseCompression is on.  Chunks
+  // are compressed on NumberOfThreads threads.
+  itkSetClampMacro( CompressionLevel, int, 1, 9 );
+  itkGetConstMacro( CompressionLevel, int );
+
   /*-------- This part of the interfaces deals with other stuff. ----- */
 
   virtual bool SupportsDimension( unsigned long dim )
@@ -101,6 +433,11 @@ private:
   // Calls: SetPixelType(), SetComponentType(), SetNumberOfComponents().
   void ReadPixelInformation();
 
+  // Read the label table of a label volume into the
+  // MetaDataDictionary and, with UseCompactLabels, set the component
+  // type of the compact labels.
+  void ReadLabelInformation();
+
   // Set image shape information (dimensions, size of each dimension)
   // from the file.
   // Calls: SetNumberOfDimensions(), SetDimensions().
@@ -111,19 +448,324 @@ private:
   // Calls: SetOrigin(), SetSpacing(), SetDirection()
   void ReadImageToWorldInformation();
 
-  void SetDirectionFromCosines( unsigned int i, double cosines[3] );
+  // Set the time and width of each frame from the file, and store
+  // them in the MetaDataDictionary.
+  void ReadTimeInformation();
 
-  // Close cached MINC file handle, if open.
+  // Create the MINC dimensions of the image to be written: names,
+  // sizes, spacing, origin and direction cosines, then the
+  // vector_dimension if m_VectorComponents is set.
+  void CreateDimensions( midimhandle_t dimensions[] );
+
+  // Chunk size of dimension i in the file written.
+  unsigned int ComputeWriteChunkSize( unsigned int i ) const;
+
+  // Convert a piece to the stored data type.  With slice scaling, the
+  // range of each slice in the piece is recorded for FinishWriting().
+  void ScaleSlicesForWriting( const unsigned long starts[],
+			      const unsigned long sizes[],
+			      const void* buffer,
+			      void* stored );
+
+  // Add the rows of a piece to the pyramid levels.
+  void AddPieceToPyramid( const unsigned long starts[],
+			  const unsigned long sizes[],
+			  const void* buffer );
+
+  // Store the slice ranges and close the file.
+  void FinishWriting();
+
+  // Replace the full-resolution size, spacing and origin by those of
+  // the selected resolution level.
+  void ApplyResolutionLevel();
+
+  // Set the chunk size of each dimension from the file.
+  void ReadChunkInformation();
+
+  // Reorder the shape, geometry and chunk sizes read in file order
+  // into canonical order, if UseCanonicalOrder is on, and set
+  // m_FileAxis.
+  void ApplyCanonicalOrder();
+
+  // Shrink the size, spacing, origin, chunk size and frames of each
+  // image dimension by its sampling factor, and set
+  // m_FileSamplingFactor and m_StoredSize.
+  void ApplySampling();
+
+  // Whether any dimension is sampled.
+  bool IsSampled() const;
+
+  // Read the IORegion into buffer.
+  void ReadRegion( void* buffer );
+
+  // Read a hyperslab of the sampled image in file order, one plane
+  // along dimension 0 at a time.  Without sampling, this is
+  // ReadHyperslab().
+  void ReadSampledHyperslab( const unsigned long starts[],
+			     const unsigned long sizes[],
+			     void* buffer );
+
+  // Statistics of the ReadImageInformation() or Read() in progress,
+  // or 0 if they are not collected.
+  MINCReadStatistics* GetCurrentStatistics()
+  {
+    return m_CollectReadStatistics ? &m_CurrentStatistics : 0;
+  }
+
+  // Add the statistics of the call in progress to those of this
+  // instance and to the global ones, and tell the observers.
+  void CommitStatistics();
+
+  // Count the stored voxels of a hyperslab as read from the file.
+  void CountBytesRead( const unsigned long sizes[] );
+
+  // Read a hyperslab in file order, as Read() does.  The hyperslabs
+  // passed to the methods below span every dimension of the file,
+  // including the vector dimension.
+  void ReadHyperslab( const unsigned long starts[],
+		      const unsigned long sizes[],
+		      void* buffer );
+
+  // Number of dimensions of the file: those of the image, and the
+  // vector dimension if there is one.
+  unsigned int GetNumberOfFileDimensions() const
+  {
+    return m_FileDimensions.size();
+  }
+
+  // Set the voxel-to-real mapping of each slice from the file.
+  void ReadScalingInformation();
+
+  // Store m_RescaleSlope and m_RescaleIntercept in the
+  // MetaDataDictionary.
+  void EncapsulateScalingInformation();
+
+  // Whether reads of the stored voxels go through m_Dataset, on
+  // several threads, rather than through libminc.
+  bool CanReadThroughDataset() const;
+
+  // Read stored voxels through m_Dataset straight into buffer.
+  // Returns false if the dataset cannot be used for this read.
+  bool ReadRawVoxelsFromDataset( const unsigned long starts[],
+				 const unsigned long sizes[],
+				 void* buffer );
+
+  // Read the stored voxels of a hyperslab and map them to real
+  // values with RescaleVoxels(), or only convert them if unscaled is
+  // set.  Returns false if the stored type cannot be rescaled here,
+  // leaving the read to libminc.
+  bool ReadAndRescaleVoxels( const unsigned long starts[],
+			     const unsigned long sizes[],
+			     void* buffer,
+			     bool unscaled = false );
+
+  // The stored voxels of a hyperslab in place in the mapped file, or 0
+  // if they cannot be used as they are.
+  const void* GetMappedStoredVoxels( const unsigned long starts[],
+				     const unsigned long sizes[] ) const;
+
+  // Read stored voxels through m_Dataset, or take them from the read
+  // ahead, then start reading the next slab ahead.
+  bool ReadFromDataset( const unsigned long starts[],
+			const unsigned long sizes[],
+			void* stored );
+
+  // Set the chunk cache of m_Dataset for reading (starts, sizes),
+  // according to ChunkCacheMode.
+  void ConfigureChunkCache( const unsigned long starts[],
+			    const unsigned long sizes[] );
+
+  // Start reading the slab after (starts, sizes) in the background,
+  // if UseReadAhead is on.
+  void StartReadAhead( const unsigned long starts[],
+		       const unsigned long sizes[] );
+
+  // Read the stored voxels of a hyperslab through m_Dataset.
+  // Returns false if this is not possible.
+  bool ReadChunksInParallel( const unsigned long starts[],
+			     const unsigned long sizes[],
+			     void* stored );
+
+  // Map the stored voxels of a hyperslab to real values of the
+  // component type, slice by slice, or compact labels to their index;
+  // with unscaled set, only convert them to the component type.  The
+  // stored voxels may occupy the end of the output buffer.
+  void RescaleVoxels( const unsigned long starts[],
+		      const unsigned long sizes[],
+		      const void* stored,
+		      void* buffer,
+		      bool unscaled = false ) const;
+
+  // Open the MINC file for reading, and its image dataset at the
+  // selected resolution level, and set m_FileDimensions.  MINC1 files
+  // are opened as m_NetCDFFile instead.
+  void OpenVolume();
+
+  // Set m_FileDimensions from the dimension handles of m_Volume, or
+  // from the header of m_NetCDFFile.  The latter returns false if the
+  // file has no image.
+  void ReadVolumeDimensions( const std::vector<midimhandle_t>& dimensions );
+  bool ReadNetCDFDimensions();
+
+  // Valid range and range of each slice (or of the whole image) of a
+  // MINC1 file.  Returns false if the ranges do not match the image.
+  bool ReadNetCDFScaling( double& validMin, double& validMax,
+			  std::vector<double>& imageMin,
+			  std::vector<double>& imageMax ) const;
+
+  // Read the stored voxels of a hyperslab of m_NetCDFFile, converted
+  // to the component type but not scaled.
+  void ReadRawVoxelsFromNetCDF( const unsigned long starts[],
+				const unsigned long sizes[],
+				void* buffer );
+
+  // Release the MINC file handle, if held.
   void CloseVolume();
 
-  // MINC file handle, cached between calls to ReadImageInformation()
-  // and Read().  The flag m_VolumeValid indicates whether the handle
-  // is valid.
+  // The settings a cached header depends on.
+  std::string GetHeaderCacheKey() const;
+
+  // Everything ReadImageInformation() sets, as a header cache record,
+  // and back.  RestoreHeader() returns false if the record does not
+  // make sense.
+  std::string SaveHeader() const;
+  bool RestoreHeader( const std::string& record );
+
+  // MINC file handle, held from ReadImageInformation() on and shared
+  // through MINCVolumeCache under m_VolumeID, whose lock is held while
+  // libminc uses it.  The flag m_VolumeValid indicates whether the
+  // handle is valid.
   mihandle_t m_Volume;
+  unsigned long m_VolumeID;
   bool m_VolumeValid;
 
-  // Set as a side-effect of ReadShapeInformation().
-  midimhandle_t* m_VolumeDimension;
+  // MINC1 file, read without libminc, held instead of m_Volume.
+  MINCNetCDFFile* m_NetCDFFile;
+
+  // What is read of each dimension of the file, in file order, from
+  // m_Volume or m_NetCDFFile alike.  The start and step are in file
+  // order; an irregularly sampled dimension has the mean step between
+  // its samples.  Samples (the time and width of each) are kept for
+  // time dimensions only.  The flags tell which could be read.
+  struct FileDimension
+  {
+    std::string name;
+    midimclass_t dimClass;
+    unsigned long size;
+    bool hasSampling;
+    double start;
+    double step;
+    bool hasCosines;
+    double cosines[3];
+    bool hasSamples;
+    std::vector<double> offsets;
+    std::vector<double> widths;
+  };
+  std::vector<FileDimension> m_FileDimensions;
+
+  // Whether the last dimension of the file read or written is a
+  // vector_dimension holding the components of each pixel.
+  bool m_VectorComponents;
+
+  // File dimension along time, or -1, and the time and width of each
+  // of its frames.
+  int m_TimeFileDimension;
+  std::vector<double> m_FrameTimes;
+  std::vector<double> m_FrameWidths;
+
+  unsigned int m_ResolutionLevel;
+  unsigned int m_NumberOfResolutionLevels;
+
+  // Chunk size of each dimension and compression level of the image,
+  // set by ReadChunkInformation().
+  std::vector<unsigned int> m_ChunkSize;
+  int m_StoredCompressionLevel;
+
+  // Dimension i of the image is dimension m_FileAxis[i] of the file.
+  std::vector<unsigned int> m_FileAxis;
+
+  // Sampling factors as set, in image order; the factor of each file
+  // dimension, all 1 without sampling; and the size of each file
+  // dimension before sampling.
+  std::vector<unsigned int> m_SamplingFactor;
+  SamplingModeType m_SamplingMode;
+  std::vector<unsigned int> m_FileSamplingFactor;
+  std::vector<unsigned long> m_StoredSize;
+
+  // Data type and class of the voxels in the file, set by
+  // ReadPixelInformation().
+  mitype_t m_StoredDataType;
+  miclass_t m_StoredDataClass;
+
+  // Label table of a label volume, sorted by value, and the stored
+  // value of each compact label.
+  std::vector<int> m_LabelValues;
+  std::vector<std::string> m_LabelNames;
+  std::vector<int> m_CompactLabelValues;
+
+  // Real value of a stored voxel v in slice s is 
+  //   v * m_RescaleSlope[s] + m_RescaleIntercept[s].
+  // A single entry applies to all slices.  Slices are indexed by all
+  // but the two fastest-varying dimensions.
+  std::vector<double> m_RescaleSlope;
+  std::vector<double> m_RescaleIntercept;
+
+  // Direct access to the image dataset, opened alongside m_Volume.
+  MINCImageDataset* m_Dataset;
+
+  // Background read of the next slab, and the buffer its voxels are
+  // taken into.
+  MINCReadAhead* m_ReadAhead;
+  std::vector<char> m_ReadAheadBuffer;
+
+  bool m_UseParallelDecompression;
+  bool m_UseParallelReading;
+  bool m_UseReadAhead;
+  bool m_UseMemoryMapping;
+  bool m_UseHeaderCache;
+  bool m_UseRawVoxels;
+  bool m_UseCanonicalOrder;
+  bool m_UseCompactLabels;
+  IOComponentType m_RequestedComponentType;
+  bool m_CollectReadStatistics;
+  int m_NumberOfThreads;
+  ChunkCacheModeType m_ChunkCacheMode;
+  size_t m_ChunkCacheSize;
+  size_t m_ChunkCacheSlots;
+  double m_ChunkCachePolicy;
+
+  // Counts of all the calls so far, and of the call in progress
+  MINCReadStatistics m_ReadStatistics;
+  MINCReadStatistics m_CurrentStatistics;
+  RealTimeClock::Pointer m_Clock;
+
+  // Write options
+  std::vector<unsigned int> m_WriteChunkSize;
+  int m_CompressionLevel;
+  IOComponentType m_FileComponentType;
+  unsigned int m_NumberOfPyramidLevels;
+  bool m_WriteLabels;
+  LabelDownsamplingType m_LabelDownsampling;
+
+  // Lower resolution levels being written
+  MINCPyramidBuilder* m_PyramidBuilder;
+
+  // Thickness of the slabs written, set by
+  // GetActualNumberOfSplitsForWriting().
+  unsigned long m_WriteSlabThickness;
+
+  // Whether voxels are scaled into the range of the stored type, with
+  // a range for each slice or, without slice scaling, for the whole
+  // image.  The ranges are those of the voxels written.
+  bool m_WriteScaling;
+  bool m_WriteSliceScaling;
+  std::vector<double> m_WriteImageMin;
+  std::vector<double> m_WriteImageMax;
+
+  // Set by WriteImageInformation(); the file is closed once every
+  // pixel has been written.
+  bool m_WritingVolume;
+  unsigned long m_NumberOfPixelsWritten;
 };
 
 } // end namespace itk
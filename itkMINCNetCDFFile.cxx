@@ -0,0 +1,643 @@
+#include "itkMINCNetCDFFile.h"
+
+#include "itkMultiThreader.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+
+
+
+namespace itk {
+
+
+namespace {
+
+// Tags of the lists in a header
+const unsigned int TagDimension = 0x0A;
+const unsigned int TagVariable = 0x0B;
+const unsigned int TagAttribute = 0x0C;
+
+// Number of records of a file still being written
+const unsigned int StreamingRecords = 0xFFFFFFFFu;
+
+// Bytes read for the header at first; longer headers are read again,
+// whole.  MINC1 headers are a few kilobytes.
+const size_t InitialHeaderBytes = 64 << 10;
+
+// Largest read issued at once, so that the work can be shared out
+// even when the hyperslab is a single run of the file.
+const size_t MaximumSegmentBytes = 4 << 20;
+
+bool IsBigEndianHost()
+{
+  const unsigned short one = 1;
+  return *reinterpret_cast<const unsigned char*>( &one ) == 0;
+}
+
+void SwapComponents( char* data, size_t numBytes, size_t componentSize )
+{
+  for( size_t i = 0; i + componentSize <= numBytes; i += componentSize )
+    {
+    std::reverse( data + i, data + i + componentSize );
+    }
+}
+
+/**
+ * Big-endian fields of a header, each padded to 4 bytes.  A field
+ * past the end of the bytes read fails and marks the header as
+ * truncated.
+ */
+class HeaderCursor
+{
+public:
+  HeaderCursor( const char* data, size_t numBytes )
+    : m_Data( data ), m_Size( numBytes ), m_Position( 0 ), m_Truncated( false )
+  {
+  }
+
+  bool ReadUInt( unsigned int& value )
+  {
+    const char* bytes;
+    if ( ! this->Take( 4, bytes ) )
+      return false;
+    const unsigned char* u = reinterpret_cast<const unsigned char*>( bytes );
+    value = ( static_cast<unsigned int>( u[0] ) << 24 ) | ( u[1] << 16 ) | ( u[2] << 8 ) | u[3];
+    return true;
+  }
+
+  // An offset is 4 bytes long, or 8 in the 64-bit offset variant
+  bool ReadOffset( bool wide, unsigned long long& value )
+  {
+    unsigned int high = 0, low;
+    if ( ( wide && ! this->ReadUInt( high ) ) || ! this->ReadUInt( low ) )
+      return false;
+    value = ( static_cast<unsigned long long>( high ) << 32 ) | low;
+    return true;
+  }
+
+  bool ReadBytes( size_t numBytes, std::string& bytes )
+  {
+    const char* data;
+    if ( ! this->Take( numBytes + ( 4 - numBytes % 4 ) % 4, data ) )
+      return false;
+    bytes.assign( data, numBytes );
+    return true;
+  }
+
+  bool ReadName( std::string& name )
+  {
+    unsigned int length;
+    return this->ReadUInt( length ) && this->ReadBytes( length, name );
+  }
+
+  bool IsTruncated() const
+  {
+    return m_Truncated;
+  }
+
+private:
+  bool Take( size_t numBytes, const char*& data )
+  {
+    if ( numBytes > m_Size - m_Position )
+      {
+      m_Truncated = true;
+      return false;
+      }
+    data = m_Data + m_Position;
+    m_Position += numBytes;
+    return true;
+  }
+
+  const char* m_Data;
+  size_t m_Size;
+  size_t m_Position;
+  bool m_Truncated;
+};
+
+template <class T>
+double ValueOf( const char* bytes )
+{
+  T value;
+  std::memcpy( &value, bytes, sizeof( T ) );
+  return value;
+}
+
+/**
+ * Convert count values of a numeric type, big-endian if swap is set,
+ * to doubles.
+ */
+bool ConvertValues( MINCNetCDFFile::DataType type, const char* data, size_t count,
+		    bool swap, std::vector<double>& values )
+{
+  const size_t size = MINCNetCDFFile::GetTypeSize( type );
+  values.resize( count );
+  for( size_t i = 0; i < count; ++i )
+    {
+    char bytes[8];
+    std::memcpy( bytes, data + i * size, size );
+    if ( swap )
+      std::reverse( bytes, bytes + size );
+
+    switch( type )
+      {
+      case MINCNetCDFFile::Byte:
+	values[i] = ValueOf<signed char>( bytes );
+	break;
+      case MINCNetCDFFile::Short:
+	values[i] = ValueOf<short>( bytes );
+	break;
+      case MINCNetCDFFile::Int:
+	values[i] = ValueOf<int>( bytes );
+	break;
+      case MINCNetCDFFile::Float:
+	values[i] = ValueOf<float>( bytes );
+	break;
+      case MINCNetCDFFile::Double:
+	values[i] = ValueOf<double>( bytes );
+	break;
+      default:
+	return false;
+      }
+    }
+  return true;
+}
+
+/**
+ * Pieces of a variable read straight into the hyperslab buffer.
+ * Each thread reads a consecutive run of segments, so the file is
+ * read in a few long sequential streams.
+ */
+struct SegmentRead
+{
+  const MINCRawFile* file;
+  std::vector<unsigned long long> addresses;
+  std::vector<size_t> offsets;
+  std::vector<size_t> bytes;
+  char* output;
+  size_t typeSize;
+  bool swapBytes;
+
+  // Set by a worker thread that fails to read
+  std::vector<int> failed;
+
+  void Add( unsigned long long address, size_t numBytes, size_t offset )
+  {
+    // Runs that follow each other in the file are read together
+    if ( ! addresses.empty() && addresses.back() + bytes.back() == address
+	 && bytes.back() + numBytes <= MaximumSegmentBytes )
+      {
+      bytes.back() += numBytes;
+      return;
+      }
+
+    while( numBytes > 0 )
+      {
+      const size_t segmentBytes = std::min( numBytes, MaximumSegmentBytes );
+      addresses.push_back( address );
+      offsets.push_back( offset );
+      bytes.push_back( segmentBytes );
+      address += segmentBytes;
+      offset += segmentBytes;
+      numBytes -= segmentBytes;
+      }
+  }
+};
+
+ITK_THREAD_RETURN_TYPE ReadSegmentsThreadCallback( void* arg )
+{
+  MultiThreader::ThreadInfoStruct* info
+    = static_cast<MultiThreader::ThreadInfoStruct*>( arg );
+  SegmentRead* read = static_cast<SegmentRead*>( info->UserData );
+
+  const size_t numSegments = read->addresses.size();
+  const size_t first = numSegments * info->ThreadID / info->NumberOfThreads;
+  const size_t last = numSegments * ( info->ThreadID + 1 ) / info->NumberOfThreads;
+
+  for( size_t i = first; i < last; ++i )
+    {
+    char* out = read->output + read->offsets[i];
+    if ( ! read->file->Read( read->addresses[i], read->bytes[i], out ) )
+      {
+      read->failed[info->ThreadID] = 1;
+      break;
+      }
+    if ( read->swapBytes )
+      SwapComponents( out, read->bytes[i], read->typeSize );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+} // end of unnamed namespace
+
+
+MINCNetCDFFile::MINCNetCDFFile()
+  : m_FileSize( 0 ),
+    m_RecordDimension( -1 ),
+    m_RecordSize( 0 )
+{
+}
+
+MINCNetCDFFile::~MINCNetCDFFile()
+{
+  this->Close();
+}
+
+size_t MINCNetCDFFile::GetTypeSize( DataType type )
+{
+  switch( type )
+    {
+    case Byte:
+    case Char:
+      return 1;
+    case Short:
+      return 2;
+    case Int:
+    case Float:
+      return 4;
+    case Double:
+      return 8;
+    default:
+      return 0;
+    }
+}
+
+bool MINCNetCDFFile::Open( const char* filename )
+{
+  this->Close();
+
+  struct stat status;
+  if ( stat( filename, &status ) != 0 || ! m_File.Open( filename ) )
+    return false;
+  m_FileSize = status.st_size;
+
+  // Headers longer than the first read are read again, whole
+  std::vector<char> header( static_cast<size_t>( std::min<unsigned long long>( InitialHeaderBytes, m_FileSize ) ) );
+  for( ;; )
+    {
+    bool truncated = false;
+    if ( ! header.empty() && m_File.Read( 0, header.size(), &header[0] )
+	 && this->ParseHeader( &header[0], header.size(), truncated ) )
+      {
+      return true;
+      }
+
+    if ( ! truncated || header.size() >= m_FileSize )
+      break;
+    header.resize( static_cast<size_t>( std::min<unsigned long long>( 4 * header.size(), m_FileSize ) ) );
+    }
+
+  this->Close();
+  return false;
+}
+
+void MINCNetCDFFile::Close()
+{
+  m_File.Close();
+  m_FileSize = 0;
+  m_Dimensions.clear();
+  m_Variables.clear();
+  m_RecordDimension = -1;
+  m_RecordSize = 0;
+}
+
+bool MINCNetCDFFile::ParseHeader( const char* header, size_t numBytes, bool& truncated )
+{
+  m_Dimensions.clear();
+  m_Variables.clear();
+  m_RecordDimension = -1;
+  m_RecordSize = 0;
+
+  HeaderCursor cursor( header, numBytes );
+
+  std::string magic;
+  unsigned int numRecords;
+  if ( ! cursor.ReadBytes( 4, magic ) || magic.compare( 0, 3, "CDF" ) != 0
+       || ( magic[3] != 1 && magic[3] != 2 ) || ! cursor.ReadUInt( numRecords ) )
+    {
+    truncated = cursor.IsTruncated();
+    return false;
+    }
+  const bool wideOffsets = magic[3] == 2;
+
+  // Each list is a tag and a count, or two zeros when it is empty
+  unsigned int tag, count;
+
+  if ( ! cursor.ReadUInt( tag ) || ! cursor.ReadUInt( count )
+       || ( tag != TagDimension && ( tag != 0 || count != 0 ) ) )
+    {
+    truncated = cursor.IsTruncated();
+    return false;
+    }
+  for( unsigned int i = 0; i < count; ++i )
+    {
+    Dimension dimension;
+    unsigned int size;
+    if ( ! cursor.ReadName( dimension.name ) || ! cursor.ReadUInt( size ) )
+      {
+      truncated = cursor.IsTruncated();
+      return false;
+      }
+    dimension.size = size;
+    if ( size == 0 )
+      {
+      if ( m_RecordDimension >= 0 )
+	return false;
+      m_RecordDimension = m_Dimensions.size();
+      }
+    m_Dimensions.push_back( dimension );
+    }
+
+  // Global attributes, then variables with their own
+  std::vector<Attribute> globalAttributes;
+  for( int list = 0; list < 2; ++list )
+    {
+    const unsigned int expectedTag = list == 0 ? TagAttribute : TagVariable;
+    if ( ! cursor.ReadUInt( tag ) || ! cursor.ReadUInt( count )
+	 || ( tag != expectedTag && ( tag != 0 || count != 0 ) ) )
+      {
+      truncated = cursor.IsTruncated();
+      return false;
+      }
+
+    for( unsigned int i = 0; i < count; ++i )
+      {
+      Variable variable;
+      std::vector<Attribute>& attributes = list == 0 ? globalAttributes : variable.attributes;
+
+      unsigned int numAttributes = 1;
+      if ( list == 1 )
+	{
+	unsigned int numDimensions;
+	if ( ! cursor.ReadName( variable.name ) || ! cursor.ReadUInt( numDimensions ) )
+	  {
+	  truncated = cursor.IsTruncated();
+	  return false;
+	  }
+	for( unsigned int d = 0; d < numDimensions; ++d )
+	  {
+	  unsigned int dimension;
+	  if ( ! cursor.ReadUInt( dimension ) )
+	    {
+	    truncated = cursor.IsTruncated();
+	    return false;
+	    }
+	  if ( dimension >= m_Dimensions.size()
+	       || ( static_cast<int>( dimension ) == m_RecordDimension && d > 0 ) )
+	    {
+	    return false;
+	    }
+	  variable.dimensions.push_back( dimension );
+	  }
+
+	if ( ! cursor.ReadUInt( tag ) || ! cursor.ReadUInt( numAttributes )
+	     || ( tag != TagAttribute && ( tag != 0 || numAttributes != 0 ) ) )
+	  {
+	  truncated = cursor.IsTruncated();
+	  return false;
+	  }
+	}
+
+      for( unsigned int a = 0; a < numAttributes; ++a )
+	{
+	Attribute attribute;
+	unsigned int type, numValues;
+	if ( ! cursor.ReadName( attribute.name )
+	     || ! cursor.ReadUInt( type ) || ! cursor.ReadUInt( numValues ) )
+	  {
+	  truncated = cursor.IsTruncated();
+	  return false;
+	  }
+	attribute.type = static_cast<DataType>( type );
+	attribute.count = numValues;
+	const size_t size = GetTypeSize( attribute.type );
+	if ( size == 0 )
+	  return false;
+	if ( numValues > numBytes / size )
+	  {
+	  truncated = true;
+	  return false;
+	  }
+	if ( ! cursor.ReadBytes( numValues * size, attribute.values ) )
+	  {
+	  truncated = cursor.IsTruncated();
+	  return false;
+	  }
+	attributes.push_back( attribute );
+	}
+
+      if ( list == 0 )
+	continue;
+
+      unsigned int type, vsize;
+      if ( ! cursor.ReadUInt( type ) || ! cursor.ReadUInt( vsize )
+	   || ! cursor.ReadOffset( wideOffsets, variable.begin ) )
+	{
+	truncated = cursor.IsTruncated();
+	return false;
+	}
+      variable.type = static_cast<DataType>( type );
+      if ( GetTypeSize( variable.type ) == 0 )
+	return false;
+      variable.record = ! variable.dimensions.empty()
+	&& static_cast<int>( variable.dimensions[0] ) == m_RecordDimension;
+      m_Variables.push_back( variable );
+      }
+    }
+
+  // A record holds one record of each record variable, each padded to
+  // 4 bytes unless there is only one.  The vsize of the header cannot
+  // be trusted for this: it overflows for large variables.
+  unsigned int numRecordVariables = 0;
+  unsigned long long recordBytes = 0;
+  unsigned long long firstRecord = m_FileSize;
+  for( size_t v = 0; v < m_Variables.size(); ++v )
+    {
+    const Variable& variable = m_Variables[v];
+    if ( ! variable.record )
+      continue;
+
+    recordBytes = GetTypeSize( variable.type );
+    for( size_t d = 1; d < variable.dimensions.size(); ++d )
+      recordBytes *= m_Dimensions[variable.dimensions[d]].size;
+    m_RecordSize += ( recordBytes + 3 ) / 4 * 4;
+    firstRecord = std::min( firstRecord, variable.begin );
+    ++numRecordVariables;
+    }
+  if ( numRecordVariables == 1 )
+    m_RecordSize = recordBytes;
+
+  // A file still being written counts its records as it goes
+  if ( m_RecordDimension >= 0 )
+    {
+    unsigned long long records = numRecords;
+    if ( numRecords == StreamingRecords )
+      records = m_RecordSize > 0 && m_FileSize > firstRecord ? ( m_FileSize - firstRecord ) / m_RecordSize : 0;
+    m_Dimensions[m_RecordDimension].size = static_cast<unsigned long>( records );
+    }
+
+  return true;
+}
+
+int MINCNetCDFFile::FindVariable( const std::string& name ) const
+{
+  for( size_t v = 0; v < m_Variables.size(); ++v )
+    {
+    if ( m_Variables[v].name == name )
+      return static_cast<int>( v );
+    }
+  return -1;
+}
+
+const MINCNetCDFFile::Attribute* MINCNetCDFFile::FindAttribute( int v, const std::string& name ) const
+{
+  if ( v < 0 || v >= static_cast<int>( m_Variables.size() ) )
+    return 0;
+
+  const std::vector<Attribute>& attributes = m_Variables[v].attributes;
+  for( size_t a = 0; a < attributes.size(); ++a )
+    {
+    if ( attributes[a].name == name )
+      return &attributes[a];
+    }
+  return 0;
+}
+
+bool MINCNetCDFFile::GetAttribute( int v, const std::string& name, std::vector<double>& values ) const
+{
+  const Attribute* attribute = this->FindAttribute( v, name );
+  return attribute && attribute->type != Char
+    && ConvertValues( attribute->type, attribute->values.data(), attribute->count,
+		      ! IsBigEndianHost(), values );
+}
+
+bool MINCNetCDFFile::GetAttribute( int v, const std::string& name, std::string& text ) const
+{
+  const Attribute* attribute = this->FindAttribute( v, name );
+  if ( ! attribute || attribute->type != Char )
+    return false;
+
+  // Some writers count the terminating null
+  text = attribute->values;
+  const std::string::size_type end = text.find_last_not_of( '\0' );
+  text.erase( end == std::string::npos ? 0 : end + 1 );
+  return true;
+}
+
+bool MINCNetCDFFile::ReadValues( int v, std::vector<double>& values ) const
+{
+  if ( v < 0 || v >= static_cast<int>( m_Variables.size() ) || m_Variables[v].type == Char )
+    return false;
+
+  const Variable& variable = m_Variables[v];
+  std::vector<unsigned long> starts( variable.dimensions.size() + 1, 0 );
+  std::vector<unsigned long> counts( variable.dimensions.size() + 1, 1 );
+  size_t count = 1;
+  for( size_t d = 0; d < variable.dimensions.size(); ++d )
+    {
+    counts[d] = m_Dimensions[variable.dimensions[d]].size;
+    count *= counts[d];
+    }
+
+  if ( count == 0 )
+    {
+    values.clear();
+    return true;
+    }
+
+  // Read as stored, then converted
+  std::vector<char> stored( count * GetTypeSize( variable.type ) );
+  return this->ReadHyperslab( v, &starts[0], &counts[0], &stored[0] )
+    && ConvertValues( variable.type, &stored[0], count, false, values );
+}
+
+bool MINCNetCDFFile::ReadHyperslab( int v,
+                                    const unsigned long starts[],
+                                    const unsigned long counts[],
+                                    void* buffer,
+                                    int numberOfThreads ) const
+{
+  if ( ! this->IsOpen() || v < 0 || v >= static_cast<int>( m_Variables.size() ) )
+    return false;
+
+  const Variable& variable = m_Variables[v];
+  const size_t typeSize = GetTypeSize( variable.type );
+  const unsigned int n = variable.dimensions.size();
+
+  // Bytes between successive indices along each dimension; records
+  // are a record apart
+  std::vector<unsigned long long> strides( n );
+  std::vector<unsigned long> sizes( n );
+  unsigned long long stride = typeSize;
+  for( int d = static_cast<int>( n ) - 1; d >= 0; --d )
+    {
+    sizes[d] = m_Dimensions[variable.dimensions[d]].size;
+    if ( counts[d] == 0 )
+      return true;
+    if ( starts[d] + counts[d] > sizes[d] )
+      return false;
+    strides[d] = ( d == 0 && variable.record ) ? m_RecordSize : stride;
+    stride *= sizes[d];
+    }
+
+  SegmentRead read;
+  read.file = &m_File;
+  read.output = static_cast<char*>( buffer );
+  read.typeSize = typeSize;
+  read.swapBytes = typeSize > 1 && ! IsBigEndianHost();
+
+  if ( n == 0 )
+    {
+    read.Add( variable.begin, typeSize, 0 );
+    }
+  else
+    {
+    // The hyperslab is a run of the file along the fastest dimension,
+    // and along slower ones for as long as those faster are read
+    // whole
+    int k = static_cast<int>( n ) - 1;
+    size_t runBytes = counts[k] * typeSize;
+    while( k > 0 && counts[k] == sizes[k] && strides[k - 1] == strides[k] * sizes[k] )
+      {
+      --k;
+      runBytes *= counts[k];
+      }
+
+    std::vector<unsigned long> index( starts, starts + k );
+    size_t offset = 0;
+    for( ;; )
+      {
+      unsigned long long address = variable.begin + starts[k] * strides[k];
+      for( int d = 0; d < k; ++d )
+	address += index[d] * strides[d];
+      read.Add( address, runBytes, offset );
+      offset += runBytes;
+
+      int d = k - 1;
+      for( ; d >= 0; --d )
+	{
+	if ( ++index[d] < starts[d] + counts[d] )
+	  break;
+	index[d] = starts[d];
+	}
+      if ( d < 0 )
+	break;
+      }
+    }
+
+  const int numThreads = static_cast<int>( std::min<size_t>( std::max( numberOfThreads, 1 ),
+							     read.addresses.size() ) );
+  read.failed.assign( numThreads, 0 );
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( numThreads );
+  threader->SetSingleMethod( ReadSegmentsThreadCallback, &read );
+  threader->SingleMethodExecute();
+
+  return std::find( read.failed.begin(), read.failed.end(), 1 ) == read.failed.end();
+}
+
+} // namespace itk
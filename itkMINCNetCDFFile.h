@@ -0,0 +1,166 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCNetCDFFile.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCNetCDFFile_h
+#define __itkMINCNetCDFFile_h
+
+#include "itkMINCRawFile.h"
+
+#include <string>
+#include <vector>
+
+
+namespace itk
+{
+
+/** \class MINCNetCDFFile
+ *
+ * \brief Read-only access to the variables of a netCDF classic file,
+ * the format of MINC1.
+ *
+ * libminc opens MINC1 files by converting them to MINC2 first, which
+ * rewrites the whole file before a voxel can be read.  A netCDF
+ * classic file is a header followed by the values of each variable,
+ * stored big-endian at an offset the header gives, so the header is
+ * parsed here and the values are read from where they are, on
+ * several threads (see MINCRawFile).  Both the 32-bit ("CDF\1") and
+ * 64-bit offset ("CDF\2") variants are read.
+ *
+ * Variables along the record (unlimited) dimension are stored one
+ * record at a time, the records of all such variables interleaved;
+ * reading them is no different.
+ *
+ * \ingroup IOFilters
+ */
+class MINCNetCDFFile
+{
+public:
+  // Types of the values of attributes and variables
+  typedef enum { Byte = 1, Char, Short, Int, Float, Double } DataType;
+
+  MINCNetCDFFile();
+  ~MINCNetCDFFile();
+
+  // Returns false if the file cannot be opened or is not a netCDF
+  // classic file.
+  bool Open( const char* filename );
+  void Close();
+
+  bool IsOpen() const
+  {
+    return m_File.IsOpen();
+  }
+
+  unsigned int GetNumberOfDimensions() const
+  {
+    return m_Dimensions.size();
+  }
+
+  const std::string& GetDimensionName( unsigned int d ) const
+  {
+    return m_Dimensions[d].name;
+  }
+
+  // The size of the record dimension is the number of records.
+  unsigned long GetDimensionSize( unsigned int d ) const
+  {
+    return m_Dimensions[d].size;
+  }
+
+  // Index of the variable named name, or -1 if there is none.
+  int FindVariable( const std::string& name ) const;
+
+  // Dimensions of variable v, slowest-varying first; empty for a
+  // scalar.
+  const std::vector<unsigned int>& GetVariableDimensions( int v ) const
+  {
+    return m_Variables[v].dimensions;
+  }
+
+  DataType GetVariableType( int v ) const
+  {
+    return m_Variables[v].type;
+  }
+
+  // Attribute of variable v as numbers, or as text.  Returns false if
+  // v has no such attribute, or it is not of that kind.
+  bool GetAttribute( int v, const std::string& name, std::vector<double>& values ) const;
+  bool GetAttribute( int v, const std::string& name, std::string& text ) const;
+
+  // Read all the values of numeric variable v.
+  bool ReadValues( int v, std::vector<double>& values ) const;
+
+  // Read a hyperslab of variable v, in native byte order, on up to
+  // numberOfThreads threads.  Returns false on error.
+  bool ReadHyperslab( int v,
+                      const unsigned long starts[],
+                      const unsigned long counts[],
+                      void* buffer,
+                      int numberOfThreads = 1 ) const;
+
+  // Size in bytes of a value of the given type, 0 if unknown.
+  static size_t GetTypeSize( DataType type );
+
+private:
+  MINCNetCDFFile(const MINCNetCDFFile&); //purposely not implemented
+  void operator=(const MINCNetCDFFile&); //purposely not implemented
+
+  struct Dimension
+  {
+    std::string name;
+    unsigned long size;
+  };
+
+  // Values are kept as stored, big-endian.
+  struct Attribute
+  {
+    std::string name;
+    DataType type;
+    size_t count;
+    std::string values;
+  };
+
+  struct Variable
+  {
+    std::string name;
+    std::vector<unsigned int> dimensions;
+    std::vector<Attribute> attributes;
+    DataType type;
+    unsigned long long begin;
+    bool record;
+  };
+
+  // Parse the first numBytes of the file.  Returns false if they are
+  // not a valid header, setting truncated if more bytes might make
+  // them one.
+  bool ParseHeader( const char* header, size_t numBytes, bool& truncated );
+
+  const Attribute* FindAttribute( int v, const std::string& name ) const;
+
+  MINCRawFile m_File;
+  unsigned long long m_FileSize;
+
+  std::vector<Dimension> m_Dimensions;
+  std::vector<Variable> m_Variables;
+
+  // The record dimension, or -1, and the bytes of one record of all
+  // record variables together.
+  int m_RecordDimension;
+  unsigned long long m_RecordSize;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCNetCDFFile_h
@@ -0,0 +1,287 @@
+#include "itkMINCNetCDFWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+
+
+namespace itk {
+
+
+namespace {
+
+// Fields of a netCDF classic header: big-endian, each padded to 4
+// bytes
+void AppendUInt( std::string& out, unsigned long long value, size_t numBytes = 4 )
+{
+  for( int shift = static_cast<int>( 8 * numBytes ) - 8; shift >= 0; shift -= 8 )
+    out += static_cast<char>( ( value >> shift ) & 0xFF );
+}
+
+void AppendPadding( std::string& out )
+{
+  out.append( ( 4 - out.size() % 4 ) % 4, '\0' );
+}
+
+void AppendName( std::string& out, const std::string& name )
+{
+  AppendUInt( out, name.size() );
+  out += name;
+  AppendPadding( out );
+}
+
+std::string DoubleValues( const double* values, size_t count )
+{
+  std::string bytes( count * sizeof( double ), '\0' );
+  if ( count > 0 )
+    {
+    std::memcpy( &bytes[0], values, bytes.size() );
+    MINCNetCDFWriter::SwapToBigEndian( &bytes[0], bytes.size(), sizeof( double ) );
+    }
+  return bytes;
+}
+
+unsigned long long PadTo4( unsigned long long numBytes )
+{
+  return ( numBytes + 3 ) / 4 * 4;
+}
+
+const unsigned int TagDimension = 0x0A;
+const unsigned int TagVariable = 0x0B;
+const unsigned int TagAttribute = 0x0C;
+
+} // end of unnamed namespace
+
+
+MINCNetCDFWriter::MINCNetCDFWriter()
+  : m_NumberOfRecords( 0 )
+{
+}
+
+unsigned int MINCNetCDFWriter::AddDimension( const std::string& name, unsigned long size )
+{
+  Dimension dimension;
+  dimension.name = name;
+  dimension.size = size;
+  m_Dimensions.push_back( dimension );
+  return m_Dimensions.size() - 1;
+}
+
+unsigned int MINCNetCDFWriter::AddVariable( const std::string& name,
+					    DataType type,
+					    const std::vector<unsigned int>& dimensions )
+{
+  Variable variable;
+  variable.name = name;
+  variable.dimensions = dimensions;
+  variable.type = type;
+  variable.record = ! dimensions.empty() && m_Dimensions[dimensions[0]].size == 0;
+  variable.begin = 0;
+  variable.source = 0;
+
+  variable.numBytes = MINCNetCDFFile::GetTypeSize( type );
+  for( size_t d = variable.record ? 1 : 0; d < dimensions.size(); ++d )
+    variable.numBytes *= m_Dimensions[dimensions[d]].size;
+
+  m_Variables.push_back( variable );
+  return m_Variables.size() - 1;
+}
+
+void MINCNetCDFWriter::AddAttribute( unsigned int variable,
+				     const std::string& name,
+				     const std::string& text )
+{
+  Attribute attribute;
+  attribute.name = name;
+  attribute.type = MINCNetCDFFile::Char;
+  attribute.count = text.size();
+  attribute.values = text;
+  m_Variables[variable].attributes.push_back( attribute );
+}
+
+void MINCNetCDFWriter::AddAttribute( unsigned int variable,
+				     const std::string& name,
+				     const double* values,
+				     size_t count )
+{
+  Attribute attribute;
+  attribute.name = name;
+  attribute.type = MINCNetCDFFile::Double;
+  attribute.count = count;
+  attribute.values = DoubleValues( values, count );
+  m_Variables[variable].attributes.push_back( attribute );
+}
+
+void MINCNetCDFWriter::SetValues( unsigned int variable, const double* values, size_t count )
+{
+  m_Variables[variable].values = DoubleValues( values, count );
+}
+
+void MINCNetCDFWriter::SetValueSource( unsigned int variable, const ValueSource* source )
+{
+  m_Variables[variable].source = source;
+}
+
+void MINCNetCDFWriter::SwapToBigEndian( char* data, size_t numBytes, size_t valueSize )
+{
+  const unsigned short one = 1;
+  if ( *reinterpret_cast<const unsigned char*>( &one ) == 0 )
+    return;
+
+  for( size_t i = 0; i + valueSize <= numBytes; i += valueSize )
+    std::reverse( data + i, data + i + valueSize );
+}
+
+std::string MINCNetCDFWriter::SerializeHeader( bool wideOffsets ) const
+{
+  std::string header( "CDF" );
+  header += static_cast<char>( wideOffsets ? 2 : 1 );
+  AppendUInt( header, m_NumberOfRecords );
+
+  AppendUInt( header, TagDimension );
+  AppendUInt( header, m_Dimensions.size() );
+  for( size_t d = 0; d < m_Dimensions.size(); ++d )
+    {
+    AppendName( header, m_Dimensions[d].name );
+    AppendUInt( header, m_Dimensions[d].size );
+    }
+
+  // No global attributes
+  AppendUInt( header, 0 );
+  AppendUInt( header, 0 );
+
+  AppendUInt( header, TagVariable );
+  AppendUInt( header, m_Variables.size() );
+  for( size_t v = 0; v < m_Variables.size(); ++v )
+    {
+    const Variable& variable = m_Variables[v];
+    AppendName( header, variable.name );
+    AppendUInt( header, variable.dimensions.size() );
+    for( size_t d = 0; d < variable.dimensions.size(); ++d )
+      AppendUInt( header, variable.dimensions[d] );
+
+    AppendUInt( header, TagAttribute );
+    AppendUInt( header, variable.attributes.size() );
+    for( size_t a = 0; a < variable.attributes.size(); ++a )
+      {
+      const Attribute& attribute = variable.attributes[a];
+      AppendName( header, attribute.name );
+      AppendUInt( header, attribute.type );
+      AppendUInt( header, attribute.count );
+      header += attribute.values;
+      AppendPadding( header );
+      }
+
+    AppendUInt( header, variable.type );
+    AppendUInt( header, std::min( PadTo4( variable.numBytes ), 0xFFFFFFFFULL ) );
+    AppendUInt( header, variable.begin, wideOffsets ? 8 : 4 );
+    }
+
+  return header;
+}
+
+unsigned long long MINCNetCDFWriter::GetStoredBytes( const Variable& variable,
+						     unsigned int numRecordVariables ) const
+{
+  // Only a lone record variable is not padded within its records
+  if ( variable.record && numRecordVariables == 1 )
+    return variable.numBytes;
+  return PadTo4( variable.numBytes );
+}
+
+bool MINCNetCDFWriter::Write( const char* filename )
+{
+  // The values of the other variables come first, then the records,
+  // each holding one record of every record variable
+  unsigned int numRecordVariables = 0;
+  for( size_t v = 0; v < m_Variables.size(); ++v )
+    {
+    if ( m_Variables[v].record )
+      ++numRecordVariables;
+    }
+
+  unsigned long long fixedBytes = 0;
+  unsigned long long recordBytes = 0;
+  for( size_t v = 0; v < m_Variables.size(); ++v )
+    {
+    if ( m_Variables[v].record )
+      recordBytes += this->GetStoredBytes( m_Variables[v], numRecordVariables );
+    else
+      fixedBytes += this->GetStoredBytes( m_Variables[v], numRecordVariables );
+    }
+
+  // Offsets past 2 GiB need the 64-bit offset variant
+  const unsigned long long headerBytes = this->SerializeHeader( false ).size();
+  const bool wideOffsets = headerBytes + fixedBytes + recordBytes * m_NumberOfRecords > 0x7FFFFFFFULL;
+
+  unsigned long long offset = this->SerializeHeader( wideOffsets ).size();
+  for( size_t v = 0; v < m_Variables.size(); ++v )
+    {
+    if ( m_Variables[v].record )
+      continue;
+    m_Variables[v].begin = offset;
+    offset += this->GetStoredBytes( m_Variables[v], numRecordVariables );
+    }
+  for( size_t v = 0; v < m_Variables.size(); ++v )
+    {
+    if ( ! m_Variables[v].record )
+      continue;
+    m_Variables[v].begin = offset;
+    offset += this->GetStoredBytes( m_Variables[v], numRecordVariables );
+    }
+
+  std::ofstream out( filename, std::ios::binary | std::ios::trunc );
+  if ( ! out )
+    return false;
+
+  const std::string header = this->SerializeHeader( wideOffsets );
+  out.write( header.data(), header.size() );
+
+  const char padding[4] = { 0, 0, 0, 0 };
+  for( size_t v = 0; v < m_Variables.size() && out; ++v )
+    {
+    const Variable& variable = m_Variables[v];
+    if ( variable.record )
+      continue;
+
+    if ( variable.source )
+      {
+      const unsigned long numSlices = variable.dimensions.empty()
+	? 1 : m_Dimensions[variable.dimensions[0]].size;
+      if ( ! variable.source->WriteValues( out, 0, numSlices ) )
+	return false;
+      }
+    else
+      {
+      out.write( variable.values.data(), variable.values.size() );
+      }
+    out.write( padding, this->GetStoredBytes( variable, numRecordVariables ) - variable.numBytes );
+    }
+
+  for( unsigned long r = 0; r < m_NumberOfRecords && out; ++r )
+    {
+    for( size_t v = 0; v < m_Variables.size(); ++v )
+      {
+      const Variable& variable = m_Variables[v];
+      if ( ! variable.record )
+	continue;
+
+      if ( variable.source )
+	{
+	if ( ! variable.source->WriteValues( out, r, 1 ) )
+	  return false;
+	}
+      else
+	{
+	out.write( variable.values.data() + r * variable.numBytes, variable.numBytes );
+	}
+      out.write( padding, this->GetStoredBytes( variable, numRecordVariables ) - variable.numBytes );
+      }
+    }
+
+  out.close();
+  return ! out.fail();
+}
+
+} // namespace itk
@@ -0,0 +1,145 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCNetCDFWriter.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCNetCDFWriter_h
+#define __itkMINCNetCDFWriter_h
+
+#include "itkMINCNetCDFFile.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+
+namespace itk
+{
+
+/** \class MINCNetCDFWriter
+ *
+ * \brief Writes netCDF classic files, such as MINC1 files, for tests
+ * and benchmarks.
+ *
+ * The counterpart of MINCNetCDFFile.  Dimensions, variables and their
+ * attributes are declared first; Write() then lays the variables out,
+ * switches to the 64-bit offset variant if the file would pass 2 GiB,
+ * and writes the header followed by the values.  Small variables are
+ * given their values up front; large ones get them from a
+ * ValueSource as they are written, so that a file of any size is
+ * written with bounded memory.
+ *
+ * A dimension of size 0 is the record (unlimited) dimension, which
+ * must be the first dimension of the variables along it.
+ *
+ * \ingroup IOFilters
+ */
+class MINCNetCDFWriter
+{
+public:
+  typedef MINCNetCDFFile::DataType DataType;
+
+  // Writes the values of a variable as they are needed: count records
+  // from record first of a record variable, or count slices from slice
+  // first along the first dimension of another (all of a scalar being
+  // one slice).  Values go to out big-endian.
+  class ValueSource
+  {
+  public:
+    virtual ~ValueSource() {}
+
+    virtual bool WriteValues( std::ostream& out,
+                              unsigned long first,
+                              unsigned long count ) const = 0;
+  };
+
+  MINCNetCDFWriter();
+
+  // Add a dimension and return its index.  Size 0 makes it the record
+  // dimension.
+  unsigned int AddDimension( const std::string& name, unsigned long size );
+
+  void SetNumberOfRecords( unsigned long numberOfRecords )
+  {
+    m_NumberOfRecords = numberOfRecords;
+  }
+
+  // Add a variable along the given dimensions, slowest-varying first,
+  // and return its index.
+  unsigned int AddVariable( const std::string& name,
+                            DataType type,
+                            const std::vector<unsigned int>& dimensions );
+
+  void AddAttribute( unsigned int variable, const std::string& name, const std::string& text );
+  void AddAttribute( unsigned int variable, const std::string& name,
+                     const double* values, size_t count );
+
+  // All the values of a Double variable, records included.
+  void SetValues( unsigned int variable, const double* values, size_t count );
+
+  // Values of a variable from source, which must outlive Write().
+  void SetValueSource( unsigned int variable, const ValueSource* source );
+
+  // Write the file, replacing any file there.  Returns false on error.
+  bool Write( const char* filename );
+
+  // Reverse each valueSize bytes of data on little-endian hosts.
+  static void SwapToBigEndian( char* data, size_t numBytes, size_t valueSize );
+
+private:
+  struct Dimension
+  {
+    std::string name;
+    unsigned long size;
+  };
+
+  // Values are kept big-endian, as stored.
+  struct Attribute
+  {
+    std::string name;
+    DataType type;
+    size_t count;
+    std::string values;
+  };
+
+  struct Variable
+  {
+    std::string name;
+    std::vector<unsigned int> dimensions;
+    std::vector<Attribute> attributes;
+    DataType type;
+    bool record;
+
+    // Bytes of the variable, or of one record of it, before padding
+    unsigned long long numBytes;
+    unsigned long long begin;
+
+    std::string values;
+    const ValueSource* source;
+  };
+
+  // Header with the current offsets of the variables.
+  std::string SerializeHeader( bool wideOffsets ) const;
+
+  // Bytes a variable takes in a record, or in the file
+  unsigned long long GetStoredBytes( const Variable& variable,
+                                     unsigned int numRecordVariables ) const;
+
+  std::vector<Dimension> m_Dimensions;
+  std::vector<Variable> m_Variables;
+  unsigned long m_NumberOfRecords;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCNetCDFWriter_h
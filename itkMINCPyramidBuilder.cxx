@@ -0,0 +1,456 @@
+#include "itkMINCPyramidBuilder.h"
+#include "itkMINCImageDataset.h"
+#include "itkMINCVoxelRescaler.h"
+
+#include "itkMultiThreader.h"
+
+#include <algorithm>
+
+
+
+namespace itk {
+
+
+struct MINCPyramidBuilder::Slab
+{
+  std::vector<char> values;
+  unsigned long numberOfRows;
+};
+
+struct MINCPyramidBuilder::Level
+{
+  MINCImageDataset dataset;
+
+  std::vector<unsigned long> dimensions;
+  std::vector<unsigned long> parentDimensions;
+
+  // Voxels of the level above covered by one voxel, per dimension: 1 or 2
+  std::vector<unsigned int> factor;
+
+  // Values in one row of this level, and of the level above
+  size_t rowSize;
+  size_t parentRowSize;
+
+  // Offsets, in voxels within a row of the level above, of the
+  // voxels of a block relative to its first
+  std::vector<size_t> blockOffsets;
+
+  // Rows of the level above waiting for the rest of their block
+  std::map<unsigned long, std::vector<double> > pending;
+
+  // Rows gathered into chunk-aligned slabs before writing
+  unsigned long slabRows;
+  std::map<unsigned long, Slab> slabs;
+
+  // Range of each slice, with slice scaling
+  size_t sliceSize;
+  std::vector<double> imageMin;
+  std::vector<double> imageMax;
+};
+
+
+namespace {
+
+struct ReduceJob
+{
+  const MINCPyramidBuilder::DownsamplingType* method;
+  unsigned int numberOfComponents;
+  unsigned int numberOfDimensions;
+  const unsigned long* dimensions;
+  const unsigned int* factor;
+  const unsigned long* parentDimensions;
+  const std::vector<size_t>* blockOffsets;
+  std::vector<const double*> rows;
+  size_t numberOfVoxels;
+  double* out;
+};
+
+// Most frequent of the values, the smallest one on ties.
+double Mode( std::vector<double>& values )
+{
+  std::sort( values.begin(), values.end() );
+
+  double mode = values[0];
+  size_t modeCount = 0;
+  for( size_t i = 0; i < values.size(); )
+    {
+    size_t j = i + 1;
+    while( j < values.size() && values[j] == values[i] )
+      ++j;
+    if ( j - i > modeCount )
+      {
+      mode = values[i];
+      modeCount = j - i;
+      }
+    i = j;
+    }
+  return mode;
+}
+
+ITK_THREAD_RETURN_TYPE ReduceThreadCallback( void* arg )
+{
+  MultiThreader::ThreadInfoStruct* info
+    = static_cast<MultiThreader::ThreadInfoStruct*>( arg );
+  const ReduceJob& job = *static_cast<ReduceJob*>( info->UserData );
+
+  const unsigned int n = job.numberOfDimensions;
+  const unsigned int numComponents = job.numberOfComponents;
+  const size_t first = job.numberOfVoxels * info->ThreadID / info->NumberOfThreads;
+  const size_t last = job.numberOfVoxels * ( info->ThreadID + 1 ) / info->NumberOfThreads;
+
+  std::vector<double> block( job.rows.size() * job.blockOffsets->size() );
+
+  for( size_t v = first; v < last; ++v )
+    {
+    // First voxel of the block in a row of the level above
+    size_t base = 0;
+    size_t remainder = v;
+    size_t parentStride = 1;
+    for( int d = static_cast<int>( n ) - 1; d >= 1; --d )
+      {
+      base += ( remainder % job.dimensions[d] ) * job.factor[d] * parentStride;
+      remainder /= job.dimensions[d];
+      parentStride *= job.parentDimensions[d];
+      }
+
+    for( unsigned int c = 0; c < numComponents; ++c )
+      {
+      double* out = job.out + v * numComponents + c;
+
+      if ( *job.method == MINCPyramidBuilder::Nearest )
+	{
+	*out = job.rows[0][base * numComponents + c];
+	continue;
+	}
+
+      size_t k = 0;
+      for( size_t r = 0; r < job.rows.size(); ++r )
+	{
+	for( size_t o = 0; o < job.blockOffsets->size(); ++o )
+	  block[k++] = job.rows[r][ ( base + (*job.blockOffsets)[o] ) * numComponents + c ];
+	}
+
+      if ( *job.method == MINCPyramidBuilder::Mode )
+	{
+	*out = Mode( block );
+	}
+      else
+	{
+	double sum = 0;
+	for( size_t i = 0; i < block.size(); ++i )
+	  sum += block[i];
+	*out = sum / block.size();
+	}
+      }
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+} // end of unnamed namespace
+
+
+MINCPyramidBuilder::MINCPyramidBuilder()
+  : m_RowSize( 0 ),
+    m_NumberOfComponents( 1 ),
+    m_StoredType( ImageIOBase::UNKNOWNCOMPONENTTYPE ),
+    m_StoredComponentSize( 0 ),
+    m_SliceScaling( false ),
+    m_ImageScaling( false ),
+    m_ImageMin( 0 ),
+    m_ImageMax( 0 ),
+    m_ValidMin( 0 ),
+    m_ValidMax( 0 ),
+    m_Method( Average ),
+    m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() )
+{
+}
+
+MINCPyramidBuilder::~MINCPyramidBuilder()
+{
+  this->Close();
+}
+
+void MINCPyramidBuilder::SetNumberOfThreads( int numberOfThreads )
+{
+  m_NumberOfThreads = std::max( 1, numberOfThreads );
+  for( size_t k = 0; k < m_Levels.size(); ++k )
+    m_Levels[k]->dataset.SetNumberOfThreads( m_NumberOfThreads );
+}
+
+void MINCPyramidBuilder::SetImageRange( double imageMin, double imageMax )
+{
+  m_ImageScaling = ! m_SliceScaling;
+  m_ImageMin = imageMin;
+  m_ImageMax = imageMax;
+}
+
+bool MINCPyramidBuilder::Create( MINCImageDataset* fullResolution,
+				 const char* filename,
+				 unsigned int numberOfLevels,
+				 unsigned int numberOfComponents,
+				 IOComponentType storedType,
+				 bool sliceScaling,
+				 double validMin,
+				 double validMax,
+				 DownsamplingType method )
+{
+  this->Close();
+
+  const unsigned int n = fullResolution->GetNumberOfDimensions();
+  if ( n == 0 || ( sliceScaling && n < 3 ) )
+    return false;
+
+  m_NumberOfComponents = numberOfComponents;
+  m_StoredType = storedType;
+  m_StoredComponentSize = fullResolution->GetComponentSize();
+  m_SliceScaling = sliceScaling;
+  m_ImageScaling = false;
+  m_ValidMin = validMin;
+  m_ValidMax = validMax;
+  m_Method = method;
+
+  std::vector<unsigned long> dimensions( n );
+  for( unsigned int d = 0; d < n; ++d )
+    dimensions[d] = fullResolution->GetDimensionSize( d );
+
+  m_RowSize = numberOfComponents;
+  for( unsigned int d = 1; d < n; ++d )
+    m_RowSize *= dimensions[d];
+
+  for( unsigned int k = 1; k <= numberOfLevels; ++k )
+    {
+    Level* level = new Level;
+    level->parentDimensions = dimensions;
+    level->factor.resize( n );
+
+    bool halved = false;
+    for( unsigned int d = 0; d < n; ++d )
+      {
+      level->factor[d] = dimensions[d] >= 2 ? 2 : 1;
+      halved = halved || level->factor[d] == 2;
+      dimensions[d] /= level->factor[d];
+      }
+
+    if ( ! halved )
+      {
+      delete level;
+      break;
+      }
+
+    if ( ! fullResolution->CreateResolutionLevel( k, &dimensions[0], sliceScaling )
+	 || ! level->dataset.Open( filename, k, true ) )
+      {
+      delete level;
+      this->Close();
+      return false;
+      }
+
+    level->dimensions = dimensions;
+    level->dataset.SetNumberOfThreads( m_NumberOfThreads );
+
+    level->rowSize = numberOfComponents;
+    level->parentRowSize = numberOfComponents;
+    for( unsigned int d = 1; d < n; ++d )
+      {
+      level->rowSize *= level->dimensions[d];
+      level->parentRowSize *= level->parentDimensions[d];
+      }
+
+    // Voxels of a block within one row of the level above
+    level->blockOffsets.assign( 1, 0 );
+    size_t parentStride = 1;
+    for( int d = static_cast<int>( n ) - 1; d >= 1; --d )
+      {
+      const size_t numOffsets = level->blockOffsets.size();
+      for( unsigned int f = 1; f < level->factor[d]; ++f )
+	{
+	for( size_t o = 0; o < numOffsets; ++o )
+	  level->blockOffsets.push_back( level->blockOffsets[o] + f * parentStride );
+	}
+      parentStride *= level->parentDimensions[d];
+      }
+
+    // A contiguous image is written row by row
+    level->slabRows = level->dataset.IsChunked() ? level->dataset.GetChunkSize( 0 ) : 1;
+
+    level->sliceSize = numberOfComponents;
+    if ( sliceScaling )
+      {
+      level->sliceSize *= level->dimensions[n - 2] * level->dimensions[n - 1];
+      size_t numSlices = 1;
+      for( unsigned int d = 0; d + 2 < n; ++d )
+	numSlices *= level->dimensions[d];
+      level->imageMin.assign( numSlices, 0.0 );
+      level->imageMax.assign( numSlices, 0.0 );
+      }
+
+    m_Levels.push_back( level );
+    }
+
+  return true;
+}
+
+bool MINCPyramidBuilder::AddRow( unsigned long row, const double* values )
+{
+  if ( m_Levels.empty() )
+    return true;
+
+  std::vector<double> copy( values, values + m_RowSize );
+  return this->AddRow( 0, row, copy );
+}
+
+bool MINCPyramidBuilder::AddRow( unsigned int k, unsigned long parentRow, std::vector<double>& values )
+{
+  Level& level = *m_Levels[k];
+
+  // An odd last row of the level above is dropped
+  const unsigned long row = parentRow / level.factor[0];
+  if ( row >= level.dimensions[0] )
+    return true;
+
+  level.pending[parentRow].swap( values );
+
+  const unsigned long first = row * level.factor[0];
+  for( unsigned long r = first; r < first + level.factor[0]; ++r )
+    {
+    if ( level.pending.find( r ) == level.pending.end() )
+      return true;
+    }
+
+  std::vector<double> reduced( level.rowSize );
+  this->ReduceRow( level, row, &reduced[0] );
+
+  for( unsigned long r = first; r < first + level.factor[0]; ++r )
+    level.pending.erase( r );
+
+  if ( ! this->StoreRow( level, row, reduced ) )
+    return false;
+
+  if ( k + 1 < m_Levels.size() )
+    return this->AddRow( k + 1, row, reduced );
+  return true;
+}
+
+void MINCPyramidBuilder::ReduceRow( const Level& level, unsigned long row, double* out ) const
+{
+  ReduceJob job;
+  job.method = &m_Method;
+  job.numberOfComponents = m_NumberOfComponents;
+  job.numberOfDimensions = level.dimensions.size();
+  job.dimensions = &level.dimensions[0];
+  job.factor = &level.factor[0];
+  job.parentDimensions = &level.parentDimensions[0];
+  job.blockOffsets = &level.blockOffsets;
+  job.numberOfVoxels = level.rowSize / m_NumberOfComponents;
+  job.out = out;
+
+  for( unsigned int f = 0; f < level.factor[0]; ++f )
+    job.rows.push_back( &level.pending.find( row * level.factor[0] + f )->second[0] );
+
+  // Small rows are not worth the threads
+  const size_t work = level.parentRowSize * level.factor[0];
+  size_t numThreads = std::min<size_t>( m_NumberOfThreads, work / 65536 + 1 );
+  numThreads = std::max<size_t>( std::min( numThreads, job.numberOfVoxels ), 1 );
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( static_cast<int>( numThreads ) );
+  threader->SetSingleMethod( ReduceThreadCallback, &job );
+  threader->SingleMethodExecute();
+}
+
+bool MINCPyramidBuilder::StoreRow( Level& level, unsigned long row, const std::vector<double>& values )
+{
+  const unsigned long slabIndex = row / level.slabRows;
+  const unsigned long slabStart = slabIndex * level.slabRows;
+  const unsigned long slabSize = std::min( level.slabRows, level.dimensions[0] - slabStart );
+  const size_t rowBytes = level.rowSize * m_StoredComponentSize;
+
+  Slab& slab = level.slabs[slabIndex];
+  if ( slab.values.empty() )
+    {
+    slab.values.resize( slabSize * rowBytes );
+    slab.numberOfRows = 0;
+    }
+
+  char* out = &slab.values[( row - slabStart ) * rowBytes];
+
+  if ( ! m_SliceScaling )
+    {
+    // Averages stay within the range of the full-resolution image
+    double slope = 1.0;
+    double intercept = 0.0;
+    if ( m_ImageScaling )
+      {
+      slope = 0.0;
+      if ( m_ImageMax > m_ImageMin )
+	slope = ( m_ValidMax - m_ValidMin ) / ( m_ImageMax - m_ImageMin );
+      intercept = m_ValidMin - m_ImageMin * slope;
+      }
+    MINCVoxelRescaler::Rescale( ImageIOBase::DOUBLE, &values[0], m_StoredType, out,
+				level.rowSize, slope, intercept );
+    }
+  else
+    {
+    // Map each slice's range onto the valid range, like the full
+    // resolution image
+    const size_t slicesPerRow = level.rowSize / level.sliceSize;
+    for( size_t s = 0; s < slicesPerRow; ++s )
+      {
+      const double* in = &values[s * level.sliceSize];
+      const double imageMin = *std::min_element( in, in + level.sliceSize );
+      const double imageMax = *std::max_element( in, in + level.sliceSize );
+
+      level.imageMin[row * slicesPerRow + s] = imageMin;
+      level.imageMax[row * slicesPerRow + s] = imageMax;
+
+      double slope = 0.0;
+      if ( imageMax > imageMin )
+	slope = ( m_ValidMax - m_ValidMin ) / ( imageMax - imageMin );
+
+      MINCVoxelRescaler::Rescale( ImageIOBase::DOUBLE, in, m_StoredType,
+				  out + s * level.sliceSize * m_StoredComponentSize,
+				  level.sliceSize, slope, m_ValidMin - imageMin * slope );
+      }
+    }
+
+  if ( ++slab.numberOfRows < slabSize )
+    return true;
+
+  const unsigned int n = level.dimensions.size();
+  std::vector<unsigned long> starts( n, 0 );
+  std::vector<unsigned long> counts( level.dimensions );
+  starts[0] = slabStart;
+  counts[0] = slabSize;
+
+  bool ok = level.dataset.WriteHyperslab( &starts[0], &counts[0], &slab.values[0] );
+  level.slabs.erase( slabIndex );
+  return ok;
+}
+
+bool MINCPyramidBuilder::Finish()
+{
+  bool ok = true;
+  for( size_t k = 0; k < m_Levels.size(); ++k )
+    {
+    Level& level = *m_Levels[k];
+    ok = ok && level.pending.empty() && level.slabs.empty();
+    if ( m_SliceScaling )
+      ok = ok && level.dataset.WriteImageRange( level.imageMin, level.imageMax );
+    else if ( m_ImageScaling )
+      ok = ok && level.dataset.WriteImageRange( std::vector<double>( 1, m_ImageMin ),
+						std::vector<double>( 1, m_ImageMax ) );
+    }
+
+  this->Close();
+  return ok;
+}
+
+void MINCPyramidBuilder::Close()
+{
+  for( size_t k = 0; k < m_Levels.size(); ++k )
+    delete m_Levels[k];
+  m_Levels.clear();
+}
+
+} // end namespace itk
@@ -0,0 +1,140 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCPyramidBuilder.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCPyramidBuilder_h
+#define __itkMINCPyramidBuilder_h
+
+#include "itkImageIOBase.h"
+
+#include <map>
+#include <vector>
+
+
+namespace itk
+{
+
+class MINCImageDataset;
+
+/** \class MINCPyramidBuilder
+ *
+ * \brief Lower resolution levels of a MINC2 image, built as it is
+ * written.
+ *
+ * Level k halves every dimension of level k-1 that has at least two
+ * voxels (dropping an odd last voxel).  Rows of full-resolution real
+ * values, i.e. slabs one voxel thick along dimension 0, are fed in as
+ * they are written, in any order.  As soon as the rows a level row
+ * depends on are all in, it is computed from them, its own level
+ * rows follow, and the memory is released; the full image is never
+ * held.  Rows are reduced on several threads and gathered into
+ * chunk-aligned slabs, so their compression is parallel too.
+ *
+ * Dimensions are in file order (slowest-varying first).
+ *
+ * \ingroup IOFilters
+ */
+class MINCPyramidBuilder
+{
+public:
+  typedef ImageIOBase::IOComponentType IOComponentType;
+
+  // Reduction of each block of voxels to one voxel of the level
+  // below: the mean for real-valued images, the most frequent value
+  // (smallest on ties) or the first voxel for label images.
+  typedef enum { Average = 0, Mode, Nearest } DownsamplingType;
+
+  MINCPyramidBuilder();
+  ~MINCPyramidBuilder();
+
+  // Create up to numberOfLevels levels below the image of
+  // fullResolution, which must be open for writing, and open them.
+  // Fewer levels are created if the image runs out of voxels to
+  // halve.  Values are stored as storedType; with slice scaling, each
+  // slice is scaled to [validMin, validMax] like the full-resolution
+  // image, and without it see SetImageRange().  Returns false on
+  // error.
+  bool Create( MINCImageDataset* fullResolution,
+               const char* filename,
+               unsigned int numberOfLevels,
+               unsigned int numberOfComponents,
+               IOComponentType storedType,
+               bool sliceScaling,
+               double validMin,
+               double validMax,
+               DownsamplingType method );
+
+  void SetNumberOfThreads( int numberOfThreads );
+
+  // Without slice scaling, scale every level from the real range of
+  // the full-resolution image to [validMin, validMax], as that image
+  // was scaled as a whole.  Must be set before the first row.
+  void SetImageRange( double imageMin, double imageMax );
+
+  bool IsOpen() const
+  {
+    return ! m_Levels.empty();
+  }
+
+  // Number of values in one full-resolution row.
+  size_t GetRowSize() const
+  {
+    return m_RowSize;
+  }
+
+  // Add full-resolution row, GetRowSize() real values with the last
+  // dimension varying fastest.  Returns false on error.
+  bool AddRow( unsigned long row, const double* values );
+
+  // Write the ranges of the levels and close them.  Returns false on
+  // error.
+  bool Finish();
+
+  void Close();
+
+private:
+  MINCPyramidBuilder(const MINCPyramidBuilder&); //purposely not implemented
+  void operator=(const MINCPyramidBuilder&); //purposely not implemented
+
+  struct Level;
+  struct Slab;
+
+  // Hand row of the level above level to it, taking its values.
+  bool AddRow( unsigned int level, unsigned long row, std::vector<double>& values );
+
+  // Compute row of level from the rows of the level above.
+  void ReduceRow( const Level& level, unsigned long row, double* out ) const;
+
+  // Convert a computed row to the stored type and write the slab it
+  // completes, if any.
+  bool StoreRow( Level& level, unsigned long row, const std::vector<double>& values );
+
+  std::vector<Level*> m_Levels;
+  size_t m_RowSize;
+  unsigned int m_NumberOfComponents;
+  IOComponentType m_StoredType;
+  size_t m_StoredComponentSize;
+  bool m_SliceScaling;
+  bool m_ImageScaling;
+  double m_ImageMin;
+  double m_ImageMax;
+  double m_ValidMin;
+  double m_ValidMax;
+  DownsamplingType m_Method;
+  int m_NumberOfThreads;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCPyramidBuilder_h
@@ -0,0 +1,217 @@
+#include "itkMINCRawFile.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+
+
+namespace itk {
+
+#ifdef _WIN32
+
+MINCRawFile::MINCRawFile()
+  : m_Handle( INVALID_HANDLE_VALUE ),
+    m_Mapping( 0 ),
+    m_MapStart( 0 ),
+    m_MapBytes( 0 ),
+    m_MappedData( 0 )
+{
+}
+
+bool MINCRawFile::Open( const char* filename )
+{
+  this->Close();
+  m_Handle = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+			  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+  return this->IsOpen();
+}
+
+void MINCRawFile::Close()
+{
+  this->Unmap();
+  if ( this->IsOpen() )
+    CloseHandle( m_Handle );
+  m_Handle = INVALID_HANDLE_VALUE;
+}
+
+bool MINCRawFile::IsOpen() const
+{
+  return m_Handle != INVALID_HANDLE_VALUE;
+}
+
+bool MINCRawFile::Read( unsigned long long offset, size_t numBytes, void* buffer ) const
+{
+  char* out = static_cast<char*>( buffer );
+
+  while( numBytes > 0 )
+    {
+    // The offset of a synchronous read is given in its OVERLAPPED
+    // structure, so concurrent reads do not interfere.
+    OVERLAPPED overlapped;
+    ZeroMemory( &overlapped, sizeof( overlapped ) );
+    overlapped.Offset = static_cast<DWORD>( offset );
+    overlapped.OffsetHigh = static_cast<DWORD>( offset >> 32 );
+
+    const DWORD request = numBytes > 0x40000000 ? 0x40000000 : static_cast<DWORD>( numBytes );
+    DWORD numRead = 0;
+    if ( ! ReadFile( m_Handle, out, request, &numRead, &overlapped ) || numRead == 0 )
+      return false;
+
+    out += numRead;
+    offset += numRead;
+    numBytes -= numRead;
+    }
+
+  return true;
+}
+
+const char* MINCRawFile::Map( unsigned long long offset, size_t numBytes )
+{
+  this->Unmap();
+  if ( ! this->IsOpen() || numBytes == 0 )
+    return 0;
+
+  SYSTEM_INFO info;
+  GetSystemInfo( &info );
+  const unsigned long long start = offset - offset % info.dwAllocationGranularity;
+  const unsigned long long end = offset + numBytes;
+
+  m_Mapping = CreateFileMappingA( m_Handle, 0, PAGE_READONLY,
+				  static_cast<DWORD>( end >> 32 ), static_cast<DWORD>( end ), 0 );
+  if ( ! m_Mapping )
+    return 0;
+
+  m_MapBytes = static_cast<size_t>( end - start );
+  m_MapStart = MapViewOfFile( m_Mapping, FILE_MAP_READ,
+			      static_cast<DWORD>( start >> 32 ), static_cast<DWORD>( start ),
+			      m_MapBytes );
+  if ( ! m_MapStart )
+    {
+    this->Unmap();
+    return 0;
+    }
+
+  m_MappedData = static_cast<const char*>( m_MapStart ) + ( offset - start );
+  return m_MappedData;
+}
+
+void MINCRawFile::Unmap()
+{
+  if ( m_MapStart )
+    UnmapViewOfFile( m_MapStart );
+  if ( m_Mapping )
+    CloseHandle( m_Mapping );
+
+  m_Mapping = 0;
+  m_MapStart = 0;
+  m_MapBytes = 0;
+  m_MappedData = 0;
+}
+
+#else
+
+MINCRawFile::MINCRawFile()
+  : m_Descriptor( -1 ),
+    m_MapStart( 0 ),
+    m_MapBytes( 0 ),
+    m_MappedData( 0 )
+{
+}
+
+bool MINCRawFile::Open( const char* filename )
+{
+  this->Close();
+  m_Descriptor = open( filename, O_RDONLY );
+  return this->IsOpen();
+}
+
+void MINCRawFile::Close()
+{
+  this->Unmap();
+  if ( this->IsOpen() )
+    close( m_Descriptor );
+  m_Descriptor = -1;
+}
+
+bool MINCRawFile::IsOpen() const
+{
+  return m_Descriptor >= 0;
+}
+
+bool MINCRawFile::Read( unsigned long long offset, size_t numBytes, void* buffer ) const
+{
+  char* out = static_cast<char*>( buffer );
+
+  while( numBytes > 0 )
+    {
+    const ssize_t numRead = pread( m_Descriptor, out, numBytes, static_cast<off_t>( offset ) );
+    if ( numRead < 0 && errno == EINTR )
+      continue;
+    if ( numRead <= 0 )
+      return false;
+
+    out += numRead;
+    offset += numRead;
+    numBytes -= numRead;
+    }
+
+  return true;
+}
+
+const char* MINCRawFile::Map( unsigned long long offset, size_t numBytes )
+{
+  this->Unmap();
+  if ( ! this->IsOpen() || numBytes == 0 )
+    return 0;
+
+  // Pages past the end of the file cannot be touched
+  struct stat status;
+  if ( fstat( m_Descriptor, &status ) != 0
+       || offset + numBytes > static_cast<unsigned long long>( status.st_size ) )
+    {
+    return 0;
+    }
+
+  const unsigned long long pageSize = sysconf( _SC_PAGESIZE );
+  const unsigned long long start = offset - offset % pageSize;
+
+  m_MapBytes = static_cast<size_t>( offset + numBytes - start );
+  void* mapStart = mmap( 0, m_MapBytes, PROT_READ, MAP_SHARED, m_Descriptor,
+			 static_cast<off_t>( start ) );
+  if ( mapStart == MAP_FAILED )
+    {
+    m_MapBytes = 0;
+    return 0;
+    }
+
+  m_MapStart = mapStart;
+  m_MappedData = static_cast<const char*>( m_MapStart ) + ( offset - start );
+  return m_MappedData;
+}
+
+void MINCRawFile::Unmap()
+{
+  if ( m_MapStart )
+    munmap( m_MapStart, m_MapBytes );
+
+  m_MapStart = 0;
+  m_MapBytes = 0;
+  m_MappedData = 0;
+}
+
+#endif
+
+MINCRawFile::~MINCRawFile()
+{
+  this->Close();
+}
+
+} // namespace itk
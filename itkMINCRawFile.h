@@ -0,0 +1,89 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCRawFile.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCRawFile_h
+#define __itkMINCRawFile_h
+
+#include <cstddef>
+
+
+namespace itk
+{
+
+/** \class MINCRawFile
+ *
+ * \brief Read-only access to the bytes of a file at given offsets.
+ *
+ * HDF5 serializes every call, so a single thread would otherwise do
+ * all the reading.  Once the file address of a piece of a dataset is
+ * known, any number of threads can read it through this class at the
+ * same time: reads are positional (pread, or overlapped ReadFile on
+ * Windows) and share no file position.
+ *
+ * A range of the file can also be mapped into memory, so that it is
+ * read straight from the page cache, which processes reading the same
+ * file share.
+ *
+ * \ingroup IOFilters
+ */
+class MINCRawFile
+{
+public:
+  MINCRawFile();
+  ~MINCRawFile();
+
+  // Returns false if the file cannot be opened.
+  bool Open( const char* filename );
+  void Close();
+
+  bool IsOpen() const;
+
+  // Read exactly numBytes at offset into buffer.  Safe to call from
+  // several threads at once.  Returns false on error or end of file.
+  bool Read( unsigned long long offset, size_t numBytes, void* buffer ) const;
+
+  // Map numBytes at offset into memory, read-only, replacing any
+  // mapping made before.  Returns the address of the byte at offset,
+  // or 0 on error.  The mapping lasts until Unmap() or Close().
+  const char* Map( unsigned long long offset, size_t numBytes );
+  void Unmap();
+
+  // The address of the mapped range, or 0 if there is none.
+  const char* GetMappedData() const
+  {
+    return m_MappedData;
+  }
+
+private:
+  MINCRawFile(const MINCRawFile&); //purposely not implemented
+  void operator=(const MINCRawFile&); //purposely not implemented
+
+#ifdef _WIN32
+  void* m_Handle;
+  void* m_Mapping;
+#else
+  int m_Descriptor;
+#endif
+
+  // Start and length of the mapping, which begins on a page boundary
+  // at or before m_MappedData.
+  void* m_MapStart;
+  size_t m_MapBytes;
+  const char* m_MappedData;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCRawFile_h
@@ -0,0 +1,125 @@
+#include "itkMINCReadAhead.h"
+
+#include <algorithm>
+
+
+
+namespace itk {
+
+
+namespace {
+
+// Spare buffers kept for reuse: one being filled while the previous
+// one is consumed.
+const size_t MaximumPoolSize = 2;
+
+} // end of unnamed namespace
+
+
+MINCReadAhead::MINCReadAhead()
+  : m_Threader( MultiThreader::New() ),
+    m_ThreadID( -1 ),
+    m_Dataset( 0 ),
+    m_NumberOfThreads( 1 ),
+    m_Succeeded( false )
+{
+}
+
+MINCReadAhead::~MINCReadAhead()
+{
+  this->Cancel();
+}
+
+ITK_THREAD_RETURN_TYPE MINCReadAhead::ReadThreadCallback( void* arg )
+{
+  MultiThreader::ThreadInfoStruct* info
+    = static_cast<MultiThreader::ThreadInfoStruct*>( arg );
+  MINCReadAhead* self = static_cast<MINCReadAhead*>( info->UserData );
+
+  self->m_Succeeded = self->m_Dataset->ExecuteRead( self->m_Plan, self->m_NumberOfThreads,
+						    self->m_Buffer.empty() ? 0 : &self->m_Buffer[0],
+						    &self->m_Statistics );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+bool MINCReadAhead::Start( const MINCImageDataset* dataset,
+			   const unsigned long starts[],
+			   const unsigned long counts[],
+			   size_t numBytes,
+			   int numberOfThreads )
+{
+  this->Cancel();
+
+  if ( ! dataset->PlanRead( starts, counts, m_Plan ) )
+    return false;
+
+  if ( ! m_Pool.empty() )
+    {
+    m_Buffer.swap( m_Pool.back() );
+    m_Pool.pop_back();
+    }
+  m_Buffer.resize( numBytes );
+
+  m_Dataset = dataset;
+  m_NumberOfThreads = numberOfThreads;
+  m_Succeeded = false;
+  m_Statistics.Reset();
+  m_ThreadID = m_Threader->SpawnThread( ReadThreadCallback, this );
+
+  return m_ThreadID >= 0;
+}
+
+bool MINCReadAhead::Take( const unsigned long starts[],
+			  const unsigned long counts[],
+			  std::vector<char>& buffer,
+			  MINCReadStatistics* statistics )
+{
+  if ( ! this->IsRunning() )
+    return false;
+
+  const bool match = std::equal( m_Plan.starts.begin(), m_Plan.starts.end(), starts )
+    && std::equal( m_Plan.counts.begin(), m_Plan.counts.end(), counts );
+
+  this->Wait();
+
+  if ( ! match || ! m_Succeeded )
+    {
+    this->Recycle( m_Buffer );
+    return false;
+    }
+
+  if ( statistics )
+    statistics->Add( m_Statistics );
+
+  this->Recycle( buffer );
+  buffer.swap( m_Buffer );
+  return true;
+}
+
+void MINCReadAhead::Recycle( std::vector<char>& buffer )
+{
+  if ( ! buffer.empty() && m_Pool.size() < MaximumPoolSize )
+    {
+    m_Pool.push_back( std::vector<char>() );
+    m_Pool.back().swap( buffer );
+    }
+  std::vector<char>().swap( buffer );
+}
+
+void MINCReadAhead::Cancel()
+{
+  if ( ! this->IsRunning() )
+    return;
+
+  this->Wait();
+  this->Recycle( m_Buffer );
+}
+
+void MINCReadAhead::Wait()
+{
+  m_Threader->TerminateThread( m_ThreadID );
+  m_ThreadID = -1;
+}
+
+} // namespace itk
@@ -0,0 +1,107 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCReadAhead.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCReadAhead_h
+#define __itkMINCReadAhead_h
+
+#include "itkMINCImageDataset.h"
+#include "itkMINCReadStatistics.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
+
+
+namespace itk
+{
+
+/** \class MINCReadAhead
+ *
+ * \brief Background read of the hyperslab expected next.
+ *
+ * The read is planned on the calling thread, which makes all the HDF5
+ * calls, and carried out on a spawned thread, which makes none (see
+ * MINCImageDataset::PlanRead()).  Only datasets read around HDF5 can
+ * therefore be read ahead.
+ *
+ * The stored voxels land in a buffer taken from a small pool; buffers
+ * handed back with Recycle() are reused, so a streamed read allocates
+ * nothing once it is under way.
+ *
+ * \ingroup IOFilters
+ */
+class MINCReadAhead
+{
+public:
+  MINCReadAhead();
+  ~MINCReadAhead();
+
+  // Start reading the hyperslab (starts, counts) of dataset, numBytes
+  // in all, on numberOfThreads threads.  A read ahead still running is
+  // discarded first.  Returns false if the dataset cannot be read in
+  // the background.
+  bool Start( const MINCImageDataset* dataset,
+              const unsigned long starts[],
+              const unsigned long counts[],
+              size_t numBytes,
+              int numberOfThreads );
+
+  // If (starts, counts) is the hyperslab being read ahead, wait for
+  // it and swap its stored voxels into buffer, adding the bytes and
+  // chunks it read to statistics, if given.  Returns false, with the
+  // read ahead discarded, if it is another hyperslab or the read
+  // failed.
+  bool Take( const unsigned long starts[],
+             const unsigned long counts[],
+             std::vector<char>& buffer,
+             MINCReadStatistics* statistics = 0 );
+
+  // Hand a buffer back to the pool, leaving buffer empty.
+  void Recycle( std::vector<char>& buffer );
+
+  // Wait for the read ahead, if any, and discard it.  Must be called
+  // before the dataset is closed or reopened.
+  void Cancel();
+
+  bool IsRunning() const
+  {
+    return m_ThreadID >= 0;
+  }
+
+private:
+  MINCReadAhead(const MINCReadAhead&); //purposely not implemented
+  void operator=(const MINCReadAhead&); //purposely not implemented
+
+  static ITK_THREAD_RETURN_TYPE ReadThreadCallback( void* arg );
+
+  // Wait for the spawned thread.
+  void Wait();
+
+  MultiThreader::Pointer m_Threader;
+  int m_ThreadID;
+
+  const MINCImageDataset* m_Dataset;
+  MINCImageDataset::ReadPlan m_Plan;
+  int m_NumberOfThreads;
+  std::vector<char> m_Buffer;
+  bool m_Succeeded;
+  MINCReadStatistics m_Statistics;
+
+  // Spare buffers, at most MaximumPoolSize of them
+  std::vector< std::vector<char> > m_Pool;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCReadAhead_h
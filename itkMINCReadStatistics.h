@@ -0,0 +1,117 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCReadStatistics.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCReadStatistics_h
+#define __itkMINCReadStatistics_h
+
+#include "itkIndent.h"
+
+#include <ostream>
+
+
+namespace itk
+{
+
+/** \struct MINCReadStatistics
+ *
+ * \brief Counters of the work done reading MINC files.
+ *
+ * Bytes read from the file are the raw bytes of the chunks fetched
+ * and the bytes of contiguous data copied, mapped or not; reads left
+ * to HDF5 or libminc are counted as the stored bytes of the
+ * hyperslab.  Chunks found in the chunk cache are neither read nor
+ * decompressed.  Times are in seconds; those of reads made by
+ * libminc include the conversion to real values.
+ *
+ * \ingroup IOFilters
+ */
+struct MINCReadStatistics
+{
+  MINCReadStatistics()
+  {
+    this->Reset();
+  }
+
+  // Files opened, and calls to Read()
+  unsigned long numberOfOpens;
+  unsigned long numberOfReads;
+
+  // Bytes handed to the caller, and read from the file to that end
+  unsigned long long bytesRequested;
+  unsigned long long bytesRead;
+
+  unsigned long long chunksRead;
+  unsigned long long chunksDecompressed;
+  unsigned long long chunkCacheHits;
+  unsigned long long chunkCacheMisses;
+
+  // Opening the file, reading its metadata, reading the stored voxels
+  // and converting them
+  double openTime;
+  double metadataTime;
+  double readTime;
+  double conversionTime;
+
+  void Reset()
+  {
+    numberOfOpens = numberOfReads = 0;
+    bytesRequested = bytesRead = 0;
+    chunksRead = chunksDecompressed = chunkCacheHits = chunkCacheMisses = 0;
+    openTime = metadataTime = readTime = conversionTime = 0.0;
+  }
+
+  void Add( const MINCReadStatistics& other )
+  {
+    numberOfOpens += other.numberOfOpens;
+    numberOfReads += other.numberOfReads;
+    bytesRequested += other.bytesRequested;
+    bytesRead += other.bytesRead;
+    chunksRead += other.chunksRead;
+    chunksDecompressed += other.chunksDecompressed;
+    chunkCacheHits += other.chunkCacheHits;
+    chunkCacheMisses += other.chunkCacheMisses;
+    openTime += other.openTime;
+    metadataTime += other.metadataTime;
+    readTime += other.readTime;
+    conversionTime += other.conversionTime;
+  }
+
+  // Bytes read per byte requested; 0 before anything is requested.
+  double GetReadAmplification() const
+  {
+    return bytesRequested == 0 ? 0.0 : static_cast<double>( bytesRead ) / bytesRequested;
+  }
+
+  void Print( std::ostream& os, Indent indent ) const
+  {
+    os << indent << "NumberOfOpens: " << numberOfOpens << "\n";
+    os << indent << "NumberOfReads: " << numberOfReads << "\n";
+    os << indent << "BytesRequested: " << bytesRequested << "\n";
+    os << indent << "BytesRead: " << bytesRead << "\n";
+    os << indent << "ReadAmplification: " << this->GetReadAmplification() << "\n";
+    os << indent << "ChunksRead: " << chunksRead << "\n";
+    os << indent << "ChunksDecompressed: " << chunksDecompressed << "\n";
+    os << indent << "ChunkCacheHits: " << chunkCacheHits << "\n";
+    os << indent << "ChunkCacheMisses: " << chunkCacheMisses << "\n";
+    os << indent << "OpenTime: " << openTime << "\n";
+    os << indent << "MetadataTime: " << metadataTime << "\n";
+    os << indent << "ReadTime: " << readTime << "\n";
+    os << indent << "ConversionTime: " << conversionTime << "\n";
+  }
+};
+
+} // end namespace itk
+
+#endif // __itkMINCReadStatistics_h
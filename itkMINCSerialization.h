@@ -0,0 +1,128 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCSerialization.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCSerialization_h
+#define __itkMINCSerialization_h
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace itk
+{
+
+// Binary files kept alongside MINC files, such as catalog indices and
+// cached headers, hold fixed-size values in native byte order, and
+// strings and vectors preceded by their length.  Reads return false
+// at the end of the stream; a corrupt length fails there too rather
+// than allocating it all.
+namespace MINCSerialization
+{
+
+template< class T >
+void WriteValue( std::ostream& out, const T& value )
+{
+  out.write( reinterpret_cast<const char*>( &value ), sizeof( T ) );
+}
+
+template< class T >
+bool ReadValue( std::istream& in, T& value )
+{
+  return static_cast<bool>( in.read( reinterpret_cast<char*>( &value ), sizeof( T ) ) );
+}
+
+inline void WriteString( std::ostream& out, const std::string& value )
+{
+  WriteValue( out, static_cast<unsigned int>( value.size() ) );
+  out.write( value.data(), value.size() );
+}
+
+inline bool ReadString( std::istream& in, std::string& value )
+{
+  unsigned int size;
+  if ( ! ReadValue( in, size ) )
+    return false;
+
+  value.clear();
+  char piece[4096];
+  while( size > 0 )
+    {
+    const unsigned int numBytes = std::min<unsigned int>( size, sizeof( piece ) );
+    if ( ! in.read( piece, numBytes ) )
+      return false;
+    value.append( piece, numBytes );
+    size -= numBytes;
+    }
+  return true;
+}
+
+// Elements are stored as TStored
+template< class TStored, class T >
+void WriteVector( std::ostream& out, const std::vector<T>& values )
+{
+  WriteValue( out, static_cast<unsigned int>( values.size() ) );
+  for( size_t i = 0; i < values.size(); ++i )
+    WriteValue( out, static_cast<TStored>( values[i] ) );
+}
+
+template< class TStored, class T >
+bool ReadVector( std::istream& in, std::vector<T>& values )
+{
+  unsigned int size;
+  if ( ! ReadValue( in, size ) )
+    return false;
+
+  values.clear();
+  for( unsigned int i = 0; i < size; ++i )
+    {
+    TStored value;
+    if ( ! ReadValue( in, value ) )
+      return false;
+    values.push_back( static_cast<T>( value ) );
+    }
+  return true;
+}
+
+inline void WriteStrings( std::ostream& out, const std::vector<std::string>& values )
+{
+  WriteValue( out, static_cast<unsigned int>( values.size() ) );
+  for( size_t i = 0; i < values.size(); ++i )
+    WriteString( out, values[i] );
+}
+
+inline bool ReadStrings( std::istream& in, std::vector<std::string>& values )
+{
+  unsigned int size;
+  if ( ! ReadValue( in, size ) )
+    return false;
+
+  values.clear();
+  for( unsigned int i = 0; i < size; ++i )
+    {
+    values.push_back( std::string() );
+    if ( ! ReadString( in, values.back() ) )
+      return false;
+    }
+  return true;
+}
+
+} // end namespace MINCSerialization
+
+} // end namespace itk
+
+#endif // __itkMINCSerialization_h
@@ -0,0 +1,329 @@
+#include "itkMINCVolumeCache.h"
+#include "itkMINCFileStamp.h"
+#include "itkMutexLockHolder.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <list>
+#include <string>
+
+
+
+namespace itk {
+
+
+namespace {
+
+struct VolumeEntry
+{
+  VolumeEntry( const MINCFileStamp& fileStamp ) : stamp( fileStamp ) {}
+
+  unsigned long id;
+  std::string filename;
+  MINCFileStamp stamp;
+
+  mihandle_t volume;
+  std::vector<midimhandle_t> dimensions;
+
+  // Held by a user of the handle between Lock() and Unlock()
+  SimpleFastMutexLock* lock;
+
+  unsigned int numberOfUsers;
+  unsigned long lastUse;
+
+  // Set once the file has changed or the entry was invalidated; the
+  // handle is then closed as soon as it is idle.
+  bool stale;
+
+  // Set once the handle was closed while still acquired; the entry is
+  // kept until its last user releases it.
+  bool closed;
+};
+
+typedef std::list<VolumeEntry> VolumeListType;
+
+VolumeListType Volumes;
+unsigned long UseClock = 0;
+unsigned long LastID = 0;
+unsigned int MaximumNumberOfIdleVolumes = 8;
+SimpleFastMutexLock VolumesLock;
+
+// Open filename and read its dimensions into entry.
+bool OpenVolume( const char* filename, VolumeEntry& entry )
+{
+  if ( miopen_volume( filename, MI2_OPEN_READ, &entry.volume ) == MI_ERROR )
+    return false;
+
+  // Irregularly sampled dimensions (typically time) are dimensions of
+  // the image like any other.
+  int numDimensions;
+  if ( miget_volume_dimension_count( entry.volume, MI_DIMCLASS_ANY,
+				     MI_DIMATTR_ALL, &numDimensions ) == MI_ERROR
+       || numDimensions <= 0 )
+    {
+    miclose_volume( entry.volume );
+    return false;
+    }
+
+  entry.dimensions.resize( numDimensions );
+  if ( miget_volume_dimensions( entry.volume, MI_DIMCLASS_ANY, MI_DIMATTR_ALL,
+				MI_DIMORDER_FILE, numDimensions, &entry.dimensions[0] ) == MI_ERROR )
+    {
+    miclose_volume( entry.volume );
+    return false;
+    }
+
+  return true;
+}
+
+// Close the handle of an entry and remove it.  Caller holds the lock.
+VolumeListType::iterator CloseEntry( VolumeListType::iterator entry )
+{
+  if ( ! entry->closed )
+    miclose_volume( entry->volume );
+  delete entry->lock;
+  return Volumes.erase( entry );
+}
+
+// Caller holds the lock.
+VolumeListType::iterator FindEntry( unsigned long id )
+{
+  VolumeListType::iterator v = Volumes.begin();
+  while( v != Volumes.end() && v->id != id )
+    ++v;
+  return v;
+}
+
+// Drop a user of an entry, closing it if stale and now idle.  Caller
+// holds the lock.
+void ReleaseEntry( VolumeListType::iterator entry )
+{
+  --entry->numberOfUsers;
+  entry->lastUse = ++UseClock;
+  if ( entry->stale && entry->numberOfUsers == 0 )
+    CloseEntry( entry );
+}
+
+// Close the least recently used idle handles beyond the limit.
+// Caller holds the lock.
+void EvictIdleVolumes()
+{
+  for( ;; )
+    {
+    unsigned int numIdle = 0;
+    VolumeListType::iterator oldest = Volumes.end();
+    for( VolumeListType::iterator v = Volumes.begin(); v != Volumes.end(); ++v )
+      {
+      if ( v->numberOfUsers > 0 )
+	continue;
+      ++numIdle;
+      if ( oldest == Volumes.end() || v->lastUse < oldest->lastUse )
+	oldest = v;
+      }
+
+    if ( numIdle <= MaximumNumberOfIdleVolumes )
+      return;
+    CloseEntry( oldest );
+    }
+}
+
+// Mark an entry stale, closing it if idle.  Caller holds the lock.
+VolumeListType::iterator RetireEntry( VolumeListType::iterator entry )
+{
+  entry->stale = true;
+  if ( entry->numberOfUsers == 0 )
+    return CloseEntry( entry );
+  return ++entry;
+}
+
+// Close the handles of filename, or of every file if null.  Handles
+// still acquired are closed once their current user, if any, unlocks
+// them; meanwhile a use of our own keeps the entry.
+void CloseVolumes( const char* filename )
+{
+  std::vector<unsigned long> busy;
+  {
+  MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+
+  for( VolumeListType::iterator v = Volumes.begin(); v != Volumes.end(); )
+    {
+    if ( v->closed || ( filename && v->filename != filename ) )
+      {
+      ++v;
+      continue;
+      }
+
+    v->stale = true;
+    if ( v->numberOfUsers == 0 )
+      {
+      v = CloseEntry( v );
+      continue;
+      }
+
+    ++v->numberOfUsers;
+    busy.push_back( v->id );
+    ++v;
+    }
+  }
+
+  for( unsigned int i = 0; i < busy.size(); ++i )
+    {
+    SimpleFastMutexLock* lock;
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+    lock = FindEntry( busy[i] )->lock;
+    }
+
+    {
+    MutexLockHolder<SimpleFastMutexLock> userHolder( *lock );
+    MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+    VolumeListType::iterator v = FindEntry( busy[i] );
+    if ( ! v->closed )
+      {
+      miclose_volume( v->volume );
+      v->closed = true;
+      }
+    }
+
+    MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+    ReleaseEntry( FindEntry( busy[i] ) );
+    }
+}
+
+} // end of unnamed namespace
+
+
+bool MINCVolumeCache::Acquire( const char* filename,
+			       unsigned long* id,
+			       mihandle_t* volume,
+			       std::vector<midimhandle_t>* dimensions )
+{
+  MINCFileStamp stamp;
+  if ( ! filename || ! stamp.Read( filename ) )
+    return false;
+
+  MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+
+  for( VolumeListType::iterator v = Volumes.begin(); v != Volumes.end(); )
+    {
+    if ( v->stale || v->filename != filename )
+      {
+      ++v;
+      continue;
+      }
+
+    if ( ! ( v->stamp == stamp ) )
+      {
+      v = RetireEntry( v );
+      continue;
+      }
+
+    ++v->numberOfUsers;
+    *id = v->id;
+    *volume = v->volume;
+    *dimensions = v->dimensions;
+    return true;
+    }
+
+  VolumeEntry entry( stamp );
+  if ( ! OpenVolume( filename, entry ) )
+    return false;
+
+  entry.id = ++LastID;
+  entry.filename = filename;
+  entry.lock = new SimpleFastMutexLock;
+  entry.numberOfUsers = 1;
+  entry.lastUse = ++UseClock;
+  entry.stale = false;
+  entry.closed = false;
+  Volumes.push_back( entry );
+
+  *id = entry.id;
+  *volume = entry.volume;
+  *dimensions = entry.dimensions;
+  return true;
+}
+
+void MINCVolumeCache::Release( unsigned long id )
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+
+  VolumeListType::iterator v = FindEntry( id );
+  if ( v != Volumes.end() && v->numberOfUsers > 0 )
+    ReleaseEntry( v );
+
+  EvictIdleVolumes();
+}
+
+bool MINCVolumeCache::Lock( unsigned long id )
+{
+  SimpleFastMutexLock* lock;
+  {
+  MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+  VolumeListType::iterator v = FindEntry( id );
+  if ( v == Volumes.end() || v->closed )
+    return false;
+  lock = v->lock;
+  }
+
+  // The entry stays while acquired, but its handle may be closed while
+  // we wait
+  lock->Lock();
+
+  MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+  if ( FindEntry( id )->closed )
+    {
+    lock->Unlock();
+    return false;
+    }
+  return true;
+}
+
+void MINCVolumeCache::Unlock( unsigned long id )
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+
+  VolumeListType::iterator v = FindEntry( id );
+  if ( v != Volumes.end() )
+    v->lock->Unlock();
+}
+
+void MINCVolumeCache::Invalidate( const char* filename )
+{
+  if ( filename )
+    CloseVolumes( filename );
+}
+
+void MINCVolumeCache::Clear()
+{
+  CloseVolumes( 0 );
+}
+
+void MINCVolumeCache::SetMaximumNumberOfIdleVolumes( unsigned int maximum )
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+
+  MaximumNumberOfIdleVolumes = maximum;
+  EvictIdleVolumes();
+}
+
+unsigned int MINCVolumeCache::GetMaximumNumberOfIdleVolumes()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+
+  return MaximumNumberOfIdleVolumes;
+}
+
+unsigned int MINCVolumeCache::GetNumberOfOpenVolumes()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder( VolumesLock );
+
+  unsigned int numOpen = 0;
+  for( VolumeListType::const_iterator v = Volumes.begin(); v != Volumes.end(); ++v )
+    {
+    if ( ! v->closed )
+      ++numOpen;
+    }
+  return numOpen;
+}
+
+} // namespace itk
@@ -0,0 +1,117 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCVolumeCache.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCVolumeCache_h
+#define __itkMINCVolumeCache_h
+
+#include <vector>
+
+extern "C" {
+#include <minc2.h>
+}
+
+
+namespace itk
+{
+
+/** \class MINCVolumeCache
+ *
+ * \brief Process-wide cache of MINC files open for reading.
+ *
+ * Every reader of a file, and every call to ReadImageInformation(),
+ * would otherwise open the file again.  Here a handle is shared by all
+ * users of the same file for as long as the file's size and
+ * modification time do not change, together with the handles of its
+ * dimensions.
+ *
+ * Libminc is not thread-safe, so a shared handle is only used between
+ * Lock() and Unlock(), which let one of its users in at a time.
+ *
+ * Released handles stay open until more than
+ * GetMaximumNumberOfIdleVolumes() of them are idle, at which point the
+ * least recently used ones are closed.  Invalidate() closes the handles
+ * of a file even if they are still acquired, so that the file can be
+ * rewritten; their users then fail to Lock() them.
+ *
+ * \ingroup IOFilters
+ */
+class MINCVolumeCache
+{
+public:
+  // Open filename for reading, or share the handle already open for
+  // it, and get all its dimensions in file order.  The id stands for
+  // the handle in the calls below; each successful call must be
+  // matched by a call to Release().  Returns false if the file cannot
+  // be opened.
+  static bool Acquire( const char* filename,
+                       unsigned long* id,
+                       mihandle_t* volume,
+                       std::vector<midimhandle_t>* dimensions );
+
+  static void Release( unsigned long id );
+
+  // Wait until no other user of the handle is between Lock() and
+  // Unlock().  Returns false, without locking, if the handle was closed
+  // by Invalidate() since it was acquired.
+  static bool Lock( unsigned long id );
+  static void Unlock( unsigned long id );
+
+  // Holds the lock on a handle for as long as it exists.
+  class LockHolder
+  {
+  public:
+    explicit LockHolder( unsigned long id )
+      : m_ID( id ), m_Locked( MINCVolumeCache::Lock( id ) )
+    {
+    }
+
+    ~LockHolder()
+    {
+      if ( m_Locked )
+        MINCVolumeCache::Unlock( m_ID );
+    }
+
+    bool IsLocked() const { return m_Locked; }
+
+  private:
+    LockHolder( const LockHolder& ); //purposely not implemented
+    void operator=( const LockHolder& ); //purposely not implemented
+
+    unsigned long m_ID;
+    bool m_Locked;
+  };
+
+  // Close the handles of filename, e.g. because the file is about to
+  // be rewritten.  Handles still acquired are closed as soon as no
+  // user holds their lock, and are not handed out again.
+  static void Invalidate( const char* filename );
+
+  // Invalidate every file.
+  static void Clear();
+
+  // Zero closes handles as soon as they are released.
+  static void SetMaximumNumberOfIdleVolumes( unsigned int maximum );
+  static unsigned int GetMaximumNumberOfIdleVolumes();
+
+  // Handles currently open, in use or not.
+  static unsigned int GetNumberOfOpenVolumes();
+
+private:
+  MINCVolumeCache(); //purposely not implemented
+};
+
+} // end namespace itk
+
+#endif // __itkMINCVolumeCache_h
@@ -0,0 +1,699 @@
+#include "itkMINCVolumeGenerator.h"
+#include "itkMINCImageDataset.h"
+#include "itkMINCNetCDFWriter.h"
+#include "itkMINCVolumeCache.h"
+#include "itkMINCVoxelRescaler.h"
+#include "itkMultiThreader.h"
+
+#include <algorithm>
+#include <limits>
+#include <ostream>
+
+extern "C" {
+#include <minc2.h>
+}
+
+
+
+namespace itk {
+
+
+namespace {
+
+// MINC type of the stored components, or MI_TYPE_UNKNOWN
+mitype_t ConvertComponentTypeToMINC( ImageIOBase::IOComponentType componentType )
+{
+  switch( componentType )
+    {
+    case ImageIOBase::UCHAR:
+      return MI_TYPE_UBYTE;
+    case ImageIOBase::CHAR:
+      return MI_TYPE_BYTE;
+    case ImageIOBase::USHORT:
+      return MI_TYPE_USHORT;
+    case ImageIOBase::SHORT:
+      return MI_TYPE_SHORT;
+    case ImageIOBase::UINT:
+      return MI_TYPE_UINT;
+    case ImageIOBase::INT:
+      return MI_TYPE_INT;
+    case ImageIOBase::FLOAT:
+      return MI_TYPE_FLOAT;
+    case ImageIOBase::DOUBLE:
+      return MI_TYPE_DOUBLE;
+    default:
+      return MI_TYPE_UNKNOWN;
+    }
+}
+
+// Range of an integer component type.  Returns false for floating
+// point types.
+template<class T>
+bool GetRange( double& minimum, double& maximum )
+{
+  minimum = std::numeric_limits<T>::min();
+  maximum = std::numeric_limits<T>::max();
+  return std::numeric_limits<T>::is_integer;
+}
+
+bool GetComponentTypeRange( ImageIOBase::IOComponentType componentType,
+			    double& minimum, double& maximum )
+{
+  switch( componentType )
+    {
+    case ImageIOBase::UCHAR:
+      return GetRange<unsigned char>( minimum, maximum );
+    case ImageIOBase::CHAR:
+      return GetRange<signed char>( minimum, maximum );
+    case ImageIOBase::USHORT:
+      return GetRange<unsigned short>( minimum, maximum );
+    case ImageIOBase::SHORT:
+      return GetRange<short>( minimum, maximum );
+    case ImageIOBase::UINT:
+      return GetRange<unsigned int>( minimum, maximum );
+    case ImageIOBase::INT:
+      return GetRange<int>( minimum, maximum );
+    default:
+      return false;
+    }
+}
+
+size_t ComponentSize( ImageIOBase::IOComponentType componentType )
+{
+  switch( componentType )
+    {
+    case ImageIOBase::UCHAR:
+    case ImageIOBase::CHAR:
+      return 1;
+    case ImageIOBase::USHORT:
+    case ImageIOBase::SHORT:
+      return 2;
+    case ImageIOBase::UINT:
+    case ImageIOBase::INT:
+    case ImageIOBase::FLOAT:
+      return 4;
+    default:
+      return 8;
+    }
+}
+
+// netCDF type of the stored components, and whether they are
+// unsigned.  Returns false for unsupported types.
+bool ConvertComponentTypeToNetCDF( ImageIOBase::IOComponentType componentType,
+				   MINCNetCDFFile::DataType& type,
+				   bool& isUnsigned )
+{
+  isUnsigned = componentType == ImageIOBase::UCHAR
+    || componentType == ImageIOBase::USHORT
+    || componentType == ImageIOBase::UINT;
+
+  switch( componentType )
+    {
+    case ImageIOBase::UCHAR:
+    case ImageIOBase::CHAR:
+      type = MINCNetCDFFile::Byte;
+      return true;
+    case ImageIOBase::USHORT:
+    case ImageIOBase::SHORT:
+      type = MINCNetCDFFile::Short;
+      return true;
+    case ImageIOBase::UINT:
+    case ImageIOBase::INT:
+      type = MINCNetCDFFile::Int;
+      return true;
+    case ImageIOBase::FLOAT:
+      type = MINCNetCDFFile::Float;
+      return true;
+    case ImageIOBase::DOUBLE:
+      type = MINCNetCDFFile::Double;
+      return true;
+    default:
+      return false;
+    }
+}
+
+midimclass_t GetDimensionClass( const std::string& name )
+{
+  if ( name == "xspace" || name == "yspace" || name == "zspace" )
+    return MI_DIMCLASS_SPATIAL;
+  if ( name == "time" )
+    return MI_DIMCLASS_TIME;
+  if ( name == "xfrequency" || name == "yfrequency" || name == "zfrequency" )
+    return MI_DIMCLASS_SFREQUENCY;
+  if ( name == "tfrequency" )
+    return MI_DIMCLASS_TFREQUENCY;
+  if ( name == "vector_dimension" )
+    return MI_DIMCLASS_RECORD;
+  return MI_DIMCLASS_USER;
+}
+
+// Uniform value in [0, 1] for a voxel and a seed: a hash of both, so
+// that it does not depend on the order voxels are generated in.
+double Hash( unsigned long long voxel, unsigned int seed )
+{
+  unsigned long long h = voxel * 0x9E3779B97F4A7C15ULL + seed;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return static_cast<double>( h >> 11 ) / static_cast<double>( ( 1ULL << 53 ) - 1 );
+}
+
+// Attributes every MINC1 variable starts with
+void AddStandardAttributes( MINCNetCDFWriter& writer, unsigned int variable, const char* varType )
+{
+  writer.AddAttribute( variable, "varid", "MINC standard variable" );
+  writer.AddAttribute( variable, "vartype", varType );
+  writer.AddAttribute( variable, "version", "MINC Version    1.0" );
+}
+
+// Voxels per slab written: 8M doubles are staged at a time.
+const size_t SlabVoxels = 8 << 20;
+
+} // end of unnamed namespace
+
+
+MINCVolumeGenerator::MINCVolumeGenerator()
+  : m_ComponentType( ImageIOBase::UCHAR ),
+    m_Labels( false ),
+    m_RealMin( 0.0 ),
+    m_RealMax( 1.0 ),
+    m_RealRangeSet( false ),
+    m_SliceScaling( false ),
+    m_CompressionLevel( 0 ),
+    m_FillPattern( Ramp ),
+    m_Seed( 0 ),
+    m_FileFormat( MINC2Format ),
+    m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() )
+{
+}
+
+void MINCVolumeGenerator::AddDimension( const std::string& name,
+					unsigned long size,
+					double start,
+					double step )
+{
+  Dimension dimension;
+  dimension.name = name;
+  dimension.size = size;
+  dimension.start = start;
+  dimension.step = step;
+  dimension.hasCosines = false;
+  dimension.cosines[0] = dimension.cosines[1] = dimension.cosines[2] = 0.0;
+  m_Dimensions.push_back( dimension );
+}
+
+void MINCVolumeGenerator::ClearDimensions()
+{
+  m_Dimensions.clear();
+}
+
+void MINCVolumeGenerator::SetDimensionCosines( unsigned int d, const double cosines[3] )
+{
+  m_Dimensions[d].hasCosines = true;
+  std::copy( cosines, cosines + 3, m_Dimensions[d].cosines );
+}
+
+void MINCVolumeGenerator::SetDimensionOffsets( unsigned int d,
+					       const std::vector<double>& offsets,
+					       const std::vector<double>& widths )
+{
+  m_Dimensions[d].offsets = offsets;
+  m_Dimensions[d].widths = widths;
+}
+
+double MINCVolumeGenerator::GetFillValue( const unsigned long index[] ) const
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+
+  unsigned long long voxel = 0;
+  double gradient = 0.0;
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    voxel = voxel * m_Dimensions[d].size + index[d];
+    if ( m_Dimensions[d].size > 1 )
+      gradient += static_cast<double>( index[d] ) / ( m_Dimensions[d].size - 1 );
+    }
+  gradient /= numDimensions;
+
+  switch( m_FillPattern )
+    {
+    case Ramp:
+      return ( voxel % 256 ) / 255.0;
+    case Gradient:
+      return gradient;
+    case Noise:
+      return Hash( voxel, m_Seed );
+    default:
+      return 0.875 * gradient + 0.125 * Hash( voxel, m_Seed );
+    }
+}
+
+unsigned long MINCVolumeGenerator::ComputeChunkSize( unsigned int d ) const
+{
+  const unsigned long size = m_Dimensions[d].size;
+
+  if ( d < m_ChunkSize.size() )
+    return m_ChunkSize[d] == 0 ? size : std::min( m_ChunkSize[d], size );
+
+  if ( m_ChunkSize.empty() && m_CompressionLevel <= 0 )
+    return 0;
+
+  return std::min( 32UL, size );
+}
+
+void MINCVolumeGenerator::FillRows( unsigned long firstRow,
+				    unsigned long numRows,
+				    double* values ) const
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  const unsigned long rowSize = m_Dimensions[numDimensions - 1].size;
+
+  std::vector<unsigned long> index( numDimensions, 0 );
+  unsigned long row = firstRow;
+  for( int d = static_cast<int>( numDimensions ) - 2; d >= 0; --d )
+    {
+    index[d] = row % m_Dimensions[d].size;
+    row /= m_Dimensions[d].size;
+    }
+
+  for( unsigned long r = 0; r < numRows; ++r )
+    {
+    for( index[numDimensions - 1] = 0; index[numDimensions - 1] < rowSize; ++index[numDimensions - 1] )
+      *values++ = this->GetFillValue( &index[0] );
+
+    for( int d = static_cast<int>( numDimensions ) - 2; d >= 0; --d )
+      {
+      if ( ++index[d] < m_Dimensions[d].size )
+	break;
+      index[d] = 0;
+      }
+    }
+}
+
+void MINCVolumeGenerator::ComputeSliceRanges( double realMin, double realMax,
+					      std::vector<double>& sliceMin,
+					      std::vector<double>& sliceMax ) const
+{
+  // Slices span the two fastest-varying dimensions other than the
+  // components
+  unsigned int numDimensions = this->GetNumberOfDimensions();
+  if ( m_Dimensions[numDimensions - 1].name == "vector_dimension" )
+    --numDimensions;
+
+  size_t numSlices = 1;
+  for( unsigned int d = 0; d + 2 < numDimensions; ++d )
+    numSlices *= m_Dimensions[d].size;
+
+  sliceMin.assign( numSlices, realMin );
+  sliceMax.resize( numSlices );
+  for( size_t s = 0; s < numSlices; ++s )
+    sliceMax[s] = realMin + ( realMax - realMin ) * ( s + 1 ) / numSlices;
+}
+
+bool MINCVolumeGenerator::Write( const char* filename ) const
+{
+  for( unsigned int d = 0; d < this->GetNumberOfDimensions(); ++d )
+    {
+    if ( m_Dimensions[d].size == 0 )
+      return false;
+    }
+
+  if ( m_FileFormat == MINC1Format )
+    return this->WriteMINC1( filename );
+
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  const mitype_t dataType = ConvertComponentTypeToMINC( m_ComponentType );
+  if ( numDimensions == 0 || dataType == MI_TYPE_UNKNOWN )
+    return false;
+
+  double typeMin, typeMax;
+  const bool integerType = GetComponentTypeRange( m_ComponentType, typeMin, typeMax );
+  if ( m_Labels && ! integerType )
+    return false;
+
+  const bool sliceScaling = m_SliceScaling && integerType && ! m_Labels;
+
+  double realMin = m_RealMin, realMax = m_RealMax;
+  if ( ! m_RealRangeSet && integerType )
+    {
+    realMin = typeMin;
+    realMax = typeMax;
+    }
+
+  std::vector<midimhandle_t> dimensions( numDimensions );
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    const Dimension& dimension = m_Dimensions[d];
+    const bool irregular = ! dimension.offsets.empty();
+    const midimclass_t dimClass = GetDimensionClass( dimension.name );
+
+    if ( micreate_dimension( dimension.name.c_str(), dimClass,
+			     irregular ? MI_DIMATTR_NOT_REGULARLY_SAMPLED : MI_DIMATTR_REGULARLY_SAMPLED,
+			     dimension.size, &dimensions[d] ) == MI_ERROR )
+      {
+      return false;
+      }
+
+    if ( irregular )
+      {
+      miset_dimension_offsets( dimensions[d], dimension.size, 0, &dimension.offsets[0] );
+      if ( ! dimension.widths.empty() )
+	miset_dimension_widths( dimensions[d], dimension.size, 0, &dimension.widths[0] );
+      }
+    else
+      {
+      miset_dimension_separation( dimensions[d], dimension.step );
+      miset_dimension_start( dimensions[d], dimension.start );
+      }
+
+    if ( dimClass == MI_DIMCLASS_SPATIAL && dimension.hasCosines )
+      miset_dimension_cosines( dimensions[d], dimension.cosines );
+    }
+
+  // Chunking and compression
+  mivolumeprops_t props;
+  if ( minew_volume_props( &props ) == MI_ERROR )
+    return false;
+
+  if ( m_CompressionLevel > 0 )
+    {
+    miset_props_compression_type( props, MI_COMPRESS_ZLIB );
+    miset_props_zlib_compression( props, m_CompressionLevel );
+    }
+  else
+    {
+    miset_props_compression_type( props, MI_COMPRESS_NONE );
+    }
+
+  const bool chunked = this->ComputeChunkSize( 0 ) != 0;
+  if ( chunked )
+    {
+    std::vector<int> chunkSize( numDimensions );
+    for( unsigned int d = 0; d < numDimensions; ++d )
+      chunkSize[d] = this->ComputeChunkSize( d );
+    miset_props_blocking( props, numDimensions, &chunkSize[0] );
+    }
+
+  MINCVolumeCache::Invalidate( filename );
+
+  mihandle_t volume;
+  if ( micreate_volume( filename, numDimensions, &dimensions[0], dataType,
+			m_Labels ? MI_CLASS_LABEL : MI_CLASS_REAL, props, &volume ) == MI_ERROR )
+    {
+    mifree_volume_props( props );
+    return false;
+    }
+  mifree_volume_props( props );
+
+  miset_slice_scaling_flag( volume, sliceScaling );
+
+  if ( micreate_volume_image( volume ) == MI_ERROR )
+    {
+    miclose_volume( volume );
+    return false;
+    }
+
+  if ( integerType )
+    {
+    miset_volume_valid_range( volume, typeMax, typeMin );
+    if ( ! sliceScaling && ! m_Labels )
+      miset_volume_range( volume, realMax, realMin );
+    }
+
+  miclose_volume( volume );
+
+  // The voxels, in slabs along dimension 0 made of whole chunks so
+  // that they are compressed in parallel
+  MINCImageDataset dataset;
+  if ( ! dataset.Open( filename, 0, true ) )
+    return false;
+  dataset.SetNumberOfThreads( m_NumberOfThreads );
+
+  size_t sliceVoxels = 1;
+  for( unsigned int d = 1; d < numDimensions; ++d )
+    sliceVoxels *= m_Dimensions[d].size;
+
+  const unsigned long size0 = m_Dimensions[0].size;
+  const unsigned long chunk0 = chunked ? this->ComputeChunkSize( 0 ) : 1;
+  unsigned long thickness = std::max( 1UL, static_cast<unsigned long>( SlabVoxels / sliceVoxels ) );
+  thickness = std::min( size0, std::max( chunk0, thickness / chunk0 * chunk0 ) );
+
+  // Fill values map onto the valid range of integer types, onto the
+  // real range otherwise
+  double slope = realMax - realMin;
+  double intercept = realMin;
+  if ( integerType )
+    {
+    slope = typeMax - typeMin;
+    intercept = typeMin;
+    }
+
+  const size_t rowSize = m_Dimensions[numDimensions - 1].size;
+  const unsigned long rowsPerSlice = sliceVoxels / rowSize;
+
+  std::vector<double> values( thickness * sliceVoxels );
+  std::vector<char> stored( thickness * sliceVoxels * ComponentSize( m_ComponentType ) );
+
+  std::vector<unsigned long> starts( numDimensions, 0 );
+  std::vector<unsigned long> counts( numDimensions );
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    counts[d] = m_Dimensions[d].size;
+
+  for( unsigned long first = 0; first < size0; first += thickness )
+    {
+    starts[0] = first;
+    counts[0] = std::min( thickness, size0 - first );
+
+    const size_t numVoxels = counts[0] * sliceVoxels;
+    this->FillRows( first * rowsPerSlice, counts[0] * rowsPerSlice, &values[0] );
+    MINCVoxelRescaler::Rescale( ImageIOBase::DOUBLE, &values[0], m_ComponentType, &stored[0],
+				numVoxels, slope, intercept );
+
+    if ( ! dataset.WriteHyperslab( &starts[0], &counts[0], &stored[0] ) )
+      return false;
+    }
+
+  if ( ! sliceScaling )
+    return true;
+
+  std::vector<double> sliceMin, sliceMax;
+  this->ComputeSliceRanges( realMin, realMax, sliceMin, sliceMax );
+  const bool rangeWritten = dataset.WriteImageRange( sliceMin, sliceMax );
+  dataset.Close();
+
+  if ( rangeWritten )
+    return true;
+
+  // Fall back on libminc to store the slice ranges
+  if ( miopen_volume( filename, MI2_OPEN_RDWR, &volume ) == MI_ERROR )
+    return false;
+
+  std::vector<unsigned long> position( numDimensions, 0 );
+  const int numSliceDimensions = static_cast<int>( numDimensions ) - 2
+    - ( m_Dimensions[numDimensions - 1].name == "vector_dimension" ? 1 : 0 );
+
+  bool ok = true;
+  for( size_t s = 0; s < sliceMin.size(); ++s )
+    {
+    size_t slice = s;
+    for( int d = numSliceDimensions - 1; d >= 0; --d )
+      {
+      position[d] = slice % m_Dimensions[d].size;
+      slice /= m_Dimensions[d].size;
+      }
+    ok = miset_slice_range( volume, &position[0], numDimensions,
+			    sliceMax[s], sliceMin[s] ) != MI_ERROR && ok;
+    }
+
+  miclose_volume( volume );
+  return ok;
+}
+
+// Writes the voxels of a MINC1 image, slab by slab along its first
+// dimension
+class MINCVolumeGenerator::NetCDFImageSource : public MINCNetCDFWriter::ValueSource
+{
+public:
+  NetCDFImageSource( const MINCVolumeGenerator& generator, double slope, double intercept )
+    : m_Generator( generator ), m_Slope( slope ), m_Intercept( intercept )
+  {
+  }
+
+  virtual bool WriteValues( std::ostream& out, unsigned long first, unsigned long count ) const
+  {
+    size_t sliceVoxels = 1;
+    for( unsigned int d = 1; d < m_Generator.GetNumberOfDimensions(); ++d )
+      sliceVoxels *= m_Generator.m_Dimensions[d].size;
+
+    const unsigned long thickness = std::max( 1UL, static_cast<unsigned long>( SlabVoxels / sliceVoxels ) );
+    for( unsigned long slab = first; slab < first + count; slab += thickness )
+      {
+      if ( ! m_Generator.WriteBigEndianSlab( out, slab, std::min( thickness, first + count - slab ),
+					     m_Slope, m_Intercept ) )
+	{
+	return false;
+	}
+      }
+    return true;
+  }
+
+private:
+  const MINCVolumeGenerator& m_Generator;
+  double m_Slope;
+  double m_Intercept;
+};
+
+bool MINCVolumeGenerator::WriteBigEndianSlab( std::ostream& out,
+					      unsigned long first,
+					      unsigned long count,
+					      double slope,
+					      double intercept ) const
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+
+  size_t sliceVoxels = 1;
+  for( unsigned int d = 1; d < numDimensions; ++d )
+    sliceVoxels *= m_Dimensions[d].size;
+  const unsigned long rowsPerSlice = sliceVoxels / m_Dimensions[numDimensions - 1].size;
+
+  const size_t numVoxels = count * sliceVoxels;
+  const size_t componentSize = ComponentSize( m_ComponentType );
+  std::vector<double> values( numVoxels );
+  std::vector<char> stored( numVoxels * componentSize );
+
+  this->FillRows( first * rowsPerSlice, count * rowsPerSlice, &values[0] );
+  MINCVoxelRescaler::Rescale( ImageIOBase::DOUBLE, &values[0], m_ComponentType, &stored[0],
+			      numVoxels, slope, intercept );
+  MINCNetCDFWriter::SwapToBigEndian( &stored[0], stored.size(), componentSize );
+
+  return out.write( &stored[0], stored.size() ).good();
+}
+
+bool MINCVolumeGenerator::WriteMINC1( const char* filename ) const
+{
+  const unsigned int numDimensions = this->GetNumberOfDimensions();
+  MINCNetCDFFile::DataType dataType;
+  bool isUnsigned;
+  if ( numDimensions == 0 || m_Labels
+       || ! ConvertComponentTypeToNetCDF( m_ComponentType, dataType, isUnsigned ) )
+    {
+    return false;
+    }
+
+  double typeMin, typeMax;
+  const bool integerType = GetComponentTypeRange( m_ComponentType, typeMin, typeMax );
+  const bool sliceScaling = m_SliceScaling && integerType;
+
+  double realMin = m_RealMin, realMax = m_RealMax;
+  if ( ! m_RealRangeSet && integerType )
+    {
+    realMin = typeMin;
+    realMax = typeMax;
+    }
+
+  // A leading time dimension is the record dimension, as in files
+  // written a frame at a time
+  const bool records = m_Dimensions[0].name == "time";
+
+  MINCNetCDFWriter writer;
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    writer.AddDimension( m_Dimensions[d].name, records && d == 0 ? 0UL : m_Dimensions[d].size );
+  if ( records )
+    writer.SetNumberOfRecords( m_Dimensions[0].size );
+
+  // Each dimension is described by the variable named after it, its
+  // widths by another
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    {
+    const Dimension& dimension = m_Dimensions[d];
+    if ( dimension.name == "vector_dimension" )
+      continue;
+
+    const std::vector<unsigned int> along( dimension.offsets.empty() ? 0 : 1, d );
+    const unsigned int variable = writer.AddVariable( dimension.name, MINCNetCDFFile::Double, along );
+    AddStandardAttributes( writer, variable, "dimension____" );
+    if ( dimension.offsets.empty() )
+      {
+      writer.SetValues( variable, &dimension.start, 1 );
+      writer.AddAttribute( variable, "spacing", "regular__" );
+      writer.AddAttribute( variable, "step", &dimension.step, 1 );
+      writer.AddAttribute( variable, "start", &dimension.start, 1 );
+      }
+    else
+      {
+      writer.SetValues( variable, &dimension.offsets[0], dimension.size );
+      writer.AddAttribute( variable, "spacing", "irregular" );
+      }
+    writer.AddAttribute( variable, "alignment", "centre" );
+    if ( GetDimensionClass( dimension.name ) == MI_DIMCLASS_SPATIAL && dimension.hasCosines )
+      writer.AddAttribute( variable, "direction_cosines", dimension.cosines, 3 );
+
+    if ( dimension.widths.empty() )
+      continue;
+
+    const unsigned int widths = writer.AddVariable( dimension.name + "-width", MINCNetCDFFile::Double, along );
+    AddStandardAttributes( writer, widths, "dim-width____" );
+    writer.SetValues( widths, &dimension.widths[0], dimension.size );
+    writer.AddAttribute( widths, "spacing", "irregular" );
+    writer.AddAttribute( widths, "filtertype", "none" );
+    }
+
+  // The real range of integer voxels, over the slices when slice
+  // scaling
+  if ( integerType )
+    {
+    const int numSliceDimensions = static_cast<int>( numDimensions ) - 2
+      - ( m_Dimensions[numDimensions - 1].name == "vector_dimension" ? 1 : 0 );
+
+    std::vector<double> sliceMin( 1, realMin ), sliceMax( 1, realMax );
+    std::vector<unsigned int> sliceDimensions;
+    if ( sliceScaling )
+      {
+      this->ComputeSliceRanges( realMin, realMax, sliceMin, sliceMax );
+      for( int d = 0; d < numSliceDimensions; ++d )
+	sliceDimensions.push_back( d );
+      }
+
+    const unsigned int imageMax = writer.AddVariable( "image-max", MINCNetCDFFile::Double, sliceDimensions );
+    AddStandardAttributes( writer, imageMax, "var_attribute" );
+    writer.SetValues( imageMax, &sliceMax[0], sliceMax.size() );
+
+    const unsigned int imageMin = writer.AddVariable( "image-min", MINCNetCDFFile::Double, sliceDimensions );
+    AddStandardAttributes( writer, imageMin, "var_attribute" );
+    writer.SetValues( imageMin, &sliceMin[0], sliceMin.size() );
+    }
+
+  std::vector<unsigned int> imageDimensions;
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    imageDimensions.push_back( d );
+
+  const unsigned int image = writer.AddVariable( "image", dataType, imageDimensions );
+  AddStandardAttributes( writer, image, "group________" );
+  writer.AddAttribute( image, "complete", "true_" );
+  writer.AddAttribute( image, "signtype", isUnsigned ? "unsigned" : "signed__" );
+  if ( integerType )
+    {
+    const double validRange[2] = { typeMin, typeMax };
+    writer.AddAttribute( image, "valid_range", validRange, 2 );
+    }
+
+  // Fill values map onto the valid range of integer types, onto the
+  // real range otherwise, as in Write()
+  double slope = realMax - realMin;
+  double intercept = realMin;
+  if ( integerType )
+    {
+    slope = typeMax - typeMin;
+    intercept = typeMin;
+    }
+
+  NetCDFImageSource imageSource( *this, slope, intercept );
+  writer.SetValueSource( image, &imageSource );
+
+  MINCVolumeCache::Invalidate( filename );
+  return writer.Write( filename );
+}
+
+} // namespace itk
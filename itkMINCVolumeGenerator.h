@@ -0,0 +1,226 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCVolumeGenerator.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCVolumeGenerator_h
+#define __itkMINCVolumeGenerator_h
+
+#include "itkImageIOBase.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+
+namespace itk
+{
+
+/** \class MINCVolumeGenerator
+ *
+ * \brief Writes synthetic MINC volumes, for tests and benchmarks.
+ *
+ * MINC2 files and their metadata are created through libminc; the
+ * voxels are then written slab by slab through MINCImageDataset, so
+ * that volumes of any size are written with bounded memory and their
+ * chunks compressed in parallel.  MINC1 files are written through
+ * MINCNetCDFWriter, a leading "time" dimension being the record
+ * dimension; they are neither chunked nor compressed, and hold no
+ * labels.
+ *
+ * Each voxel gets a value between 0 and 1 from the fill pattern,
+ * which depends only on its position in the file.  Integer voxels
+ * store that value mapped onto the valid range of their type, and
+ * the image is scaled so that it maps onto the real range; floating
+ * point voxels store the real value itself.  With slice scaling, the
+ * stored values are the same but slice s of n gets the real range
+ * [min, min + (max - min) * (s + 1) / n].
+ *
+ * Dimensions are in file order (slowest-varying first).  A dimension
+ * named "vector_dimension", which must come last, holds the
+ * components of vector voxels.
+ *
+ * \ingroup IOFilters
+ */
+class MINCVolumeGenerator
+{
+public:
+  typedef ImageIOBase::IOComponentType IOComponentType;
+
+  // Ramp repeats 0, 1, ..., 255 (divided by 255) along the file, as
+  // a byte stream piped into rawtominc would.  Gradient rises
+  // smoothly from the first voxel to the last; Noise is uniform and
+  // all but incompressible; NoisyGradient is a gradient with one
+  // eighth of noise, which compresses about as well as real images.
+  typedef enum { Ramp = 0, Gradient, Noise, NoisyGradient } FillPatternType;
+
+  typedef enum { MINC2Format = 0, MINC1Format } FileFormatType;
+
+  MINCVolumeGenerator();
+
+  // Add a regularly sampled dimension after the existing ones.  Its
+  // class follows from its name: "xspace", "yspace" and "zspace" are
+  // spatial, "time" is time, and so on.  A volume with a dimension of
+  // size 0 is not written.
+  void AddDimension( const std::string& name,
+                     unsigned long size,
+                     double start = 0.0,
+                     double step = 1.0 );
+
+  void ClearDimensions();
+
+  unsigned int GetNumberOfDimensions() const
+  {
+    return m_Dimensions.size();
+  }
+
+  // Direction cosines of spatial dimension d.
+  void SetDimensionCosines( unsigned int d, const double cosines[3] );
+
+  // Make dimension d irregularly sampled, with one offset and one
+  // width per sample.
+  void SetDimensionOffsets( unsigned int d,
+                            const std::vector<double>& offsets,
+                            const std::vector<double>& widths );
+
+  // Type of the stored components: any scalar type but LONG and
+  // ULONG.  Defaults to UCHAR.
+  void SetComponentType( IOComponentType componentType )
+  {
+    m_ComponentType = componentType;
+  }
+
+  // Store a label image: no scaling, and an integer type is needed.
+  void SetLabels( bool labels )
+  {
+    m_Labels = labels;
+  }
+
+  // Real range of the image.  By default integer voxels are unscaled,
+  // their real range being the valid range of their type, and
+  // floating point voxels lie in [0, 1].
+  void SetRealRange( double minimum, double maximum )
+  {
+    m_RealMin = minimum;
+    m_RealMax = maximum;
+    m_RealRangeSet = true;
+  }
+
+  // Scale integer voxels slice by slice, as described above.  Off by
+  // default.
+  void SetSliceScaling( bool sliceScaling )
+  {
+    m_SliceScaling = sliceScaling;
+  }
+
+  // Chunk size along each dimension, 0 for the whole dimension.  With
+  // none given, the image is contiguous unless compressed, in which
+  // case chunks are 32 voxels on a side.
+  void SetChunkSize( const std::vector<unsigned long>& chunkSize )
+  {
+    m_ChunkSize = chunkSize;
+  }
+
+  // zlib level from 1 to 9, or 0 for no compression (the default).
+  void SetCompressionLevel( int level )
+  {
+    m_CompressionLevel = level;
+  }
+
+  void SetFillPattern( FillPatternType pattern )
+  {
+    m_FillPattern = pattern;
+  }
+
+  // Seed of the noise patterns.
+  void SetSeed( unsigned int seed )
+  {
+    m_Seed = seed;
+  }
+
+  // MINC2 (the default) or MINC1.
+  void SetFileFormat( FileFormatType format )
+  {
+    m_FileFormat = format;
+  }
+
+  // Threads compressing the chunks.
+  void SetNumberOfThreads( int numberOfThreads )
+  {
+    m_NumberOfThreads = numberOfThreads;
+  }
+
+  // Value between 0 and 1 of the voxel component at index (one value
+  // per dimension) under the fill pattern.
+  double GetFillValue( const unsigned long index[] ) const;
+
+  // Write the volume to filename, replacing any file there.  Returns
+  // false on error, or if a dimension has size 0.
+  bool Write( const char* filename ) const;
+
+private:
+  struct Dimension
+  {
+    std::string name;
+    unsigned long size;
+    double start;
+    double step;
+    bool hasCosines;
+    double cosines[3];
+    std::vector<double> offsets;
+    std::vector<double> widths;
+  };
+
+  // Chunk size along dimension d, or 0 if the image is contiguous.
+  unsigned long ComputeChunkSize( unsigned int d ) const;
+
+  // Write the volume as a MINC1 file.
+  bool WriteMINC1( const char* filename ) const;
+
+  // Hands the image of a MINC1 file to MINCNetCDFWriter.
+  class NetCDFImageSource;
+  friend class NetCDFImageSource;
+
+  // Write slices [first, first + count) along dimension 0 to out,
+  // big-endian as MINC1 stores them.
+  bool WriteBigEndianSlab( std::ostream& out, unsigned long first, unsigned long count,
+                           double slope, double intercept ) const;
+
+  // Fill values of the rows [firstRow, firstRow + numRows), a row
+  // being all the voxels that differ only in the last dimension.
+  void FillRows( unsigned long firstRow, unsigned long numRows, double* values ) const;
+
+  // Real range of each slice when slice scaling, the image's being
+  // [realMin, realMax].
+  void ComputeSliceRanges( double realMin, double realMax,
+                           std::vector<double>& sliceMin,
+                           std::vector<double>& sliceMax ) const;
+
+  std::vector<Dimension> m_Dimensions;
+  IOComponentType m_ComponentType;
+  bool m_Labels;
+  double m_RealMin;
+  double m_RealMax;
+  bool m_RealRangeSet;
+  bool m_SliceScaling;
+  std::vector<unsigned long> m_ChunkSize;
+  int m_CompressionLevel;
+  FillPatternType m_FillPattern;
+  unsigned int m_Seed;
+  FileFormatType m_FileFormat;
+  int m_NumberOfThreads;
+};
+
+} // end namespace itk
+
+#endif // __itkMINCVolumeGenerator_h
@@ -0,0 +1,522 @@
+#include "itkMINCVoxelRescaler.h"
+
+#include <cstring>
+#include <limits>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#  define ITK_MINC_RESCALE_X86 1
+#  define ITK_MINC_SSE41 __attribute__((target("sse4.1")))
+#  define ITK_MINC_AVX2 __attribute__((target("avx2")))
+#  include <immintrin.h>
+#elif defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+#  define ITK_MINC_RESCALE_X86 1
+#  define ITK_MINC_SSE41
+#  define ITK_MINC_AVX2
+#  include <intrin.h>
+#  include <immintrin.h>
+#else
+#  define ITK_MINC_RESCALE_X86 0
+#endif
+
+
+
+namespace itk {
+
+
+namespace {
+
+/**
+ * Convert a real value to a component of type TOut the way libminc
+ * does: integers are clamped to the range of the type and rounded
+ * to nearest, halfway cases away from zero.
+ */
+template <class TOut>
+inline TOut ConvertRealToComponent( double value )
+{
+  if ( ! std::numeric_limits<TOut>::is_integer )
+    return static_cast<TOut>( value );
+
+  if ( value <= static_cast<double>( std::numeric_limits<TOut>::min() ) )
+    return std::numeric_limits<TOut>::min();
+  if ( value >= static_cast<double>( std::numeric_limits<TOut>::max() ) )
+    return std::numeric_limits<TOut>::max();
+
+  return static_cast<TOut>( value >= 0 ? value + 0.5 : value - 0.5 );
+}
+
+/**
+ * Scalar loop over components [first, count).
+ */
+template <class TIn, class TOut>
+void RescaleScalar( const TIn* in, TOut* out, size_t first, size_t count,
+		    double slope, double intercept )
+{
+  if ( slope == 1.0 && intercept == 0.0 )
+    {
+    for( size_t i = first; i < count; ++i )
+      out[i] = ConvertRealToComponent<TOut>( in[i] );
+    }
+  else
+    {
+    for( size_t i = first; i < count; ++i )
+      out[i] = ConvertRealToComponent<TOut>( in[i] * slope + intercept );
+    }
+}
+
+
+#if ITK_MINC_RESCALE_X86
+
+/*
+ * The vector loops work on blocks of four components, which are
+ * converted to doubles, mapped, clamped, truncated towards zero after
+ * adding +-0.5, and converted back.  Each block is loaded whole before
+ * it is stored, which keeps rescaling safe in place and when the input
+ * ends where the output ends (see Rescale()).  Loads and stores never
+ * touch memory outside the block.
+ */
+
+// Four components of a type narrower than 32 bits, or int, widened
+// to 32-bit integers.
+ITK_MINC_SSE41 inline __m128i LoadInt32( const unsigned char* p )
+{
+  int v;
+  std::memcpy( &v, p, 4 );
+  return _mm_cvtepu8_epi32( _mm_cvtsi32_si128( v ) );
+}
+
+ITK_MINC_SSE41 inline __m128i LoadInt32( const signed char* p )
+{
+  int v;
+  std::memcpy( &v, p, 4 );
+  return _mm_cvtepi8_epi32( _mm_cvtsi32_si128( v ) );
+}
+
+ITK_MINC_SSE41 inline __m128i LoadInt32( const unsigned short* p )
+{
+  return _mm_cvtepu16_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( p ) ) );
+}
+
+ITK_MINC_SSE41 inline __m128i LoadInt32( const short* p )
+{
+  return _mm_cvtepi16_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( p ) ) );
+}
+
+ITK_MINC_SSE41 inline __m128i LoadInt32( const int* p )
+{
+  return _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) );
+}
+
+// Unsigned ints are biased by -2^31 to fit in a signed int.
+ITK_MINC_SSE41 inline __m128i LoadInt32Biased( const unsigned int* p )
+{
+  return _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) ),
+			_mm_set1_epi32( static_cast<int>( 0x80000000u ) ) );
+}
+
+// Narrow four in-range 32-bit integers and store them.
+ITK_MINC_SSE41 inline void StoreInt32( unsigned char* p, __m128i v )
+{
+  v = _mm_packus_epi32( v, v );
+  int packed = _mm_cvtsi128_si32( _mm_packus_epi16( v, v ) );
+  std::memcpy( p, &packed, 4 );
+}
+
+ITK_MINC_SSE41 inline void StoreInt32( signed char* p, __m128i v )
+{
+  v = _mm_packs_epi32( v, v );
+  int packed = _mm_cvtsi128_si32( _mm_packs_epi16( v, v ) );
+  std::memcpy( p, &packed, 4 );
+}
+
+ITK_MINC_SSE41 inline void StoreInt32( unsigned short* p, __m128i v )
+{
+  _mm_storel_epi64( reinterpret_cast<__m128i*>( p ), _mm_packus_epi32( v, v ) );
+}
+
+ITK_MINC_SSE41 inline void StoreInt32( short* p, __m128i v )
+{
+  _mm_storel_epi64( reinterpret_cast<__m128i*>( p ), _mm_packs_epi32( v, v ) );
+}
+
+ITK_MINC_SSE41 inline void StoreInt32( int* p, __m128i v )
+{
+  _mm_storeu_si128( reinterpret_cast<__m128i*>( p ), v );
+}
+
+ITK_MINC_SSE41 inline void StoreInt32Biased( unsigned int* p, __m128i v )
+{
+  _mm_storeu_si128( reinterpret_cast<__m128i*>( p ),
+		    _mm_xor_si128( v, _mm_set1_epi32( static_cast<int>( 0x80000000u ) ) ) );
+}
+
+
+namespace sse41 {
+
+// Four doubles in two registers
+struct Vec
+{
+  __m128d lo;
+  __m128d hi;
+};
+
+ITK_MINC_SSE41 inline Vec FromInt32( __m128i v )
+{
+  Vec x;
+  x.lo = _mm_cvtepi32_pd( v );
+  x.hi = _mm_cvtepi32_pd( _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+  return x;
+}
+
+// The values must be integers in the range of int.
+ITK_MINC_SSE41 inline __m128i ToInt32( Vec x )
+{
+  return _mm_unpacklo_epi64( _mm_cvtpd_epi32( x.lo ), _mm_cvtpd_epi32( x.hi ) );
+}
+
+ITK_MINC_SSE41 inline Vec Add( Vec x, __m128d c )
+{
+  x.lo = _mm_add_pd( x.lo, c );
+  x.hi = _mm_add_pd( x.hi, c );
+  return x;
+}
+
+// Clamp to [minimum, maximum] and round halfway cases away from zero.
+ITK_MINC_SSE41 inline Vec ClampRound( Vec x, double minimum, double maximum )
+{
+  const __m128d lo = _mm_set1_pd( minimum );
+  const __m128d hi = _mm_set1_pd( maximum );
+  const __m128d half = _mm_set1_pd( 0.5 );
+  const __m128d sign = _mm_set1_pd( -0.0 );
+
+  x.lo = _mm_min_pd( _mm_max_pd( x.lo, lo ), hi );
+  x.hi = _mm_min_pd( _mm_max_pd( x.hi, lo ), hi );
+  x.lo = _mm_add_pd( x.lo, _mm_or_pd( half, _mm_and_pd( x.lo, sign ) ) );
+  x.hi = _mm_add_pd( x.hi, _mm_or_pd( half, _mm_and_pd( x.hi, sign ) ) );
+  x.lo = _mm_round_pd( x.lo, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC );
+  x.hi = _mm_round_pd( x.hi, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC );
+  return x;
+}
+
+template <class T>
+ITK_MINC_SSE41 inline Vec Load( const T* p )
+{
+  return FromInt32( LoadInt32( p ) );
+}
+
+ITK_MINC_SSE41 inline Vec Load( const unsigned int* p )
+{
+  return Add( FromInt32( LoadInt32Biased( p ) ), _mm_set1_pd( 2147483648.0 ) );
+}
+
+ITK_MINC_SSE41 inline Vec Load( const float* p )
+{
+  const __m128 v = _mm_loadu_ps( p );
+  Vec x;
+  x.lo = _mm_cvtps_pd( v );
+  x.hi = _mm_cvtps_pd( _mm_movehl_ps( v, v ) );
+  return x;
+}
+
+ITK_MINC_SSE41 inline Vec Load( const double* p )
+{
+  Vec x;
+  x.lo = _mm_loadu_pd( p );
+  x.hi = _mm_loadu_pd( p + 2 );
+  return x;
+}
+
+template <class T>
+ITK_MINC_SSE41 inline void Store( T* p, Vec x )
+{
+  x = ClampRound( x, std::numeric_limits<T>::min(), std::numeric_limits<T>::max() );
+  StoreInt32( p, ToInt32( x ) );
+}
+
+ITK_MINC_SSE41 inline void Store( unsigned int* p, Vec x )
+{
+  x = ClampRound( x, 0.0, 4294967295.0 );
+  StoreInt32Biased( p, ToInt32( Add( x, _mm_set1_pd( -2147483648.0 ) ) ) );
+}
+
+ITK_MINC_SSE41 inline void Store( float* p, Vec x )
+{
+  _mm_storeu_ps( p, _mm_movelh_ps( _mm_cvtpd_ps( x.lo ), _mm_cvtpd_ps( x.hi ) ) );
+}
+
+ITK_MINC_SSE41 inline void Store( double* p, Vec x )
+{
+  _mm_storeu_pd( p, x.lo );
+  _mm_storeu_pd( p + 2, x.hi );
+}
+
+// Rescale whole blocks of four; returns the number of components done.
+template <class TIn, class TOut>
+ITK_MINC_SSE41 size_t Rescale( const TIn* in, TOut* out, size_t count,
+			       double slope, double intercept )
+{
+  const __m128d s = _mm_set1_pd( slope );
+  const __m128d c = _mm_set1_pd( intercept );
+  const bool identity = slope == 1.0 && intercept == 0.0;
+
+  size_t i = 0;
+  for( ; i + 4 <= count; i += 4 )
+    {
+    Vec x = Load( in + i );
+    if ( ! identity )
+      {
+      x.lo = _mm_add_pd( _mm_mul_pd( x.lo, s ), c );
+      x.hi = _mm_add_pd( _mm_mul_pd( x.hi, s ), c );
+      }
+    Store( out + i, x );
+    }
+  return i;
+}
+
+} // end namespace sse41
+
+
+namespace avx2 {
+
+typedef __m256d Vec;
+
+ITK_MINC_AVX2 inline Vec ClampRound( Vec x, double minimum, double maximum )
+{
+  const __m256d half = _mm256_set1_pd( 0.5 );
+  const __m256d sign = _mm256_set1_pd( -0.0 );
+
+  x = _mm256_min_pd( _mm256_max_pd( x, _mm256_set1_pd( minimum ) ), _mm256_set1_pd( maximum ) );
+  x = _mm256_add_pd( x, _mm256_or_pd( half, _mm256_and_pd( x, sign ) ) );
+  return _mm256_round_pd( x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC );
+}
+
+template <class T>
+ITK_MINC_AVX2 inline Vec Load( const T* p )
+{
+  return _mm256_cvtepi32_pd( LoadInt32( p ) );
+}
+
+ITK_MINC_AVX2 inline Vec Load( const unsigned int* p )
+{
+  return _mm256_add_pd( _mm256_cvtepi32_pd( LoadInt32Biased( p ) ),
+			_mm256_set1_pd( 2147483648.0 ) );
+}
+
+ITK_MINC_AVX2 inline Vec Load( const float* p )
+{
+  return _mm256_cvtps_pd( _mm_loadu_ps( p ) );
+}
+
+ITK_MINC_AVX2 inline Vec Load( const double* p )
+{
+  return _mm256_loadu_pd( p );
+}
+
+template <class T>
+ITK_MINC_AVX2 inline void Store( T* p, Vec x )
+{
+  x = ClampRound( x, std::numeric_limits<T>::min(), std::numeric_limits<T>::max() );
+  StoreInt32( p, _mm256_cvtpd_epi32( x ) );
+}
+
+ITK_MINC_AVX2 inline void Store( unsigned int* p, Vec x )
+{
+  x = ClampRound( x, 0.0, 4294967295.0 );
+  StoreInt32Biased( p, _mm256_cvtpd_epi32( _mm256_add_pd( x, _mm256_set1_pd( -2147483648.0 ) ) ) );
+}
+
+ITK_MINC_AVX2 inline void Store( float* p, Vec x )
+{
+  _mm_storeu_ps( p, _mm256_cvtpd_ps( x ) );
+}
+
+ITK_MINC_AVX2 inline void Store( double* p, Vec x )
+{
+  _mm256_storeu_pd( p, x );
+}
+
+template <class TIn, class TOut>
+ITK_MINC_AVX2 size_t Rescale( const TIn* in, TOut* out, size_t count,
+			      double slope, double intercept )
+{
+  const __m256d s = _mm256_set1_pd( slope );
+  const __m256d c = _mm256_set1_pd( intercept );
+  const bool identity = slope == 1.0 && intercept == 0.0;
+
+  size_t i = 0;
+  for( ; i + 4 <= count; i += 4 )
+    {
+    Vec x = Load( in + i );
+    if ( ! identity )
+      x = _mm256_add_pd( _mm256_mul_pd( x, s ), c );
+    Store( out + i, x );
+    }
+  return i;
+}
+
+} // end namespace avx2
+
+
+MINCVoxelRescaler::InstructionSetType DetectInstructionSet()
+{
+#if defined(__GNUC__)
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) )
+    return MINCVoxelRescaler::AVX2;
+  if ( __builtin_cpu_supports( "sse4.1" ) )
+    return MINCVoxelRescaler::SSE41;
+#else
+  int info[4];
+  __cpuid( info, 0 );
+  const int maxLeaf = info[0];
+
+  __cpuid( info, 1 );
+  const bool sse41 = ( info[2] & ( 1 << 19 ) ) != 0;
+  const bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+  const bool avx = ( info[2] & ( 1 << 28 ) ) != 0;
+
+  // AVX2 also needs the OS to save the ymm registers
+  if ( maxLeaf >= 7 && osxsave && avx && ( _xgetbv( 0 ) & 6 ) == 6 )
+    {
+    __cpuidex( info, 7, 0 );
+    if ( info[1] & ( 1 << 5 ) )
+      return MINCVoxelRescaler::AVX2;
+    }
+  if ( sse41 )
+    return MINCVoxelRescaler::SSE41;
+#endif
+  return MINCVoxelRescaler::Scalar;
+}
+
+#else
+
+MINCVoxelRescaler::InstructionSetType DetectInstructionSet()
+{
+  return MINCVoxelRescaler::Scalar;
+}
+
+#endif // ITK_MINC_RESCALE_X86
+
+
+// Detected once; -1 until then.
+int supportedInstructionSet = -1;
+int activeInstructionSet = -1;
+
+
+template <class TIn, class TOut>
+void RescaleComponents( const TIn* in, TOut* out, size_t count,
+			double slope, double intercept )
+{
+  size_t done = 0;
+
+#if ITK_MINC_RESCALE_X86
+  switch( MINCVoxelRescaler::GetInstructionSet() )
+    {
+    case MINCVoxelRescaler::AVX2:
+      done = avx2::Rescale( in, out, count, slope, intercept );
+      break;
+    case MINCVoxelRescaler::SSE41:
+      done = sse41::Rescale( in, out, count, slope, intercept );
+      break;
+    default:
+      break;
+    }
+#endif
+
+  RescaleScalar( in, out, done, count, slope, intercept );
+}
+
+template <class TIn>
+void RescaleComponentsTo( const TIn* in,
+			  ImageIOBase::IOComponentType outType, void* out,
+			  size_t count, double slope, double intercept )
+{
+  switch( outType )
+    {
+    case ImageIOBase::UCHAR:
+      RescaleComponents( in, static_cast<unsigned char*>( out ), count, slope, intercept );
+      break;
+    case ImageIOBase::CHAR:
+      RescaleComponents( in, static_cast<signed char*>( out ), count, slope, intercept );
+      break;
+    case ImageIOBase::USHORT:
+      RescaleComponents( in, static_cast<unsigned short*>( out ), count, slope, intercept );
+      break;
+    case ImageIOBase::SHORT:
+      RescaleComponents( in, static_cast<short*>( out ), count, slope, intercept );
+      break;
+    case ImageIOBase::UINT:
+      RescaleComponents( in, static_cast<unsigned int*>( out ), count, slope, intercept );
+      break;
+    case ImageIOBase::INT:
+      RescaleComponents( in, static_cast<int*>( out ), count, slope, intercept );
+      break;
+    case ImageIOBase::FLOAT:
+      RescaleComponents( in, static_cast<float*>( out ), count, slope, intercept );
+      break;
+    case ImageIOBase::DOUBLE:
+      RescaleComponents( in, static_cast<double*>( out ), count, slope, intercept );
+      break;
+    default:
+      itkGenericOutputMacro(<< "unhandled ITK data type: " << outType);
+    }
+}
+
+} // end anonymous namespace
+
+
+void MINCVoxelRescaler::Rescale( IOComponentType inType, const void* in,
+				 IOComponentType outType, void* out,
+				 size_t count, double slope, double intercept )
+{
+  switch( inType )
+    {
+    case ImageIOBase::UCHAR:
+      RescaleComponentsTo( static_cast<const unsigned char*>( in ), outType, out, count, slope, intercept );
+      break;
+    case ImageIOBase::CHAR:
+      RescaleComponentsTo( static_cast<const signed char*>( in ), outType, out, count, slope, intercept );
+      break;
+    case ImageIOBase::USHORT:
+      RescaleComponentsTo( static_cast<const unsigned short*>( in ), outType, out, count, slope, intercept );
+      break;
+    case ImageIOBase::SHORT:
+      RescaleComponentsTo( static_cast<const short*>( in ), outType, out, count, slope, intercept );
+      break;
+    case ImageIOBase::UINT:
+      RescaleComponentsTo( static_cast<const unsigned int*>( in ), outType, out, count, slope, intercept );
+      break;
+    case ImageIOBase::INT:
+      RescaleComponentsTo( static_cast<const int*>( in ), outType, out, count, slope, intercept );
+      break;
+    case ImageIOBase::FLOAT:
+      RescaleComponentsTo( static_cast<const float*>( in ), outType, out, count, slope, intercept );
+      break;
+    case ImageIOBase::DOUBLE:
+      RescaleComponentsTo( static_cast<const double*>( in ), outType, out, count, slope, intercept );
+      break;
+    default:
+      itkGenericOutputMacro(<< "unhandled ITK data type: " << inType);
+    }
+}
+
+MINCVoxelRescaler::InstructionSetType MINCVoxelRescaler::GetSupportedInstructionSet()
+{
+  if ( supportedInstructionSet < 0 )
+    supportedInstructionSet = DetectInstructionSet();
+  return static_cast<InstructionSetType>( supportedInstructionSet );
+}
+
+void MINCVoxelRescaler::SetInstructionSet( InstructionSetType instructionSet )
+{
+  InstructionSetType supported = GetSupportedInstructionSet();
+  activeInstructionSet = instructionSet < supported ? instructionSet : supported;
+}
+
+MINCVoxelRescaler::InstructionSetType MINCVoxelRescaler::GetInstructionSet()
+{
+  if ( activeInstructionSet < 0 )
+    activeInstructionSet = GetSupportedInstructionSet();
+  return static_cast<InstructionSetType>( activeInstructionSet );
+}
+
+} // end namespace itk
@@ -0,0 +1,73 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    itkMINCVoxelRescaler.h
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __itkMINCVoxelRescaler_h
+#define __itkMINCVoxelRescaler_h
+
+#include "itkImageIOBase.h"
+
+
+namespace itk
+{
+
+/** \class MINCVoxelRescaler
+ *
+ * \brief Linear mapping of stored MINC voxels to ITK components.
+ *
+ * Each component is mapped as in * slope + intercept in double
+ * precision and converted the way libminc does: integer outputs are
+ * clamped to the range of their type and rounded to nearest, halfway
+ * cases away from zero.  Components of type CHAR are signed, like
+ * MI_TYPE_BYTE.
+ *
+ * On x86 the loop is vectorized with SSE4.1 or AVX2, whichever is the
+ * best the processor supports; the results are those of the scalar
+ * loop for all but NaN, whose conversion to an integer is undefined
+ * there and which the vector loops clamp to the range of the type.
+ *
+ * \ingroup IOFilters
+ */
+class MINCVoxelRescaler
+{
+public:
+  typedef ImageIOBase::IOComponentType IOComponentType;
+
+  typedef enum { Scalar = 0, SSE41, AVX2 } InstructionSetType;
+
+  // Map count components of type inType to components of type
+  // outType.  The input may overlap the output only if it ends where
+  // the output ends and its components are no wider than the
+  // output's (as when staged at the tail of the output buffer), or if
+  // it starts where the output starts and its components are exactly
+  // as wide.
+  static void Rescale( IOComponentType inType, const void* in,
+                       IOComponentType outType, void* out,
+                       size_t count, double slope, double intercept );
+
+  // Best instruction set supported by the processor.
+  static InstructionSetType GetSupportedInstructionSet();
+
+  // Instruction set used by Rescale().  Defaults to the supported
+  // one; requests beyond it are lowered to it.
+  static void SetInstructionSet( InstructionSetType instructionSet );
+  static InstructionSetType GetInstructionSet();
+
+private:
+  MINCVoxelRescaler(); //purposely not implemented
+};
+
+} // end namespace itk
+
+#endif // __itkMINCVoxelRescaler_h
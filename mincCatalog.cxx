@@ -0,0 +1,144 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "itkMINCCatalog.h"
+#include "itkMINCImageIO.h"
+
+/* Read the headers of many MINC files into a catalog.
+ *
+ *   mincCatalog [-j threads] [-i index] [-o index] [-l list] [file ...]
+ *
+ * Files are named on the command line or, with -l, one per line in
+ * list ("-" for the standard input).  -i loads an index written
+ * before, to which the files scanned are added; -o writes the catalog
+ * to an index file.  Without -o, one line per file is printed: its
+ * name, then either its error or its pixel type, component type,
+ * number of components, size, spacing, chunk size and compression
+ * level, tab-separated.  The exit status is 1 if any file could not
+ * be read.
+ */
+
+
+namespace {
+
+void Usage()
+{
+  std::cerr << "usage: mincCatalog [-j threads] [-i index] [-o index] [-l list] [file ...]\n";
+  std::exit( 2 );
+}
+
+template< class T >
+void PrintList( std::ostream& out, const std::vector<T>& values )
+{
+  for( size_t i = 0; i < values.size(); ++i )
+    out << ( i > 0 ? "x" : "" ) << values[i];
+}
+
+void PrintEntry( std::ostream& out, const itk::MINCCatalogEntry& entry, const itk::ImageIOBase* io )
+{
+  out << entry.fileName << "\t";
+  if ( ! entry.IsValid() )
+    {
+    out << "error: " << entry.error << "\n";
+    return;
+    }
+
+  out << io->GetPixelTypeAsString( entry.pixelType )
+      << "\t" << io->GetComponentTypeAsString( entry.componentType )
+      << ( entry.labels ? " labels" : "" )
+      << "\t" << entry.numberOfComponents << "\t";
+  PrintList( out, entry.dimensions );
+  out << "\t";
+  PrintList( out, entry.spacing );
+  out << "\t";
+  PrintList( out, entry.chunkSize );
+  out << "\t" << entry.compressionLevel << "\n";
+}
+
+} // end of unnamed namespace
+
+
+int main( int argc, char** argv )
+{
+  itk::MINCCatalog catalog;
+  const char* outputIndex = 0;
+  std::vector<std::string> fileNames;
+
+  for( int i = 1; i < argc; ++i )
+    {
+    const bool hasValue = i + 1 < argc;
+    if ( std::strcmp( argv[i], "-j" ) == 0 && hasValue )
+      {
+      catalog.SetNumberOfThreads( std::atoi( argv[++i] ) );
+      }
+    else if ( std::strcmp( argv[i], "-i" ) == 0 && hasValue )
+      {
+      if ( ! catalog.Read( argv[++i] ) )
+	{
+	std::cerr << "mincCatalog: cannot read index " << argv[i] << "\n";
+	return 2;
+	}
+      }
+    else if ( std::strcmp( argv[i], "-o" ) == 0 && hasValue )
+      {
+      outputIndex = argv[++i];
+      }
+    else if ( std::strcmp( argv[i], "-l" ) == 0 && hasValue )
+      {
+      ++i;
+      std::ifstream list;
+      if ( std::strcmp( argv[i], "-" ) != 0 )
+	{
+	list.open( argv[i] );
+	if ( ! list )
+	  {
+	  std::cerr << "mincCatalog: cannot read list " << argv[i] << "\n";
+	  return 2;
+	  }
+	}
+      std::istream& in = list.is_open() ? static_cast<std::istream&>( list ) : std::cin;
+      std::string line;
+      while( std::getline( in, line ) )
+	{
+	if ( ! line.empty() )
+	  fileNames.push_back( line );
+	}
+      }
+    else if ( argv[i][0] == '-' )
+      {
+      Usage();
+      }
+    else
+      {
+      fileNames.push_back( argv[i] );
+      }
+    }
+
+  if ( fileNames.empty() && catalog.GetNumberOfEntries() == 0 )
+    Usage();
+
+  const size_t numRead = catalog.Scan( fileNames );
+
+  if ( outputIndex )
+    {
+    if ( ! catalog.Write( outputIndex ) )
+      {
+      std::cerr << "mincCatalog: cannot write index " << outputIndex << "\n";
+      return 2;
+      }
+    std::cerr << "mincCatalog: " << numRead << " of " << fileNames.size() << " headers read, "
+	      << catalog.GetNumberOfEntries() << " files in " << outputIndex << "\n";
+    }
+  else
+    {
+    itk::MINCImageIO::Pointer io = itk::MINCImageIO::New();
+    for( size_t i = 0; i < catalog.GetNumberOfEntries(); ++i )
+      PrintEntry( std::cout, catalog.GetEntry( i ), io );
+    }
+
+  return numRead == fileNames.size() ? 0 : 1;
+}
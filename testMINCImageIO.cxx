@@ -1,6 +1,25 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+#include <hdf5.h>
+#include <sys/stat.h>
+
+#include "itkCommand.h"
+#include "itkMINCCatalog.h"
+#include "itkMINCHeaderCache.h"
 #include "itkMINCImageIO.h"
+#include "itkMINCNetCDFFile.h"
+#include "itkMINCVolumeCache.h"
+#include "itkMINCVolumeGenerator.h"
+#include "itkMINCVoxelRescaler.h"
+#include "itkMetaDataObject.h"
 #include "CreateMincFile.h"
 
 
@@ -62,6 +81,15 @@ protected:
     return fileCreationCommand;
   }
 
+  std::string CreateFile( std::string rawtomincArgs, int dim0, int dim1, int dim2, int dim3 )
+  {
+    rawtomincArgs += " test.mnc";
+    std::string fileCreationCommand = createMincFile( rawtomincArgs, dim0, dim1, dim2, dim3 );
+    mImageIO->SetFileName( "test.mnc" );
+    mImageIO->ReadImageInformation();
+    return fileCreationCommand;
+  }
+
   void SizeTest( std::string fileCreationCommand,
 		 itk::ImageIOBase::IOPixelType pixelType,
 		 itk::ImageIOBase::IOComponentType compType, 
@@ -183,6 +211,76 @@ protected:
       }
   }
 
+  // Read the region into a byte buffer of the right size
+  std::vector<char> ReadRegion( const itk::ImageIORegion& region )
+  {
+    mImageIO->SetIORegion( region );
+
+    std::vector<char> buffer( region.GetNumberOfPixels()
+			      * mImageIO->GetNumberOfComponents()
+			      * mImageIO->GetComponentSize() );
+    mImageIO->Read( &buffer[0] );
+    return buffer;
+  }
+
+  // Write a 5x6x7 image with the given component type, read it back
+  // and check that values and geometry survive.
+  template<class TPixel>
+  void WriteReadTest( itk::ImageIOBase::IOComponentType compType, bool compress )
+  {
+    SCOPED_TRACE( compress ? "compressed" : "uncompressed" );
+
+    const unsigned int size[3] = { 5, 6, 7 };
+
+    ImageIO::Pointer writer = ImageIO::New();
+    writer->SetFileName( "write.mnc" );
+    writer->SetNumberOfDimensions( 3 );
+    writer->SetPixelType( itk::ImageIOBase::SCALAR );
+    writer->SetComponentType( compType );
+    writer->SetNumberOfComponents( 1 );
+    writer->SetUseCompression( compress );
+    writer->SetNumberOfThreads( 3 );
+
+    itk::ImageIORegion region( 3 );
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      writer->SetDimensions( d, size[d] );
+      writer->SetSpacing( d, d + 1 );
+      writer->SetOrigin( d, -1.0 - d );
+      writer->SetWriteChunkSize( d, 2 + d );
+      region.SetSize( d, size[d] );
+      }
+    writer->SetIORegion( region );
+
+    std::vector<TPixel> expected( region.GetNumberOfPixels() );
+    for( unsigned int i = 0; i < expected.size(); ++i )
+      expected[i] = static_cast<TPixel>( 3 * static_cast<int>( i ) - 50 );
+
+    writer->Write( &expected[0] );
+
+    ReadImageInformation( "write.mnc" );
+    EXPECT_EQ( compType, mImageIO->GetComponentType() );
+
+    DirectionType direction[] = { mDir0, mDir1, mDir2 };
+    DirectionTest( "write.mnc", direction, direction + 3 );
+
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      EXPECT_EQ( size[d], mImageIO->GetDimensions( d ) ) << "d=" << d;
+      EXPECT_DOUBLE_EQ( d + 1, mImageIO->GetSpacing( d ) ) << "d=" << d;
+      EXPECT_DOUBLE_EQ( -1.0 - d, mImageIO->GetOrigin( d ) ) << "d=" << d;
+      if ( compress )
+	{
+	EXPECT_EQ( 2 + d, mImageIO->GetChunkSize( d ) ) << "d=" << d;
+	}
+      }
+
+    std::vector<TPixel> actual( expected.size() );
+    mImageIO->SetIORegion( region );
+    mImageIO->Read( &actual[0] );
+    EXPECT_TRUE( expected == actual );
+  }
+
   // Caller must ensure the region really specifies 6 pixels; e.g. 2x3 region
   template<class TPixel>
   void TestRead6( const itk::ImageIORegion& region,
@@ -246,6 +344,38 @@ TEST_F( MINCImageIOTest, CanReadMINCFile )
   EXPECT_TRUE( mImageIO->CanReadFile( "test.mnc" ) );
 }
 
+TEST_F( MINCImageIOTest, CanReadFileSignatureTest )
+{
+  createMincFile( "test.mnc", 2, 7 );
+
+  // Not a MINC file, despite its name
+  {
+  std::ofstream text( "text.mnc" );
+  text << "not a MINC file\n";
+  }
+  EXPECT_FALSE( mImageIO->CanReadFile( "text.mnc" ) );
+
+  // HDF5, but not MINC
+  H5Fclose( H5Fcreate( "plain.h5", H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT ) );
+  EXPECT_FALSE( mImageIO->CanReadFile( "plain.h5" ) );
+
+  // MINC under another name
+  {
+  std::ifstream in( "test.mnc", std::ios::binary );
+  std::ofstream out( "copy.h5", std::ios::binary );
+  out << in.rdbuf();
+  }
+  EXPECT_TRUE( mImageIO->CanReadFile( "copy.h5" ) );
+
+  // A cached answer does not outlive a change to the file
+  {
+  std::ifstream in( "test.mnc", std::ios::binary );
+  std::ofstream out( "text.mnc", std::ios::binary );
+  out << in.rdbuf();
+  }
+  EXPECT_TRUE( mImageIO->CanReadFile( "text.mnc" ) );
+}
+
 TEST_F( MINCImageIOTest, CanWriteMINCFile )
 {
   EXPECT_FALSE( mImageIO->CanWriteFile( "" ) );
@@ -311,6 +441,65 @@ TEST_F( MINCImageIOTest, ShapeTest3D )
     }
 }
 
+TEST_F( MINCImageIOTest, CanonicalOrderTest )
+{
+  SCOPED_TRACE( "CanonicalOrderTest" );
+
+  const unsigned long shape[] = { 3, 4, 7 };
+
+  for( int i = 0; i < 6; ++i )
+    {
+    mImageIO->UseCanonicalOrderOff();
+    std::string fileCreationCommand = CreateFile( axisOrderArg[i], shape[0], shape[1], shape[2] );
+
+    itk::ImageIORegion whole( 3 );
+    for( unsigned int d = 0; d < 3; ++d )
+      whole.SetSize( d, shape[d] );
+    std::vector<char> stored = ReadRegion( whole );
+
+    mImageIO->UseCanonicalOrderOn();
+    ReadImageInformation( "test.mnc" );
+
+    // axisOrderArg[i] is "-" followed by the file order of x, y, z
+    unsigned int fileDim[3];
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      fileDim[ axisOrderArg[i][d+1] - 'x' ] = d;
+      }
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      EXPECT_EQ( fileDim[d], mImageIO->GetFileDimension( d ) ) << fileCreationCommand;
+      EXPECT_EQ( shape[fileDim[d]], mImageIO->GetDimensions( d ) ) << fileCreationCommand;
+      }
+
+    // Every region, read in canonical order, holds the voxels stored at
+    // the permuted index.
+    itk::ImageIORegion region( 3 );
+    region.SetIndex( 0, 1 );
+    region.SetSize( 0, mImageIO->GetDimensions( 0 ) - 1 );
+    region.SetIndex( 1, 0 );
+    region.SetSize( 1, mImageIO->GetDimensions( 1 ) );
+    region.SetIndex( 2, 1 );
+    region.SetSize( 2, mImageIO->GetDimensions( 2 ) - 2 );
+    std::vector<char> actual = ReadRegion( region );
+
+    const size_t pixelBytes = mImageIO->GetComponentSize() * mImageIO->GetNumberOfComponents();
+    size_t n = 0;
+    unsigned long index[3];
+    for( index[0] = 0; index[0] < region.GetSize( 0 ); ++index[0] )
+      for( index[1] = 0; index[1] < region.GetSize( 1 ); ++index[1] )
+	for( index[2] = 0; index[2] < region.GetSize( 2 ); ++index[2], ++n )
+	  {
+	  unsigned long fileIndex[3];
+	  for( unsigned int d = 0; d < 3; ++d )
+	    fileIndex[fileDim[d]] = index[d] + region.GetIndex( d );
+	  const size_t s = ( fileIndex[0] * shape[1] + fileIndex[1] ) * shape[2] + fileIndex[2];
+	  EXPECT_EQ( 0, std::memcmp( &actual[n * pixelBytes], &stored[s * pixelBytes], pixelBytes ) )
+	    << fileCreationCommand << " at " << index[0] << "," << index[1] << "," << index[2];
+	  }
+    }
+}
+
 TEST_F( MINCImageIOTest, OriginTest2DUnrotated )
 {
   std::string originArgs = "-zxy -xstart -1 -ystart 2 -xstep 3";
@@ -528,3 +717,2014 @@ TEST_F( MINCImageIOTest, ReadTestRescale )
 
   TestRead6<unsigned short>( region, 0, 4, 8, 12, 16, 20 );
 }
+
+TEST_F( MINCImageIOTest, ReadTestRawVoxels )
+{
+  SCOPED_TRACE( "ReadTestRawVoxels" );
+
+  mImageIO->UseRawVoxelsOn();
+  CreateFile( "-xyz -ounsigned -obyte -real_range 0 1024", 8, 8, 16 );
+
+  itk::ImageIORegion region( 3 );
+  region.SetIndex( 0, 2 );
+  region.SetSize( 0, 1 );
+  region.SetSize( 1, 1 );
+  region.SetSize( 2, 6 );
+
+  TestRead6<unsigned char>( region, 0, 1, 2, 3, 4, 5 );
+
+  // The mapping to real values accompanies the raw voxels
+  std::vector<double> slope, intercept;
+  const itk::MetaDataDictionary& dictionary = mImageIO->GetMetaDataDictionary();
+  ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( dictionary, "MINC_RescaleSlope", slope ) );
+  ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( dictionary, "MINC_RescaleIntercept", intercept ) );
+  ASSERT_EQ( slope.size(), intercept.size() );
+  EXPECT_TRUE( slope.size() == 1 || slope.size() == 8 );
+
+  for( unsigned int s = 0; s < slope.size(); ++s )
+    {
+    EXPECT_NEAR( 1024.0 / 255.0, slope[s], 1e-6 ) << "s=" << s;
+    EXPECT_NEAR( 0.0, intercept[s], 1e-6 ) << "s=" << s;
+    }
+}
+
+TEST_F( MINCImageIOTest, ReadTestMatchesLibminc )
+{
+  SCOPED_TRACE( "ReadTestMatchesLibminc" );
+
+  const char* typeArgs[] = { "-osigned -oshort -real_range -100 1000",
+			     "-ounsigned -obyte -real_range 0.5 2",
+			     "-ounsigned -oint -real_range -1e6 1e6" };
+
+  itk::ImageIORegion region( 3 );
+  region.SetIndex( 0, 1 );
+  region.SetSize( 0, 3 );
+  region.SetSize( 1, 9 );
+  region.SetSize( 2, 11 );
+
+  std::vector<unsigned long> starts( 3 ), counts( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    starts[d] = region.GetIndex( d );
+    counts[d] = region.GetSize( d );
+    }
+
+  for( unsigned int i = 0; i < sizeof(typeArgs) / sizeof(typeArgs[0]); ++i )
+    {
+    std::string fileCreationCommand = CreateFile( std::string( "-xyz " ) + typeArgs[i], 5, 9, 11 );
+
+    // Real values computed by libminc itself
+    mihandle_t volume;
+    ASSERT_EQ( MI_NOERROR, miopen_volume( "test.mnc", MI2_OPEN_READ, &volume ) );
+    std::vector<float> expected( region.GetNumberOfPixels() );
+    std::vector<short> expectedShort( region.GetNumberOfPixels() );
+    miget_real_value_hyperslab( volume, MI_TYPE_FLOAT, &starts[0], &counts[0], &expected[0] );
+    miget_real_value_hyperslab( volume, MI_TYPE_SHORT, &starts[0], &counts[0], &expectedShort[0] );
+    miclose_volume( volume );
+
+    mImageIO->SetIORegion( region );
+
+    std::vector<float> actual( expected.size() );
+    mImageIO->SetComponentType( itk::ImageIOBase::FLOAT );
+    mImageIO->Read( &actual[0] );
+    EXPECT_TRUE( expected == actual ) << fileCreationCommand;
+
+    std::vector<short> actualShort( expected.size() );
+    mImageIO->SetComponentType( itk::ImageIOBase::SHORT );
+    mImageIO->Read( &actualShort[0] );
+    EXPECT_TRUE( expectedShort == actualShort ) << fileCreationCommand;
+    }
+}
+
+TEST_F( MINCImageIOTest, RescaleInstructionSetTest )
+{
+  SCOPED_TRACE( "RescaleInstructionSetTest" );
+
+  typedef itk::MINCVoxelRescaler Rescaler;
+  const itk::ImageIOBase::IOComponentType types[] = { 
+    itk::ImageIOBase::UCHAR, itk::ImageIOBase::CHAR,
+    itk::ImageIOBase::USHORT, itk::ImageIOBase::SHORT,
+    itk::ImageIOBase::UINT, itk::ImageIOBase::INT,
+    itk::ImageIOBase::FLOAT, itk::ImageIOBase::DOUBLE };
+  const double slope[] = { 1.0, 3.7, -0.01, 1e9 };
+  const double intercept[] = { 0.0, -1000.25, 5.0, -3e9 };
+
+  // An odd count exercises the scalar tail of the vector loops
+  const size_t count = 1003;
+
+  // Random bytes make integers of any value; floating-point inputs
+  // are filled with moderate values, including halfway cases.
+  std::vector<unsigned char> bytes( count * sizeof(double) );
+  for( size_t i = 0; i < bytes.size(); ++i )
+    bytes[i] = static_cast<unsigned char>( rand() );
+
+  std::vector<float> floats( count );
+  std::vector<double> doubles( count );
+  for( size_t i = 0; i < count; ++i )
+    {
+    doubles[i] = 0.5 * ( static_cast<int>( i ) - 500 ) + ( i % 3 ) * 0.001;
+    floats[i] = static_cast<float>( doubles[i] );
+    }
+
+  for( unsigned int a = 0; a < 8; ++a )
+    {
+    const void* in = &bytes[0];
+    if ( types[a] == itk::ImageIOBase::FLOAT )
+      in = &floats[0];
+    else if ( types[a] == itk::ImageIOBase::DOUBLE )
+      in = &doubles[0];
+
+    for( unsigned int b = 0; b < 8; ++b )
+      {
+      for( unsigned int p = 0; p < 4; ++p )
+	{
+	std::vector<unsigned char> expected( count * sizeof(double) );
+	std::vector<unsigned char> actual( expected.size() );
+
+	Rescaler::SetInstructionSet( Rescaler::Scalar );
+	Rescaler::Rescale( types[a], in, types[b], &expected[0], count, slope[p], intercept[p] );
+
+	for( int isa = Rescaler::SSE41; isa <= Rescaler::GetSupportedInstructionSet(); ++isa )
+	  {
+	  Rescaler::SetInstructionSet( static_cast<Rescaler::InstructionSetType>( isa ) );
+	  Rescaler::Rescale( types[a], in, types[b], &actual[0], count, slope[p], intercept[p] );
+	  EXPECT_TRUE( expected == actual ) 
+	    << "in " << a << " out " << b << " p " << p << " isa " << isa;
+	  }
+	}
+      }
+    }
+
+  Rescaler::SetInstructionSet( Rescaler::GetSupportedInstructionSet() );
+}
+
+TEST_F( MINCImageIOTest, ResolutionLevelTest )
+{
+  SCOPED_TRACE( "ResolutionLevelTest" );
+
+  CreateFile( "-xyz -ounsigned -obyte", 8, 8, 16 );
+  EXPECT_EQ( 1u, mImageIO->GetNumberOfResolutionLevels() );
+
+  // Asking for a level the file does not have must fail
+  mImageIO->SetResolutionLevel( 1 );
+  EXPECT_THROW( mImageIO->ReadImageInformation(), itk::ExceptionObject );
+
+  mImageIO->SetResolutionLevel( 0 );
+  mImageIO->ReadImageInformation();
+  EXPECT_EQ( 16u, mImageIO->GetDimensions( 2 ) );
+}
+
+TEST_F( MINCImageIOTest, StreamableRegionTest )
+{
+  SCOPED_TRACE( "StreamableRegionTest" );
+
+  // Chunks of 4 voxels along every dimension, the last ones clipped
+  const unsigned int size[3] = { 10, 9, 7 };
+  ImageIO::Pointer writer = ImageIO::New();
+  writer->SetFileName( "test.mnc" );
+  writer->SetNumberOfDimensions( 3 );
+  writer->SetPixelType( itk::ImageIOBase::SCALAR );
+  writer->SetComponentType( itk::ImageIOBase::UCHAR );
+  writer->SetNumberOfComponents( 1 );
+  writer->SetUseCompression( true );
+
+  itk::ImageIORegion region( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    writer->SetDimensions( d, size[d] );
+    writer->SetWriteChunkSize( d, 4 );
+    region.SetSize( d, size[d] );
+    }
+  writer->SetIORegion( region );
+  std::vector<unsigned char> values( region.GetNumberOfPixels(), 1 );
+  writer->Write( &values[0] );
+
+  ReadImageInformation( "test.mnc" );
+  EXPECT_TRUE( mImageIO->CanStreamRead() );
+  for( unsigned int d = 0; d < 3; ++d )
+    ASSERT_EQ( 4u, mImageIO->GetChunkSize( d ) ) << "d=" << d;
+
+  itk::ImageIORegion requested( 3 );
+  requested.SetIndex( 0, 3 );
+  requested.SetIndex( 1, 2 );
+  requested.SetIndex( 2, 5 );
+  requested.SetSize( 0, 4 );
+  requested.SetSize( 1, 1 );
+  requested.SetSize( 2, 2 );
+
+  // Streamed region covers the request, from chunk boundary to chunk
+  // boundary or the end of the image
+  mImageIO->SetUseStreamedReading( true );
+  itk::ImageIORegion streamable 
+    = mImageIO->GenerateStreamableReadRegionFromRequestedRegion( requested );
+
+  const long expectedIndex[3] = { 0, 0, 4 };
+  const unsigned long expectedSize[3] = { 8, 4, 3 };
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    EXPECT_EQ( expectedIndex[d], streamable.GetIndex( d ) ) << "d=" << d;
+    EXPECT_EQ( expectedSize[d], streamable.GetSize( d ) ) << "d=" << d;
+    }
+
+  // Without streaming, the whole image is read
+  mImageIO->SetUseStreamedReading( false );
+  streamable = mImageIO->GenerateStreamableReadRegionFromRequestedRegion( requested );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    EXPECT_EQ( 0, streamable.GetIndex( d ) ) << "d=" << d;
+    EXPECT_EQ( mImageIO->GetDimensions( d ), streamable.GetSize( d ) ) << "d=" << d;
+    }
+}
+
+TEST_F( MINCImageIOTest, ParallelDecompressionTest )
+{
+  SCOPED_TRACE( "ParallelDecompressionTest" );
+
+  // Have createMincFile write compressed chunks
+  setenv( "MINC_COMPRESS", "4", 1 );
+
+  const char* typeArgs[] = { "-ounsigned -obyte -real_range 0 255",
+			     "-osigned -obyte -real_range -50 50",
+			     "-osigned -oshort -real_range -100 1000",
+			     "-ounsigned -oshort -real_range 0 1",
+			     "-ounsigned -oint -real_range 0 1e6",
+			     "-ofloat",
+			     "-odouble" };
+
+  for( unsigned int i = 0; i < sizeof(typeArgs) / sizeof(typeArgs[0]); ++i )
+    {
+    std::string fileCreationCommand = CreateFile( std::string( "-xyz " ) + typeArgs[i], 9, 40, 37 );
+
+    itk::ImageIORegion region( 3 );
+    region.SetIndex( 0, 1 );
+    region.SetIndex( 1, 3 );
+    region.SetIndex( 2, 5 );
+    region.SetSize( 0, 7 );
+    region.SetSize( 1, 30 );
+    region.SetSize( 2, 29 );
+
+    // Parallel decompression must match libminc bit for bit
+    mImageIO->UseParallelDecompressionOff();
+    std::vector<char> expected = ReadRegion( region );
+
+    mImageIO->UseParallelDecompressionOn();
+    mImageIO->SetNumberOfThreads( 4 );
+    std::vector<char> actual = ReadRegion( region );
+
+    EXPECT_TRUE( expected == actual ) << fileCreationCommand;
+    }
+
+  unsetenv( "MINC_COMPRESS" );
+}
+
+TEST_F( MINCImageIOTest, ParallelReadingTest )
+{
+  SCOPED_TRACE( "ParallelReadingTest" );
+
+  const char* typeArgs[] = { "-ounsigned -obyte -real_range 0 255",
+			     "-osigned -oshort -real_range -100 1000",
+			     "-ofloat" };
+
+  for( unsigned int i = 0; i < sizeof(typeArgs) / sizeof(typeArgs[0]); ++i )
+    {
+    std::string fileCreationCommand = CreateFile( std::string( "-xyz " ) + typeArgs[i], 9, 40, 37 );
+
+    // A sub-region, then whole slices
+    for( int slab = 0; slab < 2; ++slab )
+      {
+      itk::ImageIORegion region( 3 );
+      region.SetIndex( 0, 1 );
+      region.SetIndex( 1, slab ? 0 : 3 );
+      region.SetIndex( 2, slab ? 0 : 5 );
+      region.SetSize( 0, 7 );
+      region.SetSize( 1, slab ? 40 : 30 );
+      region.SetSize( 2, slab ? 37 : 29 );
+
+      // Reading the file directly must match libminc bit for bit
+      mImageIO->UseParallelReadingOff();
+      std::vector<char> expected = ReadRegion( region );
+
+      mImageIO->UseParallelReadingOn();
+      mImageIO->SetNumberOfThreads( 4 );
+      std::vector<char> actual = ReadRegion( region );
+
+      EXPECT_TRUE( expected == actual ) << fileCreationCommand << " slab=" << slab;
+      }
+    }
+}
+
+TEST_F( MINCImageIOTest, ReadAheadTest )
+{
+  SCOPED_TRACE( "ReadAheadTest" );
+
+  for( int compress = 0; compress < 2; ++compress )
+    {
+    if ( compress )
+      setenv( "MINC_COMPRESS", "4", 1 );
+    std::string fileCreationCommand = CreateFile( "-xyz -osigned -oshort -real_range -100 1000", 11, 40, 37 );
+    unsetenv( "MINC_COMPRESS" );
+
+    mImageIO->UseReadAheadOff();
+    itk::ImageIORegion whole( 3 );
+    for( unsigned int d = 0; d < 3; ++d )
+      whole.SetSize( d, mImageIO->GetDimensions( d ) );
+    std::vector<char> expected = ReadRegion( whole );
+    const size_t sliceBytes = expected.size() / mImageIO->GetDimensions( 0 );
+
+    // Slabs in order, as a streamed read asks for them, with a jump
+    // back that the read ahead does not predict.
+    mImageIO->UseReadAheadOn();
+    const long slabStarts[] = { 0, 3, 6, 9, 3, 6 };
+    for( unsigned int i = 0; i < sizeof(slabStarts) / sizeof(slabStarts[0]); ++i )
+      {
+      itk::ImageIORegion slab( whole );
+      slab.SetIndex( 0, slabStarts[i] );
+      slab.SetSize( 0, std::min<long>( 3, 11 - slabStarts[i] ) );
+
+      std::vector<char> actual = ReadRegion( slab );
+      EXPECT_TRUE( std::equal( actual.begin(), actual.end(), 
+			       expected.begin() + slabStarts[i] * sliceBytes ) )
+	<< fileCreationCommand << " slab " << i;
+      }
+    }
+}
+
+TEST_F( MINCImageIOTest, MemoryMappingTest )
+{
+  SCOPED_TRACE( "MemoryMappingTest" );
+
+  for( int raw = 0; raw < 2; ++raw )
+    {
+    mImageIO->SetUseRawVoxels( raw );
+    mImageIO->UseMemoryMappingOff();
+    std::string fileCreationCommand = CreateFile( "-xyz -ounsigned -oshort -real_range 0 1000", 11, 40, 37 );
+
+    itk::ImageIORegion whole( 3 );
+    for( unsigned int d = 0; d < 3; ++d )
+      whole.SetSize( d, mImageIO->GetDimensions( d ) );
+    std::vector<char> expected = ReadRegion( whole );
+    EXPECT_TRUE( mImageIO->GetMappedBuffer() == 0 );
+
+    mImageIO->UseMemoryMappingOn();
+    ReadImageInformation( "test.mnc" );
+
+    // Whole image, a slab and a block that is not one run of the file
+    itk::ImageIORegion regions[3] = { whole, whole, whole };
+    regions[1].SetIndex( 0, 4 );
+    regions[1].SetSize( 0, 5 );
+    regions[2].SetIndex( 1, 7 );
+    regions[2].SetSize( 1, 9 );
+    for( unsigned int r = 0; r < 3; ++r )
+      {
+      std::vector<char> actual = ReadRegion( regions[r] );
+      std::vector<char> expectedRegion;
+      const size_t rowBytes = expected.size() / ( 11 * 40 );
+      for( long z = regions[r].GetIndex( 0 ); z < regions[r].GetIndex( 0 ) + long( regions[r].GetSize( 0 ) ); ++z )
+	for( long y = regions[r].GetIndex( 1 ); y < regions[r].GetIndex( 1 ) + long( regions[r].GetSize( 1 ) ); ++y )
+	  expectedRegion.insert( expectedRegion.end(), expected.begin() + ( z * 40 + y ) * rowBytes,
+				 expected.begin() + ( z * 40 + y + 1 ) * rowBytes );
+      EXPECT_TRUE( actual == expectedRegion ) << fileCreationCommand << " region " << r;
+      }
+
+    // Raw voxels in native byte order can be used in place
+    const void* mapped = mImageIO->GetMappedBuffer();
+    if ( raw && mapped )
+      {
+      EXPECT_EQ( 0, std::memcmp( mapped, &expected[0], expected.size() ) ) << fileCreationCommand;
+      }
+    }
+}
+
+TEST_F( MINCImageIOTest, ChunkCacheTest )
+{
+  SCOPED_TRACE( "ChunkCacheTest" );
+
+  setenv( "MINC_COMPRESS", "4", 1 );
+  std::string fileCreationCommand = CreateFile( "-xyz -ounsigned -oshort -real_range 0 1000", 11, 40, 37 );
+  unsetenv( "MINC_COMPRESS" );
+
+  itk::ImageIORegion whole( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    whole.SetSize( d, mImageIO->GetDimensions( d ) );
+  std::vector<char> expected = ReadRegion( whole );
+  const size_t sliceBytes = expected.size() / mImageIO->GetDimensions( 0 );
+
+  const ImageIO::ChunkCacheModeType modes[] =
+    { ImageIO::ChunkCacheDefault, ImageIO::ChunkCacheAuto, ImageIO::ChunkCacheManual, ImageIO::ChunkCacheManual };
+  const size_t cacheSizes[] = { 0, 0, 100, 1 << 20 };
+
+  // Slice by slice, so that every chunk is cut across by several reads
+  for( unsigned int m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m )
+    {
+    mImageIO->SetChunkCacheMode( modes[m] );
+    mImageIO->SetChunkCacheSize( cacheSizes[m] );
+    mImageIO->SetChunkCachePolicy( m % 2 ? 0.0 : 1.0 );
+
+    for( unsigned long s = 0; s < mImageIO->GetDimensions( 0 ); ++s )
+      {
+      itk::ImageIORegion slice( whole );
+      slice.SetIndex( 0, s );
+      slice.SetSize( 0, 1 );
+
+      std::vector<char> actual = ReadRegion( slice );
+      EXPECT_TRUE( std::equal( actual.begin(), actual.end(), expected.begin() + s * sliceBytes ) )
+	<< fileCreationCommand << " mode " << m << " slice " << s;
+      }
+    }
+}
+
+TEST_F( MINCImageIOTest, TimeSeriesTest )
+{
+  SCOPED_TRACE( "TimeSeriesTest" );
+
+  // Four irregular frames of 2x3x5 voxels: time, zspace, yspace, xspace
+  std::string fileCreationCommand = 
+    CreateFile( "-ounsigned -obyte -real_range 0 255 -frame_times 0,1,3,7 -frame_widths 1,2,4,8",
+		4, 2, 3, 5 );
+
+  int shape[] = {4,2,3,5};
+  ShapeTest( fileCreationCommand, shape, shape + 4 );
+
+  EXPECT_EQ( 0, mImageIO->GetTimeDimension() ) << fileCreationCommand;
+  EXPECT_EQ( 4u, mImageIO->GetNumberOfFrames() ) << fileCreationCommand;
+  EXPECT_DOUBLE_EQ( 0.0, mImageIO->GetOrigin( 0 ) ) << fileCreationCommand;
+  EXPECT_DOUBLE_EQ( 7.0 / 3, mImageIO->GetSpacing( 0 ) ) << fileCreationCommand;
+
+  const itk::MetaDataDictionary& dictionary = mImageIO->GetMetaDataDictionary();
+  std::vector<double> times, widths;
+  ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( dictionary, "MINC_FrameTimes", times ) );
+  ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( dictionary, "MINC_FrameWidths", widths ) );
+  const double expectedTimes[] = { 0, 1, 3, 7 };
+  const double expectedWidths[] = { 1, 2, 4, 8 };
+  ASSERT_EQ( 4u, times.size() );
+  ASSERT_EQ( 4u, widths.size() );
+  for( unsigned int f = 0; f < 4; ++f )
+    {
+    EXPECT_DOUBLE_EQ( expectedTimes[f], times[f] ) << "frame " << f;
+    EXPECT_DOUBLE_EQ( expectedWidths[f], widths[f] ) << "frame " << f;
+    }
+
+  // Time has a world axis of its own, after the spatial ones
+  DirectionType time( 4 ), z( 4 );
+  time[3] = 1;
+  z[2] = 1;
+  DirectionType direction[] = { time, z };
+  DirectionTest( fileCreationCommand, direction, direction + 2 );
+
+  // Each frame holds the values stored after those of the frames before
+  std::vector<unsigned char> frame( 2 * 3 * 5 );
+  for( unsigned long f = 0; f < 4; ++f )
+    {
+    mImageIO->ReadFrame( f, &frame[0] );
+    for( unsigned int i = 0; i < frame.size(); ++i )
+      EXPECT_EQ( f * frame.size() + i, frame[i] ) << "frame " << f << ", voxel " << i;
+    }
+}
+
+TEST_F( MINCImageIOTest, FrameTest )
+{
+  SCOPED_TRACE( "FrameTest" );
+
+  setenv( "MINC_COMPRESS", "4", 1 );
+  std::string fileCreationCommand = CreateFile( "-ounsigned -obyte -real_range 0 255", 9, 3, 4, 5 );
+  unsetenv( "MINC_COMPRESS" );
+
+  ASSERT_EQ( 0, mImageIO->GetTimeDimension() ) << fileCreationCommand;
+
+  itk::ImageIORegion whole( 4 );
+  for( unsigned int d = 0; d < 4; ++d )
+    whole.SetSize( d, mImageIO->GetDimensions( d ) );
+  std::vector<char> expected = ReadRegion( whole );
+  const size_t frameBytes = expected.size() / mImageIO->GetNumberOfFrames();
+
+  itk::ImageIORegion requested( whole );
+  requested.SetIndex( 0, 3 );
+  requested.SetSize( 0, 1 );
+
+  const ImageIO::ChunkCacheModeType modes[] = { ImageIO::ChunkCacheDefault, ImageIO::ChunkCacheAuto };
+  for( unsigned int m = 0; m < 2; ++m )
+    {
+    mImageIO->SetChunkCacheMode( modes[m] );
+
+    // Frames are only read one by one with the chunk cache to keep
+    // what they share
+    itk::ImageIORegion streamable 
+      = mImageIO->GenerateStreamableReadRegionFromRequestedRegion( requested );
+    if ( modes[m] == ImageIO::ChunkCacheAuto )
+      {
+      EXPECT_EQ( requested.GetIndex( 0 ), streamable.GetIndex( 0 ) ) << fileCreationCommand;
+      EXPECT_EQ( requested.GetSize( 0 ), streamable.GetSize( 0 ) ) << fileCreationCommand;
+      }
+
+    std::vector<char> frame( frameBytes );
+    for( unsigned long f = 0; f < mImageIO->GetNumberOfFrames(); ++f )
+      {
+      mImageIO->ReadFrame( f, &frame[0] );
+      EXPECT_TRUE( std::equal( frame.begin(), frame.end(), expected.begin() + f * frameBytes ) )
+	<< fileCreationCommand << " mode " << m << " frame " << f;
+      }
+    }
+
+  EXPECT_THROW( mImageIO->ReadFrame( mImageIO->GetNumberOfFrames(), &expected[0] ),
+		itk::ExceptionObject );
+}
+
+TEST_F( MINCImageIOTest, VectorDimensionTest )
+{
+  SCOPED_TRACE( "VectorDimensionTest" );
+
+  // 2x3x4 voxels of 3 components each, the vector dimension fastest
+  std::string fileCreationCommand = 
+    detail::createMincFile( "-vector 3 -ounsigned -obyte -real_range 0 255 test.mnc 2 3 4", 72 );
+  ReadImageInformation( "test.mnc" );
+
+  EXPECT_EQ( itk::ImageIOBase::VECTOR, mImageIO->GetPixelType() ) << fileCreationCommand;
+  EXPECT_EQ( 3u, mImageIO->GetNumberOfComponents() ) << fileCreationCommand;
+  EXPECT_EQ( -1, mImageIO->GetTimeDimension() ) << fileCreationCommand;
+
+  int shape[] = {2,3,4};
+  ShapeTest( fileCreationCommand, shape, shape + 3 );
+
+  itk::ImageIORegion region( 3 );
+  region.SetIndex( 0, 1 );
+  region.SetSize( 0, 1 );
+  region.SetIndex( 1, 1 );
+  region.SetSize( 1, 2 );
+  region.SetIndex( 2, 1 );
+  region.SetSize( 2, 2 );
+  std::vector<char> actual = ReadRegion( region );
+  ASSERT_EQ( 12u, actual.size() );
+
+  size_t n = 0;
+  for( unsigned int j = 1; j < 3; ++j )
+    for( unsigned int k = 1; k < 3; ++k )
+      for( unsigned int c = 0; c < 3; ++c, ++n )
+	{
+	EXPECT_EQ( ( ( 1 * 3 + j ) * 4 + k ) * 3 + c, static_cast<unsigned char>( actual[n] ) )
+	  << fileCreationCommand << " at " << j << "," << k << "," << c;
+	}
+}
+
+TEST_F( MINCImageIOTest, VectorWriteTest )
+{
+  SCOPED_TRACE( "VectorWriteTest" );
+
+  const unsigned int size[3] = { 4, 3, 5 };
+
+  ImageIO::Pointer writer = ImageIO::New();
+  writer->SetFileName( "write.mnc" );
+  writer->SetNumberOfDimensions( 3 );
+  writer->SetPixelType( itk::ImageIOBase::VECTOR );
+  writer->SetComponentType( itk::ImageIOBase::FLOAT );
+  writer->SetFileComponentType( itk::ImageIOBase::USHORT );
+  writer->SetNumberOfComponents( 3 );
+  writer->SetUseCompression( true );
+  writer->SetUseStreamedWriting( true );
+
+  itk::ImageIORegion region( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    writer->SetDimensions( d, size[d] );
+    writer->SetWriteChunkSize( d, 2 );
+    region.SetSize( d, size[d] );
+    }
+
+  // Scaled as a whole, hence written in one piece
+  EXPECT_EQ( 1u, writer->GetActualNumberOfSplitsForWriting( 4, region, region ) );
+  writer->SetIORegion( region );
+
+  std::vector<float> expected( region.GetNumberOfPixels() * 3 );
+  for( unsigned int i = 0; i < expected.size(); ++i )
+    expected[i] = 0.25f * i - 20.0f;
+  writer->Write( &expected[0] );
+
+  ReadImageInformation( "write.mnc" );
+  EXPECT_EQ( itk::ImageIOBase::VECTOR, mImageIO->GetPixelType() );
+  EXPECT_EQ( 3u, mImageIO->GetNumberOfComponents() );
+  EXPECT_EQ( itk::ImageIOBase::USHORT, mImageIO->GetComponentType() );
+  ASSERT_EQ( 3u, mImageIO->GetNumberOfDimensions() );
+  for( unsigned int d = 0; d < 3; ++d )
+    EXPECT_EQ( size[d], mImageIO->GetDimensions( d ) ) << "d=" << d;
+  std::vector<double> slope;
+  ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( mImageIO->GetMetaDataDictionary(),
+							    "MINC_RescaleSlope", slope ) );
+  EXPECT_EQ( 1u, slope.size() );
+
+  mImageIO->SetComponentType( itk::ImageIOBase::FLOAT );
+  mImageIO->SetIORegion( region );
+  std::vector<float> actual( expected.size() );
+  mImageIO->Read( &actual[0] );
+
+  for( unsigned int i = 0; i < expected.size(); ++i )
+    EXPECT_NEAR( expected[i], actual[i], 1e-3 ) << "i=" << i;
+
+  // Levels would halve the components
+  writer->SetNumberOfPyramidLevels( 1 );
+  EXPECT_THROW( writer->WriteImageInformation(), itk::ExceptionObject );
+}
+
+TEST_F( MINCImageIOTest, WriteTest )
+{
+  SCOPED_TRACE( "WriteTest" );
+
+  for( int compress = 0; compress < 2; ++compress )
+    {
+    WriteReadTest<unsigned char>( itk::ImageIOBase::UCHAR, compress );
+    WriteReadTest<char>( itk::ImageIOBase::CHAR, compress );
+    WriteReadTest<unsigned short>( itk::ImageIOBase::USHORT, compress );
+    WriteReadTest<short>( itk::ImageIOBase::SHORT, compress );
+    WriteReadTest<unsigned int>( itk::ImageIOBase::UINT, compress );
+    WriteReadTest<int>( itk::ImageIOBase::INT, compress );
+    WriteReadTest<float>( itk::ImageIOBase::FLOAT, compress );
+    WriteReadTest<double>( itk::ImageIOBase::DOUBLE, compress );
+    }
+}
+
+TEST_F( MINCImageIOTest, StreamedWriteTest )
+{
+  SCOPED_TRACE( "StreamedWriteTest" );
+
+  const unsigned int size[3] = { 9, 6, 7 };
+
+  ImageIO::Pointer writer = ImageIO::New();
+  writer->SetFileName( "write.mnc" );
+  writer->SetNumberOfDimensions( 3 );
+  writer->SetPixelType( itk::ImageIOBase::SCALAR );
+  writer->SetComponentType( itk::ImageIOBase::FLOAT );
+  writer->SetFileComponentType( itk::ImageIOBase::USHORT );
+  writer->SetNumberOfComponents( 1 );
+  writer->SetUseStreamedWriting( true );
+  writer->SetUseCompression( true );
+  writer->SetWriteChunkSize( 0, 2 );
+  EXPECT_TRUE( writer->CanStreamWrite() );
+
+  itk::ImageIORegion region( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    writer->SetDimensions( d, size[d] );
+    region.SetSize( d, size[d] );
+    }
+
+  // Each slice has its own range
+  std::vector<float> expected( region.GetNumberOfPixels() );
+  for( unsigned int i = 0; i < expected.size(); ++i )
+    expected[i] = 0.37f * i - 40.0f * ( i / ( size[1] * size[2] ) );
+
+  // Pieces must be chunk-aligned slabs that cover the region
+  unsigned int numPieces = writer->GetActualNumberOfSplitsForWriting( 4, region, region );
+  EXPECT_LE( 2u, numPieces );
+
+  long next = 0;
+  for( unsigned int i = 0; i < numPieces; ++i )
+    {
+    itk::ImageIORegion piece = writer->GetSplitRegionForWriting( i, numPieces, region, region );
+    EXPECT_EQ( next, piece.GetIndex( 0 ) ) << "piece " << i;
+    EXPECT_EQ( 0, piece.GetIndex( 0 ) % 2 ) << "piece " << i;
+    EXPECT_EQ( size[1], piece.GetSize( 1 ) ) << "piece " << i;
+    EXPECT_EQ( size[2], piece.GetSize( 2 ) ) << "piece " << i;
+    next = piece.GetIndex( 0 ) + piece.GetSize( 0 );
+
+    writer->SetIORegion( piece );
+    writer->Write( &expected[ piece.GetIndex( 0 ) * size[1] * size[2] ] );
+    }
+  EXPECT_EQ( (long) size[0], next );
+
+  ReadImageInformation( "write.mnc" );
+  EXPECT_EQ( itk::ImageIOBase::USHORT, mImageIO->GetComponentType() );
+
+  // Read back as floats; slice scaling keeps far more than the
+  // precision of the values written.
+  mImageIO->SetComponentType( itk::ImageIOBase::FLOAT );
+  mImageIO->SetIORegion( region );
+  std::vector<float> actual( expected.size() );
+  mImageIO->Read( &actual[0] );
+
+  for( unsigned int i = 0; i < expected.size(); ++i )
+    EXPECT_NEAR( expected[i], actual[i], 1e-3 ) << "i=" << i;
+}
+
+TEST_F( MINCImageIOTest, PyramidWriteTest )
+{
+  SCOPED_TRACE( "PyramidWriteTest" );
+
+  const unsigned int size[3] = { 16, 12, 10 };
+  const unsigned int half[3] = { 8, 6, 5 };
+
+  itk::ImageIORegion region( 3 );
+  itk::ImageIORegion levelRegion( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    region.SetSize( d, size[d] );
+    levelRegion.SetSize( d, half[d] );
+    }
+
+  for( int labels = 0; labels < 2; ++labels )
+    {
+    ImageIO::Pointer writer = ImageIO::New();
+    writer->SetFileName( "pyramid.mnc" );
+    writer->SetNumberOfDimensions( 3 );
+    writer->SetPixelType( itk::ImageIOBase::SCALAR );
+    writer->SetComponentType( labels ? itk::ImageIOBase::UCHAR : itk::ImageIOBase::FLOAT );
+    writer->SetNumberOfComponents( 1 );
+    writer->SetUseCompression( true );
+    writer->SetWriteLabels( labels != 0 );
+    writer->SetNumberOfPyramidLevels( 2 );
+    for( unsigned int d = 0; d < 3; ++d )
+      writer->SetDimensions( d, size[d] );
+    writer->SetIORegion( region );
+
+    // Labels repeat along the fastest dimension, so the mode of each
+    // block is known.
+    std::vector<float> values( region.GetNumberOfPixels() );
+    std::vector<unsigned char> labelValues( values.size() );
+    for( unsigned int i = 0; i < values.size(); ++i )
+      {
+      values[i] = 0.25f * i;
+      labelValues[i] = static_cast<unsigned char>( ( i / 4 ) % 7 + ( i % 4 == 3 ) );
+      }
+
+    if ( labels )
+      writer->Write( &labelValues[0] );
+    else
+      writer->Write( &values[0] );
+
+    ReadImageInformation( "pyramid.mnc" );
+    EXPECT_EQ( 3u, mImageIO->GetNumberOfResolutionLevels() );
+
+    mImageIO->SetResolutionLevel( 1 );
+    mImageIO->ReadImageInformation();
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      EXPECT_EQ( half[d], mImageIO->GetDimensions( d ) );
+      EXPECT_DOUBLE_EQ( 2.0, mImageIO->GetSpacing( d ) );
+      }
+
+    mImageIO->SetComponentType( itk::ImageIOBase::FLOAT );
+    mImageIO->SetIORegion( levelRegion );
+    std::vector<float> actual( levelRegion.GetNumberOfPixels() );
+    mImageIO->Read( &actual[0] );
+
+    for( unsigned int i = 0; i < half[0]; ++i )
+      for( unsigned int j = 0; j < half[1]; ++j )
+	for( unsigned int k = 0; k < half[2]; ++k )
+	  {
+	  double sum = 0;
+	  std::map<int,int> counts;
+	  for( unsigned int n = 0; n < 8; ++n )
+	    {
+	    const unsigned int index = ( ( 2*i + n/4 ) * size[1] + 2*j + n/2%2 ) * size[2] + 2*k + n%2;
+	    sum += values[index];
+	    ++counts[ labelValues[index] ];
+	    }
+
+	  int mode = counts.begin()->first;
+	  for( std::map<int,int>::const_iterator c = counts.begin(); c != counts.end(); ++c )
+	    if ( c->second > counts[mode] )
+	      mode = c->first;
+
+	  const float expected = labels ? mode : static_cast<float>( sum / 8 );
+	  EXPECT_NEAR( expected, actual[ ( i * half[1] + j ) * half[2] + k ], 1e-4 )
+	    << "labels=" << labels << " i=" << i << " j=" << j << " k=" << k;
+	  }
+    mImageIO->SetResolutionLevel( 0 );
+    }
+}
+
+TEST_F( MINCImageIOTest, PyramidWriteTest2D )
+{
+  SCOPED_TRACE( "PyramidWriteTest2D" );
+
+  const unsigned int size[2] = { 12, 10 };
+  const unsigned int half[2] = { 6, 5 };
+
+  itk::ImageIORegion region( 2 );
+  itk::ImageIORegion levelRegion( 2 );
+  for( unsigned int d = 0; d < 2; ++d )
+    {
+    region.SetSize( d, size[d] );
+    levelRegion.SetSize( d, half[d] );
+    }
+
+  // Without slices, floats written as integers are scaled as a whole,
+  // and so are their levels
+  ImageIO::Pointer writer = ImageIO::New();
+  writer->SetFileName( "pyramid.mnc" );
+  writer->SetNumberOfDimensions( 2 );
+  writer->SetPixelType( itk::ImageIOBase::SCALAR );
+  writer->SetComponentType( itk::ImageIOBase::FLOAT );
+  writer->SetFileComponentType( itk::ImageIOBase::USHORT );
+  writer->SetNumberOfComponents( 1 );
+  writer->SetNumberOfPyramidLevels( 2 );
+  for( unsigned int d = 0; d < 2; ++d )
+    writer->SetDimensions( d, size[d] );
+  writer->SetIORegion( region );
+
+  std::vector<float> values( region.GetNumberOfPixels() );
+  for( unsigned int i = 0; i < values.size(); ++i )
+    values[i] = 0.5f * i - 12.0f;
+  writer->Write( &values[0] );
+
+  ReadImageInformation( "pyramid.mnc" );
+  EXPECT_EQ( itk::ImageIOBase::USHORT, mImageIO->GetComponentType() );
+  EXPECT_EQ( 3u, mImageIO->GetNumberOfResolutionLevels() );
+
+  mImageIO->SetComponentType( itk::ImageIOBase::FLOAT );
+  mImageIO->SetIORegion( region );
+  std::vector<float> actual( values.size() );
+  mImageIO->Read( &actual[0] );
+  for( unsigned int i = 0; i < values.size(); ++i )
+    EXPECT_NEAR( values[i], actual[i], 1e-3 ) << "i=" << i;
+
+  mImageIO->SetResolutionLevel( 1 );
+  mImageIO->ReadImageInformation();
+  mImageIO->SetComponentType( itk::ImageIOBase::FLOAT );
+  mImageIO->SetIORegion( levelRegion );
+  std::vector<float> level( levelRegion.GetNumberOfPixels() );
+  mImageIO->Read( &level[0] );
+
+  for( unsigned int i = 0; i < half[0]; ++i )
+    for( unsigned int j = 0; j < half[1]; ++j )
+      {
+      double sum = 0;
+      for( unsigned int n = 0; n < 4; ++n )
+	sum += values[ ( 2*i + n/2 ) * size[1] + 2*j + n%2 ];
+      EXPECT_NEAR( sum / 4, level[ i * half[1] + j ], 1e-3 ) << "i=" << i << " j=" << j;
+      }
+}
+
+TEST_F( MINCImageIOTest, PyramidGeometryTest )
+{
+  SCOPED_TRACE( "PyramidGeometryTest" );
+
+  // Odd sizes lose their last voxel at each level: 7 -> 3 -> 1,
+  // 10 -> 5 -> 2 and 5 -> 2 -> 1, each level voxel covering 2 and
+  // then 4 voxels of the full image
+  const unsigned int size[3] = { 7, 10, 5 };
+  const unsigned int levelSize[2][3] = { { 3, 5, 2 }, { 1, 2, 1 } };
+
+  itk::ImageIORegion region( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    region.SetSize( d, size[d] );
+
+  ImageIO::Pointer writer = ImageIO::New();
+  writer->SetFileName( "pyramid.mnc" );
+  writer->SetNumberOfDimensions( 3 );
+  writer->SetPixelType( itk::ImageIOBase::SCALAR );
+  writer->SetComponentType( itk::ImageIOBase::FLOAT );
+  writer->SetNumberOfComponents( 1 );
+  writer->SetNumberOfPyramidLevels( 2 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    writer->SetDimensions( d, size[d] );
+    writer->SetSpacing( d, 0.5 + d );
+    writer->SetOrigin( d, -3.0 * d );
+    }
+  writer->SetIORegion( region );
+
+  std::vector<float> values( region.GetNumberOfPixels(), 1.0f );
+  writer->Write( &values[0] );
+
+  ReadImageInformation( "pyramid.mnc" );
+  ASSERT_EQ( 3u, mImageIO->GetNumberOfResolutionLevels() );
+  std::vector<double> spacing( 3 ), origin( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    spacing[d] = mImageIO->GetSpacing( d );
+    origin[d] = mImageIO->GetOrigin( d );
+    }
+
+  for( unsigned int level = 1; level <= 2; ++level )
+    {
+    mImageIO->SetResolutionLevel( level );
+    mImageIO->ReadImageInformation();
+
+    const double factor = level == 1 ? 2.0 : 4.0;
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      EXPECT_EQ( levelSize[level - 1][d], mImageIO->GetDimensions( d ) )
+	<< "level " << level << ", dimension " << d;
+      EXPECT_DOUBLE_EQ( spacing[d] * factor, mImageIO->GetSpacing( d ) )
+	<< "level " << level << ", dimension " << d;
+      EXPECT_DOUBLE_EQ( origin[d] + 0.5 * ( factor - 1.0 ) * spacing[d], mImageIO->GetOrigin( d ) )
+	<< "level " << level << ", dimension " << d;
+      }
+    }
+  mImageIO->SetResolutionLevel( 0 );
+}
+
+TEST_F( MINCImageIOTest, LabelTest )
+{
+  SCOPED_TRACE( "LabelTest" );
+
+  const unsigned int size[3] = { 4, 6, 8 };
+  itk::ImageIORegion region( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    region.SetSize( d, size[d] );
+
+  // The table leaves out the background, 0, and is given unsorted
+  const int tableValues[] = { 1000, 7, 60000, 100 };
+  const char* const tableNames[] = { "thalamus", "cortex", "ventricle", "white matter" };
+  const unsigned short labelValues[] = { 0, 7, 100, 1000, 60000 };
+
+  for( int compress = 0; compress < 2; ++compress )
+    {
+    SCOPED_TRACE( compress ? "compressed" : "uncompressed" );
+
+    std::vector<unsigned short> labels( region.GetNumberOfPixels() );
+    for( size_t i = 0; i < labels.size(); ++i )
+      labels[i] = labelValues[i % 5];
+
+    for( int strays = 0; strays < 2; ++strays )
+      {
+      ImageIO::Pointer writer = ImageIO::New();
+      writer->SetFileName( "labels.mnc" );
+      writer->SetNumberOfDimensions( 3 );
+      writer->SetPixelType( itk::ImageIOBase::SCALAR );
+      writer->SetComponentType( itk::ImageIOBase::USHORT );
+      writer->SetNumberOfComponents( 1 );
+      writer->SetUseCompression( compress != 0 );
+      writer->SetWriteLabels( true );
+      for( unsigned int d = 0; d < 3; ++d )
+	writer->SetDimensions( d, size[d] );
+      writer->SetIORegion( region );
+
+      itk::EncapsulateMetaData< std::vector<int> >( writer->GetMetaDataDictionary(), "MINC_LabelValues",
+						    std::vector<int>( tableValues, tableValues + 4 ) );
+      itk::EncapsulateMetaData< std::vector<std::string> >( writer->GetMetaDataDictionary(), "MINC_LabelNames",
+							    std::vector<std::string>( tableNames, tableNames + 4 ) );
+
+      // A voxel whose label is not in the table
+      std::vector<unsigned short> written( labels );
+      if ( strays )
+	written[5] = 5;
+      writer->Write( &written[0] );
+
+      // As stored
+      mImageIO->SetUseCompactLabels( false );
+      ReadImageInformation( "labels.mnc" );
+      EXPECT_TRUE( mImageIO->IsLabelImage() );
+      ASSERT_EQ( itk::ImageIOBase::USHORT, mImageIO->GetComponentType() );
+      EXPECT_TRUE( mImageIO->GetCompactLabelValues().empty() );
+
+      // Labels are not scaled
+      std::vector<double> slope, intercept;
+      const itk::MetaDataDictionary& dictionary = mImageIO->GetMetaDataDictionary();
+      ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( dictionary, "MINC_RescaleSlope", slope ) );
+      ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( dictionary, "MINC_RescaleIntercept", intercept ) );
+      EXPECT_EQ( std::vector<double>( 1, 1.0 ), slope );
+      EXPECT_EQ( std::vector<double>( 1, 0.0 ), intercept );
+
+      std::vector<int> values;
+      std::vector<std::string> names;
+      ASSERT_TRUE( itk::ExposeMetaData< std::vector<int> >( dictionary, "MINC_LabelValues", values ) );
+      ASSERT_TRUE( itk::ExposeMetaData< std::vector<std::string> >( dictionary, "MINC_LabelNames", names ) );
+      ASSERT_EQ( 4u, values.size() );
+      ASSERT_EQ( 4u, names.size() );
+      EXPECT_EQ( 7, values[0] );
+      EXPECT_EQ( "cortex", names[0] );
+      EXPECT_EQ( 100, values[1] );
+      EXPECT_EQ( "white matter", names[1] );
+      EXPECT_EQ( 1000, values[2] );
+      EXPECT_EQ( "thalamus", names[2] );
+      EXPECT_EQ( 60000, values[3] );
+      EXPECT_EQ( "ventricle", names[3] );
+
+      std::vector<char> stored = ReadRegion( region );
+      EXPECT_EQ( 0, std::memcmp( &written[0], &stored[0], stored.size() ) );
+
+      // Compacted, 0 taking the first index
+      mImageIO->SetUseCompactLabels( true );
+      mImageIO->ReadImageInformation();
+      ASSERT_EQ( itk::ImageIOBase::UCHAR, mImageIO->GetComponentType() );
+      ASSERT_EQ( 5u, mImageIO->GetCompactLabelValues().size() );
+      for( unsigned int v = 0; v < 5; ++v )
+	EXPECT_EQ( labelValues[v], mImageIO->GetCompactLabelValues()[v] );
+
+      if ( strays )
+	{
+	EXPECT_THROW( ReadRegion( region ), itk::ExceptionObject );
+	continue;
+	}
+
+      std::vector<char> compact = ReadRegion( region );
+      ASSERT_EQ( labels.size(), compact.size() );
+      for( size_t i = 0; i < compact.size(); ++i )
+	EXPECT_EQ( i % 5, static_cast<unsigned char>( compact[i] ) ) << "at " << i;
+      }
+    }
+}
+
+TEST_F( MINCImageIOTest, RequestedComponentTypeTest )
+{
+  SCOPED_TRACE( "RequestedComponentTypeTest" );
+
+  for( int compress = 0; compress < 2; ++compress )
+    {
+    SCOPED_TRACE( compress ? "compressed" : "uncompressed" );
+
+    if ( compress )
+      setenv( "MINC_COMPRESS", "4", 1 );
+    std::string fileCreationCommand = CreateFile( "-xyz -ounsigned -oshort -real_range -100 900", 5, 6, 7 );
+    unsetenv( "MINC_COMPRESS" );
+
+    // The real values, as libminc has them
+    mihandle_t volume;
+    ASSERT_EQ( MI_NOERROR, miopen_volume( "test.mnc", MI2_OPEN_READ, &volume ) );
+    const unsigned long starts[] = { 0, 0, 0 };
+    const unsigned long counts[] = { 5, 6, 7 };
+    std::vector<double> expected( 5 * 6 * 7 );
+    ASSERT_EQ( MI_NOERROR, miget_real_value_hyperslab( volume, MI_TYPE_DOUBLE, starts, counts, &expected[0] ) );
+    miclose_volume( volume );
+
+    itk::ImageIORegion whole( 3 );
+    for( unsigned int d = 0; d < 3; ++d )
+      whole.SetSize( d, counts[d] );
+
+    mImageIO->SetRequestedComponentType( itk::ImageIOBase::FLOAT );
+    mImageIO->ReadImageInformation();
+    ASSERT_EQ( itk::ImageIOBase::FLOAT, mImageIO->GetComponentType() );
+
+    std::vector<char> actual = ReadRegion( whole );
+    ASSERT_EQ( expected.size() * sizeof( float ), actual.size() );
+    const float* floats = reinterpret_cast<const float*>( &actual[0] );
+    for( size_t i = 0; i < expected.size(); ++i )
+      EXPECT_NEAR( expected[i], floats[i], 1e-3 ) << fileCreationCommand << " at " << i;
+
+    // Narrower than stored: clamped and rounded
+    mImageIO->SetRequestedComponentType( itk::ImageIOBase::UCHAR );
+    mImageIO->ReadImageInformation();
+    ASSERT_EQ( itk::ImageIOBase::UCHAR, mImageIO->GetComponentType() );
+
+    actual = ReadRegion( whole );
+    ASSERT_EQ( expected.size(), actual.size() );
+    for( size_t i = 0; i < expected.size(); ++i )
+      {
+      const double clamped = std::min( 255.0, std::max( 0.0, expected[i] ) );
+      EXPECT_EQ( static_cast<int>( clamped + 0.5 ), static_cast<unsigned char>( actual[i] ) )
+	<< fileCreationCommand << " at " << i;
+      }
+
+    // The stored type again
+    mImageIO->SetRequestedComponentType( itk::ImageIOBase::UNKNOWNCOMPONENTTYPE );
+    mImageIO->ReadImageInformation();
+    EXPECT_EQ( itk::ImageIOBase::USHORT, mImageIO->GetComponentType() );
+    }
+
+  mImageIO->SetRequestedComponentType( itk::ImageIOBase::LONG );
+  EXPECT_THROW( mImageIO->ReadImageInformation(), itk::ExceptionObject );
+}
+
+TEST_F( MINCImageIOTest, RawResolutionLevelTest )
+{
+  SCOPED_TRACE( "RawResolutionLevelTest" );
+
+  // Real values stored as shorts, scaled slice by slice, with one
+  // level below
+  const unsigned int size[3] = { 4, 6, 8 };
+  itk::ImageIORegion region( 3 ), levelRegion( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    region.SetSize( d, size[d] );
+    levelRegion.SetSize( d, size[d] / 2 );
+    }
+
+  ImageIO::Pointer writer = ImageIO::New();
+  writer->SetFileName( "rawlevel.mnc" );
+  writer->SetNumberOfDimensions( 3 );
+  writer->SetPixelType( itk::ImageIOBase::SCALAR );
+  writer->SetComponentType( itk::ImageIOBase::FLOAT );
+  writer->SetFileComponentType( itk::ImageIOBase::SHORT );
+  writer->SetNumberOfComponents( 1 );
+  writer->SetNumberOfPyramidLevels( 1 );
+  for( unsigned int d = 0; d < 3; ++d )
+    writer->SetDimensions( d, size[d] );
+  writer->SetIORegion( region );
+
+  std::vector<float> values( region.GetNumberOfPixels() );
+  for( unsigned int i = 0; i < values.size(); ++i )
+    values[i] = 0.25f * i;
+  writer->Write( &values[0] );
+
+  // The stored integers, as read without conversion
+  mImageIO->SetResolutionLevel( 1 );
+  mImageIO->UseRawVoxelsOn();
+  ReadImageInformation( "rawlevel.mnc" );
+  ASSERT_EQ( itk::ImageIOBase::SHORT, mImageIO->GetComponentType() );
+  std::vector<char> stored = ReadRegion( levelRegion );
+  const short* shorts = reinterpret_cast<const short*>( &stored[0] );
+
+  // Converted to float, they are still the stored integers rather
+  // than the real values
+  mImageIO->SetRequestedComponentType( itk::ImageIOBase::FLOAT );
+  ReadImageInformation( "rawlevel.mnc" );
+  ASSERT_EQ( itk::ImageIOBase::FLOAT, mImageIO->GetComponentType() );
+  std::vector<char> actual = ReadRegion( levelRegion );
+  const float* floats = reinterpret_cast<const float*>( &actual[0] );
+
+  bool scaled = false;
+  for( size_t i = 0; i < levelRegion.GetNumberOfPixels(); ++i )
+    {
+    EXPECT_EQ( static_cast<float>( shorts[i] ), floats[i] ) << "at " << i;
+    scaled = scaled || std::abs( shorts[i] ) > 1000;
+    }
+  EXPECT_TRUE( scaled );
+}
+
+TEST_F( MINCImageIOTest, VolumeCacheTest )
+{
+  SCOPED_TRACE( "VolumeCacheTest" );
+
+  itk::MINCVolumeCache::Clear();
+  CreateFile( "-xyz -ounsigned -obyte", 4, 5, 6 );
+
+  // A second reader of the same file shares the handle
+  ImageIO::Pointer other = ImageIO::New();
+  other->SetFileName( "test.mnc" );
+  other->ReadImageInformation();
+  EXPECT_EQ( 1u, itk::MINCVolumeCache::GetNumberOfOpenVolumes() );
+  EXPECT_EQ( 6u, other->GetDimensions( 2 ) );
+
+  // Rewriting the file closes the handle its readers still hold, and
+  // the file is opened afresh
+  CreateFile( "-xyz -ounsigned -obyte", 4, 5, 8 );
+  EXPECT_EQ( 8u, mImageIO->GetDimensions( 2 ) );
+  EXPECT_EQ( 1u, itk::MINCVolumeCache::GetNumberOfOpenVolumes() );
+  other = 0;
+  EXPECT_EQ( 1u, itk::MINCVolumeCache::GetNumberOfOpenVolumes() );
+
+  // Users of a shared handle take turns, until it is closed under them
+  unsigned long first, second;
+  mihandle_t firstVolume, secondVolume;
+  std::vector<midimhandle_t> dimensions;
+  ASSERT_TRUE( itk::MINCVolumeCache::Acquire( "test.mnc", &first, &firstVolume, &dimensions ) );
+  ASSERT_TRUE( itk::MINCVolumeCache::Acquire( "test.mnc", &second, &secondVolume, &dimensions ) );
+  EXPECT_EQ( first, second );
+  EXPECT_EQ( firstVolume, secondVolume );
+  EXPECT_EQ( 3u, dimensions.size() );
+  {
+  itk::MINCVolumeCache::LockHolder lock( first );
+  EXPECT_TRUE( lock.IsLocked() );
+  }
+  itk::MINCVolumeCache::Clear();
+  EXPECT_EQ( 0u, itk::MINCVolumeCache::GetNumberOfOpenVolumes() );
+  EXPECT_FALSE( itk::MINCVolumeCache::Lock( second ) );
+  itk::MINCVolumeCache::Release( first );
+  itk::MINCVolumeCache::Release( second );
+
+  mImageIO = 0;
+  EXPECT_EQ( 0u, itk::MINCVolumeCache::GetNumberOfOpenVolumes() );
+}
+
+TEST_F( MINCImageIOTest, GeneratorTest )
+{
+  SCOPED_TRACE( "GeneratorTest" );
+
+  const unsigned long shape[] = { 6, 5, 7 };
+
+  itk::MINCVolumeGenerator generator;
+  generator.AddDimension( "zspace", shape[0] );
+  generator.AddDimension( "yspace", shape[1], -2.0, 0.5 );
+  generator.AddDimension( "xspace", shape[2] );
+  generator.SetComponentType( itk::ImageIOBase::SHORT );
+  generator.SetRealRange( -10, 50 );
+  generator.SetSliceScaling( true );
+  generator.SetCompressionLevel( 1 );
+  std::vector<unsigned long> chunkSize( 3, 0 );
+  chunkSize[0] = 2;
+  chunkSize[2] = 3;
+  generator.SetChunkSize( chunkSize );
+  generator.SetFillPattern( itk::MINCVolumeGenerator::NoisyGradient );
+  ASSERT_TRUE( generator.Write( "test.mnc" ) );
+
+  mihandle_t volume;
+  ASSERT_EQ( MI_NOERROR, miopen_volume( "test.mnc", MI2_OPEN_READ, &volume ) );
+
+  miboolean_t sliceScaling = 0;
+  miget_slice_scaling_flag( volume, &sliceScaling );
+  EXPECT_TRUE( sliceScaling );
+
+  mivolumeprops_t props;
+  ASSERT_EQ( MI_NOERROR, miget_volume_props( volume, &props ) );
+  int edgeCount = 0;
+  int edges[3] = { 0, 0, 0 };
+  miget_props_blocking( props, &edgeCount, edges, 3 );
+  mifree_volume_props( props );
+  ASSERT_EQ( 3, edgeCount );
+  EXPECT_EQ( 2, edges[0] );
+  EXPECT_EQ( 5, edges[1] );
+  EXPECT_EQ( 3, edges[2] );
+
+  // Slice s of 6 spans [-10, -10 + 60 * (s + 1) / 6]
+  const unsigned long starts[] = { 0, 0, 0 };
+  std::vector<double> actual( shape[0] * shape[1] * shape[2] );
+  ASSERT_EQ( MI_NOERROR, miget_real_value_hyperslab( volume, MI_TYPE_DOUBLE, starts, shape, &actual[0] ) );
+  miclose_volume( volume );
+
+  size_t n = 0;
+  unsigned long index[3];
+  for( index[0] = 0; index[0] < shape[0]; ++index[0] )
+    for( index[1] = 0; index[1] < shape[1]; ++index[1] )
+      for( index[2] = 0; index[2] < shape[2]; ++index[2], ++n )
+	{
+	const double sliceMax = -10 + 60.0 * ( index[0] + 1 ) / shape[0];
+	const double expected = -10 + generator.GetFillValue( index ) * ( sliceMax + 10 );
+	EXPECT_NEAR( expected, actual[n], 1e-3 )
+	  << "at " << index[0] << "," << index[1] << "," << index[2];
+	}
+
+  ReadImageInformation( "test.mnc" );
+  EXPECT_EQ( 0.5, mImageIO->GetSpacing( 1 ) );
+
+  // Empty volumes are refused, records or not
+  itk::MINCVolumeGenerator empty;
+  empty.AddDimension( "time", 0 );
+  empty.AddDimension( "yspace", 3 );
+  empty.AddDimension( "xspace", 4 );
+  empty.SetSliceScaling( true );
+  EXPECT_FALSE( empty.Write( "empty.mnc" ) );
+  empty.SetFileFormat( itk::MINCVolumeGenerator::MINC1Format );
+  EXPECT_FALSE( empty.Write( "empty.mnc" ) );
+}
+
+
+// Counts the progress and statistics events of a MINCImageIO
+class EventCounter : public itk::Command
+{
+public:
+  typedef EventCounter Self;
+  typedef itk::SmartPointer<Self> Pointer;
+  itkNewMacro( Self );
+
+  void Execute( itk::Object* caller, const itk::EventObject& event )
+  {
+    this->Execute( static_cast<const itk::Object*>( caller ), event );
+  }
+
+  void Execute( const itk::Object*, const itk::EventObject& event )
+  {
+    if ( itk::MINCReadStatisticsEvent().CheckEvent( &event ) )
+      ++numStatistics;
+    else if ( itk::ProgressEvent().CheckEvent( &event ) )
+      ++numProgress;
+  }
+
+  int numProgress;
+  int numStatistics;
+
+protected:
+  EventCounter() : numProgress( 0 ), numStatistics( 0 ) {}
+};
+
+TEST_F( MINCImageIOTest, ReadStatisticsTest )
+{
+  SCOPED_TRACE( "ReadStatisticsTest" );
+
+  setenv( "MINC_COMPRESS", "4", 1 );
+  std::string fileCreationCommand = CreateFile( "-xyz -ounsigned -oshort -real_range 0 1000", 11, 40, 37 );
+  unsetenv( "MINC_COMPRESS" );
+
+  itk::ImageIORegion whole( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    whole.SetSize( d, mImageIO->GetDimensions( d ) );
+
+  // Nothing is counted unless asked for
+  ReadRegion( whole );
+  EXPECT_EQ( 0u, mImageIO->GetReadStatistics().numberOfReads );
+  EXPECT_EQ( 0u, mImageIO->GetReadStatistics().bytesRead );
+
+  EventCounter::Pointer counter = EventCounter::New();
+  mImageIO->AddObserver( itk::ProgressEvent(), counter );
+  mImageIO->AddObserver( itk::MINCReadStatisticsEvent(), counter );
+
+  ImageIO::ResetGlobalReadStatistics();
+  mImageIO->CollectReadStatisticsOn();
+  mImageIO->ReadImageInformation();
+  std::vector<char> buffer = ReadRegion( whole );
+
+  const itk::MINCReadStatistics& statistics = mImageIO->GetReadStatistics();
+  EXPECT_EQ( 1u, statistics.numberOfOpens ) << fileCreationCommand;
+  EXPECT_EQ( 1u, statistics.numberOfReads ) << fileCreationCommand;
+  EXPECT_EQ( buffer.size(), statistics.bytesRequested ) << fileCreationCommand;
+
+  // A ramp compresses well: fewer bytes are read than handed out, but
+  // every chunk has to be inflated
+  EXPECT_LT( 0u, statistics.bytesRead ) << fileCreationCommand;
+  EXPECT_GT( 1.0, statistics.GetReadAmplification() ) << fileCreationCommand;
+  EXPECT_LT( 0u, statistics.chunksRead ) << fileCreationCommand;
+  EXPECT_EQ( statistics.chunksRead, statistics.chunksDecompressed ) << fileCreationCommand;
+  EXPECT_LE( 0.0, statistics.readTime );
+
+  EXPECT_EQ( 2, counter->numProgress );
+  EXPECT_EQ( 2, counter->numStatistics );
+
+  const itk::MINCReadStatistics global = ImageIO::GetGlobalReadStatistics();
+  EXPECT_EQ( statistics.numberOfReads, global.numberOfReads );
+  EXPECT_EQ( statistics.bytesRead, global.bytesRead );
+
+  // Reading slice by slice through the chunk cache, each chunk is read
+  // once and then found in the cache
+  mImageIO->ResetReadStatistics();
+  mImageIO->SetChunkCacheMode( ImageIO::ChunkCacheAuto );
+  for( unsigned long s = 0; s < mImageIO->GetDimensions( 0 ); ++s )
+    {
+    itk::ImageIORegion slice( whole );
+    slice.SetIndex( 0, s );
+    slice.SetSize( 0, 1 );
+    ReadRegion( slice );
+    }
+  EXPECT_EQ( mImageIO->GetDimensions( 0 ), statistics.numberOfReads );
+  EXPECT_EQ( buffer.size(), statistics.bytesRequested );
+  EXPECT_LT( 0u, statistics.chunkCacheHits ) << fileCreationCommand;
+
+  mImageIO->ResetReadStatistics();
+  EXPECT_EQ( 0u, statistics.numberOfReads );
+}
+
+TEST_F( MINCImageIOTest, SamplingTest )
+{
+  SCOPED_TRACE( "SamplingTest" );
+
+  const unsigned long shape[] = { 16, 24, 32 };
+  const unsigned int factors[] = { 2, 3, 4 };
+  const unsigned long sampled[] = { 8, 8, 8 };
+
+  // Slice scaling, so that a block spans slices of different scales
+  itk::MINCVolumeGenerator generator;
+  generator.AddDimension( "zspace", shape[0] );
+  generator.AddDimension( "yspace", shape[1], -2.0, 0.5 );
+  generator.AddDimension( "xspace", shape[2], 10.0, -1.0 );
+  generator.SetComponentType( itk::ImageIOBase::SHORT );
+  generator.SetRealRange( -10, 50 );
+  generator.SetSliceScaling( true );
+  generator.SetCompressionLevel( 1 );
+  std::vector<unsigned long> chunkSize( 3, 8 );
+  chunkSize[0] = 4;
+  generator.SetChunkSize( chunkSize );
+  generator.SetFillPattern( itk::MINCVolumeGenerator::NoisyGradient );
+  ASSERT_TRUE( generator.Write( "test.mnc" ) );
+
+  mImageIO->SetFileName( "test.mnc" );
+  mImageIO->SetRequestedComponentType( itk::ImageIOBase::FLOAT );
+  mImageIO->ReadImageInformation();
+
+  std::vector<double> origin( 3 ), spacing( 3 );
+  itk::ImageIORegion whole( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    origin[d] = mImageIO->GetOrigin( d );
+    spacing[d] = mImageIO->GetSpacing( d );
+    whole.SetSize( d, shape[d] );
+    }
+  std::vector<char> fullBytes = ReadRegion( whole );
+  const float* full = reinterpret_cast<const float*>( &fullBytes[0] );
+
+  itk::ImageIORegion sampledRegion( 3 );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    mImageIO->SetSamplingFactor( d, factors[d] );
+    sampledRegion.SetSize( d, sampled[d] );
+    }
+
+  for( int average = 0; average < 2; ++average )
+    {
+    SCOPED_TRACE( average ? "average" : "nearest" );
+
+    mImageIO->SetSamplingMode( average ? ImageIO::SamplingAverage : ImageIO::SamplingNearest );
+    mImageIO->CollectReadStatisticsOn();
+    mImageIO->ReadImageInformation();
+
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      ASSERT_EQ( sampled[d], mImageIO->GetDimensions( d ) );
+      EXPECT_DOUBLE_EQ( spacing[d] * factors[d], mImageIO->GetSpacing( d ) );
+      }
+    // A mean sits at the centre of its block, along the stored axis
+    EXPECT_DOUBLE_EQ( origin[0] + ( average ? 0.5 : 0.0 ), mImageIO->GetOrigin( 0 ) );
+    EXPECT_DOUBLE_EQ( origin[1] + ( average ? 0.5 : 0.0 ), mImageIO->GetOrigin( 1 ) );
+    EXPECT_DOUBLE_EQ( origin[2] - ( average ? 1.5 : 0.0 ), mImageIO->GetOrigin( 2 ) );
+
+    mImageIO->ResetReadStatistics();
+    std::vector<char> actualBytes = ReadRegion( sampledRegion );
+    ASSERT_EQ( 8u * 8 * 8 * sizeof( float ), actualBytes.size() );
+    const float* actual = reinterpret_cast<const float*>( &actualBytes[0] );
+
+    // Every chunk is decoded once at most
+    EXPECT_LE( mImageIO->GetReadStatistics().chunksDecompressed, 4u * 3 * 4 );
+
+    for( unsigned long i = 0; i < 8; ++i )
+      for( unsigned long j = 0; j < 8; ++j )
+	for( unsigned long k = 0; k < 8; ++k )
+	  {
+	  double expected = 0;
+	  unsigned int count = 0;
+	  for( unsigned int a = 0; a < ( average ? factors[0] : 1 ); ++a )
+	    for( unsigned int b = 0; b < ( average ? factors[1] : 1 ); ++b )
+	      for( unsigned int c = 0; c < ( average ? factors[2] : 1 ); ++c, ++count )
+		expected += full[ ( ( i * factors[0] + a ) * shape[1] + j * factors[1] + b ) * shape[2]
+				  + k * factors[2] + c ];
+	  EXPECT_NEAR( expected / count, actual[ ( i * 8 + j ) * 8 + k ], 1e-4 )
+	    << "at " << i << "," << j << "," << k;
+	  }
+
+    // A region of the sampled image is that part of the whole
+    itk::ImageIORegion part( 3 );
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      part.SetIndex( d, 3 );
+      part.SetSize( d, 2 );
+      }
+    std::vector<char> partBytes = ReadRegion( part );
+    const float* partValues = reinterpret_cast<const float*>( &partBytes[0] );
+    for( unsigned long i = 0; i < 2; ++i )
+      for( unsigned long j = 0; j < 2; ++j )
+	for( unsigned long k = 0; k < 2; ++k )
+	  {
+	  EXPECT_FLOAT_EQ( actual[ ( ( i + 3 ) * 8 + j + 3 ) * 8 + k + 3 ], partValues[ ( i * 2 + j ) * 2 + k ] )
+	    << "at " << i << "," << j << "," << k;
+	  }
+    }
+}
+
+
+TEST_F( MINCImageIOTest, CatalogTest )
+{
+  SCOPED_TRACE( "CatalogTest" );
+
+  // Slice-scaled shorts in compressed chunks
+  itk::MINCVolumeGenerator generator;
+  generator.AddDimension( "zspace", 6, 4.0, 2.0 );
+  generator.AddDimension( "yspace", 8, -2.0, 0.5 );
+  generator.AddDimension( "xspace", 10, 10.0, -1.0 );
+  generator.SetComponentType( itk::ImageIOBase::SHORT );
+  generator.SetRealRange( -10, 50 );
+  generator.SetSliceScaling( true );
+  generator.SetCompressionLevel( 4 );
+  generator.SetChunkSize( std::vector<unsigned long>( 3, 4 ) );
+  ASSERT_TRUE( generator.Write( "catalog-scaled.mnc" ) );
+
+  // Contiguous labels
+  generator.ClearDimensions();
+  generator.AddDimension( "yspace", 5 );
+  generator.AddDimension( "xspace", 7 );
+  generator.SetComponentType( itk::ImageIOBase::UCHAR );
+  generator.SetLabels( true );
+  generator.SetSliceScaling( false );
+  generator.SetCompressionLevel( 0 );
+  generator.SetChunkSize( std::vector<unsigned long>() );
+  ASSERT_TRUE( generator.Write( "catalog-labels.mnc" ) );
+
+  std::ofstream( "catalog-text.mnc" ) << "not a MINC file\n";
+  std::remove( "catalog-missing.mnc" );
+
+  const char* const names[] = { "catalog-scaled.mnc", "catalog-labels.mnc",
+				"catalog-text.mnc", "catalog-missing.mnc" };
+
+  // Enough files for the pool to look up batches ahead of the
+  // parsing; scanning a file again replaces its entry
+  std::vector<std::string> fileNames;
+  for( int repeat = 0; repeat < 20; ++repeat )
+    fileNames.insert( fileNames.end(), names, names + 4 );
+
+  itk::MINCCatalog catalog;
+  catalog.SetNumberOfThreads( 2 );
+  EXPECT_EQ( 40u, catalog.Scan( fileNames ) );
+  ASSERT_EQ( 4u, catalog.GetNumberOfEntries() );
+  EXPECT_TRUE( catalog.Find( "catalog-other.mnc" ) == 0 );
+
+  const itk::MINCCatalogEntry* scaled = catalog.Find( "catalog-scaled.mnc" );
+  ASSERT_TRUE( scaled != 0 );
+  ASSERT_TRUE( scaled->IsValid() ) << scaled->error;
+
+  ReadImageInformation( "catalog-scaled.mnc" );
+  EXPECT_EQ( mImageIO->GetPixelType(), scaled->pixelType );
+  EXPECT_EQ( mImageIO->GetComponentType(), scaled->componentType );
+  EXPECT_EQ( 1u, scaled->numberOfComponents );
+  EXPECT_FALSE( scaled->labels );
+  ASSERT_EQ( 3u, scaled->dimensions.size() );
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    EXPECT_EQ( mImageIO->GetDimensions( d ), scaled->dimensions[d] );
+    EXPECT_DOUBLE_EQ( mImageIO->GetSpacing( d ), scaled->spacing[d] );
+    EXPECT_DOUBLE_EQ( mImageIO->GetOrigin( d ), scaled->origin[d] );
+    EXPECT_EQ( mImageIO->GetDirection( d ), scaled->direction[d] );
+    EXPECT_EQ( 4u, scaled->chunkSize[d] );
+    }
+  EXPECT_EQ( 4, scaled->compressionLevel );
+  EXPECT_TRUE( scaled->IsSliceScaled() );
+  EXPECT_EQ( 6u, scaled->rescaleSlope.size() );
+  EXPECT_EQ( 6u, scaled->rescaleIntercept.size() );
+
+  struct stat status;
+  ASSERT_EQ( 0, stat( "catalog-scaled.mnc", &status ) );
+  EXPECT_EQ( static_cast<unsigned long long>( status.st_size ), scaled->fileSize );
+  EXPECT_EQ( static_cast<long long>( status.st_mtime ), scaled->modificationTime );
+#if defined(__linux__)
+  EXPECT_EQ( static_cast<long long>( status.st_mtim.tv_nsec ), scaled->modificationNanoseconds );
+#endif
+
+  const itk::MINCCatalogEntry* labels = catalog.Find( "catalog-labels.mnc" );
+  ASSERT_TRUE( labels != 0 );
+  ASSERT_TRUE( labels->IsValid() ) << labels->error;
+  EXPECT_TRUE( labels->labels );
+  EXPECT_EQ( itk::ImageIOBase::UCHAR, labels->componentType );
+  EXPECT_EQ( 0, labels->compressionLevel );
+  EXPECT_EQ( std::vector<unsigned int>( 2, 1 ), labels->chunkSize );
+  EXPECT_FALSE( labels->IsSliceScaled() );
+
+  EXPECT_FALSE( catalog.Find( "catalog-text.mnc" )->IsValid() );
+  EXPECT_FALSE( catalog.Find( "catalog-missing.mnc" )->IsValid() );
+
+  std::vector<size_t> volumes = catalog.Select( []( const itk::MINCCatalogEntry& entry )
+						{ return entry.dimensions.size() == 3; } );
+  ASSERT_EQ( 1u, volumes.size() );
+  EXPECT_EQ( "catalog-scaled.mnc", catalog.GetEntry( volumes[0] ).fileName );
+
+  // The index holds the same entries, in the same order
+  ASSERT_TRUE( catalog.Write( "catalog.index" ) );
+  itk::MINCCatalog loaded;
+  ASSERT_TRUE( loaded.Read( "catalog.index" ) );
+  ASSERT_EQ( catalog.GetNumberOfEntries(), loaded.GetNumberOfEntries() );
+  for( size_t i = 0; i < catalog.GetNumberOfEntries(); ++i )
+    {
+    const itk::MINCCatalogEntry& expected = catalog.GetEntry( i );
+    const itk::MINCCatalogEntry& actual = loaded.GetEntry( i );
+    EXPECT_EQ( expected.fileName, actual.fileName );
+    EXPECT_EQ( expected.fileSize, actual.fileSize );
+    EXPECT_EQ( expected.modificationTime, actual.modificationTime );
+    EXPECT_EQ( expected.modificationNanoseconds, actual.modificationNanoseconds );
+    EXPECT_EQ( expected.error, actual.error );
+    EXPECT_EQ( expected.pixelType, actual.pixelType );
+    EXPECT_EQ( expected.componentType, actual.componentType );
+    EXPECT_EQ( expected.numberOfComponents, actual.numberOfComponents );
+    EXPECT_EQ( expected.labels, actual.labels );
+    EXPECT_EQ( expected.dimensions, actual.dimensions );
+    EXPECT_EQ( expected.spacing, actual.spacing );
+    EXPECT_EQ( expected.origin, actual.origin );
+    EXPECT_EQ( expected.direction, actual.direction );
+    EXPECT_EQ( expected.chunkSize, actual.chunkSize );
+    EXPECT_EQ( expected.compressionLevel, actual.compressionLevel );
+    EXPECT_EQ( expected.rescaleSlope, actual.rescaleSlope );
+    EXPECT_EQ( expected.rescaleIntercept, actual.rescaleIntercept );
+    EXPECT_EQ( expected.numberOfResolutionLevels, actual.numberOfResolutionLevels );
+    }
+  EXPECT_TRUE( loaded.Find( "catalog-labels.mnc" ) != 0 );
+
+  // A truncated index is rejected whole
+  std::ifstream in( "catalog.index", std::ios::binary );
+  std::string bytes( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() );
+  std::ofstream( "catalog.index", std::ios::binary | std::ios::trunc ).write( bytes.data(), bytes.size() - 1 );
+  EXPECT_FALSE( loaded.Read( "catalog.index" ) );
+  EXPECT_EQ( 4u, loaded.GetNumberOfEntries() );
+  EXPECT_FALSE( loaded.Read( "catalog-text.mnc" ) );
+}
+
+
+TEST_F( MINCImageIOTest, HeaderCacheTest )
+{
+  SCOPED_TRACE( "HeaderCacheTest" );
+
+  // Irregular frames, slice scaling and an axis order that canonical
+  // order changes, so that every part of the header matters
+  itk::MINCVolumeGenerator generator;
+  generator.AddDimension( "time", 3 );
+  generator.SetDimensionOffsets( 0, { 0.0, 2.0, 5.0 }, { 2.0, 3.0, 4.0 } );
+  generator.AddDimension( "xspace", 4, 1.0, 2.0 );
+  generator.AddDimension( "zspace", 5, -3.0, 0.5 );
+  generator.AddDimension( "yspace", 6 );
+  generator.SetComponentType( itk::ImageIOBase::SHORT );
+  generator.SetRealRange( -10, 50 );
+  generator.SetSliceScaling( true );
+  generator.SetCompressionLevel( 2 );
+  generator.SetChunkSize( std::vector<unsigned long>( 4, 2 ) );
+  ASSERT_TRUE( generator.Write( "cached.mnc" ) );
+  itk::MINCHeaderCache::Remove( "cached.mnc" );
+
+  ImageIO::Pointer reference = ImageIO::New();
+  reference->SetFileName( "cached.mnc" );
+  reference->UseCanonicalOrderOn();
+  reference->ReadImageInformation();
+
+  const unsigned int numDimensions = reference->GetNumberOfDimensions();
+  ASSERT_EQ( 4u, numDimensions );
+  itk::ImageIORegion whole( numDimensions );
+  for( unsigned int d = 0; d < numDimensions; ++d )
+    whole.SetSize( d, reference->GetDimensions( d ) );
+
+  std::vector<char> expected( whole.GetNumberOfPixels() * reference->GetComponentSize() );
+  reference->SetIORegion( whole );
+  reference->Read( &expected[0] );
+
+  // The first reader stores the header, the second reads it from the
+  // record and only opens the file to read the voxels
+  for( int pass = 0; pass < 2; ++pass )
+    {
+    SCOPED_TRACE( pass ? "restored" : "stored" );
+
+    mImageIO = ImageIO::New();
+    mImageIO->UseCanonicalOrderOn();
+    mImageIO->UseHeaderCacheOn();
+    mImageIO->CollectReadStatisticsOn();
+    ReadImageInformation( "cached.mnc" );
+    EXPECT_EQ( pass ? 0u : 1u, mImageIO->GetReadStatistics().numberOfOpens );
+    EXPECT_TRUE( std::ifstream( itk::MINCHeaderCache::GetRecordFileName( "cached.mnc" ).c_str() ).good() );
+
+    ASSERT_EQ( numDimensions, mImageIO->GetNumberOfDimensions() );
+    for( unsigned int d = 0; d < numDimensions; ++d )
+      {
+      EXPECT_EQ( reference->GetDimensions( d ), mImageIO->GetDimensions( d ) );
+      EXPECT_EQ( reference->GetSpacing( d ), mImageIO->GetSpacing( d ) );
+      EXPECT_EQ( reference->GetOrigin( d ), mImageIO->GetOrigin( d ) );
+      EXPECT_EQ( reference->GetDirection( d ), mImageIO->GetDirection( d ) );
+      EXPECT_EQ( reference->GetChunkSize( d ), mImageIO->GetChunkSize( d ) );
+      EXPECT_EQ( reference->GetFileDimension( d ), mImageIO->GetFileDimension( d ) );
+      }
+    EXPECT_EQ( reference->GetComponentType(), mImageIO->GetComponentType() );
+    EXPECT_EQ( reference->GetTimeDimension(), mImageIO->GetTimeDimension() );
+    EXPECT_EQ( 2, mImageIO->GetStoredCompressionLevel() );
+
+    const char* const keys[] = { "MINC_FrameTimes", "MINC_FrameWidths",
+				 "MINC_RescaleSlope", "MINC_RescaleIntercept" };
+    for( unsigned int k = 0; k < 4; ++k )
+      {
+      std::vector<double> expectedValues, actualValues;
+      ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( reference->GetMetaDataDictionary(),
+							       keys[k], expectedValues ) );
+      ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( mImageIO->GetMetaDataDictionary(),
+							       keys[k], actualValues ) );
+      EXPECT_EQ( expectedValues, actualValues ) << keys[k];
+      }
+
+    // Either way the file is opened once
+    EXPECT_EQ( expected, ReadRegion( whole ) );
+    EXPECT_EQ( 1u, mImageIO->GetReadStatistics().numberOfOpens );
+    }
+
+  // Other settings make another header, which replaces the record
+  mImageIO = ImageIO::New();
+  mImageIO->UseHeaderCacheOn();
+  mImageIO->CollectReadStatisticsOn();
+  ReadImageInformation( "cached.mnc" );
+  EXPECT_EQ( 1u, mImageIO->GetReadStatistics().numberOfOpens );
+  EXPECT_EQ( 3u, mImageIO->GetDimensions( 0 ) );
+
+  // The record of a file since rewritten is not used
+  generator.ClearDimensions();
+  generator.AddDimension( "zspace", 2 );
+  generator.AddDimension( "yspace", 3 );
+  generator.AddDimension( "xspace", 7 );
+  generator.SetSliceScaling( false );
+  ASSERT_TRUE( generator.Write( "cached.mnc" ) );
+  ReadImageInformation( "cached.mnc" );
+  EXPECT_EQ( 2u, mImageIO->GetReadStatistics().numberOfOpens );
+  ASSERT_EQ( 3u, mImageIO->GetNumberOfDimensions() );
+  EXPECT_EQ( 7u, mImageIO->GetDimensions( 2 ) );
+
+  // Records may be kept together in a directory instead
+  mkdir( "headercache", 0777 );
+  itk::MINCHeaderCache::SetDirectory( "headercache" );
+  EXPECT_EQ( 0u, itk::MINCHeaderCache::GetRecordFileName( "cached.mnc" ).find( "headercache/" ) );
+  itk::MINCHeaderCache::Remove( "cached.mnc" );
+  for( int pass = 0; pass < 2; ++pass )
+    {
+    mImageIO = ImageIO::New();
+    mImageIO->UseHeaderCacheOn();
+    mImageIO->CollectReadStatisticsOn();
+    ReadImageInformation( "cached.mnc" );
+    EXPECT_EQ( pass ? 0u : 1u, mImageIO->GetReadStatistics().numberOfOpens ) << "pass " << pass;
+    EXPECT_EQ( 7u, mImageIO->GetDimensions( 2 ) );
+    }
+  itk::MINCHeaderCache::SetDirectory( "" );
+}
+
+TEST_F( MINCImageIOTest, MINC1Test )
+{
+  SCOPED_TRACE( "MINC1Test" );
+
+  // Irregular frames along the record dimension, with slice ranges
+  // and a record of odd size to pad; regular frames, the image being
+  // the only record variable; and a vector volume without records
+  for( int volume = 0; volume < 3; ++volume )
+    {
+    SCOPED_TRACE( volume );
+
+    const double cosines[3] = { 0.6, 0.8, 0.0 };
+    itk::MINCVolumeGenerator generator;
+    generator.SetFillPattern( itk::MINCVolumeGenerator::NoisyGradient );
+    switch( volume )
+      {
+      case 0:
+	generator.AddDimension( "time", 3 );
+	generator.SetDimensionOffsets( 0, { 0.0, 2.0, 5.0 }, { 2.0, 3.0, 4.0 } );
+	generator.AddDimension( "xspace", 3, 1.0, 2.0 );
+	generator.AddDimension( "zspace", 5, -3.0, 0.5 );
+	generator.AddDimension( "yspace", 7 );
+	generator.SetDimensionCosines( 1, cosines );
+	generator.SetComponentType( itk::ImageIOBase::CHAR );
+	generator.SetRealRange( -10, 50 );
+	generator.SetSliceScaling( true );
+	break;
+      case 1:
+	generator.AddDimension( "time", 2, 10.0, 2.0 );
+	generator.AddDimension( "yspace", 3, 0.0, -1.5 );
+	generator.AddDimension( "xspace", 5 );
+	break;
+      default:
+	generator.AddDimension( "zspace", 4 );
+	generator.AddDimension( "yspace", 5 );
+	generator.AddDimension( "xspace", 6, 2.0, 0.25 );
+	generator.AddDimension( "vector_dimension", 3 );
+	generator.SetComponentType( itk::ImageIOBase::FLOAT );
+	generator.SetRealRange( -1, 1 );
+	break;
+      }
+    ASSERT_TRUE( generator.Write( "minc2.mnc" ) );
+    generator.SetFileFormat( itk::MINCVolumeGenerator::MINC1Format );
+    ASSERT_TRUE( generator.Write( "minc1.mnc" ) );
+
+    EXPECT_TRUE( mImageIO->CanReadFile( "minc1.mnc" ) );
+
+    for( int raw = 0; raw < 2; ++raw )
+      {
+      SCOPED_TRACE( raw ? "raw" : "real" );
+
+      ImageIO::Pointer reference = ImageIO::New();
+      reference->UseCanonicalOrderOn();
+      reference->SetUseRawVoxels( raw );
+      reference->SetFileName( "minc2.mnc" );
+      reference->ReadImageInformation();
+
+      mImageIO = ImageIO::New();
+      mImageIO->UseCanonicalOrderOn();
+      mImageIO->SetUseRawVoxels( raw );
+      mImageIO->CollectReadStatisticsOn();
+      ReadImageInformation( "minc1.mnc" );
+
+      const unsigned int numDimensions = reference->GetNumberOfDimensions();
+      ASSERT_EQ( numDimensions, mImageIO->GetNumberOfDimensions() );
+      for( unsigned int d = 0; d < numDimensions; ++d )
+	{
+	EXPECT_EQ( reference->GetDimensions( d ), mImageIO->GetDimensions( d ) ) << "dimension " << d;
+	EXPECT_DOUBLE_EQ( reference->GetSpacing( d ), mImageIO->GetSpacing( d ) ) << "dimension " << d;
+	EXPECT_DOUBLE_EQ( reference->GetOrigin( d ), mImageIO->GetOrigin( d ) ) << "dimension " << d;
+	EXPECT_EQ( reference->GetFileDimension( d ), mImageIO->GetFileDimension( d ) ) << "dimension " << d;
+	for( unsigned int i = 0; i < numDimensions; ++i )
+	  {
+	  EXPECT_NEAR( reference->GetDirection( d )[i], mImageIO->GetDirection( d )[i], 1e-12 )
+	    << "dimension " << d << ", axis " << i;
+	  }
+	}
+      EXPECT_EQ( reference->GetComponentType(), mImageIO->GetComponentType() );
+      EXPECT_EQ( reference->GetNumberOfComponents(), mImageIO->GetNumberOfComponents() );
+      EXPECT_EQ( reference->GetTimeDimension(), mImageIO->GetTimeDimension() );
+      EXPECT_EQ( 0, mImageIO->GetStoredCompressionLevel() );
+
+      const char* const keys[] = { "MINC_RescaleSlope", "MINC_RescaleIntercept",
+				   "MINC_FrameTimes", "MINC_FrameWidths" };
+      for( unsigned int k = 0; k < ( volume < 2 ? 4u : 2u ); ++k )
+	{
+	std::vector<double> expectedValues, actualValues;
+	ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( reference->GetMetaDataDictionary(),
+								 keys[k], expectedValues ) );
+	ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( mImageIO->GetMetaDataDictionary(),
+								 keys[k], actualValues ) );
+	ASSERT_EQ( expectedValues.size(), actualValues.size() ) << keys[k];
+	for( size_t i = 0; i < expectedValues.size(); ++i )
+	  EXPECT_DOUBLE_EQ( expectedValues[i], actualValues[i] ) << keys[k] << " " << i;
+	}
+
+      // The whole image, and a region inside it
+      itk::ImageIORegion whole( numDimensions ), inside( numDimensions );
+      for( unsigned int d = 0; d < numDimensions; ++d )
+	{
+	whole.SetSize( d, reference->GetDimensions( d ) );
+	inside.SetIndex( d, 1 );
+	inside.SetSize( d, reference->GetDimensions( d ) - 1 );
+	}
+
+      const itk::ImageIORegion regions[] = { whole, inside };
+      for( unsigned int r = 0; r < 2; ++r )
+	{
+	std::vector<char> expected( regions[r].GetNumberOfPixels() * reference->GetNumberOfComponents()
+				    * reference->GetComponentSize() );
+	reference->SetIORegion( regions[r] );
+	reference->Read( &expected[0] );
+	EXPECT_EQ( expected, ReadRegion( regions[r] ) ) << "region " << r;
+	}
+      EXPECT_EQ( 1u, mImageIO->GetReadStatistics().numberOfOpens );
+      }
+    }
+}
+
+TEST_F( MINCImageIOTest, NetCDFHeaderTest )
+{
+  SCOPED_TRACE( "NetCDFHeaderTest" );
+
+  // A MINC1 file put together byte by byte: 2 records along time of
+  // 3x4 unsigned shorts, each with its own image-min and image-max,
+  // the records of the three record variables interleaved
+  auto appendUInt = []( std::string& out, unsigned long value, int numBytes ) {
+    for( int shift = 8 * numBytes - 8; shift >= 0; shift -= 8 )
+      out += static_cast<char>( ( value >> shift ) & 0xFF );
+  };
+  auto appendName = [&]( std::string& out, const std::string& name ) {
+    appendUInt( out, name.size(), 4 );
+    out += name;
+    out.append( ( 4 - name.size() % 4 ) % 4, '\0' );
+  };
+  auto appendDoubles = [&]( std::string& out, std::initializer_list<double> values ) {
+    for( double value : values )
+      {
+      unsigned long long bits;
+      std::memcpy( &bits, &value, sizeof( bits ) );
+      appendUInt( out, bits >> 32, 4 );
+      appendUInt( out, bits & 0xFFFFFFFFUL, 4 );
+      }
+  };
+  auto appendTextAttribute = [&]( std::string& out, const std::string& name, const std::string& text ) {
+    appendName( out, name );
+    appendUInt( out, 2, 4 );
+    appendName( out, text );
+  };
+  auto appendDoubleAttribute = [&]( std::string& out, const std::string& name,
+				    std::initializer_list<double> values ) {
+    appendName( out, name );
+    appendUInt( out, 6, 4 );
+    appendUInt( out, values.size(), 4 );
+    appendDoubles( out, values );
+  };
+
+  const unsigned long numRecords = 2, numRows = 3, numColumns = 4;
+  const unsigned long imageBytes = numRows * numColumns * 2;
+
+  auto header = [&]( unsigned long begin ) {
+    std::string out( "CDF\1" );
+    appendUInt( out, numRecords, 4 );
+
+    appendUInt( out, 0x0A, 4 );
+    appendUInt( out, 3, 4 );
+    appendName( out, "time" );
+    appendUInt( out, 0, 4 );
+    appendName( out, "yspace" );
+    appendUInt( out, numRows, 4 );
+    appendName( out, "xspace" );
+    appendUInt( out, numColumns, 4 );
+
+    appendUInt( out, 0, 4 );
+    appendUInt( out, 0, 4 );
+
+    appendUInt( out, 0x0B, 4 );
+    appendUInt( out, 5, 4 );
+
+    // Scalar dimension variables, then the record variables
+    appendName( out, "yspace" );
+    appendUInt( out, 0, 4 );
+    appendUInt( out, 0x0C, 4 );
+    appendUInt( out, 2, 4 );
+    appendDoubleAttribute( out, "step", { 2.0 } );
+    appendDoubleAttribute( out, "start", { 10.0 } );
+    appendUInt( out, 6, 4 );
+    appendUInt( out, 8, 4 );
+    appendUInt( out, begin, 4 );
+
+    appendName( out, "xspace" );
+    appendUInt( out, 0, 4 );
+    appendUInt( out, 0x0C, 4 );
+    appendUInt( out, 2, 4 );
+    appendDoubleAttribute( out, "step", { 0.5 } );
+    appendDoubleAttribute( out, "start", { -1.0 } );
+    appendUInt( out, 6, 4 );
+    appendUInt( out, 8, 4 );
+    appendUInt( out, begin + 8, 4 );
+
+    const char* const rangeNames[] = { "image-min", "image-max" };
+    for( int r = 0; r < 2; ++r )
+      {
+      appendName( out, rangeNames[r] );
+      appendUInt( out, 1, 4 );
+      appendUInt( out, 0, 4 );
+      appendUInt( out, 0, 4 );
+      appendUInt( out, 0, 4 );
+      appendUInt( out, 6, 4 );
+      appendUInt( out, 8, 4 );
+      appendUInt( out, begin + 16 + 8 * r, 4 );
+      }
+
+    appendName( out, "image" );
+    appendUInt( out, 3, 4 );
+    appendUInt( out, 0, 4 );
+    appendUInt( out, 1, 4 );
+    appendUInt( out, 2, 4 );
+    appendUInt( out, 0x0C, 4 );
+    appendUInt( out, 2, 4 );
+    appendTextAttribute( out, "signtype", "unsigned" );
+    appendDoubleAttribute( out, "valid_range", { 0.0, 65535.0 } );
+    appendUInt( out, 3, 4 );
+    appendUInt( out, imageBytes, 4 );
+    appendUInt( out, begin + 32, 4 );
+    return out;
+  };
+
+  // Voxels past 32767, so that they only read right as unsigned
+  auto voxel = [&]( unsigned long record, unsigned long i ) {
+    return static_cast<unsigned short>( 60000 + record * 100 + i );
+  };
+
+  const double imageMin[2] = { 0.0, 100.0 };
+  const double imageMax[2] = { 65535.0, 100.0 + 2 * 65535.0 };
+
+  std::string bytes = header( 0 );
+  bytes = header( bytes.size() );
+  appendDoubles( bytes, { 10.0, -1.0 } );
+  for( unsigned long r = 0; r < numRecords; ++r )
+    {
+    appendDoubles( bytes, { imageMin[r], imageMax[r] } );
+    for( unsigned long i = 0; i < numRows * numColumns; ++i )
+      appendUInt( bytes, voxel( r, i ), 2 );
+    }
+
+  {
+  std::ofstream out( "netcdf.mnc", std::ios::binary | std::ios::trunc );
+  out.write( bytes.data(), bytes.size() );
+  }
+
+  itk::MINCNetCDFFile file;
+  ASSERT_TRUE( file.Open( "netcdf.mnc" ) );
+  ASSERT_EQ( 3u, file.GetNumberOfDimensions() );
+  EXPECT_EQ( "time", file.GetDimensionName( 0 ) );
+  EXPECT_EQ( numRecords, file.GetDimensionSize( 0 ) );
+  EXPECT_EQ( numRows, file.GetDimensionSize( 1 ) );
+  EXPECT_EQ( numColumns, file.GetDimensionSize( 2 ) );
+
+  const int image = file.FindVariable( "image" );
+  ASSERT_EQ( 4, image );
+  EXPECT_EQ( itk::MINCNetCDFFile::Short, file.GetVariableType( image ) );
+  std::string signType;
+  EXPECT_TRUE( file.GetAttribute( image, "signtype", signType ) );
+  EXPECT_EQ( "unsigned", signType );
+
+  std::vector<double> values;
+  EXPECT_TRUE( file.GetAttribute( image, "valid_range", values ) );
+  EXPECT_EQ( std::vector<double>( { 0.0, 65535.0 } ), values );
+  EXPECT_TRUE( file.ReadValues( file.FindVariable( "image-max" ), values ) );
+  EXPECT_EQ( std::vector<double>( imageMax, imageMax + 2 ), values );
+  EXPECT_TRUE( file.ReadValues( file.FindVariable( "xspace" ), values ) );
+  EXPECT_EQ( std::vector<double>( 1, -1.0 ), values );
+
+  // Records are read across the values of the other record variables
+  const unsigned long starts[3] = { 0, 1, 1 };
+  const unsigned long counts[3] = { 2, 2, 3 };
+  std::vector<unsigned short> stored( 12 );
+  ASSERT_TRUE( file.ReadHyperslab( image, starts, counts, &stored[0] ) );
+  for( unsigned long r = 0, n = 0; r < 2; ++r )
+    for( unsigned long j = 1; j < 3; ++j )
+      for( unsigned long k = 1; k < 4; ++k, ++n )
+	EXPECT_EQ( voxel( r, j * numColumns + k ), stored[n] ) << r << "," << j << "," << k;
+  file.Close();
+
+  // The image as MINCImageIO sees it
+  itk::ImageIORegion region( 3 );
+  region.SetSize( 0, numRecords );
+  region.SetSize( 1, numRows );
+  region.SetSize( 2, numColumns );
+
+  mImageIO->SetUseRawVoxels( true );
+  ReadImageInformation( "netcdf.mnc" );
+  ASSERT_EQ( 3u, mImageIO->GetNumberOfDimensions() );
+  EXPECT_EQ( numRecords, mImageIO->GetDimensions( 0 ) );
+  EXPECT_EQ( numRows, mImageIO->GetDimensions( 1 ) );
+  EXPECT_EQ( numColumns, mImageIO->GetDimensions( 2 ) );
+  EXPECT_DOUBLE_EQ( 2.0, mImageIO->GetSpacing( 1 ) );
+  EXPECT_DOUBLE_EQ( 0.5, mImageIO->GetSpacing( 2 ) );
+  EXPECT_EQ( itk::ImageIOBase::USHORT, mImageIO->GetComponentType() );
+
+  std::vector<double> slope, intercept;
+  const itk::MetaDataDictionary& dictionary = mImageIO->GetMetaDataDictionary();
+  ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( dictionary, "MINC_RescaleSlope", slope ) );
+  ASSERT_TRUE( itk::ExposeMetaData< std::vector<double> >( dictionary, "MINC_RescaleIntercept", intercept ) );
+  ASSERT_EQ( 2u, slope.size() );
+  ASSERT_EQ( 2u, intercept.size() );
+  for( unsigned long r = 0; r < numRecords; ++r )
+    {
+    EXPECT_DOUBLE_EQ( r + 1.0, slope[r] ) << "record " << r;
+    EXPECT_DOUBLE_EQ( imageMin[r], intercept[r] ) << "record " << r;
+    }
+
+  std::vector<unsigned short> raw( region.GetNumberOfPixels() );
+  mImageIO->SetIORegion( region );
+  mImageIO->Read( &raw[0] );
+  for( unsigned long i = 0; i < raw.size(); ++i )
+    EXPECT_EQ( voxel( i / 12, i % 12 ), raw[i] ) << "i=" << i;
+
+  // Real values, scaled record by record
+  mImageIO = ImageIO::New();
+  ReadImageInformation( "netcdf.mnc" );
+  mImageIO->SetComponentType( itk::ImageIOBase::FLOAT );
+  mImageIO->SetIORegion( region );
+  std::vector<float> real( region.GetNumberOfPixels() );
+  mImageIO->Read( &real[0] );
+  for( unsigned long i = 0; i < real.size(); ++i )
+    {
+    const unsigned long r = i / 12;
+    EXPECT_FLOAT_EQ( ( r + 1.0 ) * voxel( r, i % 12 ) + imageMin[r], real[i] ) << "i=" << i;
+    }
+}